@@ -0,0 +1,56 @@
+// mac_addr.h
+#ifndef MAC_ADDR_H
+#define MAC_ADDR_H
+
+#include <stdint.h>
+
+// BSSIDs are kept as the raw 48-bit MAC packed into the low bits of a
+// uint64_t instead of 17-char "AA:BB:CC:DD:EE:FF" strings.
+
+inline uint64_t macToKey(const uint8_t mac[6]) {
+  uint64_t k = 0;
+  for(int i=0; i<6; i++) k = (k << 8) | mac[i];
+  return k;
+}
+
+inline void keyToMac(uint64_t key, uint8_t mac[6]) {
+  for(int i=5; i>=0; i--){ mac[i] = (uint8_t)key; key >>= 8; }
+}
+
+inline int hexNibble(char c) {
+  if(c>='0' && c<='9') return c-'0';
+  if(c>='a' && c<='f') return c-'a'+10;
+  if(c>='A' && c<='F') return c-'A'+10;
+  return -1;
+}
+
+// Parses "AA:BB:CC:DD:EE:FF" (':' or '-' separated); false if malformed
+inline bool parseMac(const char* s, uint64_t &key) {
+  uint64_t k = 0;
+  for(int i=0; i<6; i++){
+    int hi = hexNibble(s[0]);
+    int lo = hi<0 ? -1 : hexNibble(s[1]);
+    if(lo<0) return false;
+    k = (k << 8) | (uint64_t)(hi*16 + lo);
+    s += 2;
+    if(i<5){
+      if(*s!=':' && *s!='-') return false;
+      s++;
+    }
+  }
+  key = k;
+  return *s == '\0';
+}
+
+// Writes "AA:BB:CC:DD:EE:FF" plus terminator into out[18]
+inline void formatMac(uint64_t key, char out[18]) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  for(int i=0; i<6; i++){
+    uint8_t b = (uint8_t)(key >> (8*(5-i)));
+    out[i*3]   = HEX_DIGITS[b >> 4];
+    out[i*3+1] = HEX_DIGITS[b & 0xF];
+    out[i*3+2] = (i<5) ? ':' : '\0';
+  }
+}
+
+#endif
@@ -0,0 +1,114 @@
+// mac_set.h
+#ifndef MAC_SET_H
+#define MAC_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Set of 48-bit MACs (see mac_addr.h) in one flat open-addressing table.
+// Each slot is a single uint64_t: the MAC with bit 63 set, 0 meaning empty.
+// Linear probing, power-of-two capacity, grows at 3/4 load. There is no
+// per-entry allocation, so memory is 8 bytes/slot, ~11-16 bytes per entry.
+class MacSet {
+public:
+  explicit MacSet(size_t initialCapacity = 64)
+    : slots_(nullptr), mask_(0), size_(0)
+  {
+    rehash(roundUp(initialCapacity));
+  }
+  ~MacSet() { free(slots_); }
+  MacSet(const MacSet&) = delete;
+  MacSet& operator=(const MacSet&) = delete;
+
+  bool contains(uint64_t mac) const {
+    if(!slots_) return false;
+    const uint64_t tagged = mac | OCCUPIED;
+    for(size_t i = mix(mac) & mask_; ; i = (i + 1) & mask_){
+      if(slots_[i] == tagged) return true;
+      if(slots_[i] == 0) return false;
+    }
+  }
+
+  // true if mac was added; false if it was already present or the table
+  // could not grow
+  bool insert(uint64_t mac) {
+    if((size_ + 1) * 4 > capacity() * 3){
+      if(!rehash(capacity() * 2)) return false;
+    }
+    const uint64_t tagged = mac | OCCUPIED;
+    size_t i = mix(mac) & mask_;
+    while(slots_[i] != 0){
+      if(slots_[i] == tagged) return false;
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = tagged;
+    size_++;
+    return true;
+  }
+
+  // Pre-size for n entries to avoid growing mid-scan
+  bool reserve(size_t n) {
+    size_t want = roundUp(n + n / 3 + 1);
+    return want <= capacity() || rehash(want);
+  }
+
+  void clear() {
+    for(size_t i=0; i<capacity(); i++) slots_[i] = 0;
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return slots_ ? mask_ + 1 : 0; }
+  size_t memoryBytes() const { return capacity() * sizeof(uint64_t); }
+
+  // Visits every MAC in table order
+  template<typename F> void forEach(F fn) const {
+    for(size_t i=0; i<capacity(); i++){
+      if(slots_[i] != 0) fn(slots_[i] & ~OCCUPIED);
+    }
+  }
+
+private:
+  static const uint64_t OCCUPIED = 1ULL << 63;
+
+  // murmur3 fmix64: every input bit affects every output bit, so MACs that
+  // share a vendor OUI still spread over the whole table
+  static uint64_t mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+  }
+
+  static size_t roundUp(size_t n) {
+    size_t c = 16;
+    while(c < n) c <<= 1;
+    return c;
+  }
+
+  bool rehash(size_t newCap) {
+    uint64_t* fresh = (uint64_t*)calloc(newCap, sizeof(uint64_t));
+    if(!fresh) return false;
+    const size_t newMask = newCap - 1;
+    for(size_t i=0; i<capacity(); i++){
+      uint64_t v = slots_[i];
+      if(v == 0) continue;
+      size_t j = mix(v & ~OCCUPIED) & newMask;
+      while(fresh[j] != 0) j = (j + 1) & newMask;
+      fresh[j] = v;
+    }
+    free(slots_);
+    slots_ = fresh;
+    mask_  = newMask;
+    return true;
+  }
+
+  uint64_t* slots_;
+  size_t    mask_;
+  size_t    size_;
+};
+
+#endif
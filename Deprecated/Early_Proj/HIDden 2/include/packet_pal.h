@@ -0,0 +1,106 @@
+// packet_pal.h
+#ifndef PACKET_PAL_H
+#define PACKET_PAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// How a scanned network becomes a Packet Pal, and how two of them fight:
+// pure C++, so the firmware and the host benches make the same monsters
+// and play the same battles from the same dice.
+
+// Numbered as wifi_auth_mode_t, so the scan's value can be passed straight in
+enum PalAuth {
+  PAL_AUTH_OPEN = 0,
+  PAL_AUTH_WEP,
+  PAL_AUTH_WPA_PSK,
+  PAL_AUTH_WPA2_PSK,
+  PAL_AUTH_WPA_WPA2_PSK,
+  PAL_AUTH_WPA2_ENTERPRISE,
+  PAL_AUTH_UNKNOWN
+};
+
+enum PalRarity {
+  PAL_COMMON,
+  PAL_UNCOMMON,
+  PAL_RARE,
+  PAL_LEGENDARY
+};
+
+enum PalAbility {
+  PAL_ABILITY_NONE,
+  PAL_ABILITY_SHIELD,
+  PAL_ABILITY_PIERCE,
+  PAL_ABILITY_INVISIBILITY
+};
+
+// Arduino's random(lo, hi): lo <= r < hi
+typedef std::function<int(int lo, int hi)> PalDice;
+
+// The name is kept as indices into the prefix/suffix tables
+struct PacketPal {
+  uint8_t prefix;
+  uint8_t suffix;
+  uint8_t rarity;    // PalRarity
+  uint8_t ability;   // PalAbility
+  int hp;
+  int attack;
+  int defense;
+  int level;
+};
+
+extern const uint8_t PAL_PREFIX_COUNT;
+extern const uint8_t PAL_SUFFIX_COUNT;
+
+// "OPEN", "WPA2_PSK", ..., wifi_auth_mode_t's names; anything past
+// WPA2_ENTERPRISE is "UNKNOWN"
+const char* palAuthName(int auth);
+// The reverse; PAL_AUTH_UNKNOWN for anything else
+PalAuth palAuthFromName(const char* s);
+const char* palRarityName(uint8_t rarity);
+const char* palAbilityName(uint8_t ability);
+// "Packapal", "Bytebot", ...; truncated to fit out
+void palName(const PacketPal &p, char* out, size_t size);
+
+int clampInt(int val, int minVal, int maxVal);
+// -100 dBm gives 100, -30 dBm 170
+int mapRSSIToHP(int rssi);
+int attackForAuth(int auth);
+
+// A fresh monster for a network heard at rssi; the dice pick its name
+PacketPal makePacketPal(int rssi, int auth, const PalDice &dice);
+// Rolls a level within 3 of the player's and scales the stats by it
+void scalePacketPal(PacketPal &p, int playerLevel, const PalDice &dice);
+
+// The stats a fight uses; hp is what is left
+struct PalFighter {
+  int hp;
+  int attack;
+  int defense;
+};
+
+enum PalFightOutcome {
+  PAL_PLAYER_WINS,
+  PAL_WILD_WINS
+};
+
+struct PalFightResult {
+  uint8_t outcome;   // PalFightOutcome
+  int turns;         // hits dealt, both sides
+  int crits;
+  PalFighter player;
+  PalFighter wild;
+};
+
+// Called after each hit with the attacker's side and the defender's hp left
+typedef std::function<void(bool playerHit, int damage, bool crit, int defenderHp)> PalHitFn;
+
+// One hit: attack less a quarter of the defense, at least 1, doubled on a
+// 10% critical
+int palAttackDamage(int attack, int defense, const PalDice &dice, bool* crit);
+// Hits in turn, the player first, until one side has no hp left
+PalFightResult palFight(const PalFighter &player, const PalFighter &wild,
+                        const PalDice &dice, const PalHitFn &onHit = nullptr);
+
+#endif
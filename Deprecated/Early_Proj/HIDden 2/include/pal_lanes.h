@@ -0,0 +1,67 @@
+// pal_lanes.h
+#ifndef PAL_LANES_H
+#define PAL_LANES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "packet_pal.h"
+
+// Many palFight()s at once, for odds and matchmaking: the fights are kept
+// as a struct of arrays and advanced in lockstep, width() lanes per
+// vector step (AVX2 or SSE4.1 on a host that has them, one lane at a time
+// otherwise, e.g. on the board). Each step is one hit in every lane, with
+// the side that hits picked per lane from its turn count, so no branch
+// depends on a lane; a lane whose fight ends takes the next one.
+//
+// The crit dice are counter-based: draw k of lane i is a pure function of
+// (seed, i, k), so a lane carries no RNG state between turns, and any lane
+// can be replayed on its own through palFight() with palLaneDice().
+class PalLaneBattles {
+public:
+  enum Kernel {
+    BEST,     // the widest this build has
+    SCALAR    // one lane at a time, for checking the vector kernel
+  };
+
+  // n fights, all with no hp (and so over) until set()
+  PalLaneBattles(size_t n, uint32_t seed);
+
+  void set(size_t i, const PalFighter &player, const PalFighter &wild);
+  // New dice for every lane, so one instance can be reused for run after
+  // run without allocating
+  void reseed(uint32_t seed);
+  // Plays every fight to the end; set() the lanes again before another run
+  void run(Kernel k = BEST);
+  // As palFight() would have returned it with lane i's dice
+  PalFightResult result(size_t i) const;
+
+  size_t size() const { return n_; }
+  uint32_t seed() const { return seed_; }
+
+  // "avx2", "sse4.1" or "scalar", and its lanes per step
+  static const char* kernelName();
+  static size_t width();
+
+private:
+  void runScalar(size_t from, size_t to);
+
+  size_t n_;
+  uint32_t seed_;
+  std::vector<int32_t> playerHp_, wildHp_;
+  std::vector<int32_t> playerDmg_, wildDmg_;   // damage per hit before a crit
+  std::vector<int32_t> playerAtk_, playerDef_, wildAtk_, wildDef_;
+  std::vector<uint32_t> key_;
+  std::vector<int32_t> turns_, crits_;
+};
+
+// The counter-based generator: lowbias32 of the lane's key plus the draw
+// number times the golden ratio
+uint32_t palLaneKey(uint32_t seed, uint32_t lane);
+uint32_t palLaneDraw(uint32_t key, uint32_t draw);
+
+// Lane i's dice as a PalDice, for palFight(): lo + u * (hi - lo) / 2^32
+// for each draw in turn. counter must outlive the dice.
+PalDice palLaneDice(uint32_t seed, uint32_t lane, uint32_t &counter);
+
+#endif
@@ -0,0 +1,27 @@
+// scan_pipeline.h
+#ifndef SCAN_PIPELINE_H
+#define SCAN_PIPELINE_H
+
+#include <stdint.h>
+#include "mac_set.h"
+#include "packet_pal.h"
+
+// Scan to roster in one pass: each network is taken as the radio reports
+// it, deduped against the BSSIDs already met and, if new, made into a
+// Packet Pal and scaled to the player's level there and then. Nothing is
+// staged in a document or on flash between the scan and the roster.
+
+// One scan result, as WiFi.BSSID()/RSSI()/encryptionType() give it
+struct PalScanHit {
+  uint64_t bssid;   // mac_addr.h key
+  int rssi;
+  int auth;         // wifi_auth_mode_t; PalAuth numbers it the same
+};
+
+// For a network not met before: adds it to seen and makes its pal in out.
+// False, with no dice drawn, for one already in seen. The dice are drawn
+// as makePacketPal() then scalePacketPal() draw them.
+bool palFromScan(const PalScanHit &r, MacSet &seen, int playerLevel,
+                 const PalDice &dice, PacketPal &out);
+
+#endif
@@ -2,8 +2,10 @@
   PacketPals AP + Web UI Example
   - Creates a Wi-Fi AP named "PacketPals-AP"
   - Serves a web UI from /index.html (on SPIFFS or LittleFS)
-  - Provides endpoints: /scan, /monsters, /battle
-  - Uses custom hasher for Arduino String in std::unordered_set
+  - Provides endpoints: /scan, /monsters, /battle, /odds
+  - Tracks seen BSSIDs as raw MACs in a flat MacSet
+  - Scan results go straight to the roster; /monsters.json is
+    written behind from loop()
 *************************************************************/
 
 #include <WiFi.h>
@@ -11,30 +13,22 @@
 #include <WebServer.h>
 #include <ArduinoJson.h>
 #include <vector>
-#include <unordered_set>
-
-// 1) Custom Hasher & Equality for Arduino String
-struct StringHash {
-  size_t operator()(const String &key) const {
-    const char* str = key.c_str();
-    size_t hash = 0;
-    while (*str) {
-      hash = 37 * hash + (unsigned char)(*str++);
-    }
-    return hash;
-  }
-};
-
-struct StringEqual {
-  bool operator()(const String &a, const String &b) const {
-    return a == b;  // Arduino String equality
-  }
-};
+#include "mac_addr.h"
+#include "mac_set.h"
+#include "packet_pal.h"
+#include "pal_lanes.h"
+#include "scan_pipeline.h"
 
 // File paths in SPIFFS
-#define JSON_FILE_PATH    "/scanned_data.json"
 #define MONSTER_FILE_PATH "/monsters.json"
+#ifndef PERSIST_MONSTERS
+#define PERSIST_MONSTERS  1      // 0: the roster lives in RAM only
+#endif
+#define PERSIST_DELAY_MS  2000   // write-behind delay for /monsters.json
 #define MAX_PARTY_SIZE    6
+#define ODDS_SAMPLES      32   // fights per matchup behind a /odds estimate
+#define ODDS_PAGE_MAX     16   // matchups per /odds response
+#define ODDS_CHUNK        4    // matchups per lane run
 
 // ----------------------------------------------------------
 // Data Structures
@@ -51,15 +45,6 @@ struct Monster {
   String specialAbility;
 };
 
-struct BattleMonster {
-  String name;
-  int hp;
-  int attack;
-  int defense;
-  int level;
-  String specialAbility;
-};
-
 struct Player {
   Monster party[MAX_PARTY_SIZE];
   int partySize;
@@ -70,43 +55,25 @@ struct Player {
 // ----------------------------------------------------------
 Player gPlayer;                            // The player
 std::vector<Monster> gWildMonsters;        // In-memory list of wild monsters
-std::unordered_set<String, StringHash, StringEqual> encounteredBSSIDs; // track BSSIDs
+MacSet encounteredBSSIDs;                  // track BSSIDs (raw 48-bit MACs)
+#if PERSIST_MONSTERS
+bool gMonstersDirty = false;               // roster changed since /monsters.json
+unsigned long gMonstersDirtyAt = 0;
+#endif
 
 WebServer server(80);  // The main web server
+// /odds runs its fights here, ODDS_CHUNK matchups at a time; sized once at
+// boot so a request allocates no lanes
+PalLaneBattles gOddsLanes(ODDS_CHUNK * ODDS_SAMPLES, 0);
 
-// Fun naming arrays for Packet Pals
-static const char* NAME_PREFIXES[] = {
-  "Packa", "Byte", "Net", "Ping", "Data",
-  "Glitch", "Cypher", "Wire", "Flow", "Spark",
-  "Bug", "Volt", "Wave", "Beacon", "Link"
-};
-
-static const char* NAME_SUFFIXES[] = {
-  "pal", "bot", "ling", "zard", "tron", 
-  "pup", "geist", "buddy", "drone"
-};
+// Arduino's random() as the monster rules' dice
+static int arduinoDice(int lo, int hi) {
+  return (int)random(lo, hi);
+}
 
 // ----------------------------------------------------------
 // Helper & Utility Functions
 // ----------------------------------------------------------
-String generatePacketPalName() {
-  int prefixCount = sizeof(NAME_PREFIXES) / sizeof(NAME_PREFIXES[0]);
-  int suffixCount = sizeof(NAME_SUFFIXES) / sizeof(NAME_SUFFIXES[0]);
-
-  int pIdx = random(0, prefixCount);
-  int sIdx = random(0, suffixCount);
-
-  String prefix = NAME_PREFIXES[pIdx];
-  String suffix = NAME_SUFFIXES[sIdx];
-  return prefix + suffix;
-}
-
-int clampInt(int val, int minVal, int maxVal) {
-  if (val < minVal) return minVal;
-  if (val > maxVal) return maxVal;
-  return val;
-}
-
 // Wait for single-char input with a timeout
 char getUserChoice(unsigned long timeoutMs = 10000) {
   unsigned long start = millis();
@@ -121,8 +88,6 @@ char getUserChoice(unsigned long timeoutMs = 10000) {
   return '?';
 }
 
-// Arduino "String" is in a separate code base than std::string, so custom logic is needed for hashing.
-
 // ----------------------------------------------------------
 // Player & Party
 // ----------------------------------------------------------
@@ -149,202 +114,130 @@ void initPlayerParty() {
 }
 
 // ----------------------------------------------------------
-// Wi-Fi Scanning
+// Creating Monsters
 // ----------------------------------------------------------
-String encryptionTypeToString(wifi_auth_mode_t type) {
-  switch (type) {
-    case WIFI_AUTH_OPEN:          return "OPEN";
-    case WIFI_AUTH_WEP:           return "WEP";
-    case WIFI_AUTH_WPA_PSK:       return "WPA_PSK";
-    case WIFI_AUTH_WPA2_PSK:      return "WPA2_PSK";
-    case WIFI_AUTH_WPA_WPA2_PSK:  return "WPA_WPA2_PSK";
-    case WIFI_AUTH_WPA2_ENTERPRISE: return "WPA2_ENTERPRISE";
-    default: return "UNKNOWN";
-  }
-}
+// The rules themselves live in packet_pal.cpp; this is the roster entry
+Monster createPacketPal(uint64_t bssid, const PacketPal &p) {
+  char mac[18];
+  formatMac(bssid, mac);
+  char name[24];
+  palName(p, name, sizeof(name));
 
-void scanAndStoreNetworks() {
-  Serial.println("Scanning for Wi-Fi networks...");
-  int n = WiFi.scanNetworks(false, true);
-  
-  if (n <= 0) {
-    Serial.println("No networks found.");
-    return;
-  } else {
-    Serial.printf("%d networks found.\n", n);
-  }
-
-  DynamicJsonDocument doc(8192);
-  JsonArray nets = doc.createNestedArray("networks");
-
-  for (int i = 0; i < n; i++) {
-    JsonObject obj = nets.createNestedObject();
-    obj["ssid"]       = WiFi.SSID(i);
-    obj["bssid"]      = WiFi.BSSIDstr(i);
-    obj["rssi"]       = WiFi.RSSI(i);
-    obj["encryption"] = encryptionTypeToString(WiFi.encryptionType(i));
-  }
-
-  File file = SPIFFS.open(JSON_FILE_PATH, "w");
-  if (!file) {
-    Serial.println("Failed to open file for writing scanned data.");
-    return;
-  }
-
-  if (serializeJson(doc, file) == 0) {
-    Serial.println("Failed to write scanned data to file.");
-  } else {
-    Serial.println("Network data stored successfully to scanned_data.json");
-  }
-  file.close();
+  Monster m;
+  m.bssid          = mac;
+  m.name           = name;
+  m.type           = "Neutral";
+  m.hp             = p.hp;
+  m.attack         = p.attack;
+  m.defense        = p.defense;
+  m.level          = p.level;
+  m.rarity         = palRarityName(p.rarity);
+  m.specialAbility = palAbilityName(p.ability);
+  return m;
 }
 
 // ----------------------------------------------------------
-// Creating & Scaling Monsters
+// Persisting the Roster
 // ----------------------------------------------------------
-int mapRSSIToHP(int rssi) {
-  return 100 + (rssi + 100);
-}
-
-int calculateAttackFromEncryption(const String& enc) {
-  if (enc == "WPA2_PSK" || enc == "WPA_WPA2_PSK") return 20;
-  if (enc == "WEP") return 10;
-  if (enc == "OPEN") return 5;
-  return 15;
+// Writes gWildMonsters to /monsters.json one monster at a time, so no
+// document the size of the whole roster is built
+void saveMonsters() {
+  File outFile = SPIFFS.open(MONSTER_FILE_PATH, "w");
+  if (!outFile) {
+    Serial.println("Failed to open /monsters.json for writing");
+    return;
+  }
+  outFile.print("{\"monsters\":[");
+  for (size_t i = 0; i < gWildMonsters.size(); i++) {
+    const Monster &m = gWildMonsters[i];
+    StaticJsonDocument<384> mob;
+    mob["bssid"]   = m.bssid;
+    mob["name"]    = m.name;
+    mob["type"]    = m.type;
+    mob["hp"]      = m.hp;
+    mob["attack"]  = m.attack;
+    mob["defense"] = m.defense;
+    mob["level"]   = m.level;
+    mob["rarity"]  = m.rarity;
+    mob["ability"] = m.specialAbility;
+    if (i) outFile.print(",");
+    serializeJson(mob, outFile);
+  }
+  outFile.print("]}");
+  outFile.close();
 }
 
-Monster createPacketPal(const String& bssid, int rssi, const String& enc) {
-  Monster m;
-  m.bssid    = bssid;
-  m.name     = generatePacketPalName();
-  m.type     = "Neutral";
-  m.hp       = mapRSSIToHP(rssi);
-  m.defense  = m.hp / 2;
-  m.attack   = calculateAttackFromEncryption(enc);
-
-  int baseLevel = clampInt(m.hp / 10, 1, 99);
-  m.level = baseLevel;
-
-  // Rarity logic
-  if (enc == "OPEN") m.rarity = "Common";
-  else if (enc == "WEP") m.rarity = "Uncommon";
-  else if (enc == "WPA2_PSK" || enc == "WPA_WPA2_PSK") m.rarity = "Rare";
-  else m.rarity = "Legendary"; // e.g. WPA2_ENTERPRISE or unknown
-
-  // Ability logic
-  if (enc == "WPA2_PSK")         { m.specialAbility = "Shield"; }
-  else if (enc == "WEP")         { m.specialAbility = "Pierce"; }
-  else if (enc == "OPEN")        { m.specialAbility = "None"; }
-  else                           { m.specialAbility = "Invisibility"; }
-
-  return m;
+void markMonstersDirty() {
+#if PERSIST_MONSTERS
+  gMonstersDirty   = true;
+  gMonstersDirtyAt = millis();
+#endif
 }
 
-void scaleMonster(Monster &m, int playerLevel) {
-  int minLevel = clampInt(playerLevel - 3, 1, 99);
-  int maxLevel = clampInt(playerLevel + 3, 1, 99);
-  int newLevel = random(minLevel, maxLevel+1);
-
-  float scaleFactor = (float)newLevel / (float)m.level;
-  m.level   = newLevel;
-  m.hp      = clampInt((int)(m.hp * scaleFactor), 10, 999);
-  m.defense = clampInt((int)(m.defense * scaleFactor), 1, 999);
-  m.attack  = clampInt((int)(m.attack * scaleFactor), 1, 999);
+// From loop(): once the roster has stayed put for PERSIST_DELAY_MS, so the
+// write never holds up the response that changed it, and a scan followed
+// by a few battles is saved once
+void persistMonsters() {
+#if PERSIST_MONSTERS
+  if (!gMonstersDirty || millis() - gMonstersDirtyAt < PERSIST_DELAY_MS) return;
+  gMonstersDirty = false;
+  unsigned long start = millis();
+  saveMonsters();
+  Serial.printf("Monsters stored to /monsters.json in %lu ms\n", millis() - start);
+#endif
 }
 
+// ----------------------------------------------------------
+// Wi-Fi Scanning
+// ----------------------------------------------------------
 /**
- * Reads scanned_data.json, creates packet pals for each new BSSID,
- * scales them to player's level, and stores them in gWildMonsters.
+ * Scans, then streams each result straight into gWildMonsters: deduped
+ * against encounteredBSSIDs, made into a packet pal and scaled to the
+ * player's level as it is read (scan_pipeline.h). Nothing goes through
+ * flash on the way; /monsters.json is written later from loop().
  */
-void generateAndStoreMonsters() {
-  File inputFile = SPIFFS.open(JSON_FILE_PATH, "r");
-  if (!inputFile) {
-    Serial.println("scanned_data.json not found or open error");
-    return;
-  }
-
-  DynamicJsonDocument doc(8192);
-  DeserializationError err = deserializeJson(doc, inputFile);
-  inputFile.close();
-  
-  if (err) {
-    Serial.println("Failed to parse scanned_data.json");
-    return;
-  }
+void scanIntoRoster() {
+  Serial.println("Scanning for Wi-Fi networks...");
+  unsigned long scanStart = millis();
+  int n = WiFi.scanNetworks(false, true);
+  unsigned long scanMs = millis() - scanStart;
 
-  // Clear old data
+  // an empty scan empties the stored roster too
   gWildMonsters.clear();
-
-  Monster &active = getActiveMonster();
-  int pLevel = active.level;
-
-  JsonArray networks = doc["networks"];
-  if (networks.isNull()) {
-    Serial.println("No networks array in scanned_data.json");
+  markMonstersDirty();
+  if (n <= 0) {
+    Serial.println("No networks found.");
     return;
   }
+  Serial.printf("%d networks found.\n", n);
 
-  for (JsonObject net : networks) {
-    String bssid = net["bssid"].as<String>();
-    String enc   = net["encryption"].as<String>();
-    int rssi     = net["rssi"].as<int>();
-
-    // Skip if we have encountered this BSSID
-    if (encounteredBSSIDs.find(bssid) != encounteredBSSIDs.end()) {
-      continue;
-    }
-
-    Monster m = createPacketPal(bssid, rssi, enc);
-    scaleMonster(m, pLevel);
-
-    encounteredBSSIDs.insert(bssid);
-    gWildMonsters.push_back(m);
-  }
+  int pLevel = getActiveMonster().level;
+  encounteredBSSIDs.reserve(encounteredBSSIDs.size() + n);
 
-  // Optional: If you want to store the newly generated monsters in a file (monsters.json)
-  {
-    DynamicJsonDocument monstersDoc(8192);
-    JsonArray arr = monstersDoc.createNestedArray("monsters");
-    for (auto &m : gWildMonsters) {
-      JsonObject mob = arr.createNestedObject();
-      mob["bssid"]   = m.bssid;
-      mob["name"]    = m.name;
-      mob["type"]    = m.type;
-      mob["hp"]      = m.hp;
-      mob["attack"]  = m.attack;
-      mob["defense"] = m.defense;
-      mob["level"]   = m.level;
-      mob["rarity"]  = m.rarity;
-      mob["ability"] = m.specialAbility;
-    }
-    File outFile = SPIFFS.open(MONSTER_FILE_PATH, "w");
-    if (outFile) {
-      serializeJson(monstersDoc, outFile);
-      outFile.close();
-      Serial.println("Monsters stored to /monsters.json");
-    }
+  unsigned long rosterStart = micros();
+  for (int i = 0; i < n; i++) {
+    uint8_t *mac = WiFi.BSSID(i);
+    if (!mac) continue;
+    PalScanHit rec;
+    rec.bssid = macToKey(mac);
+    rec.rssi  = WiFi.RSSI(i);
+    rec.auth  = WiFi.encryptionType(i);
+
+    PacketPal p;
+    if (!palFromScan(rec, encounteredBSSIDs, pLevel, arduinoDice, p)) continue;
+    gWildMonsters.push_back(createPacketPal(rec.bssid, p));
   }
+  unsigned long rosterUs = micros() - rosterStart;
+  WiFi.scanDelete();
 
-  Serial.println("Monsters generated and stored in memory (and optionally /monsters.json).");
+  Serial.printf("Scan %lu ms, %u new monsters in %lu us\n",
+                scanMs, (unsigned)gWildMonsters.size(), rosterUs);
 }
 
 // ----------------------------------------------------------
 // Battle System
 // ----------------------------------------------------------
-int performAttack(BattleMonster &attacker, BattleMonster &defender) {
-  int damage = attacker.attack - (defender.defense / 4);
-  if (damage < 1) damage = 1;
-
-  int critChance = random(0, 100);
-  if (critChance < 10) {
-    Serial.println("A critical hit!");
-    damage *= 2;
-  }
-
-  defender.hp -= damage;
-  return damage;
-}
-
+// The rules themselves are palFight() in packet_pal.cpp
 String doBattle(int monsterIndex) {
   if (monsterIndex < 0 || monsterIndex >= (int)gWildMonsters.size()) {
     return "Invalid monster index!";
@@ -353,46 +246,29 @@ String doBattle(int monsterIndex) {
   Monster &act = getActiveMonster();
   Monster &chosen = gWildMonsters[monsterIndex];
 
-  // Convert to simpler BattleMonster for the fight
-  BattleMonster pBM = {
-    act.name, act.hp, act.attack, act.defense, act.level, act.specialAbility
-  };
-  BattleMonster wBM = {
-    chosen.name, chosen.hp, chosen.attack, chosen.defense, chosen.level, chosen.specialAbility
-  };
-
-  bool continuing = true;
-  bool m1Turn = true; // player first
-  while (pBM.hp > 0 && wBM.hp > 0 && continuing) {
-    BattleMonster &attacker = (m1Turn ? pBM : wBM);
-    BattleMonster &defender = (m1Turn ? wBM : pBM);
-
-    // For simplicity, let's do automatic attacks (no user prompts).
-    int dmg = performAttack(attacker, defender);
-    if (m1Turn) {
-      Serial.printf("%s attacks %s for %d damage. %s HP: %d\n",
-                    attacker.name.c_str(), defender.name.c_str(),
-                    dmg, defender.name.c_str(), defender.hp);
-    } else {
-      Serial.printf("%s counters %s for %d damage. %s HP: %d\n",
-                    attacker.name.c_str(), defender.name.c_str(),
-                    dmg, defender.name.c_str(), defender.hp);
-    }
-
-    m1Turn = !m1Turn;
-
-    if (pBM.hp <= 0 || wBM.hp <= 0) break;
-  }
+  PalFighter player = { act.hp, act.attack, act.defense };
+  PalFighter wild   = { chosen.hp, chosen.attack, chosen.defense };
+  const String &pName = act.name;
+  const String &wName = chosen.name;
+
+  // For simplicity, let's do automatic attacks (no user prompts).
+  PalFightResult r = palFight(player, wild, arduinoDice,
+    [&](bool playerHit, int dmg, bool crit, int defenderHp) {
+      if (crit) Serial.println("A critical hit!");
+      if (playerHit) {
+        Serial.printf("%s attacks %s for %d damage. %s HP: %d\n",
+                      pName.c_str(), wName.c_str(), dmg, wName.c_str(), defenderHp);
+      } else {
+        Serial.printf("%s counters %s for %d damage. %s HP: %d\n",
+                      wName.c_str(), pName.c_str(), dmg, pName.c_str(), defenderHp);
+      }
+    });
 
   // Decide outcome
-  if (pBM.hp <= 0 && wBM.hp <= 0) {
-    return "It's a draw! Both fainted!";
-  } else if (pBM.hp <= 0) {
-    return (pBM.name + " fainted! " + wBM.name + " wins!");
-  } else if (wBM.hp <= 0) {
-    return (wBM.name + " fainted! " + pBM.name + " wins!");
+  if (r.outcome == PAL_WILD_WINS) {
+    return (pName + " fainted! " + wName + " wins!");
   }
-  return "Battle ended unexpectedly.";
+  return (wName + " fainted! " + pName + " wins!");
 }
 
 // ----------------------------------------------------------
@@ -410,9 +286,7 @@ void handleRoot() {
 }
 
 void handleScan() {
-  // call our doScan
-  scanAndStoreNetworks();
-  generateAndStoreMonsters();
+  scanIntoRoster();
   server.send(200, "text/plain", "Scan + Monster Generation done");
 }
 
@@ -434,6 +308,90 @@ void handleGetMonsters() {
   server.send(200, "application/json", output);
 }
 
+/**
+ * Win odds, estimated from ODDS_SAMPLES fights per matchup on the
+ * lane-batched kernel:
+ *   /odds?offset=o&limit=l  the active monster against wild monsters
+ *                           o..o+l-1 (l at most ODDS_PAGE_MAX, the
+ *                           default); "next" is the following page's
+ *                           offset, -1 after the last
+ *   /odds?index=i           every party member against wild monster i, and
+ *                           the slot with the best chance
+ * Answers 503 if the response cannot be allocated.
+ */
+void handleOdds() {
+  bool onePal = server.hasArg("index");
+  int idx = onePal ? server.arg("index").toInt() : -1;
+  if (onePal && (idx < 0 || idx >= (int)gWildMonsters.size())) {
+    server.send(400, "text/plain", "Invalid monster index!");
+    return;
+  }
+  int total = onePal ? gPlayer.partySize : (int)gWildMonsters.size();
+  int offset = 0, count = total;
+  if (!onePal) {
+    offset = server.hasArg("offset") ? server.arg("offset").toInt() : 0;
+    int limit = server.hasArg("limit") ? server.arg("limit").toInt() : ODDS_PAGE_MAX;
+    if (offset < 0 || limit <= 0) {
+      server.send(400, "text/plain", "Invalid offset or limit!");
+      return;
+    }
+    if (limit > ODDS_PAGE_MAX) limit = ODDS_PAGE_MAX;
+    count = offset < total ? min(limit, total - offset) : 0;
+  }
+
+  int wins[ODDS_PAGE_MAX > MAX_PARTY_SIZE ? ODDS_PAGE_MAX : MAX_PARTY_SIZE] = { 0 };
+  int turns[sizeof(wins) / sizeof(wins[0])] = { 0 };
+  gOddsLanes.reseed((uint32_t)random(0x7fffffff));
+  for (int first = 0; first < count; first += ODDS_CHUNK) {
+    int n = min(ODDS_CHUNK, count - first);
+    for (int c = 0; c < n; c++) {
+      int m = first + c;
+      const Monster &p = onePal ? gPlayer.party[m] : getActiveMonster();
+      const Monster &w = onePal ? gWildMonsters[idx] : gWildMonsters[offset + m];
+      PalFighter pf = { p.hp, p.attack, p.defense };
+      PalFighter wf = { w.hp, w.attack, w.defense };
+      for (int k = 0; k < ODDS_SAMPLES; k++) gOddsLanes.set(c * ODDS_SAMPLES + k, pf, wf);
+    }
+    gOddsLanes.run();
+    for (int c = 0; c < n; c++) {
+      for (int k = 0; k < ODDS_SAMPLES; k++) {
+        PalFightResult r = gOddsLanes.result(c * ODDS_SAMPLES + k);
+        wins[first + c]  += r.outcome == PAL_PLAYER_WINS;
+        turns[first + c] += r.turns;
+      }
+    }
+  }
+
+  DynamicJsonDocument doc(512 + count * 96);
+  if (doc.capacity() == 0) {
+    server.send(503, "text/plain", "Out of memory, try again");
+    return;
+  }
+  JsonArray arr = doc.createNestedArray("odds");
+  int best = -1, bestWins = -1;
+  for (int m = 0; m < count; m++) {
+    if (wins[m] > bestWins) { best = m; bestWins = wins[m]; }
+    JsonObject obj = arr.createNestedObject();
+    obj["index"] = offset + m;
+    obj["name"]  = onePal ? gPlayer.party[m].name : gWildMonsters[offset + m].name;
+    obj["win"]   = (float)wins[m] / ODDS_SAMPLES;
+    obj["turns"] = (float)turns[m] / ODDS_SAMPLES;
+  }
+  if (onePal) {
+    doc["bestPartySlot"] = best;
+  } else {
+    doc["total"] = total;
+    doc["next"]  = offset + count < total ? offset + count : -1;
+  }
+
+  String output;
+  if (serializeJson(doc, output) == 0 || output.length() == 0) {
+    server.send(503, "text/plain", "Out of memory, try again");
+    return;
+  }
+  server.send(200, "application/json", output);
+}
+
 void handleBattleEndpoint() {
   if (!server.hasArg("index")) {
     server.send(400, "text/plain", "Missing 'index' parameter");
@@ -445,6 +403,7 @@ void handleBattleEndpoint() {
   // Optionally remove the monster from gWildMonsters
   if (idx >= 0 && idx < (int)gWildMonsters.size()) {
     gWildMonsters.erase(gWildMonsters.begin() + idx);
+    markMonstersDirty();
   }
 
   server.send(200, "text/plain", result);
@@ -476,6 +435,7 @@ void setup() {
   server.on("/scan", HTTP_GET, handleScan);
   server.on("/monsters", HTTP_GET, handleGetMonsters);
   server.on("/battle", HTTP_GET, handleBattleEndpoint);
+  server.on("/odds", HTTP_GET, handleOdds);
 
   // For anything else, 404
   server.onNotFound([](){
@@ -488,4 +448,5 @@ void setup() {
 
 void loop() {
   server.handleClient();
+  persistMonsters();
 }
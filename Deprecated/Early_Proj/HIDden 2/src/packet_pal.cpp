@@ -0,0 +1,147 @@
+// packet_pal.cpp
+#include "packet_pal.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* NAME_PREFIXES[] = {
+  "Packa", "Byte", "Net", "Ping", "Data",
+  "Glitch", "Cypher", "Wire", "Flow", "Spark",
+  "Bug", "Volt", "Wave", "Beacon", "Link"
+};
+
+static const char* NAME_SUFFIXES[] = {
+  "pal", "bot", "ling", "zard", "tron",
+  "pup", "geist", "buddy", "drone"
+};
+
+static const char* AUTH_NAMES[] = {
+  "OPEN", "WEP", "WPA_PSK", "WPA2_PSK", "WPA_WPA2_PSK", "WPA2_ENTERPRISE", "UNKNOWN"
+};
+
+const uint8_t PAL_PREFIX_COUNT = sizeof(NAME_PREFIXES) / sizeof(NAME_PREFIXES[0]);
+const uint8_t PAL_SUFFIX_COUNT = sizeof(NAME_SUFFIXES) / sizeof(NAME_SUFFIXES[0]);
+
+const char* palAuthName(int auth) {
+  if(auth < 0 || auth > PAL_AUTH_UNKNOWN) auth = PAL_AUTH_UNKNOWN;
+  return AUTH_NAMES[auth];
+}
+
+PalAuth palAuthFromName(const char* s) {
+  for(int a = PAL_AUTH_OPEN; a < PAL_AUTH_UNKNOWN; a++) {
+    if(strcmp(s, AUTH_NAMES[a]) == 0) return (PalAuth)a;
+  }
+  return PAL_AUTH_UNKNOWN;
+}
+
+const char* palRarityName(uint8_t rarity) {
+  switch(rarity) {
+    case PAL_COMMON:   return "Common";
+    case PAL_UNCOMMON: return "Uncommon";
+    case PAL_RARE:     return "Rare";
+    default:           return "Legendary";
+  }
+}
+
+const char* palAbilityName(uint8_t ability) {
+  switch(ability) {
+    case PAL_ABILITY_SHIELD: return "Shield";
+    case PAL_ABILITY_PIERCE: return "Pierce";
+    case PAL_ABILITY_INVISIBILITY: return "Invisibility";
+    default: return "None";
+  }
+}
+
+void palName(const PacketPal &p, char* out, size_t size) {
+  snprintf(out, size, "%s%s", NAME_PREFIXES[p.prefix % PAL_PREFIX_COUNT],
+           NAME_SUFFIXES[p.suffix % PAL_SUFFIX_COUNT]);
+}
+
+int clampInt(int val, int minVal, int maxVal) {
+  if(val < minVal) return minVal;
+  if(val > maxVal) return maxVal;
+  return val;
+}
+
+int mapRSSIToHP(int rssi) {
+  return 100 + (rssi + 100);
+}
+
+int attackForAuth(int auth) {
+  switch(auth) {
+    case PAL_AUTH_WPA2_PSK:
+    case PAL_AUTH_WPA_WPA2_PSK: return 20;
+    case PAL_AUTH_WEP:          return 10;
+    case PAL_AUTH_OPEN:         return 5;
+    default:                    return 15;
+  }
+}
+
+PacketPal makePacketPal(int rssi, int auth, const PalDice &dice) {
+  PacketPal p;
+  p.prefix  = (uint8_t)dice(0, PAL_PREFIX_COUNT);
+  p.suffix  = (uint8_t)dice(0, PAL_SUFFIX_COUNT);
+  p.hp      = mapRSSIToHP(rssi);
+  p.defense = p.hp / 2;
+  p.attack  = attackForAuth(auth);
+  p.level   = clampInt(p.hp / 10, 1, 99);
+
+  switch(auth) {
+    case PAL_AUTH_OPEN:         p.rarity = PAL_COMMON; break;
+    case PAL_AUTH_WEP:          p.rarity = PAL_UNCOMMON; break;
+    case PAL_AUTH_WPA2_PSK:
+    case PAL_AUTH_WPA_WPA2_PSK: p.rarity = PAL_RARE; break;
+    default:                    p.rarity = PAL_LEGENDARY; break;   // enterprise or unknown
+  }
+  // WPA_WPA2_PSK is Rare but, unlike WPA2_PSK, gets no Shield
+  switch(auth) {
+    case PAL_AUTH_WPA2_PSK: p.ability = PAL_ABILITY_SHIELD; break;
+    case PAL_AUTH_WEP:      p.ability = PAL_ABILITY_PIERCE; break;
+    case PAL_AUTH_OPEN:     p.ability = PAL_ABILITY_NONE; break;
+    default:                p.ability = PAL_ABILITY_INVISIBILITY; break;
+  }
+  return p;
+}
+
+void scalePacketPal(PacketPal &p, int playerLevel, const PalDice &dice) {
+  int minLevel = clampInt(playerLevel - 3, 1, 99);
+  int maxLevel = clampInt(playerLevel + 3, 1, 99);
+  int newLevel = dice(minLevel, maxLevel + 1);
+
+  float scaleFactor = (float)newLevel / (float)p.level;
+  p.level   = newLevel;
+  p.hp      = clampInt((int)(p.hp * scaleFactor), 10, 999);
+  p.defense = clampInt((int)(p.defense * scaleFactor), 1, 999);
+  p.attack  = clampInt((int)(p.attack * scaleFactor), 1, 999);
+}
+
+int palAttackDamage(int attack, int defense, const PalDice &dice, bool* crit) {
+  int damage = attack - (defense / 4);
+  if(damage < 1) damage = 1;
+
+  *crit = dice(0, 100) < 10;
+  if(*crit) damage *= 2;
+  return damage;
+}
+
+PalFightResult palFight(const PalFighter &player, const PalFighter &wild,
+                        const PalDice &dice, const PalHitFn &onHit) {
+  PalFightResult r;
+  r.turns = 0;
+  r.crits = 0;
+  r.player = player;
+  r.wild = wild;
+  bool playerTurn = true;
+  while(r.player.hp > 0 && r.wild.hp > 0) {
+    PalFighter &attacker = playerTurn ? r.player : r.wild;
+    PalFighter &defender = playerTurn ? r.wild : r.player;
+    bool crit;
+    int damage = palAttackDamage(attacker.attack, defender.defense, dice, &crit);
+    defender.hp -= damage;
+    r.turns++;
+    r.crits += crit;
+    if(onHit) onHit(playerTurn, damage, crit, defender.hp);
+    playerTurn = !playerTurn;
+  }
+  r.outcome = r.wild.hp <= 0 ? PAL_PLAYER_WINS : PAL_WILD_WINS;
+  return r;
+}
@@ -0,0 +1,267 @@
+// pal_lanes.cpp
+#include "pal_lanes.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PAL_LANES_AVX2 1
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define PAL_LANES_SSE41 1
+#endif
+
+static const uint32_t GOLDEN = 0x9e3779b9u;
+// palAttackDamage() crits when dice(0, 100) < 10, and with palLaneDice()
+// that is u * 100 / 2^32 < 10, i.e. u below this
+static const uint32_t CRIT_BELOW = (uint32_t)(((10ULL << 32) + 99) / 100);
+
+// Chris Wellons' lowbias32
+static inline uint32_t lowbias32(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+uint32_t palLaneKey(uint32_t seed, uint32_t lane) {
+  return lowbias32(seed ^ lowbias32(lane + 1));
+}
+
+uint32_t palLaneDraw(uint32_t key, uint32_t draw) {
+  return lowbias32(key + draw * GOLDEN);
+}
+
+PalDice palLaneDice(uint32_t seed, uint32_t lane, uint32_t &counter) {
+  uint32_t key = palLaneKey(seed, lane);
+  return [key, &counter](int lo, int hi) {
+    uint32_t u = palLaneDraw(key, counter++);
+    return lo + (int)(((uint64_t)u * (uint32_t)(hi - lo)) >> 32);
+  };
+}
+
+const char* PalLaneBattles::kernelName() {
+#if defined(PAL_LANES_AVX2)
+  return "avx2";
+#elif defined(PAL_LANES_SSE41)
+  return "sse4.1";
+#else
+  return "scalar";
+#endif
+}
+
+size_t PalLaneBattles::width() {
+#if defined(PAL_LANES_AVX2)
+  return 8;
+#elif defined(PAL_LANES_SSE41)
+  return 4;
+#else
+  return 1;
+#endif
+}
+
+PalLaneBattles::PalLaneBattles(size_t n, uint32_t seed)
+  : n_(n), seed_(seed),
+    playerHp_(n), wildHp_(n), playerDmg_(n), wildDmg_(n),
+    playerAtk_(n), playerDef_(n), wildAtk_(n), wildDef_(n),
+    key_(n), turns_(n), crits_(n)
+{
+  reseed(seed);
+}
+
+void PalLaneBattles::reseed(uint32_t seed) {
+  seed_ = seed;
+  for(size_t i = 0; i < n_; i++) key_[i] = palLaneKey(seed, (uint32_t)i);
+}
+
+void PalLaneBattles::set(size_t i, const PalFighter &player, const PalFighter &wild) {
+  playerHp_[i] = player.hp;
+  playerAtk_[i] = player.attack;
+  playerDef_[i] = player.defense;
+  wildHp_[i] = wild.hp;
+  wildAtk_[i] = wild.attack;
+  wildDef_[i] = wild.defense;
+  // what palAttackDamage() works out before its crit roll
+  int p = player.attack - (wild.defense / 4);
+  int w = wild.attack - (player.defense / 4);
+  playerDmg_[i] = p < 1 ? 1 : p;
+  wildDmg_[i] = w < 1 ? 1 : w;
+  turns_[i] = 0;
+  crits_[i] = 0;
+}
+
+PalFightResult PalLaneBattles::result(size_t i) const {
+  PalFightResult r;
+  r.turns = turns_[i];
+  r.crits = crits_[i];
+  r.player.hp = playerHp_[i];
+  r.player.attack = playerAtk_[i];
+  r.player.defense = playerDef_[i];
+  r.wild.hp = wildHp_[i];
+  r.wild.attack = wildAtk_[i];
+  r.wild.defense = wildDef_[i];
+  r.outcome = r.wild.hp <= 0 ? PAL_PLAYER_WINS : PAL_WILD_WINS;
+  return r;
+}
+
+void PalLaneBattles::runScalar(size_t from, size_t to) {
+  for(size_t i = from; i < to; i++) {
+    int32_t p = playerHp_[i], w = wildHp_[i];
+    int32_t turns = 0, crits = 0;
+    while(p > 0 && w > 0) {
+      bool crit = palLaneDraw(key_[i], (uint32_t)turns) < CRIT_BELOW;
+      if(turns & 1) p -= wildDmg_[i] << crit;
+      else w -= playerDmg_[i] << crit;
+      crits += crit;
+      turns++;
+    }
+    playerHp_[i] = p;
+    wildHp_[i] = w;
+    turns_[i] = turns;
+    crits_[i] = crits;
+  }
+}
+
+#if defined(PAL_LANES_AVX2) || defined(PAL_LANES_SSE41)
+
+#if defined(PAL_LANES_AVX2)
+// The handful of vector operations the kernel needs, for one ISA
+struct LaneOps {
+  typedef __m256i V;
+  static const size_t WIDTH = 8;
+  static V load(const void* p) { return _mm256_load_si256((const V*)p); }
+  static void store(void* p, V v) { _mm256_store_si256((V*)p, v); }
+  static V set1(uint32_t x) { return _mm256_set1_epi32((int)x); }
+  static V add(V a, V b) { return _mm256_add_epi32(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+  static V mul(V a, V b) { return _mm256_mullo_epi32(a, b); }
+  static V band(V a, V b) { return _mm256_and_si256(a, b); }
+  static V andNot(V a, V b) { return _mm256_andnot_si256(a, b); }   // ~a & b
+  static V bxor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V shr(V a, int n) { return _mm256_srli_epi32(a, n); }
+  static V gt(V a, V b) { return _mm256_cmpgt_epi32(a, b); }
+  static V eq(V a, V b) { return _mm256_cmpeq_epi32(a, b); }
+  static int mask(V a) { return _mm256_movemask_ps(_mm256_castsi256_ps(a)); }
+};
+#else
+struct LaneOps {
+  typedef __m128i V;
+  static const size_t WIDTH = 4;
+  static V load(const void* p) { return _mm_load_si128((const V*)p); }
+  static void store(void* p, V v) { _mm_store_si128((V*)p, v); }
+  static V set1(uint32_t x) { return _mm_set1_epi32((int)x); }
+  static V add(V a, V b) { return _mm_add_epi32(a, b); }
+  static V sub(V a, V b) { return _mm_sub_epi32(a, b); }
+  static V mul(V a, V b) { return _mm_mullo_epi32(a, b); }
+  static V band(V a, V b) { return _mm_and_si128(a, b); }
+  static V andNot(V a, V b) { return _mm_andnot_si128(a, b); }
+  static V bxor(V a, V b) { return _mm_xor_si128(a, b); }
+  static V shr(V a, int n) { return _mm_srli_epi32(a, n); }
+  static V gt(V a, V b) { return _mm_cmpgt_epi32(a, b); }
+  static V eq(V a, V b) { return _mm_cmpeq_epi32(a, b); }
+  static int mask(V a) { return _mm_movemask_ps(_mm_castsi128_ps(a)); }
+};
+#endif
+
+// Fights are fed through WIDTH slots: all slots step together until one
+// of them finishes, then its result is written back and the next fight
+// moved in, so a long fight holds up one slot rather than a whole vector.
+// Each slot keeps its own turn count, and its parity says whose hit it is.
+void PalLaneBattles::run(Kernel k) {
+  if(k == SCALAR) {
+    runScalar(0, n_);
+    return;
+  }
+  typedef LaneOps::V V;
+  const size_t W = LaneOps::WIDTH;
+  const size_t NONE = (size_t)-1;
+  alignas(32) int32_t p[W], w[W], pDmg[W], wDmg[W], turns[W], crits[W];
+  alignas(32) uint32_t ctr[W];
+  size_t idx[W];
+  size_t next = 0;
+
+  auto refill = [&](size_t s) {
+    while(next < n_) {
+      size_t i = next++;
+      if(playerHp_[i] > 0 && wildHp_[i] > 0) {
+        idx[s] = i;
+        p[s] = playerHp_[i];
+        w[s] = wildHp_[i];
+        pDmg[s] = playerDmg_[i];
+        wDmg[s] = wildDmg_[i];
+        ctr[s] = key_[i];
+        turns[s] = 0;
+        crits[s] = 0;
+        return;
+      }
+      turns_[i] = 0;   // over before the first hit
+      crits_[i] = 0;
+    }
+    idx[s] = NONE;
+    p[s] = w[s] = pDmg[s] = wDmg[s] = turns[s] = crits[s] = 0;
+    ctr[s] = 0;
+  };
+  for(size_t s = 0; s < W; s++) refill(s);
+
+  const V zero = LaneOps::set1(0);
+  const V one = LaneOps::set1(1);
+  // unsigned u < CRIT_BELOW as a signed compare with the sign bits flipped
+  const V sign = LaneOps::set1(0x80000000u);
+  const V critBelow = LaneOps::set1(CRIT_BELOW ^ 0x80000000u);
+  const V step = LaneOps::set1(GOLDEN);
+  const V m1 = LaneOps::set1(0x7feb352du);
+  const V m2 = LaneOps::set1(0x846ca68bu);
+  for(;;) {
+    V vp = LaneOps::load(p), vw = LaneOps::load(w);
+    V vpDmg = LaneOps::load(pDmg), vwDmg = LaneOps::load(wDmg);
+    V vturns = LaneOps::load(turns), vcrits = LaneOps::load(crits);
+    V vctr = LaneOps::load(ctr);
+    V active = LaneOps::band(LaneOps::gt(vp, zero), LaneOps::gt(vw, zero));
+    int live = LaneOps::mask(active);
+    if(!live) break;
+    int still;
+    do {
+      V u = vctr;   // lowbias32
+      u = LaneOps::bxor(u, LaneOps::shr(u, 16));
+      u = LaneOps::mul(u, m1);
+      u = LaneOps::bxor(u, LaneOps::shr(u, 15));
+      u = LaneOps::mul(u, m2);
+      u = LaneOps::bxor(u, LaneOps::shr(u, 16));
+      V crit = LaneOps::band(LaneOps::gt(critBelow, LaneOps::bxor(u, sign)), active);
+      V wildTurn = LaneOps::eq(LaneOps::band(vturns, one), one);
+      // a crit doubles the hit: dmg + (dmg & crit)
+      V hitP = LaneOps::add(vpDmg, LaneOps::band(vpDmg, crit));
+      V hitW = LaneOps::add(vwDmg, LaneOps::band(vwDmg, crit));
+      vw = LaneOps::sub(vw, LaneOps::band(hitP, LaneOps::andNot(wildTurn, active)));
+      vp = LaneOps::sub(vp, LaneOps::band(hitW, LaneOps::band(wildTurn, active)));
+      vturns = LaneOps::sub(vturns, active);   // active lanes are -1
+      vcrits = LaneOps::sub(vcrits, crit);
+      vctr = LaneOps::add(vctr, step);
+      active = LaneOps::band(active, LaneOps::band(LaneOps::gt(vp, zero), LaneOps::gt(vw, zero)));
+      still = LaneOps::mask(active);
+    } while(still == live);
+
+    LaneOps::store(p, vp);
+    LaneOps::store(w, vw);
+    LaneOps::store(turns, vturns);
+    LaneOps::store(crits, vcrits);
+    LaneOps::store(ctr, vctr);
+    for(size_t s = 0; s < W; s++) {
+      if(!((live & ~still) >> s & 1)) continue;
+      size_t i = idx[s];
+      playerHp_[i] = p[s];
+      wildHp_[i] = w[s];
+      turns_[i] = turns[s];
+      crits_[i] = crits[s];
+      refill(s);
+    }
+  }
+}
+
+#else
+
+void PalLaneBattles::run(Kernel) {
+  runScalar(0, n_);
+}
+
+#endif
@@ -0,0 +1,11 @@
+// scan_pipeline.cpp
+#include "scan_pipeline.h"
+
+bool palFromScan(const PalScanHit &r, MacSet &seen, int playerLevel,
+                 const PalDice &dice, PacketPal &out) {
+  if(seen.contains(r.bssid)) return false;
+  out = makePacketPal(r.rssi, r.auth, dice);
+  scalePacketPal(out, playerLevel, dice);
+  seen.insert(r.bssid);
+  return true;
+}
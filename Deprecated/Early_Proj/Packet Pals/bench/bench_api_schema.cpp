@@ -0,0 +1,210 @@
+// bench_api_schema.cpp
+// Host harness: heap allocations and time per JSON response, the old
+// handlers' path vs api_schema.h views written straight into a send
+// window.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_api_schema.cpp src/api_schema.cpp src/json_stream.cpp src/pull_sink.cpp -o /tmp/bench_api_schema
+//   /tmp/bench_api_schema
+//
+// "document" stands in for what each handler did before: names held as
+// Strings, the battle message grown with String +=, a DynamicJsonDocument
+// (one pool block) filled, serializeJson into a String out that grows as
+// it is written, and server.send copying out into the response. "schema"
+// fills the fixed-size view, measures the body for Content-Length and
+// renders it into a 1436-byte window, as SchemaResponse does. Allocations
+// are counted with a global operator new/delete; both bodies must match
+// byte for byte.
+#include <chrono>
+#include <functional>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "api_schema.h"
+
+static size_t allocations = 0;
+
+void* operator new(size_t n) {
+  allocations++;
+  void* p = malloc(n ? n : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const size_t SEND_WINDOW = 1436;
+static const int ROUNDS = 200000;
+
+static double nowNs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Mon {
+  const char* name;
+  int level, hp, defense;
+};
+static const Mon PARTY[3] = { { "StarDino", 7, 31, 12 }, { "TurboBee", 5, 25, 10 }, { "Lava\"Pup\"", 9, 37, 14 } };
+
+// --- old path --------------------------------------------------------------
+
+// DynamicJsonDocument(capacity): one pool block; its strings are copied in
+struct Document {
+  explicit Document(size_t capacity) : pool(new char[capacity]) {}
+  ~Document() { delete[] pool; }
+  char* pool;
+};
+
+// serializeJson(doc, out): the String grows as the writer appends
+class GrowingSink : public ByteSink {
+public:
+  explicit GrowingSink(std::string &out) : out_(out) {}
+  bool write(const char* data, size_t len) override {
+    for(size_t i = 0; i < len; i++) out_ += data[i];
+    return true;
+  }
+private:
+  std::string &out_;
+};
+
+static std::string sendOld(size_t capacity, const std::function<void(JsonStream&)> &emit) {
+  Document doc(capacity);
+  std::string out;
+  GrowingSink sink(out);
+  char buf[16];
+  JsonStream js(sink, buf, sizeof(buf));
+  emit(js);
+  js.flush();
+  std::string response = out;   // server.send(200, type, out)
+  return response;
+}
+
+static void partyOld(JsonStream &js, const char* message) {
+  js.beginObject();
+  if(message) js.field("message", message);
+  js.field("partySize", 3);
+  js.key("party");
+  js.beginArray();
+  for(const Mon &m : PARTY) {
+    std::string name = m.name;   // Monster::name is a String
+    js.beginObject();
+    js.field("name", name.c_str());
+    js.field("level", m.level);
+    js.field("hp", m.hp);
+    js.field("defense", m.defense);
+    js.endObject();
+  }
+  js.endArray();
+  js.endObject();
+}
+
+static void turnOld(JsonStream &js) {
+  std::string partyName = PARTY[0].name, wildName = "CosmicGhost";
+  std::string msg;
+  msg += partyName + " attacked for " + std::to_string(4) + " dmg. ";
+  msg += wildName + " countered for " + std::to_string(3) + " dmg. ";
+  msg += " " + wildName + " fainted! Your monster wins!";
+  js.beginObject();
+  js.field("message", msg.c_str());
+  js.field("partyHP", 28);
+  js.field("wildHP", -1);
+  js.field("battleEnd", true);
+  js.endObject();
+}
+
+// --- schema path -----------------------------------------------------------
+
+template<class View>
+static void fillParty(View &v) {
+  v.partySize = 3;
+  v.partyCount = 3;
+  for(int i = 0; i < 3; i++) {
+    snprintf(v.party[i].name, sizeof(v.party[i].name), "%s", PARTY[i].name);
+    v.party[i].level = PARTY[i].level;
+    v.party[i].hp = PARTY[i].hp;
+    v.party[i].defense = PARTY[i].defense;
+  }
+}
+
+static void fillTurn(BattleTurn &v) {
+  const char* partyName = PARTY[0].name;
+  const char* wildName = "CosmicGhost";
+  v.message[0] = 0;
+  appendField(v.message, sizeof(v.message), "%s attacked for %d dmg. ", partyName, 4);
+  appendField(v.message, sizeof(v.message), "%s countered for %d dmg. ", wildName, 3);
+  appendField(v.message, sizeof(v.message), " %s fainted! Your monster wins!", wildName);
+  v.partyHP = 28;
+  v.wildHP = -1;
+  v.battleEnd = true;
+}
+
+// SchemaResponse: Content-Length, then one window per _fillBuffer call
+template<class T>
+static size_t sendSchema(const T &view, uint8_t* window, std::string* keep) {
+  JsonBody<T> body(view);
+  size_t len = body.length(), sent = 0, n;
+  while((n = body.fill(window, SEND_WINDOW)) > 0) {
+    if(keep) keep->append((const char*)window, n);
+    sent += n;
+  }
+  return sent == len ? len : 0;
+}
+
+// --- harness ---------------------------------------------------------------
+
+struct Case {
+  const char* name;
+  std::function<std::string()> old;
+  std::function<size_t(uint8_t*, std::string*)> schema;
+};
+
+int main() {
+  static uint8_t window[SEND_WINDOW];
+  Case cases[] = {
+    { "myParty",
+      [] { return sendOld(1024, [](JsonStream &js) { partyOld(js, nullptr); }); },
+      [](uint8_t* w, std::string* keep) { Party v; fillParty(v); return sendSchema(v, w, keep); } },
+    { "swapPartySlots",
+      [] { return sendOld(256, [](JsonStream &js) {
+             std::string msg = "Swapped slots " + std::to_string(0) + " and " + std::to_string(2);
+             partyOld(js, msg.c_str()); }); },
+      [](uint8_t* w, std::string* keep) {
+        PartyChange v;
+        snprintf(v.message, sizeof(v.message), "Swapped slots %d and %d", 0, 2);
+        fillParty(v);
+        return sendSchema(v, w, keep); } },
+    { "battleAction",
+      [] { return sendOld(512, turnOld); },
+      [](uint8_t* w, std::string* keep) { BattleTurn v; fillTurn(v); return sendSchema(v, w, keep); } },
+  };
+
+  bool ok = true;
+  printf("%-15s %5s  %21s  %21s\n", "response", "bytes", "document", "schema");
+  for(Case &c : cases) {
+    std::string want = c.old();
+    std::string got;
+    ok = ok && c.schema(window, &got) > 0 && got == want;
+
+    size_t a0 = allocations;
+    double t0 = nowNs();
+    size_t sink = 0;
+    for(int i = 0; i < ROUNDS; i++) sink += c.old().size();
+    double oldNs = (nowNs() - t0) / ROUNDS;
+    double oldAllocs = (double)(allocations - a0) / ROUNDS;
+
+    // the lambdas are built once; only what a response does is counted
+    a0 = allocations;
+    t0 = nowNs();
+    for(int i = 0; i < ROUNDS; i++) sink += c.schema(window, nullptr);
+    double newNs = (nowNs() - t0) / ROUNDS;
+    double newAllocs = (double)(allocations - a0) / ROUNDS;
+
+    printf("%-15s %5zu  %5.1f allocs %6.0f ns  %5.1f allocs %6.0f ns%s\n", c.name, want.size(),
+           oldAllocs, oldNs, newAllocs, newNs, sink ? "" : " ");
+    ok = ok && newAllocs == 0;
+  }
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// bench_battle_lanes.cpp
+// Host harness for HIDden 2's lane-batched battle kernel (pal_lanes.h):
+// every lane checked against palFight(), the rules doBattle() plays, with
+// the same lane's dice, and a reseeded reuse against a fresh instance;
+// then battles/s one fight at a time vs the kernel.
+//
+//   g++ -std=gnu++17 -O2 -march=native -Iinclude -I"../HIDden 2/include" bench/bench_battle_lanes.cpp src/hal_posix.cpp "../HIDden 2/src/packet_pal.cpp" "../HIDden 2/src/pal_lanes.cpp" -o /tmp/bench_battle_lanes
+//   /tmp/bench_battle_lanes
+//
+// Build without -march=native (or with -mno-avx2 -mno-sse4.1) for the
+// scalar kernel, which is what the board runs.
+//
+// Matchups are monsters made and scaled as scanIntoRoster()
+// does, against Startmon and against each other, plus edge cases: a side
+// with no hp, damage floored at 1, one-hit fights.
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "pal_hal.h"
+#include "pal_lanes.h"
+#include "packet_pal.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t MATCHUPS = 200000;
+static const uint32_t SEED = 0x5eed;
+
+struct Matchup {
+  PalFighter player;
+  PalFighter wild;
+};
+
+static std::vector<Matchup> makeMatchups(size_t n) {
+  SeededRng rng(24);
+  PalDice dice = [&rng](int lo, int hi) { return rng.uniform(lo, hi); };
+  const PalFighter startmon = { 120, 10, 30 };
+  std::vector<Matchup> v;
+  for(size_t i = 0; i < n; i++) {
+    PacketPal a = makePacketPal(dice(-95, -29), dice(0, 7), dice);
+    PacketPal b = makePacketPal(dice(-95, -29), dice(0, 7), dice);
+    scalePacketPal(a, dice(1, 60), dice);
+    scalePacketPal(b, dice(1, 60), dice);
+    Matchup m;
+    m.player = (i % 3 == 0) ? startmon : PalFighter{ a.hp, a.attack, a.defense };
+    m.wild = { b.hp, b.attack, b.defense };
+    switch(i % 997) {
+      case 1: m.player.hp = 0; break;
+      case 2: m.wild.hp = 0; break;
+      case 3: m.player.attack = 1; m.wild.defense = 999; break;   // floored at 1
+      case 4: m.player.attack = 999; m.wild.hp = 1; break;        // one hit
+      case 5: m.wild.hp = -5; break;
+    }
+    v.push_back(m);
+  }
+  return v;
+}
+
+static bool same(const PalFightResult &a, const PalFightResult &b) {
+  return a.outcome == b.outcome && a.turns == b.turns && a.crits == b.crits
+      && a.player.hp == b.player.hp && a.wild.hp == b.wild.hp
+      && a.player.attack == b.player.attack && a.player.defense == b.player.defense
+      && a.wild.attack == b.wild.attack && a.wild.defense == b.wild.defense;
+}
+
+static double secondsSince(Clock::time_point t0) {
+  return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Fastest of a few runs, in battles/s
+template<class F> static double rate(size_t battles, F f) {
+  double best = 1e30;
+  for(int r = 0; r < 5; r++) {
+    Clock::time_point t0 = Clock::now();
+    f();
+    best = std::min(best, secondsSince(t0));
+  }
+  return battles / best;
+}
+
+int main() {
+  std::vector<Matchup> m = makeMatchups(MATCHUPS);
+  printf("kernel: %s, %u lanes per step\n", PalLaneBattles::kernelName(),
+         (unsigned)PalLaneBattles::width());
+
+  // equivalence: each lane against palFight() on its own dice
+  PalLaneBattles best(m.size(), SEED), scalar(m.size(), SEED);
+  for(size_t i = 0; i < m.size(); i++) {
+    best.set(i, m[i].player, m[i].wild);
+    scalar.set(i, m[i].player, m[i].wild);
+  }
+  best.run();
+  scalar.run(PalLaneBattles::SCALAR);
+  size_t mismatches = 0, drawMismatches = 0, playerWins = 0;
+  uint64_t turns = 0;
+  for(size_t i = 0; i < m.size(); i++) {
+    uint32_t counter = 0;
+    PalFightResult ref = palFight(m[i].player, m[i].wild, palLaneDice(SEED, (uint32_t)i, counter));
+    if(!same(ref, best.result(i)) || !same(ref, scalar.result(i))) {
+      if(mismatches < 5) {
+        PalFightResult k = best.result(i);
+        printf("  lane %u: palFight %d turns %d crits hp %d/%d, kernel %d turns %d crits hp %d/%d\n",
+               (unsigned)i, ref.turns, ref.crits, ref.player.hp, ref.wild.hp,
+               k.turns, k.crits, k.player.hp, k.wild.hp);
+      }
+      mismatches++;
+    }
+    if((int)counter != ref.turns) drawMismatches++;   // one draw per hit
+    playerWins += ref.outcome == PAL_PLAYER_WINS;
+    turns += ref.turns;
+  }
+  printf("equivalence: %u matchups, %u mismatches (%s and scalar kernels vs palFight), "
+         "player wins %.1f%%, %.1f turns per fight\n",
+         (unsigned)m.size(), (unsigned)mismatches, PalLaneBattles::kernelName(),
+         100.0 * playerWins / m.size(), (double)turns / m.size());
+
+  // reuse, as HIDden 2's /odds does: reseed, set only some lanes (the rest
+  // keep their finished fights), run again; must match a fresh instance
+  size_t reused = m.size() / 2, reuseMismatches = 0;
+  best.reseed(SEED + 1);
+  PalLaneBattles fresh(reused, SEED + 1);
+  for(size_t i = 0; i < reused; i++) {
+    best.set(i, m[i].player, m[i].wild);
+    fresh.set(i, m[i].player, m[i].wild);
+  }
+  best.run();
+  fresh.run();
+  for(size_t i = 0; i < reused; i++) reuseMismatches += !same(best.result(i), fresh.result(i));
+  printf("reuse: %u lanes reseeded and run again, %u mismatches against a fresh instance\n",
+         (unsigned)reused, (unsigned)reuseMismatches);
+
+  // throughput
+  volatile int sink = 0;
+  double oneRng = rate(m.size(), [&]() {
+    SeededRng rng(1);
+    PalDice dice = [&rng](int lo, int hi) { return rng.uniform(lo, hi); };
+    for(const Matchup &x : m) sink += palFight(x.player, x.wild, dice).turns;
+  });
+  double oneLane = rate(m.size(), [&]() {
+    for(size_t i = 0; i < m.size(); i++) {
+      uint32_t counter = 0;
+      sink += palFight(m[i].player, m[i].wild, palLaneDice(SEED, (uint32_t)i, counter)).turns;
+    }
+  });
+  // set() is part of the cost: a request fills the lanes from its monsters
+  double kScalar = rate(m.size(), [&]() {
+    PalLaneBattles k(m.size(), SEED);
+    for(size_t i = 0; i < m.size(); i++) k.set(i, m[i].player, m[i].wild);
+    k.run(PalLaneBattles::SCALAR);
+    sink += k.result(m.size() - 1).turns;
+  });
+  double kBest = rate(m.size(), [&]() {
+    PalLaneBattles k(m.size(), SEED);
+    for(size_t i = 0; i < m.size(); i++) k.set(i, m[i].player, m[i].wild);
+    k.run();
+    sink += k.result(m.size() - 1).turns;
+  });
+
+  printf("\n%-34s %14s %9s\n", "", "battles/s", "speedup");
+  printf("%-34s %14.0f %8.2fx\n", "palFight, SplitMix dice", oneRng, 1.0);
+  printf("%-34s %14.0f %8.2fx\n", "palFight, lane dice", oneLane, oneLane / oneRng);
+  printf("%-34s %14.0f %8.2fx\n", "lane kernel, scalar", kScalar, kScalar / oneRng);
+  char name[40];
+  snprintf(name, sizeof(name), "lane kernel, %s", PalLaneBattles::kernelName());
+  printf("%-34s %14.0f %8.2fx\n", name, kBest, kBest / oneRng);
+
+  bool ok = mismatches == 0 && drawMismatches == 0 && reuseMismatches == 0;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
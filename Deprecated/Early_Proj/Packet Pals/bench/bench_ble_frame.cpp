@@ -0,0 +1,185 @@
+// bench_ble_frame.cpp
+// Host harness for the BLE framing: effective bytes/s at different MTUs
+// over a loopback link, compared with one JSON object per notification,
+// plus reassembly under frame loss.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_ble_frame.cpp src/ble_frame.cpp -o /tmp/bench_ble_frame
+//   /tmp/bench_ble_frame
+//
+// The loopback stands in for the radio: a connection event every
+// INTERVAL_MS carries at most PER_EVENT notifications (what phones
+// typically allow), so time is connection events, not host time. The
+// workload is a play session's updates: bursts of new wild monsters from
+// a scan with the roster summary, and party updates from battle turns.
+// "json" is what ble_service.dart decodes today: one JSON object per
+// notification, which must fit mtu - 3 bytes or the app cannot parse it.
+// bytes/s counts the update data the app receives (record bodies or JSON
+// text), so framing and headers are the overhead; updates/s compares the
+// two on what the app actually learns.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ble_frame.h"
+
+static const double INTERVAL_MS = 15;
+static const int PER_EVENT = 4;
+static const int BURSTS = 200;
+
+struct Loopback : public BleLink {
+  std::vector<std::vector<uint8_t>> frames;
+  int dropPermille = 0;
+  size_t dropped = 0;
+  bool send(const uint8_t* frame, size_t len) override {
+    if(dropPermille && rand() % 1000 < dropPermille) {
+      dropped++;
+      return true;   // lost in the air: the sender does not know
+    }
+    frames.emplace_back(frame, frame + len);
+    return true;
+  }
+};
+
+struct Update {
+  uint8_t type;
+  std::vector<uint8_t> body;
+  std::string json;
+};
+
+static const char* NAMES[] = { "StarDino", "TurboBee", "LavaPup", "CosmicGhost", "MegaSprout", "NeonFox" };
+
+static std::vector<Update> session() {
+  std::vector<Update> u;
+  uint8_t buf[RECORD_MAX];
+  char json[256];
+  uint32_t id = 1;
+  srand(5);
+  for(int b = 0; b < BURSTS; b++) {
+    int found = 5 + rand() % 36;
+    for(int i = 0; i < found; i++, id++) {
+      const char* name = NAMES[rand() % 6];
+      uint8_t level = (uint8_t)(1 + rand() % 20);
+      size_t n = wildRecord(buf, sizeof(buf), id, level, name);
+      snprintf(json, sizeof(json), "{\"type\":\"wild\",\"id\":%u,\"name\":\"%s\",\"level\":%u}",
+               (unsigned)id, name, (unsigned)level);
+      u.push_back({ REC_WILD, std::vector<uint8_t>(buf, buf + n), json });
+    }
+    size_t n = rosterRecord(buf, sizeof(buf), (uint16_t)(id > 256 ? 256 : id - 1), id > 256 ? id - 256 : 1);
+    snprintf(json, sizeof(json), "{\"type\":\"roster\",\"total\":%u,\"firstId\":%u}",
+             (unsigned)(id > 256 ? 256 : id - 1), (unsigned)(id > 256 ? id - 256 : 1));
+    u.push_back({ REC_ROSTER, std::vector<uint8_t>(buf, buf + n), json });
+    for(int t = 0; t < 3; t++) {
+      BlePartyMonster party[3] = { { "StarterPal", 7, (int16_t)(60 - t * 4), 11 },
+                                   { "TurboBee", 5, 50, 9 }, { "LavaPup", 3, 40, 7 } };
+      n = partyRecord(buf, sizeof(buf), 9, party, 3);
+      std::string j = "{\"type\":\"party\",\"playerLevel\":9,\"party\":[";
+      for(int i = 0; i < 3; i++) {
+        snprintf(json, sizeof(json), "%s{\"name\":\"%s\",\"level\":%u,\"hp\":%d,\"defense\":%d}", i ? "," : "",
+                 party[i].name, party[i].level, party[i].hp, party[i].defense);
+        j += json;
+      }
+      j += "]}";
+      u.push_back({ REC_PARTY, std::vector<uint8_t>(buf, buf + n), j });
+    }
+  }
+  return u;
+}
+
+static double seconds(size_t notifications) {
+  return ((notifications + PER_EVENT - 1) / PER_EVENT) * INTERVAL_MS / 1000.0;
+}
+
+// Framed and batched: everything a burst produces goes out together
+static bool framed(const std::vector<Update> &u, size_t mtu, double &bps, double &ups, double &overhead) {
+  Loopback link;
+  BleBatcher tx(link, mtu);
+  size_t data = 0;
+  for(const Update &x : u) {
+    tx.add(x.type, x.body.data(), x.body.size());
+    data += x.body.size();
+    if(x.type == REC_PARTY) tx.flush();   // end of a burst's turn
+  }
+  tx.flush();
+
+  size_t i = 0;
+  bool ok = true;
+  BleRx rx([&](uint8_t type, const uint8_t* body, size_t len) {
+    ok = ok && i < u.size() && type == u[i].type && len == u[i].body.size() &&
+         memcmp(body, u[i].body.data(), len) == 0;
+    i++;
+  });
+  for(auto &f : link.frames) rx.receive(f.data(), f.size());
+  ok = ok && i == u.size() && rx.stats().gaps == 0;
+  bps = data / seconds(link.frames.size());
+  ups = u.size() / seconds(link.frames.size());
+  overhead = 100.0 * (tx.stats().frameBytes + link.frames.size() * ATT_HEADER - data) / data;
+  return ok;
+}
+
+// One JSON object per notification; ones longer than mtu - 3 are cut off
+static size_t jsonOnly(const std::vector<Update> &u, size_t mtu, double &bps, double &ups) {
+  size_t data = 0, fit = 0;
+  for(const Update &x : u) {
+    if(x.json.size() > mtu - ATT_HEADER) continue;
+    data += x.json.size();
+    fit++;
+  }
+  bps = data / seconds(u.size());
+  ups = fit / seconds(u.size());
+  return fit;
+}
+
+// Drops frames at random: whatever is delivered must be intact and in
+// order, and every loss must show up as a gap
+static bool lossy(const std::vector<Update> &u, int dropPermille) {
+  Loopback link;
+  link.dropPermille = dropPermille;
+  BleBatcher tx(link, 185);
+  srand(9);
+  for(const Update &x : u) {
+    tx.add(x.type, x.body.data(), x.body.size());
+    if(x.type == REC_PARTY) tx.flush();
+  }
+  tx.flush();
+
+  size_t next = 0, delivered = 0;
+  bool ok = true;
+  BleRx rx([&](uint8_t type, const uint8_t* body, size_t len) {
+    while(next < u.size() && !(u[next].type == type && u[next].body.size() == len &&
+                               memcmp(u[next].body.data(), body, len) == 0)) next++;
+    ok = ok && next < u.size();
+    next++;
+    delivered++;
+  });
+  for(auto &f : link.frames) rx.receive(f.data(), f.size());
+  const BleRx::Stats &s = rx.stats();
+  // a lost frame at the very end leaves no later seq to reveal the gap
+  ok = ok && (link.dropped == 0 || s.gaps > 0) && s.malformed == 0 &&
+       s.messages + s.dropped <= tx.stats().messages;
+  printf("loss %4.1f%%:  %zu of %u frames dropped, %u gaps, %u messages lost mid-way, %zu of %zu updates delivered  %s\n",
+         dropPermille / 10.0, link.dropped, tx.stats().frames, s.gaps, s.dropped, delivered, u.size(),
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main() {
+  std::vector<Update> u = session();
+  bool ok = true;
+  printf("%zu updates, connection event every %.1f ms, %d notifications per event\n\n", u.size(),
+         INTERVAL_MS, PER_EVENT);
+  printf("%5s  %10s %9s %9s  %10s %9s %10s\n", "mtu", "framed B/s", "updates/s", "overhead",
+         "json B/s", "updates/s", "json fits");
+  for(size_t mtu : { 23, 64, 185, 247, 517 }) {
+    double fb, fu, fo, jb, ju;
+    ok = framed(u, mtu, fb, fu, fo) && ok;
+    size_t fit = jsonOnly(u, mtu, jb, ju);
+    printf("%5zu  %10.0f %9.0f %8.1f%%  %10.0f %9.0f %5zu/%zu\n", mtu, fb, fu, fo, jb, ju, fit, u.size());
+  }
+  printf("\n");
+  ok = lossy(u, 0) && ok;
+  ok = lossy(u, 20) && ok;
+  ok = lossy(u, 100) && ok;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
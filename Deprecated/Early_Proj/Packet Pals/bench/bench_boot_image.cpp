@@ -0,0 +1,152 @@
+// bench_boot_image.cpp
+// Host harness: seen-set boot time and flash bytes read, full segment scan
+// (SeenIndex::begin) vs the boot image (beginFromImage), plus the fallbacks.
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ibench bench/bench_boot_image.cpp src/boot_image.cpp src/seen_index.cpp src/bssid_journal.cpp src/pal_fs_posix.cpp -o /tmp/bench_boot_image
+//   /tmp/bench_boot_image
+//
+// Checks: both boots answer contains() the same for every stored MAC and
+// a sample of unseen ones; an image left behind by an older segment, or
+// with one flipped byte, is refused so setup() takes the slow path.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "boot_image.h"
+#include "counting_fs.h"
+#include "seen_index.h"
+
+static double nowUs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static uint64_t randomMac() {
+  return (((uint64_t)rand() << 24) ^ (uint64_t)rand()) & 0xFFFFFFFFFFFFULL;
+}
+
+static void removeAll(PalFs &fs) {
+  const char* files[] = { "/seen.seg", "/bssids.bin", "/bssids.bin.tmp", "/boot.img" };
+  for(const char* f : files) fs.remove(f);
+  char path[32];
+  for(size_t i = 1; i < SeenIndex::SEGMENT_SLOTS; i++) {
+    snprintf(path, sizeof(path), "/seen.seg.%u", (unsigned)i);
+    fs.remove(path);
+  }
+}
+
+static bool flipByte(PalFs &fs, const char* path, size_t pos) {
+  std::unique_ptr<PalFile> f = fs.open(path, "r");
+  std::string s(f->size(), '\0');
+  f->read((uint8_t*)&s[0], s.size());
+  f.reset();
+  if(pos >= s.size()) return false;
+  s[pos] ^= 0x10;
+  f = fs.open(path, "w");
+  return f->write((const uint8_t*)s.data(), s.size()) == s.size();
+}
+
+static bool writeImage(PalFs &fs) {
+  SeenIndex seen(fs, "/seen.seg", "/bssids.bin");
+  seen.begin();
+  BootImageWriter w(fs, "/boot.img");
+  return seen.addToImage(w) && w.commit();
+}
+
+static bool fromImage(PalFs &fs) {
+  BootImageReader img(fs, "/boot.img");
+  SeenIndex seen(fs, "/seen.seg", "/bssids.bin");
+  return img.begin() && seen.beginFromImage(img);
+}
+
+static bool bench(PalFs &disk, size_t n) {
+  std::vector<uint64_t> macs(n), unseen(2000);
+  srand(13);
+  for(uint64_t &m : macs) m = randomMac();
+  for(uint64_t &m : unseen) m = randomMac() | (1ULL << 47);
+  {
+    SeenIndex seen(disk, "/seen.seg", "/bssids.bin");
+    seen.begin();
+    for(uint64_t m : macs) if(!seen.contains(m)) seen.insert(m);
+    seen.sync();
+    while(seen.merging()) seen.service();
+  }
+  bool ok = writeImage(disk);
+
+  CountingPalFs fs(disk);
+  double t0 = nowUs();
+  SeenIndex slow(fs, "/seen.seg", "/bssids.bin");
+  slow.begin();
+  double slowUs = nowUs() - t0;
+  unsigned long slowBytes = fs.counters().bytesRead;
+
+  fs.reset();
+  t0 = nowUs();
+  BootImageReader img(fs, "/boot.img");
+  SeenIndex fast(fs, "/seen.seg", "/bssids.bin");
+  ok = img.begin() && fast.beginFromImage(img) && ok;
+  double fastUs = nowUs() - t0;
+  unsigned long fastBytes = fs.counters().bytesRead;
+
+  size_t mismatches = 0;
+  for(uint64_t m : macs) if(slow.contains(m) != fast.contains(m) || !fast.contains(m)) mismatches++;
+  for(uint64_t m : unseen) if(slow.contains(m) != fast.contains(m)) mismatches++;
+  ok = ok && mismatches == 0 && fast.size() == slow.size();
+
+  printf("n=%-6zu begin: %8.0f us %8lu B read   image: %6.0f us %7lu B read  mismatches %zu\n",
+         n, slowUs, slowBytes, fastUs, fastBytes, mismatches);
+  removeAll(disk);
+  return ok;
+}
+
+// A stale or damaged image must be refused, never half-used
+static bool fallbacks(PalFs &fs) {
+  bool ok = true;
+  srand(21);
+  SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 256 * 1024, 64);
+  seen.begin();
+  for(int i = 0; i < 200; i++) { uint64_t m = randomMac(); if(!seen.contains(m)) seen.insert(m); }
+  seen.sync();
+  while(seen.merging()) seen.service();
+  BootImageWriter w(fs, "/boot.img");
+  ok = seen.addToImage(w) && w.commit();
+  ok = fromImage(fs) && ok;
+
+  // another merge after the image was written: the segment moved on
+  for(int i = 0; i < 200; i++) { uint64_t m = randomMac(); if(!seen.contains(m)) seen.insert(m); }
+  seen.sync();
+  while(seen.merging()) seen.service();
+  bool stale = fromImage(fs);
+  printf("stale image:   %s\n", stale ? "accepted (wrong)" : "refused");
+  ok = !stale && ok;
+
+  ok = writeImage(fs) && fromImage(fs) && ok;
+  ok = flipByte(fs, "/boot.img", 200) && ok;
+  bool corrupt = fromImage(fs);
+  printf("corrupt image: %s\n", corrupt ? "accepted (wrong)" : "refused");
+  ok = !corrupt && ok;
+
+  fs.remove("/boot.img");
+  bool missing = fromImage(fs);
+  printf("missing image: %s\n", missing ? "accepted (wrong)" : "refused");
+  ok = !missing && ok;
+  removeAll(fs);
+  return ok;
+}
+
+int main() {
+  char dir[] = "/tmp/boot_image_XXXXXX";
+  if(!mkdtemp(dir)) { perror("mkdtemp"); return 1; }
+  PosixPalFs disk(dir);
+
+  bool ok = true;
+  const size_t sizes[] = { 1000, 10000, 50000 };
+  for(size_t n : sizes) ok = bench(disk, n) && ok;
+  ok = fallbacks(disk) && ok;
+
+  rmdir(dir);
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// bench_bssid_journal.cpp
+// Host benchmark: cost of remembering one new BSSID as the seen-set grows.
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ibench bench/bench_bssid_journal.cpp src/bssid_journal.cpp src/pal_fs_posix.cpp -o /tmp/bench_bssid_journal
+//   /tmp/bench_bssid_journal
+//
+// "journal" is the /bssids.bin path (append per scan of 40 APs).
+// "rewrite" models the old saveEncounteredBSSIDs(): serialize the whole set
+// as JSON and rewrite the file for every new BSSID.
+// "full" fills the file system mid-record while scans keep coming, then
+// frees space: the file must hold each MAC at most once, in append order,
+// and the compaction must bring every dropped MAC back.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <set>
+#include "bssid_journal.h"
+#include "full_fs.h"
+#include "mac_addr.h"
+
+static const int SCAN_SIZE = 40;
+
+static double nowNs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t nextMac(uint64_t &state) {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return state >> 16;
+}
+
+static void benchJournal(PalFs &fs, size_t n) {
+  fs.remove("/bssids.bin");
+  BssidJournal j(fs, "/bssids.bin");
+  uint64_t rng = 42;
+  // time the last 100 inserts so the figure reflects cost at size n
+  size_t tail = n < 100 ? n : 100;
+  double t0 = 0;
+  for(size_t i=0; i<n; i++){
+    if(i == n - tail) t0 = nowNs();
+    j.append(nextMac(rng));
+    if((i+1) % SCAN_SIZE == 0) j.flush();
+  }
+  j.flush();
+  double perInsert = (nowNs() - t0) / tail;
+
+  double l0 = nowNs();
+  size_t loaded = j.load([](uint64_t){});
+  double loadMs = (nowNs() - l0) / 1e6;
+  printf("journal  n=%-7zu insert=%8.0f ns  flash=%6zu B/insert  load=%7.2f ms (%zu recs)\n",
+         n, perInsert, BssidJournal::RECORD_SIZE, loadMs, loaded);
+}
+
+static void benchRewrite(PalFs &fs, size_t n) {
+  std::vector<uint64_t> set;
+  uint64_t rng = 42;
+  size_t tail = n < 20 ? n : 20;
+  double t0 = 0;
+  size_t lastBytes = 0;
+  char mac[18];
+  for(size_t i=0; i<n; i++){
+    set.push_back(nextMac(rng));
+    if(i < n - tail) continue;
+    if(i == n - tail) t0 = nowNs();
+    std::string json = "{\"bssids\":[";
+    for(size_t k=0; k<set.size(); k++){
+      formatMac(set[k], mac);
+      if(k) json += ',';
+      json += '"'; json += mac; json += '"';
+    }
+    json += "]}";
+    std::unique_ptr<PalFile> f = fs.open("/bssids.json", "w");
+    f->write((const uint8_t*)json.data(), json.size());
+    lastBytes = json.size();
+  }
+  double perInsert = (nowNs() - t0) / tail;
+  printf("rewrite  n=%-7zu insert=%8.0f ns  flash=%6zu B/insert\n", n, perInsert, lastBytes);
+}
+
+static bool benchFull(PalFs &inner) {
+  inner.remove("/bssids.bin");
+  // room for 100 records and half of the next one
+  FullPalFs fs(inner, 100 * BssidJournal::RECORD_SIZE + 3);
+  BssidJournal j(fs, "/bssids.bin");
+  std::vector<uint64_t> live;
+  uint64_t rng = 7;
+  size_t failed = 0;
+  for(size_t i=0; i<1000; i++){
+    live.push_back(nextMac(rng));
+    if(!j.append(live.back())) failed++;
+    if((i+1) % SCAN_SIZE == 0 && !j.flush()) failed++;
+  }
+  size_t dropped = j.dropped();
+
+  // what reached the file: a prefix of the appends, each once
+  std::vector<uint64_t> got;
+  j.load([&](uint64_t mac){ got.push_back(mac); });
+  bool ok = got.size() == 100 && j.needsCompaction(live.size());
+  for(size_t i=0; ok && i<got.size(); i++) ok = got[i] == live[i];
+
+  fs.setFree(1 << 20);
+  ok = ok && j.beginCompaction();
+  for(uint64_t mac : live) j.addCompacted(mac);
+  ok = ok && j.commitCompaction();
+  std::set<uint64_t> back;
+  size_t loaded = j.load([&](uint64_t mac){ back.insert(mac); });
+  ok = ok && loaded == live.size() && back.size() == live.size() && !j.needsCompaction(live.size());
+  // and appends work again
+  ok = ok && j.append(nextMac(rng)) && j.flush() && j.records() == live.size() + 1;
+
+  printf("full     1000 appends into room for 100.5: %zu failed calls, %zu dropped, %zu short writes, "
+         "file %zu recs, after compaction %zu -> %s\n",
+         failed, dropped, (size_t)fs.shortWrites(), got.size(), loaded, ok ? "ok" : "FAILED");
+  inner.remove("/bssids.bin");
+  return ok;
+}
+
+int main() {
+  char dir[] = "/tmp/bssid_bench_XXXXXX";
+  if(!mkdtemp(dir)){ perror("mkdtemp"); return 1; }
+  PosixPalFs fs(dir);
+
+  const size_t sizes[] = {100, 1000, 10000, 100000};
+  for(size_t n : sizes) benchJournal(fs, n);
+  for(size_t n : sizes) benchRewrite(fs, n);
+  bool ok = benchFull(fs);
+
+  fs.remove("/bssids.bin");
+  fs.remove("/bssids.json");
+  rmdir(dir);
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
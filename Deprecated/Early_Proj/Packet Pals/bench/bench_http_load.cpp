@@ -0,0 +1,450 @@
+// bench_http_load.cpp
+// Host load test: /monsters over loopback TCP with 1, 4 and 8 concurrent
+// clients, served one connection at a time (the old WebServer loop) vs
+// from a single-threaded event loop that answers whichever socket is
+// ready (the AsyncWebServer model). The event loop renders the body
+// through PullSink a send window at a time, as the async handler does.
+//
+//   g++ -std=c++17 -O2 -pthread -Iinclude bench/bench_http_load.cpp src/json_stream.cpp src/pull_sink.cpp -o /tmp/bench_http_load
+//   /tmp/bench_http_load
+//
+// Socket buffers are cut to the minimum and each client takes LINK_US to
+// read every segment, standing in for a phone on WiFi acking the ESP32's
+// small TCP window. A blocking server sits in send() until the client
+// catches up; the event loop spends that time on the other clients.
+// Every response body is compared with the one-shot rendering of the same
+// page, and the pager alone is checked against it for send windows of
+// 1 byte up to a full TCP segment.
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "json_stream.h"
+#include "pull_sink.h"
+#include "wild_roster.h"
+
+typedef WildRoster<600> Roster;
+
+static const int LINK_US = 1000;
+static const int SOCKET_BUF = 2048;       // the kernel raises this to its minimum
+static const int REQUESTS_PER_CLIENT = 30;
+static const size_t SEND_WINDOW = 1436;   // one TCP segment per fill, as on the ESP32
+static const char* PREFIXES[] = { "Star", "Candy", "Turbo", "Spark", "Rainbow" };
+static const char* SUFFIXES[] = { "Dino", "Bat", "Cat", "\"Quoted\"\\" };
+
+static Roster roster;
+
+static void nameOf(const WildMonster &w, char* out) {
+  snprintf(out, 16, "%s%s", PREFIXES[w.prefix], SUFFIXES[w.suffix]);
+}
+
+static double nowSec() {
+  using namespace std::chrono;
+  return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+class StringSink : public ByteSink {
+public:
+  bool write(const char* data, size_t len) override { out.append(data, len); return true; }
+  std::string out;
+};
+
+// --- request parsing -----------------------------------------------------
+
+struct Query {
+  uint32_t cursor;
+  uint32_t limit;
+};
+
+static bool argOf(const std::string &target, const char* name, long &out) {
+  std::string key = std::string(name) + "=";
+  size_t q = target.find('?');
+  if(q == std::string::npos) return false;
+  for(size_t p = q + 1; p < target.size();) {
+    size_t amp = target.find('&', p);
+    if(amp == std::string::npos) amp = target.size();
+    if(target.compare(p, key.size(), key) == 0) {
+      out = atol(target.c_str() + p + key.size());
+      return true;
+    }
+    p = amp + 1;
+  }
+  return false;
+}
+
+// Same defaults and clamps as handleMonsters()
+static Query parseQuery(const std::string &request) {
+  size_t sp = request.find(' '), sp2 = request.find(' ', sp + 1);
+  std::string target = request.substr(sp + 1, sp2 - sp - 1);
+  Query q = { 0, (uint32_t)roster.size() };
+  long v;
+  if(argOf(target, "cursor", v)) q.cursor = v < 0 ? 0 : (uint32_t)v;
+  if(argOf(target, "limit", v)) q.limit = v < 1 ? 1 : v > 100 ? 100 : (uint32_t)v;
+  return q;
+}
+
+static const char* RESPONSE_HEAD =
+  "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n";
+
+// --- one-shot rendering (the old handler: whole page in one go) ----------
+
+static std::string renderPage(const Query &q) {
+  StringSink sink;
+  char buf[512], name[16];
+  JsonStream js(sink, buf, sizeof(buf));
+  size_t total = roster.size();
+  size_t first = roster.lowerBound(q.cursor);
+  size_t end = first + q.limit;
+  if(end > total) end = total;
+  js.beginObject();
+  js.field("total", (unsigned long)total);
+  js.key("monsters");
+  js.beginArray();
+  for(size_t i = first; i < end; i++) {
+    WildMonster w = roster.at(i);
+    nameOf(w, name);
+    js.beginObject();
+    js.field("id", w.id);
+    js.field("name", (const char*)name);
+    js.field("level", (unsigned)w.level);
+    js.endObject();
+  }
+  js.endArray();
+  js.key("nextCursor");
+  if(end < total) js.value(roster.at(end).id);
+  else js.null();
+  js.endObject();
+  js.flush();
+  return sink.out;
+}
+
+// --- pull rendering (mirrors MonsterPager in pals_core.cpp) --------------
+
+class Pager {
+public:
+  explicit Pager(const Query &q)
+    : sink_(spill_, sizeof(spill_)), js_(sink_, buf_, sizeof(buf_)),
+      nextId_(q.cursor), left_(q.limit), started_(false), done_(false) {}
+
+  size_t fill(uint8_t* out, size_t room) {
+    sink_.begin(out, room);
+    while(!sink_.full() && !done_) {
+      step();
+      js_.flush();
+    }
+    return sink_.filled();
+  }
+  bool ok() const { return sink_.ok(); }
+
+private:
+  void step() {
+    if(!started_) {
+      js_.beginObject();
+      js_.field("total", (unsigned long)roster.size());
+      js_.key("monsters");
+      js_.beginArray();
+      started_ = true;
+      return;
+    }
+    size_t slot = roster.lowerBound(nextId_);
+    if(left_ > 0 && slot < roster.size()) {
+      char name[16];
+      WildMonster w = roster.at(slot);
+      nameOf(w, name);
+      js_.beginObject();
+      js_.field("id", w.id);
+      js_.field("name", (const char*)name);
+      js_.field("level", (unsigned)w.level);
+      js_.endObject();
+      nextId_ = w.id + 1;
+      left_--;
+      return;
+    }
+    js_.endArray();
+    js_.key("nextCursor");
+    if(left_ == 0 && slot < roster.size()) js_.value(roster.at(slot).id);
+    else js_.null();
+    js_.endObject();
+    done_ = true;
+  }
+
+  char spill_[384];
+  char buf_[128];
+  PullSink sink_;
+  JsonStream js_;
+  uint32_t nextId_;
+  uint32_t left_;
+  bool started_;
+  bool done_;
+};
+
+static std::string pullAll(const Query &q, size_t window) {
+  Pager p(q);
+  std::string out;
+  std::vector<uint8_t> buf(window);
+  for(;;) {
+    size_t n = p.fill(buf.data(), window);
+    if(n == 0) break;
+    out.append((const char*)buf.data(), n);
+  }
+  return p.ok() ? out : std::string();
+}
+
+// --- servers -------------------------------------------------------------
+
+static int listenLoopback(uint16_t &port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  // accepted sockets inherit it
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &SOCKET_BUF, sizeof(SOCKET_BUF));
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, (sockaddr*)&a, sizeof(a));
+  listen(fd, 64);
+  socklen_t len = sizeof(a);
+  getsockname(fd, (sockaddr*)&a, &len);
+  port = ntohs(a.sin_port);
+  return fd;
+}
+
+static bool sendAll(int fd, const char* data, size_t len) {
+  while(len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if(n <= 0) return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static std::atomic<bool> stopping(false);
+
+// WebServer::handleClient(): take one client, wait for its whole request,
+// answer, close, and only then look at the next
+static void blockingServer(int lfd) {
+  for(;;) {
+    int fd = accept(lfd, nullptr, nullptr);
+    if(fd < 0 || stopping) {
+      if(fd >= 0) close(fd);
+      return;
+    }
+    std::string req;
+    char buf[512];
+    while(req.find("\r\n\r\n") == std::string::npos) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if(n <= 0) break;
+      req.append(buf, n);
+    }
+    if(req.find("\r\n\r\n") != std::string::npos) {
+      std::string body = renderPage(parseQuery(req));
+      sendAll(fd, RESPONSE_HEAD, strlen(RESPONSE_HEAD)) && sendAll(fd, body.data(), body.size());
+    }
+    close(fd);
+  }
+}
+
+struct Conn {
+  int fd;
+  std::string req;
+  std::unique_ptr<Pager> pager;
+  std::vector<uint8_t> out;
+  size_t outOff;
+};
+
+// AsyncWebServer: every socket is non-blocking and the loop serves
+// whichever is ready, one send window per turn
+static void eventServer(int lfd) {
+  fcntl(lfd, F_SETFL, O_NONBLOCK);
+  std::vector<std::unique_ptr<Conn>> conns;
+  std::vector<pollfd> fds;
+  while(!stopping) {
+    fds.clear();
+    fds.push_back({ lfd, POLLIN, 0 });
+    for(auto &c : conns) fds.push_back({ c->fd, (short)(c->pager ? POLLOUT : POLLIN), 0 });
+    if(poll(fds.data(), fds.size(), 50) <= 0) continue;
+    if(fds[0].revents & POLLIN) {
+      int fd;
+      while((fd = accept(lfd, nullptr, nullptr)) >= 0) {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        conns.emplace_back(new Conn());
+        conns.back()->fd = fd;
+        conns.back()->outOff = 0;
+      }
+    }
+    for(size_t i = 1; i < fds.size(); i++) {
+      Conn &c = *conns[i - 1];
+      if(!fds[i].revents) continue;
+      bool closing = false;
+      if(!c.pager) {
+        char buf[512];
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if(n <= 0) closing = true;
+        else c.req.append(buf, n);
+        if(!closing && c.req.find("\r\n\r\n") != std::string::npos) {
+          c.pager.reset(new Pager(parseQuery(c.req)));
+          c.out.assign(RESPONSE_HEAD, RESPONSE_HEAD + strlen(RESPONSE_HEAD));
+        }
+      } else {
+        if(c.outOff == c.out.size()) {
+          c.out.resize(SEND_WINDOW);
+          c.out.resize(c.pager->fill(c.out.data(), SEND_WINDOW));
+          c.outOff = 0;
+          if(c.out.empty()) closing = true;
+        }
+        if(!closing) {
+          ssize_t n = send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+          if(n > 0) c.outOff += n;
+          else if(errno != EAGAIN) closing = true;
+        }
+      }
+      if(closing) {
+        close(c.fd);
+        c.fd = -1;
+      }
+    }
+    for(size_t i = 0; i < conns.size();) {
+      if(conns[i]->fd < 0) {
+        conns[i] = std::move(conns.back());
+        conns.pop_back();
+      } else {
+        i++;
+      }
+    }
+  }
+  for(auto &c : conns) close(c->fd);
+}
+
+// --- clients -------------------------------------------------------------
+
+static const Query QUERIES[] = {
+  { 0, 0 }, { 150, 20 }, { 300, 0 }, { 590, 20 }, { 0, 100 }, { 420, 1 }, { 9999, 20 }, { 0, 600 }
+};
+static const size_t QUERY_COUNT = sizeof(QUERIES) / sizeof(QUERIES[0]);
+static std::string expected[QUERY_COUNT];
+
+// limit 0: no limit argument, the whole roster
+static std::string requestLine(const Query &q) {
+  char line[128];
+  if(q.limit) {
+    snprintf(line, sizeof(line), "GET /monsters?cursor=%u&limit=%u HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n",
+             q.cursor, q.limit);
+  } else {
+    snprintf(line, sizeof(line), "GET /monsters?cursor=%u HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n", q.cursor);
+  }
+  return line;
+}
+
+static bool fetch(uint16_t port, size_t qi) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &SOCKET_BUF, sizeof(SOCKET_BUF));
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  a.sin_port = htons(port);
+  if(connect(fd, (sockaddr*)&a, sizeof(a)) < 0) {
+    close(fd);
+    return false;
+  }
+  std::string req = requestLine(QUERIES[qi]);
+  bool ok = sendAll(fd, req.data(), req.size());
+  std::string resp;
+  char buf[SEND_WINDOW];
+  ssize_t n;
+  while(ok && (n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+    resp.append(buf, n);
+    std::this_thread::sleep_for(std::chrono::microseconds(LINK_US));
+  }
+  close(fd);
+  size_t body = resp.find("\r\n\r\n");
+  return ok && body != std::string::npos && resp.compare(body + 4, std::string::npos, expected[qi]) == 0;
+}
+
+static double run(bool event, int clients, bool &ok) {
+  uint16_t port;
+  int lfd = listenLoopback(port);
+  stopping = false;
+  std::thread server(event ? eventServer : blockingServer, lfd);
+  std::atomic<int> bad(0);
+  double t0 = nowSec();
+  std::vector<std::thread> threads;
+  for(int c = 0; c < clients; c++) {
+    threads.emplace_back([&, c]() {
+      for(int r = 0; r < REQUESTS_PER_CLIENT; r++) {
+        if(!fetch(port, (c * 7 + r) % QUERY_COUNT)) bad++;
+      }
+    });
+  }
+  for(auto &t : threads) t.join();
+  double secs = nowSec() - t0;
+  stopping = true;
+  if(!event) {
+    // wake accept()
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    a.sin_port = htons(port);
+    connect(fd, (sockaddr*)&a, sizeof(a));
+    close(fd);
+  }
+  server.join();
+  close(lfd);
+  double rps = clients * REQUESTS_PER_CLIENT / secs;
+  printf("  %-8s %d client%s  %6.0f req/s  %s\n", event ? "event" : "blocking", clients,
+         clients == 1 ? " " : "s", rps, bad ? "BODY MISMATCH" : "");
+  ok = ok && bad == 0;
+  return rps;
+}
+
+int main() {
+  srand(1);
+  for(size_t i = 0; i < Roster::capacity(); i++) roster.add(rand() % 5, rand() % 4, 1 + rand() % 5);
+  for(int i = 0; i < 40; i++) roster.remove(1 + rand() % 600);   // gaps, as evictions leave
+  // what the server should make of each request, limit clamp included
+  for(size_t i = 0; i < QUERY_COUNT; i++) expected[i] = renderPage(parseQuery(requestLine(QUERIES[i])));
+
+  bool ok = true;
+  const size_t windows[] = { 1, 7, 64, 500, SEND_WINDOW };
+  for(size_t w : windows) {
+    for(size_t i = 0; i < QUERY_COUNT; i++) {
+      ok = ok && pullAll(parseQuery(requestLine(QUERIES[i])), w) == expected[i];
+    }
+  }
+  printf("pager:  %s for windows of 1..%zu B\n", ok ? "matches one-shot body" : "MISMATCH", SEND_WINDOW);
+
+  printf("/monsters, %d requests per client, %d us link delay:\n", REQUESTS_PER_CLIENT, LINK_US);
+  double blocking4 = 0, event4 = 0;
+  const int counts[] = { 1, 4, 8 };
+  for(int c : counts) {
+    double b = run(false, c, ok);
+    double e = run(true, c, ok);
+    if(c == 4) {
+      blocking4 = b;
+      event4 = e;
+    }
+  }
+  printf("4 clients: event loop %.1fx the blocking server\n", event4 / blocking4);
+  ok = ok && event4 > 2 * blocking4;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
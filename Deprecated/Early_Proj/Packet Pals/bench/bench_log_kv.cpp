@@ -0,0 +1,284 @@
+// bench_log_kv.cpp
+// Host harness for LogKv on the RAM flash emulator: write latency and write
+// amplification of a simulated play session on KvFs, plus consistency
+// checks under random operations, remounts and power cuts, and the erase
+// count spread with cold data.
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ibench bench/bench_log_kv.cpp src/log_kv.cpp src/kv_fs.cpp src/flash_posix.cpp src/save_store.cpp src/save_format.cpp src/seen_index.cpp src/boot_image.cpp src/bssid_journal.cpp -o /tmp/bench_log_kv
+//   /tmp/bench_log_kv
+//
+// Latency is RamFlash's modelled busy time (typical SPI NOR page program
+// and sector erase figures), not host wall time. The session mirrors
+// loop(): a scan every 10 s inserts up to 40 new BSSIDs and syncs the
+// journal, a save snapshot goes out after each burst of game changes, the
+// seen-set merges in the background and the boot image is rewritten after
+// each merge. "write" latency is what a scan or save waits for;
+// background work (merges, compaction) is reported separately, and
+// "held" is how long the compaction step keeps palsLoop()'s state lock:
+// the sector erase runs outside it, as palsLoop() does.
+// Write amplification is bytes programmed on flash over bytes the game
+// wrote to its files.
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "counting_fs.h"
+#include "boot_image.h"
+#include "flash_backend.h"
+#include "kv_fs.h"
+#include "log_kv.h"
+#include "save_format.h"
+#include "save_store.h"
+#include "seen_index.h"
+
+static const size_t SECTOR = 4096;
+static const size_t PARTITION_SECTORS = 320;   // "pals" in partitions.csv
+static const int SCANS = 3000;
+
+static uint64_t randomMac() {
+  return (((uint64_t)rand() << 24) ^ (uint64_t)rand()) & 0xFFFFFFFFFFFFULL;
+}
+
+static double percentile(std::vector<uint64_t> v, double p) {
+  if(v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return (double)v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+// --- play session --------------------------------------------------------
+
+static bool session(bool background) {
+  RamFlash flash(SECTOR, PARTITION_SECTORS);
+  LogKv kv(flash);
+  kv.begin();
+  KvFs kvfs(kv);
+  kvfs.begin();
+  CountingPalFs fs(kvfs);
+
+  SaveGame game;
+  memset(&game, 0, sizeof(game));
+  copyName(game.playerName, sizeof(game.playerName), "NoName");
+  SaveStore saves(fs, "/save.a", "/save.b", 768);
+  saves.setEncoder([&](uint8_t* buf, size_t cap) { return encodeSaveGame(game, buf, cap); });
+  SeenIndex seen(fs, "/seen.seg", "/bssids.bin");
+  seen.begin();
+
+  std::vector<uint64_t> fg, bg, held;
+  uint64_t bgTotal = 0;
+  uint32_t merges = 0, images = 0;
+  srand(17);
+  for(int scan = 0; scan < SCANS; scan++) {
+    uint64_t t0 = flash.busyUs();
+    int found = 5 + rand() % 36;
+    for(int i = 0; i < found; i++) {
+      uint64_t m = randomMac();
+      if(!seen.contains(m)) seen.insert(m);
+    }
+    seen.sync();
+    fg.push_back(flash.busyUs() - t0);
+
+    if(rand() % 3 == 0) {   // a battle or capture since the last scan
+      game.playerLevel++;
+      saves.markDirty(0);
+      t0 = flash.busyUs();
+      saves.sync();
+      fg.push_back(flash.busyUs() - t0);
+    }
+
+    // loop() until the next scan: merge steps, boot image, compaction
+    for(int tick = 0; tick < 200; tick++) {
+      t0 = flash.busyUs();
+      seen.service();
+      if(seen.stats().merges != merges && !seen.merging()) {
+        merges = seen.stats().merges;
+        BootImageWriter w(fs, "/boot.img");
+        if(seen.addToImage(w) && w.commit()) images++;
+      }
+      uint64_t t1 = flash.busyUs();
+      kvfs.service();
+      size_t erase = background ? kv.takeErase() : LogKv::NONE;
+      if(background && erase == LogKv::NONE) kv.service();
+      if(flash.busyUs() != t1) held.push_back(flash.busyUs() - t1);
+      if(erase != LogKv::NONE) kv.finishErase(erase, kv.eraseFlash(erase));
+      uint64_t d = flash.busyUs() - t0;
+      if(d) bg.push_back(d);
+      bgTotal += d;
+    }
+  }
+
+  const LogKv::Stats &s = kv.stats();
+  uint32_t minErase = 0xFFFFFFFF, maxErase = 0;
+  for(size_t i = 0; i < PARTITION_SECTORS; i++) {
+    minErase = std::min(minErase, flash.eraseCount(i));
+    maxErase = std::max(maxErase, flash.eraseCount(i));
+  }
+  double wa = (double)flash.bytesProgrammed() / (double)fs.counters().bytesWritten;
+  printf("%s compaction: %zu BSSIDs, %u merges, %u images\n",
+         background ? "background" : "foreground", seen.size(), merges, images);
+  printf("  write  p50 %6.1f ms  p99 %6.1f ms  max %6.1f ms  (%zu scans+saves)\n",
+         percentile(fg, 0.5) / 1000, percentile(fg, 0.99) / 1000, percentile(fg, 1.0) / 1000, fg.size());
+  printf("  loop   p99 %6.1f ms  max %6.1f ms  total %.1f s busy\n",
+         percentile(bg, 0.99) / 1000, percentile(bg, 1.0) / 1000, bgTotal / 1e6);
+  printf("  held   p99 %6.1f ms  max %6.1f ms  (compaction under the state lock)\n",
+         percentile(held, 0.99) / 1000, percentile(held, 1.0) / 1000);
+  printf("  app %lu B -> flash %llu B: write amplification %.2f\n",
+         fs.counters().bytesWritten, (unsigned long long)flash.bytesProgrammed(), wa);
+  printf("  %u erases, %u compactions (%u in put, %u for wear), erase count %u..%u, index %zu B\n",
+         s.erases, s.compactions, s.foreground, s.wearMoves, minErase, maxErase, kv.memoryBytes());
+
+  // what was written must come back after a reboot
+  LogKv kv2(flash);
+  KvFs fs2(kv2);
+  bool ok = kv2.begin() && fs2.begin();
+  SeenIndex seen2(fs2, "/seen.seg", "/bssids.bin");
+  ok = ok && seen2.begin() && seen2.size() == seen.size();
+  SaveStore saves2(fs2, "/save.a", "/save.b", 768);
+  uint8_t buf[768];
+  SaveGame back;
+  size_t len = saves2.load(buf, sizeof(buf));
+  ok = ok && decodeSaveGame(buf, len, back) && back.playerLevel == game.playerLevel;
+  ok = ok && (!background || percentile(held, 1.0) < RamFlash::SECTOR_ERASE_US);
+  return ok && maxErase - minErase <= 2 * LogKv::WEAR_SPREAD + 2;
+}
+
+// --- random operations against a shadow map ------------------------------
+
+typedef std::map<uint32_t, std::string> Shadow;
+
+static std::string randomValue(size_t maxLen) {
+  std::string v(rand() % (maxLen + 1), '\0');
+  for(char &c : v) c = (char)rand();
+  return v;
+}
+
+static bool matches(LogKv &kv, const Shadow &shadow) {
+  size_t n = 0;
+  bool ok = true;
+  kv.forEach([&](uint32_t key, size_t len) {
+    n++;
+    auto it = shadow.find(key);
+    if(it == shadow.end() || it->second.size() != len) { ok = false; return; }
+    std::string v(len, '\0');
+    if(len && (!kv.read(key, 0, &v[0], len) || v != it->second)) ok = false;
+  });
+  return ok && n == shadow.size();
+}
+
+static bool randomOps() {
+  RamFlash flash(SECTOR, 24);
+  LogKv kv(flash);
+  kv.begin();
+  Shadow shadow;
+  srand(3);
+  bool ok = true;
+  size_t erasing = LogKv::NONE;
+  for(int op = 0; op < 40000 && ok; op++) {
+    uint32_t key = rand() % 60;
+    if(rand() % 5 == 0) {
+      ok = kv.remove(key);
+      shadow.erase(key);
+    } else {
+      std::string v = randomValue(rand() % 8 ? 200 : 1500);
+      ok = kv.put(key, v.data(), v.size());
+      shadow[key] = v;
+    }
+    if(rand() % 4 == 0) {
+      // an erase taken out stays pending across the puts in between
+      if(erasing != LogKv::NONE) {
+        ok = ok && kv.finishErase(erasing, kv.eraseFlash(erasing));
+        erasing = LogKv::NONE;
+      } else if((erasing = kv.takeErase()) == LogKv::NONE) {
+        kv.service(512);
+      }
+    }
+    if(op % 5000 == 4999) {
+      LogKv again(flash);
+      ok = ok && again.begin() && matches(again, shadow);
+    }
+  }
+  ok = ok && matches(kv, shadow);
+  printf("random ops:    %s (%u compactions, %u tombstone-bearing keys)\n",
+         ok ? "consistent" : "MISMATCH", kv.stats().compactions, (unsigned)(kv.keys() - shadow.size()));
+  return ok;
+}
+
+// Half the region is cold data written once; one hot key is rewritten
+// over and over. Without static wear leveling the cold sectors would
+// never be erased.
+static bool wearLeveling() {
+  const size_t sectors = 32;
+  RamFlash flash(SECTOR, sectors);
+  LogKv kv(flash);
+  kv.begin();
+  std::string cold(1000, 'c');
+  for(uint32_t k = 0; k < 60; k++) kv.put(1000 + k, cold.data(), cold.size());
+  std::string hot(300, 'h');
+  for(int i = 0; i < 100000; i++) {
+    kv.put(1, hot.data(), hot.size());
+    kv.service();
+  }
+  uint32_t lo = 0xFFFFFFFF, hi = 0;
+  for(size_t i = 0; i < sectors; i++) {
+    lo = std::min(lo, flash.eraseCount(i));
+    hi = std::max(hi, flash.eraseCount(i));
+  }
+  printf("wear leveling: erase count %u..%u over %zu sectors (%u wear moves)\n",
+         lo, hi, sectors, kv.stats().wearMoves);
+  return hi - lo <= 2 * LogKv::WEAR_SPREAD + 2;
+}
+
+// Cuts power at a random byte, remounts, and checks every key holds its
+// last acknowledged value, or for the key being written, the new one
+static bool powerCuts() {
+  RamFlash flash(SECTOR, 12);
+  Shadow shadow;
+  srand(11);
+  int cuts = 0, failed = 0;
+  for(int round = 0; round < 400; round++) {
+    LogKv kv(flash);
+    if(!kv.begin()) { failed++; break; }
+    if(!matches(kv, shadow)) { failed++; break; }
+    flash.tearAfter(rand() % 20000);
+    uint32_t key = 0;
+    std::string v;
+    bool removing = false;
+    for(;;) {
+      key = rand() % 24;
+      removing = rand() % 6 == 0;
+      v = randomValue(600);
+      bool ok = removing ? kv.remove(key) : kv.put(key, v.data(), v.size());
+      if(ok && !flash.torn()) {
+        if(removing) shadow.erase(key);
+        else shadow[key] = v;
+        kv.service(256);
+      }
+      if(flash.torn()) break;
+    }
+    flash.repair();
+    cuts++;
+    // the interrupted operation may or may not have landed
+    LogKv after(flash);
+    if(!after.begin()) { failed++; continue; }
+    Shadow landed = shadow;
+    if(removing) landed.erase(key);
+    else landed[key] = v;
+    if(matches(after, landed)) shadow = landed;
+    else if(!matches(after, shadow)) failed++;
+  }
+  printf("power cuts:    %d cuts, %d inconsistent\n", cuts, failed);
+  return failed == 0;
+}
+
+int main() {
+  bool ok = true;
+  ok = session(true) && ok;
+  ok = session(false) && ok;
+  ok = randomOps() && ok;
+  ok = wearLeveling() && ok;
+  ok = powerCuts() && ok;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// bench_mac_set.cpp
+// Host benchmark: MacSet vs the old unordered_set<String, StringHash> seen-set.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_mac_set.cpp -o /tmp/bench_mac_set
+//   /tmp/bench_mac_set
+//
+// A heap std::string stands in for Arduino String: both allocate the 17-char
+// "AA:BB:.." text. Bytes/entry counts every live heap byte of the container.
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "mac_addr.h"
+#include "mac_set.h"
+
+static size_t gLiveBytes = 0;
+
+// Tracks live heap bytes of the old set (nodes, buckets and string text)
+template<typename T> struct CountingAlloc {
+  typedef T value_type;
+  CountingAlloc() {}
+  template<typename U> CountingAlloc(const CountingAlloc<U>&) {}
+  T* allocate(size_t n) { gLiveBytes += n * sizeof(T); return std::allocator<T>().allocate(n); }
+  void deallocate(T* p, size_t n) { gLiveBytes -= n * sizeof(T); std::allocator<T>().deallocate(p, n); }
+  template<typename U> bool operator==(const CountingAlloc<U>&) const { return true; }
+  template<typename U> bool operator!=(const CountingAlloc<U>&) const { return false; }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, CountingAlloc<char> > HeapString;
+
+// The hasher Packet Pals and HIDden 2 used before MacSet
+struct StringHash {
+  size_t operator()(const HeapString &key) const {
+    const char* str = key.c_str();
+    size_t hash = 0;
+    while (*str) {
+      hash = 37 * hash + (unsigned char)*str++;
+    }
+    return hash;
+  }
+};
+
+static double nowNs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t nextMac(uint64_t &state) {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (state >> 16) & 0xFFFFFFFFFFFFULL;
+}
+
+static void bench(size_t n) {
+  std::vector<uint64_t> keys, misses;
+  uint64_t rng = 7;
+  for(size_t i=0; i<n; i++) keys.push_back(nextMac(rng));
+  for(size_t i=0; i<n; i++) misses.push_back(nextMac(rng));
+  std::vector<HeapString> keyStr, missStr;
+  char buf[18];
+  for(uint64_t k : keys)   { formatMac(k, buf); keyStr.push_back(buf); }
+  for(uint64_t k : misses) { formatMac(k, buf); missStr.push_back(buf); }
+  const int rounds = (int)(2000000 / n) + 1;
+  volatile size_t sink = 0;
+
+  // old: unordered_set<String>
+  size_t before = gLiveBytes;
+  std::unordered_set<HeapString, StringHash, std::equal_to<HeapString>, CountingAlloc<HeapString> > oldSet;
+  for(auto &s : keyStr) oldSet.insert(s);
+  double oldBytes = (double)(gLiveBytes - before) / n;
+  double t0 = nowNs();
+  for(int r=0; r<rounds; r++){
+    for(size_t i=0; i<n; i++){
+      sink += oldSet.find(keyStr[i]) != oldSet.end();
+      sink += oldSet.find(missStr[i]) != oldSet.end();
+    }
+  }
+  double oldNs = (nowNs() - t0) / (rounds * 2.0 * n);
+
+  // new: MacSet
+  MacSet set;
+  for(uint64_t k : keys) set.insert(k);
+  double newBytes = (double)set.memoryBytes() / n;
+  t0 = nowNs();
+  for(int r=0; r<rounds; r++){
+    for(size_t i=0; i<n; i++){
+      sink += set.contains(keys[i]);
+      sink += set.contains(misses[i]);
+    }
+  }
+  double newNs = (nowNs() - t0) / (rounds * 2.0 * n);
+
+  printf("n=%-7zu unordered_set<String>: %6.1f B/entry %6.1f ns/lookup | MacSet: %5.1f B/entry %5.1f ns/lookup\n",
+         n, oldBytes, oldNs, newBytes, newNs);
+  (void)sink;
+}
+
+int main() {
+  const size_t sizes[] = {100, 1000, 10000, 100000};
+  for(size_t n : sizes) bench(n);
+  return 0;
+}
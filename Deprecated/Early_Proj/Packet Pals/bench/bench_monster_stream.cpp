@@ -0,0 +1,167 @@
+// bench_monster_stream.cpp
+// Host harness: /monsters response cost for a large roster, one document
+// built in RAM (old handler) vs cursor pages streamed through JsonStream.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_monster_stream.cpp src/json_stream.cpp -o /tmp/bench_monster_stream
+//   /tmp/bench_monster_stream [monsters]
+//
+// "document" stands in for DynamicJsonDocument + serializeJson(String): the
+// whole body exists in memory before the first byte goes out. "stream"
+// walks the roster with cursor/limit like the web UI does; each page is
+// written through a 512-byte buffer into a sink that only counts. The
+// pages are re-joined and checked: every id appears once, in order, and
+// the nextCursor chain ends with null.
+#include <chrono>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "json_stream.h"
+#include "wild_roster.h"
+
+typedef WildRoster<16384> Roster;
+
+static const uint32_t PAGE = 100;
+static const char* PREFIXES[] = { "Star", "Candy", "Turbo", "Spark", "Rainbow" };
+static const char* SUFFIXES[] = { "Dino", "Bat", "Cat", "\"Quoted\"\\" };   // exercises escaping
+
+static void nameOf(const WildMonster &w, char* out) {
+  snprintf(out, 16, "%s%s", PREFIXES[w.prefix], SUFFIXES[w.suffix]);
+}
+
+static double nowUs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static size_t heapInUse() {
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;   // large blocks are mmapped
+}
+
+// Counts chunks; optionally keeps a copy so the output can be verified
+class CountingSink : public ByteSink {
+public:
+  CountingSink() : chunks(0), bytes(0), maxChunk(0), keep(nullptr) {}
+  bool write(const char* data, size_t len) override {
+    chunks++;
+    bytes += len;
+    if(len > maxChunk) maxChunk = len;
+    if(keep) keep->append(data, len);
+    return true;
+  }
+  size_t chunks, bytes, maxChunk;
+  std::string* keep;
+};
+
+// Same body the old handler produced, built in one piece
+static std::string buildDocument(const Roster &roster) {
+  std::string out = "{\"monsters\":[";
+  char name[16];
+  for(size_t i = 0; i < roster.size(); i++) {
+    WildMonster w = roster.at(i);
+    nameOf(w, name);
+    if(i) out += ',';
+    out += "{\"index\":" + std::to_string(i) + ",\"name\":\"" + name +
+           "\",\"level\":" + std::to_string(w.level) + "}";
+  }
+  out += "]}";
+  return out;
+}
+
+// Mirrors handleMonsters(); returns the next cursor or -1
+static long streamPage(const Roster &roster, uint32_t cursor,
+                       uint32_t limit, CountingSink &sink) {
+  uint32_t total = roster.size();
+  size_t first = roster.lowerBound(cursor);
+  size_t end = first + limit;
+  if(end > total) end = total;
+  char buf[512];
+  char name[16];
+  JsonStream js(sink, buf, sizeof(buf));
+  js.beginObject();
+  js.field("total", total);
+  js.key("monsters");
+  js.beginArray();
+  for(size_t i = first; i < end; i++) {
+    WildMonster w = roster.at(i);
+    nameOf(w, name);
+    js.beginObject();
+    js.field("id", w.id);
+    js.field("name", (const char*)name);
+    js.field("level", (unsigned)w.level);
+    js.endObject();
+  }
+  js.endArray();
+  js.key("nextCursor");
+  if(end < total) js.value(roster.at(end).id);
+  else js.null();
+  js.endObject();
+  js.flush();
+  return end < total ? (long)roster.at(end).id : -1;
+}
+
+// Every "id": value must count 1..n in order
+static bool checkIds(const std::string &all, uint32_t n) {
+  uint32_t expect = 1;
+  const char* p = all.c_str();
+  while((p = strstr(p, "\"id\":")) != nullptr) {
+    p += 5;
+    if((uint32_t)strtoul(p, nullptr, 10) != expect) return false;
+    expect++;
+  }
+  return expect == n + 1;
+}
+
+int main(int argc, char** argv) {
+  uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+  if(n > Roster::capacity()) n = Roster::capacity();
+  static Roster roster;
+  srand(1);
+  for(uint32_t i = 0; i < n; i++) {
+    roster.add(rand() % 5, rand() % 4, 1 + rand() % 5);
+  }
+
+  // document
+  size_t h0 = heapInUse();
+  double t0 = nowUs();
+  std::string doc = buildDocument(roster);
+  double docUs = nowUs() - t0;
+  size_t docHeap = heapInUse() - h0;
+  printf("document: %u monsters  body %zu B  held in RAM %zu B  %.0f us\n",
+         n, doc.size(), docHeap, docUs);
+
+  // stream, timed, nothing kept
+  CountingSink sink;
+  size_t pages = 0;
+  h0 = heapInUse();
+  size_t heapPeak = 0;
+  t0 = nowUs();
+  long cursor = 0;
+  while(cursor >= 0) {
+    cursor = streamPage(roster, (uint32_t)cursor, PAGE, sink);
+    pages++;
+    size_t h = heapInUse();
+    if(h > h0 && h - h0 > heapPeak) heapPeak = h - h0;
+  }
+  double streamUs = nowUs() - t0;
+  printf("stream:   %zu pages of %u  %zu B in %zu chunks (max %zu B)  heap growth %zu B  %.0f us\n",
+         pages, PAGE, sink.bytes, sink.chunks, sink.maxChunk, heapPeak, streamUs);
+
+  // verify: re-run keeping the output
+  std::string all;
+  CountingSink keepSink;
+  keepSink.keep = &all;
+  cursor = 0;
+  size_t nulls = 0;
+  while(cursor >= 0) {
+    size_t before = all.size();
+    cursor = streamPage(roster, (uint32_t)cursor, PAGE, keepSink);
+    if(all.compare(all.size() - 18, 18, "\"nextCursor\":null}") == 0 && all.size() > before) nulls++;
+  }
+  bool ok = checkIds(all, n) && nulls == 1;
+  printf("check:    %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
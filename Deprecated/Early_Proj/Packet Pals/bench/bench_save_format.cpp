@@ -0,0 +1,265 @@
+// bench_save_format.cpp
+// Host harness: load/save time and bytes on flash for the binary save
+// formats vs the old JSON files.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_save_format.cpp src/save_format.cpp src/save_store.cpp src/seen_index.cpp src/boot_image.cpp src/bssid_journal.cpp src/pal_fs_posix.cpp -o /tmp/bench_save_format
+//   /tmp/bench_save_format
+//
+// ArduinoJson is not available on the host, so the JSON side is a stand-in
+// with the same shape of work: snprintf the documents the old
+// savePlayer()/saveUserParty()/saveEncounteredBSSIDs() wrote, and parse them
+// back by tokenizing every string and number into its own heap copy, the
+// way a DynamicJsonDocument fills its pool. Treat the JSON timings as a
+// lower bound for the real library.
+//
+// Checks: binary save round-trips; forEachJsonMac() finds every MAC of a
+// large /bssids.json; a segment with one flipped byte fails its CRC.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "mac_addr.h"
+#include "save_format.h"
+#include "save_store.h"
+#include "seen_index.h"
+
+static const int ROUNDS = 2000;
+
+static double nowUs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static void writeFile(PalFs &fs, const char* path, const std::string &s) {
+  std::unique_ptr<PalFile> f = fs.open(path, "w");
+  f->write((const uint8_t*)s.data(), s.size());
+}
+
+static std::string readFile(PalFs &fs, const char* path) {
+  std::unique_ptr<PalFile> f = fs.open(path, "r");
+  std::string s(f->size(), '\0');
+  f->read((uint8_t*)&s[0], s.size());
+  return s;
+}
+
+static size_t fileSize(PalFs &fs, const char* path) {
+  std::unique_ptr<PalFile> f = fs.open(path, "r");
+  return f ? f->size() : 0;
+}
+
+// Every string and number token as its own heap value
+// Every seen-set segment: /seen.seg, /seen.seg.1, ...
+static const char* segmentPath(size_t slot, char* buf, size_t len) {
+  if(slot == 0) snprintf(buf, len, "/seen.seg");
+  else snprintf(buf, len, "/seen.seg.%u", (unsigned)slot);
+  return buf;
+}
+
+static size_t segmentBytes(PalFs &fs) {
+  char path[32];
+  size_t n = 0;
+  for(size_t i = 0; i < SeenIndex::SEGMENT_SLOTS; i++) n += fileSize(fs, segmentPath(i, path, sizeof(path)));
+  return n;
+}
+
+static std::vector<std::string> tokenize(const std::string &s) {
+  std::vector<std::string> out;
+  for(size_t i = 0; i < s.size(); i++) {
+    if(s[i] == '"') {
+      size_t j = s.find('"', i + 1);
+      out.push_back(s.substr(i + 1, j - i - 1));
+      i = j;
+    } else if((s[i] >= '0' && s[i] <= '9') || s[i] == '-' || s[i] == 't' || s[i] == 'f') {
+      size_t j = i;
+      while(j < s.size() && s[j] != ',' && s[j] != '}' && s[j] != ']') j++;
+      out.push_back(s.substr(i, j - i));
+      i = j - 1;
+    }
+  }
+  return out;
+}
+
+static SaveGame sampleGame() {
+  SaveGame g;
+  memset(&g, 0, sizeof(g));
+  copyName(g.playerName, sizeof(g.playerName), "NoName");
+  g.playerLevel = 17;
+  g.hasStarter = true;
+  g.partySize = 3;
+  const char* names[] = { "StarterPal", "CosmicDragon", "FizzyFrog" };
+  for(int i = 0; i < 3; i++) {
+    copyName(g.party[i].name, sizeof(g.party[i].name), names[i]);
+    g.party[i].level = 10 + i;
+    g.party[i].hp = 30 + 5 * (9 + i);
+    g.party[i].defense = 5 + 9 + i;
+  }
+  return g;
+}
+
+static std::string playerJson(const SaveGame &g) {
+  char b[128];
+  snprintf(b, sizeof(b), "{\"name\":\"%s\",\"level\":%u,\"hasStarter\":%s}",
+           g.playerName, g.playerLevel, g.hasStarter ? "true" : "false");
+  return b;
+}
+
+static std::string partyJson(const SaveGame &g) {
+  std::string s = "{\"partySize\":" + std::to_string(g.partySize) + ",\"party\":[";
+  for(int i = 0; i < g.partySize; i++) {
+    char b[128];
+    snprintf(b, sizeof(b), "%s{\"name\":\"%s\",\"level\":%u,\"hp\":%d,\"defense\":%d}",
+             i ? "," : "", g.party[i].name, g.party[i].level, g.party[i].hp, g.party[i].defense);
+    s += b;
+  }
+  return s + "]}";
+}
+
+static bool benchGame(PalFs &fs) {
+  SaveGame g = sampleGame();
+  volatile size_t sink = 0;
+
+  double t0 = nowUs();
+  for(int r = 0; r < ROUNDS; r++) {
+    writeFile(fs, "/player.json", playerJson(g));
+    writeFile(fs, "/userparty.json", partyJson(g));
+  }
+  double jsonSave = (nowUs() - t0) / ROUNDS;
+  t0 = nowUs();
+  for(int r = 0; r < ROUNDS; r++) {
+    sink += tokenize(readFile(fs, "/player.json")).size();
+    sink += tokenize(readFile(fs, "/userparty.json")).size();
+  }
+  double jsonLoad = (nowUs() - t0) / ROUNDS;
+  size_t jsonBytes = fileSize(fs, "/player.json") + fileSize(fs, "/userparty.json");
+
+  SaveStore store(fs, "/save.a", "/save.b");
+  store.setEncoder([&](uint8_t* buf, size_t cap) { return encodeSaveGame(g, buf, cap); });
+  t0 = nowUs();
+  for(int r = 0; r < ROUNDS; r++) {
+    store.markDirty(0);
+    store.sync();
+  }
+  double binSave = (nowUs() - t0) / ROUNDS;
+  uint8_t buf[256];
+  SaveGame back;
+  bool ok = true;
+  t0 = nowUs();
+  for(int r = 0; r < ROUNDS; r++) {
+    SaveStore reader(fs, "/save.a", "/save.b");
+    size_t len = reader.load(buf, sizeof(buf));
+    ok = decodeSaveGame(buf, len, back) && ok;
+  }
+  double binLoad = (nowUs() - t0) / ROUNDS;
+  size_t binBytes = fileSize(fs, "/save.a");
+
+  printf("player+party  json: save %6.1f us  load %6.1f us  %4zu B (2 files)\n", jsonSave, jsonLoad, jsonBytes);
+  printf("              bin:  save %6.1f us  load %6.1f us  %4zu B per slot (x2)\n", binSave, binLoad, binBytes);
+
+  ok = ok && strcmp(back.playerName, g.playerName) == 0 && back.playerLevel == g.playerLevel &&
+       back.partySize == g.partySize;
+  for(int i = 0; i < g.partySize && ok; i++) {
+    ok = strcmp(back.party[i].name, g.party[i].name) == 0 && back.party[i].level == g.party[i].level &&
+         back.party[i].hp == g.party[i].hp && back.party[i].defense == g.party[i].defense;
+  }
+  const char* files[] = { "/player.json", "/userparty.json", "/save.a", "/save.b" };
+  for(const char* f : files) fs.remove(f);
+  return ok;
+}
+
+// "save" is one scan's worth: whole-file rewrite for JSON, 40 inserts +
+// journal sync for the binary index
+static bool benchSeen(PalFs &fs, size_t n) {
+  std::vector<uint64_t> macs(n);
+  srand(9);
+  for(uint64_t &m : macs) m = (((uint64_t)rand() << 24) ^ (uint64_t)rand()) & 0xFFFFFFFFFFFFULL;
+
+  std::string json = "{\"bssids\":[";
+  char mac[18];
+  for(size_t i = 0; i < n; i++) {
+    formatMac(macs[i], mac);
+    if(i) json += ',';
+    json += '"';
+    json += mac;
+    json += '"';
+  }
+  json += "]}";
+  double t0 = nowUs();
+  writeFile(fs, "/bssids.json", json);
+  double jsonSave = nowUs() - t0;
+  t0 = nowUs();
+  std::vector<std::string> tok = tokenize(readFile(fs, "/bssids.json"));
+  size_t parsed = 0;
+  for(const std::string &t : tok) {
+    uint64_t k;
+    if(parseMac(t.c_str(), k)) parsed++;
+  }
+  double jsonLoad = nowUs() - t0;
+
+  size_t streamed = 0;
+  {
+    std::unique_ptr<PalFile> f = fs.open("/bssids.json", "r");
+    streamed = forEachJsonMac(*f, [](uint64_t) {});
+  }
+
+  // binary: build the set, then time one more scan's save (40 new MACs)
+  // and a cold begin(). The old code rewrote the whole JSON file per save.
+  double binSave;
+  std::vector<uint64_t> scan(40);
+  for(uint64_t &m : scan) m = (((uint64_t)rand() << 24) ^ (uint64_t)rand() ^ (1ULL << 47)) & 0xFFFFFFFFFFFFULL;
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin");
+    seen.begin();
+    for(uint64_t m : macs) if(!seen.contains(m)) seen.insert(m);
+    seen.sync();
+    while(seen.merging()) seen.service();
+    t0 = nowUs();
+    for(uint64_t m : scan) if(!seen.contains(m)) seen.insert(m);
+    seen.sync();
+    binSave = nowUs() - t0;
+  }
+  n += scan.size();
+  t0 = nowUs();
+  SeenIndex cold(fs, "/seen.seg", "/bssids.bin");
+  bool crcOk = cold.begin();
+  double binLoad = nowUs() - t0;
+  size_t binBytes = segmentBytes(fs) + fileSize(fs, "/bssids.bin");
+
+  // ~34 B per MAC in an ArduinoJson pool: 16 B slot + 18 B string copy
+  printf("seen n=%-6zu json: save %8.0f us  load %8.0f us  %7zu B  (old 8 KB doc holds ~%d)\n",
+         macs.size(), jsonSave, jsonLoad, json.size(), 8192 / 34);
+  printf("              bin:  save %8.0f us  load %8.0f us  %7zu B  (segments %zu + journal)\n",
+         binSave, binLoad, binBytes, segmentBytes(fs));
+
+  bool ok = crcOk && parsed == macs.size() && streamed == macs.size() && cold.size() == n;
+
+  // flip one record byte: begin() must report it
+  if(fileSize(fs, "/seen.seg") > 0) {
+    std::string seg = readFile(fs, "/seen.seg");
+    seg[seg.size() / 2] ^= 0x40;
+    writeFile(fs, "/seen.seg", seg);
+    SeenIndex bad(fs, "/seen.seg", "/bssids.bin");
+    if(bad.begin() || bad.stats().badSegments != 1) ok = false;
+  }
+  const char* files[] = { "/bssids.json", "/bssids.bin", "/bssids.bin.tmp" };
+  for(const char* f : files) fs.remove(f);
+  char path[32];
+  for(size_t i = 0; i < SeenIndex::SEGMENT_SLOTS; i++) fs.remove(segmentPath(i, path, sizeof(path)));
+  return ok;
+}
+
+int main() {
+  char dir[] = "/tmp/save_format_XXXXXX";
+  if(!mkdtemp(dir)) { perror("mkdtemp"); return 1; }
+  PosixPalFs fs(dir);
+
+  bool ok = benchGame(fs);
+  const size_t sizes[] = { 200, 2000, 20000 };
+  for(size_t n : sizes) ok = benchSeen(fs, n) && ok;
+
+  rmdir(dir);
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// bench_save_store.cpp
+// Host harness: flash traffic of player/party saves during play, old
+// synchronous JSON rewrites vs SaveStore write-behind, plus power-cut checks.
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ibench bench/bench_save_store.cpp src/save_store.cpp src/pal_fs_posix.cpp -o /tmp/bench_save_store
+//   /tmp/bench_save_store
+//
+// The play session is a simulated clock: requests arrive 50 ms..3 s apart
+// and each one changes the save state 1-3 times, like handleBattleAction()
+// (party twice and player once on a win). "sync" rewrites the file inside
+// the handler on every change; "write-behind" marks dirty and lets loop()
+// write one snapshot after the delay. Power cuts are modelled by a file
+// system that stops writing halfway through a file: load() must return the
+// previous snapshot intact, never a torn one.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include "counting_fs.h"
+#include "save_store.h"
+
+static const int REQUESTS = 5000;
+static const uint32_t LOOP_MS = 5;
+
+// Tears every write in half once armed
+class TearingFs : public PalFs {
+public:
+  explicit TearingFs(PalFs &inner) : armed(false), inner_(inner) {}
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override {
+    std::unique_ptr<PalFile> f = inner_.open(path, mode);
+    if(!f) return nullptr;
+    return std::unique_ptr<PalFile>(new File(std::move(f), armed));
+  }
+  bool exists(const char* path) override { return inner_.exists(path); }
+  bool remove(const char* path) override { return inner_.remove(path); }
+  bool rename(const char* from, const char* to) override { return inner_.rename(from, to); }
+  bool armed;
+private:
+  class File : public PalFile {
+  public:
+    File(std::unique_ptr<PalFile> f, bool &armed) : f_(std::move(f)), armed_(armed) {}
+    size_t read(uint8_t* buf, size_t len) override { return f_->read(buf, len); }
+    size_t write(const uint8_t* buf, size_t len) override {
+      return f_->write(buf, armed_ ? len / 2 : len);
+    }
+    bool seek(size_t pos) override { return f_->seek(pos); }
+    size_t size() override { return f_->size(); }
+    void flush() override { f_->flush(); }
+  private:
+    std::unique_ptr<PalFile> f_;
+    bool &armed_;
+  };
+  PalFs &inner_;
+};
+
+// Stand-in for the player + party JSON (~250 bytes)
+static int gVersion = 0;
+static size_t encodeState(uint8_t* buf, size_t cap) {
+  std::string s = "{\"player\":{\"name\":\"NoName\",\"level\":" + std::to_string(gVersion) +
+    ",\"hasStarter\":true},\"partySize\":3,\"party\":[";
+  for(int i = 0; i < 3; i++) {
+    if(i) s += ',';
+    s += "{\"name\":\"StarterPal\",\"level\":" + std::to_string(gVersion + i) +
+         ",\"hp\":42,\"defense\":9}";
+  }
+  s += "]}";
+  if(s.size() > cap) return 0;
+  memcpy(buf, s.data(), s.size());
+  return s.size();
+}
+
+static int versionOf(const uint8_t* buf, size_t len) {
+  std::string s((const char*)buf, len);
+  size_t p = s.find("\"level\":");
+  return p == std::string::npos ? -1 : atoi(s.c_str() + p + 8);
+}
+
+static void session(PalFs &disk, bool writeBehind, uint32_t delayMs) {
+  CountingPalFs fs(disk);
+  SaveStore store(fs, "/save.a", "/save.b");
+  store.setEncoder(encodeState);
+  store.setDelay(delayMs);
+  srand(5);
+  uint32_t now = 0;
+  unsigned long handlerOpens = 0;
+  uint32_t changes = 0;
+  for(int r = 0; r < REQUESTS; r++) {
+    uint32_t gap = 50 + rand() % 2950;
+    for(uint32_t t = 0; t < gap; t += LOOP_MS) store.service(now + t);
+    now += gap;
+    unsigned long before = fs.counters().opens;
+    int n = 1 + rand() % 3;
+    for(int i = 0; i < n; i++) {
+      gVersion++;
+      changes++;
+      store.markDirty(now);
+      if(!writeBehind) store.sync();
+    }
+    handlerOpens += fs.counters().opens - before;
+  }
+  store.sync();
+  const FsCounters &c = fs.counters();
+  if(writeBehind) printf("write-behind %4u ms", delayMs);
+  else            printf("sync              ");
+  printf("  %u changes -> %u snapshots (%lu B), opens in handlers %lu\n",
+         changes, store.writes(), c.bytesWritten, handlerOpens);
+  disk.remove("/save.a");
+  disk.remove("/save.b");
+}
+
+static bool powerCut(PalFs &disk) {
+  bool ok = true;
+  for(int round = 0; round < 4; round++) {
+    TearingFs fs(disk);
+    {
+      SaveStore store(fs, "/save.a", "/save.b");
+      store.setEncoder(encodeState);
+      uint8_t buf[1024];
+      store.load(buf, sizeof(buf));
+      gVersion = 1000 + round;
+      store.markDirty(0);
+      if(!store.sync()) ok = false;
+      // the cut: the next snapshot only gets halfway to flash
+      fs.armed = true;
+      gVersion = 2000 + round;
+      store.markDirty(0);
+      if(store.sync()) ok = false;
+      fs.armed = false;
+    }
+    SaveStore reboot(fs, "/save.a", "/save.b");
+    uint8_t buf[1024];
+    size_t len = reboot.load(buf, sizeof(buf));
+    int v = len ? versionOf(buf, len) : -1;
+    printf("power cut %d: recovered level %d (expected %d)\n", round, v, 1000 + round);
+    if(v != 1000 + round) ok = false;
+  }
+  disk.remove("/save.a");
+  disk.remove("/save.b");
+  return ok;
+}
+
+int main() {
+  char dir[] = "/tmp/save_bench_XXXXXX";
+  if(!mkdtemp(dir)) { perror("mkdtemp"); return 1; }
+  PosixPalFs disk(dir);
+
+  session(disk, false, 0);
+  session(disk, true, 500);
+  session(disk, true, 2000);
+  session(disk, true, 5000);
+  bool ok = powerCut(disk);
+
+  rmdir(dir);
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
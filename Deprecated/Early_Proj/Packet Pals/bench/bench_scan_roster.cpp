@@ -0,0 +1,273 @@
+// bench_scan_roster.cpp
+// Host harness: HIDden 2's scan-to-roster latency, the old handleScan()
+// (scanned_data.json written, reopened and parsed, then /monsters.json
+// written) vs the in-memory pipeline (scan_pipeline.h) with /monsters.json
+// written behind from loop().
+//
+//   g++ -std=gnu++17 -O2 -Iinclude -Ibench -I"../HIDden 2/include" bench/bench_scan_roster.cpp src/hal_posix.cpp src/kv_fs.cpp src/log_kv.cpp src/flash_posix.cpp "../HIDden 2/src/packet_pal.cpp" "../HIDden 2/src/scan_pipeline.cpp" -o /tmp/bench_scan_roster
+//   /tmp/bench_scan_roster
+//
+// ArduinoJson is not available on the host, so as in bench_save_format the
+// old documents are snprintf'd and parsed back by tokenizing every string
+// and number into its own heap copy; treat the old timings as a lower
+// bound. Files go through KvFs on a RamFlash, whose modelled NOR busy time
+// stands in for SPIFFS (erases included, averaged over the scans).
+//
+// Each size runs a drive past a pool of networks: every scan hears n of
+// them, half already met. Both paths get the same dice, and every scan's
+// roster must come out the same. Not modelled: the old 8 KB document
+// silently dropped networks past roughly 65 per scan.
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "flash_backend.h"
+#include "kv_fs.h"
+#include "log_kv.h"
+#include "mac_addr.h"
+#include "mac_set.h"
+#include "packet_pal.h"
+#include "pal_hal.h"
+#include "scan_pipeline.h"
+
+static const int SCANS = 200;
+static const int RUNS = 5;
+
+// main.cpp's Monster, with std::string for String
+struct Monster {
+  std::string bssid;
+  std::string name;
+  std::string type;
+  int hp;
+  int attack;
+  int defense;
+  int level;
+  std::string rarity;
+  std::string specialAbility;
+};
+
+struct Network {
+  PalScanHit rec;
+  char ssid[33];
+};
+
+struct StateStore {
+  RamFlash flash;
+  LogKv kv;
+  KvFs fs;
+  StateStore() : flash(4096, 320), kv(flash), fs(kv) {
+    kv.begin();
+    fs.begin();
+  }
+};
+
+// One scan's worth of timing and flash traffic, summed over SCANS
+struct Cost {
+  double cpuUs;        // fastest run
+  uint64_t flashUs;    // modelled, on the request path
+  uint64_t bytes;      // programmed, on the request path
+  uint64_t behindUs;   // modelled, written behind from loop()
+  uint64_t behindBytes;
+};
+
+static double nowUs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static void writeFile(PalFs &fs, const char* path, const std::string &s) {
+  std::unique_ptr<PalFile> f = fs.open(path, "w");
+  f->write((const uint8_t*)s.data(), s.size());
+}
+
+static std::string readFile(PalFs &fs, const char* path) {
+  std::unique_ptr<PalFile> f = fs.open(path, "r");
+  std::string s(f->size(), '\0');
+  f->read((uint8_t*)&s[0], s.size());
+  return s;
+}
+
+// Every string and number token as its own heap value
+static std::vector<std::string> tokenize(const std::string &s) {
+  std::vector<std::string> out;
+  for(size_t i = 0; i < s.size(); i++) {
+    if(s[i] == '"') {
+      size_t j = s.find('"', i + 1);
+      out.push_back(s.substr(i + 1, j - i - 1));
+      i = j;
+    } else if((s[i] >= '0' && s[i] <= '9') || s[i] == '-') {
+      size_t j = i;
+      while(j < s.size() && s[j] != ',' && s[j] != '}' && s[j] != ']') j++;
+      out.push_back(s.substr(i, j - i));
+      i = j - 1;
+    }
+  }
+  return out;
+}
+
+static Monster toMonster(const std::string &bssid, const PacketPal &p) {
+  char name[24];
+  palName(p, name, sizeof(name));
+  Monster m;
+  m.bssid          = bssid;
+  m.name           = name;
+  m.type           = "Neutral";
+  m.hp             = p.hp;
+  m.attack         = p.attack;
+  m.defense        = p.defense;
+  m.level          = p.level;
+  m.rarity         = palRarityName(p.rarity);
+  m.specialAbility = palAbilityName(p.ability);
+  return m;
+}
+
+static std::string monstersJson(const std::vector<Monster> &roster) {
+  std::string s = "{\"monsters\":[";
+  for(size_t i = 0; i < roster.size(); i++) {
+    const Monster &m = roster[i];
+    char b[256];
+    snprintf(b, sizeof(b),
+             "%s{\"bssid\":\"%s\",\"name\":\"%s\",\"type\":\"%s\",\"hp\":%d,\"attack\":%d,"
+             "\"defense\":%d,\"level\":%d,\"rarity\":\"%s\",\"ability\":\"%s\"}",
+             i ? "," : "", m.bssid.c_str(), m.name.c_str(), m.type.c_str(), m.hp, m.attack,
+             m.defense, m.level, m.rarity.c_str(), m.specialAbility.c_str());
+    s += b;
+  }
+  return s + "]}";
+}
+
+// scanAndStoreNetworks() + generateAndStoreMonsters()
+static void oldScan(PalFs &fs, const Network* nets, int n, MacSet &seen, int pLevel,
+                    const PalDice &dice, std::vector<Monster> &roster) {
+  std::string doc = "{\"networks\":[";
+  char mac[18];
+  for(int i = 0; i < n; i++) {
+    formatMac(nets[i].rec.bssid, mac);
+    char b[160];
+    snprintf(b, sizeof(b), "%s{\"ssid\":\"%s\",\"bssid\":\"%s\",\"rssi\":%d,\"encryption\":\"%s\"}",
+             i ? "," : "", nets[i].ssid, mac, nets[i].rec.rssi, palAuthName(nets[i].rec.auth));
+    doc += b;
+  }
+  doc += "]}";
+  writeFile(fs, "/scanned_data.json", doc);
+
+  std::vector<std::string> tok = tokenize(readFile(fs, "/scanned_data.json"));
+  roster.clear();
+  // "networks", then per network: ssid, <ssid>, bssid, <bssid>, rssi, <rssi>, encryption, <enc>
+  for(size_t t = 1; t + 7 < tok.size(); t += 8) {
+    const std::string &bssid = tok[t + 3];
+    int rssi = atoi(tok[t + 5].c_str());
+    const std::string &enc = tok[t + 7];
+    uint64_t key;
+    if(!parseMac(bssid.c_str(), key) || seen.contains(key)) continue;
+    PacketPal p = makePacketPal(rssi, palAuthFromName(enc.c_str()), dice);
+    scalePacketPal(p, pLevel, dice);
+    seen.insert(key);
+    roster.push_back(toMonster(bssid, p));
+  }
+  writeFile(fs, "/monsters.json", monstersJson(roster));
+}
+
+// scanIntoRoster(); the save is persistMonsters() later on
+static void newScan(const Network* nets, int n, MacSet &seen, int pLevel,
+                    const PalDice &dice, std::vector<Monster> &roster) {
+  roster.clear();
+  seen.reserve(seen.size() + n);
+  char mac[18];
+  for(int i = 0; i < n; i++) {
+    PacketPal p;
+    if(!palFromScan(nets[i].rec, seen, pLevel, dice, p)) continue;
+    formatMac(nets[i].rec.bssid, mac);
+    roster.push_back(toMonster(mac, p));
+  }
+}
+
+static std::vector<Network> makePool(size_t count) {
+  SeededRng rng(25);
+  std::vector<Network> pool(count);
+  for(Network &net : pool) {
+    net.rec.bssid = (((uint64_t)rng.next() << 16) ^ rng.next()) & 0xFFFFFFFFFFFFULL;
+    net.rec.rssi = rng.uniform(-95, -29);
+    net.rec.auth = rng.uniform(0, 8);
+    snprintf(net.ssid, sizeof(net.ssid), "Net-%0*u", rng.uniform(2, 12), (unsigned)rng.next() % 100000);
+  }
+  return pool;
+}
+
+static bool sameRoster(const std::vector<Monster> &a, const std::vector<Monster> &b) {
+  if(a.size() != b.size()) return false;
+  for(size_t i = 0; i < a.size(); i++) {
+    if(a[i].bssid != b[i].bssid || a[i].name != b[i].name || a[i].hp != b[i].hp ||
+       a[i].attack != b[i].attack || a[i].defense != b[i].defense || a[i].level != b[i].level ||
+       a[i].rarity != b[i].rarity || a[i].specialAbility != b[i].specialAbility) return false;
+  }
+  return true;
+}
+
+static bool benchSize(int n) {
+  std::vector<Network> pool = makePool((size_t)SCANS * n / 2 + n);
+  Cost oldCost = { 1e30, 0, 0, 0, 0 }, newCost = { 1e30, 0, 0, 0, 0 };
+  size_t mismatches = 0, fresh = 0;
+
+  for(int run = 0; run < RUNS; run++) {
+    StateStore oldSt, newSt;
+    MacSet oldSeen, newSeen;
+    SeededRng oldRng(7), newRng(7);
+    PalDice oldDice = [&oldRng](int lo, int hi) { return oldRng.uniform(lo, hi); };
+    PalDice newDice = [&newRng](int lo, int hi) { return newRng.uniform(lo, hi); };
+    std::vector<Monster> oldRoster, newRoster;
+    double oldUs = 0, newUs = 0;
+    uint64_t behindUs = 0, behindBytes = 0;
+
+    for(int s = 0; s < SCANS; s++) {
+      const Network* scan = &pool[(size_t)s * n / 2];
+      int pLevel = 5 + s % 40;
+      double t0 = nowUs();
+      oldScan(oldSt.fs, scan, n, oldSeen, pLevel, oldDice, oldRoster);
+      oldUs += nowUs() - t0;
+
+      t0 = nowUs();
+      newScan(scan, n, newSeen, pLevel, newDice, newRoster);
+      newUs += nowUs() - t0;
+      uint64_t busy = newSt.flash.busyUs(), bytes = newSt.flash.bytesProgrammed();
+      writeFile(newSt.fs, "/monsters.json", monstersJson(newRoster));
+      behindUs += newSt.flash.busyUs() - busy;
+      behindBytes += newSt.flash.bytesProgrammed() - bytes;
+
+      if(run == 0) {
+        mismatches += !sameRoster(oldRoster, newRoster);
+        fresh += newRoster.size();
+      }
+    }
+    oldCost.cpuUs = std::min(oldCost.cpuUs, oldUs);
+    newCost.cpuUs = std::min(newCost.cpuUs, newUs);
+    oldCost.flashUs = oldSt.flash.busyUs();
+    oldCost.bytes = oldSt.flash.bytesProgrammed();
+    newCost.behindUs = behindUs;
+    newCost.behindBytes = behindBytes;
+  }
+
+  double oldCpu = oldCost.cpuUs / SCANS, newCpu = newCost.cpuUs / SCANS;
+  double oldFlash = (double)oldCost.flashUs / SCANS;
+  double oldTotal = oldCpu + oldFlash, newTotal = newCpu;
+  printf("%4d networks (%4.1f new)  old: cpu %8.1f us + flash %8.1f us = %8.1f us, %6.0f B\n",
+         n, (double)fresh / SCANS, oldCpu, oldFlash, oldTotal, (double)oldCost.bytes / SCANS);
+  printf("%26s  new: cpu %8.1f us + flash %8.1f us = %8.1f us, %6.0f B  (%.0fx)\n",
+         "", newCpu, 0.0, newTotal, 0.0, oldTotal / newTotal);
+  printf("%26s       behind: flash %8.1f us, %6.0f B after the response\n",
+         "", (double)newCost.behindUs / SCANS, (double)newCost.behindBytes / SCANS);
+  if(mismatches) printf("  %u scans gave different rosters\n", (unsigned)mismatches);
+  return mismatches == 0 && fresh > 0;
+}
+
+int main() {
+  printf("scan -> roster per scan, %d scans, fastest of %d runs; flash is modelled NOR time\n\n",
+         SCANS, RUNS);
+  bool ok = true;
+  const int sizes[] = { 10, 30, 60, 150 };
+  for(int n : sizes) ok = benchSize(n) && ok;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+// bench_seen_index.cpp
+// Host harness for SeenIndex (seen_index.h).
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ibench bench/bench_seen_index.cpp src/seen_index.cpp src/bssid_journal.cpp src/boot_image.cpp src/pal_fs_posix.cpp src/kv_fs.cpp src/log_kv.cpp src/flash_posix.cpp -o /tmp/bench_seen_index
+//   /tmp/bench_seen_index
+//
+// "merge failure" fills the file system under a running index, once with
+// no room at all (the index sees it in freeBytes() and keeps the run in
+// RAM) and once, with free space hidden, so the merge runs out
+// mid-segment, with inserts carrying on through both. Every key must stay
+// a member, in RAM, after space comes back, and after a reboot from flash.
+//
+// "short merge" has a merge find room for the frozen run but not for its
+// oldest input, so the new segment is bigger than an older one; the boot
+// image written after it must be taken at the next boot. "old footers"
+// boots from segments written before footers had a sequence number.
+//
+// "scaling" inserts random MACs at the firmware's sizes (1024-key
+// memtable, 32 KB Bloom cap) and reports at each step: segments, bytes
+// written per key against what rewriting one segment on every merge would
+// have written, the Bloom filter's size, its false positive rate
+// (estimated, and measured on MACs never inserted) and segment block reads
+// per lookup of a new MAC. On the host file system it goes to 200 K keys;
+// on a KvFs over a RamFlash the size of the 1.25 MB "pals" partition it
+// runs until a merge finds no room, then checks every key is still found,
+// before and after a reboot.
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "boot_image.h"
+#include "counting_fs.h"
+#include "crc32.h"
+#include "flash_backend.h"
+#include "full_fs.h"
+#include "kv_fs.h"
+#include "log_kv.h"
+#include "mac_addr.h"
+#include "seen_index.h"
+
+static const size_t MEMTABLE = 256;
+static const size_t FW_MEMTABLE = 1024;
+static const size_t FW_BLOOM_BITS = 256 * 1024;
+static const size_t PROBES = 20000;
+
+static uint64_t nextMac(uint64_t &state) {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (state >> 16) & 0xFFFFFFFFFFFFULL;
+}
+
+static size_t insertNew(SeenIndex &seen, std::vector<uint64_t> &keys, size_t n, uint64_t &rng) {
+  for(size_t i=0; i<n; i++){
+    uint64_t mac = nextMac(rng);
+    if(seen.contains(mac)) continue;
+    seen.insert(mac);
+    keys.push_back(mac);
+    if(keys.size() % 40 == 0) seen.sync();
+    seen.service();
+  }
+  return keys.size();
+}
+
+static size_t missing(SeenIndex &seen, const std::vector<uint64_t> &keys) {
+  size_t n = 0;
+  for(uint64_t k : keys) n += !seen.contains(k);
+  return n;
+}
+
+static void removeAll(PalFs &fs) {
+  char path[32];
+  for(size_t i=0; i<SeenIndex::SEGMENT_SLOTS; i++){
+    if(i == 0) snprintf(path, sizeof(path), "/seen.seg");
+    else snprintf(path, sizeof(path), "/seen.seg.%u", (unsigned)i);
+    fs.remove(path);
+  }
+  fs.remove("/seen.seg.tmp");
+  fs.remove("/bssids.bin");
+  fs.remove("/bssids.bin.tmp");
+}
+
+static bool benchMergeFailure(PalFs &inner) {
+  FullPalFs fs(inner, 1 << 30);
+  std::vector<uint64_t> keys;
+  uint64_t rng = 3;
+  bool ok = true;
+  size_t lostOpen, lostMid, lostAfter, lostBoot;
+  uint32_t merges;
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 64 * 1024, MEMTABLE);
+    seen.begin();
+    insertNew(seen, keys, 3 * MEMTABLE, rng);
+    while(seen.merging()) seen.service();
+    merges = seen.stats().merges;
+
+    // no room at all: the next merge is put off
+    fs.setFree(0);
+    insertNew(seen, keys, MEMTABLE + 10, rng);
+    lostOpen = missing(seen, keys);
+    ok = ok && seen.stats().mergesNoRoom > 0;
+
+    // room for part of a segment, unannounced: the merge dies mid-output
+    fs.setFree(3000);
+    fs.hideFree(true);
+    insertNew(seen, keys, MEMTABLE + 10, rng);
+    while(seen.merging()) seen.service();
+    lostMid = missing(seen, keys);
+    ok = ok && seen.stats().merges == merges;
+    fs.hideFree(false);
+
+    // space back: the next merge takes every frozen key with it
+    fs.setFree(1 << 30);
+    insertNew(seen, keys, MEMTABLE + 10, rng);
+    while(seen.merging()) seen.service();
+    seen.sync();
+    lostAfter = missing(seen, keys);
+    ok = ok && seen.stats().merges > merges && seen.size() == keys.size();
+  }
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 64 * 1024, MEMTABLE);
+    seen.begin();
+    lostBoot = missing(seen, keys);
+    ok = ok && seen.size() == keys.size();
+  }
+  ok = ok && lostOpen == 0 && lostMid == 0 && lostAfter == 0 && lostBoot == 0;
+  printf("merge failure  %zu keys, %lu short writes; missing: no room %zu, mid-merge %zu, "
+         "after %zu, after reboot %zu -> %s\n",
+         keys.size(), fs.shortWrites(), lostOpen, lostMid, lostAfter, lostBoot, ok ? "ok" : "FAILED");
+  removeAll(inner);
+  return ok;
+}
+
+static bool benchShortMerge(PalFs &inner) {
+  FullPalFs fs(inner, 1 << 30);
+  std::vector<uint64_t> keys;
+  uint64_t rng = 5;
+  bool ok, fromImage = false;
+  size_t lostBoot;
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 64 * 1024, MEMTABLE);
+    seen.begin();
+    insertNew(seen, keys, MEMTABLE, rng);
+    while(seen.merging()) seen.service();
+    // no room: the next run stays frozen
+    fs.setFree(0);
+    insertNew(seen, keys, MEMTABLE, rng);
+    // room for the frozen run and the next memtable, not for the segment too
+    while(seen.stats().mergesNoRoom < 2){
+      fs.setFree(2 * MEMTABLE * BssidJournal::RECORD_SIZE + 1024);
+      insertNew(seen, keys, 1, rng);
+    }
+    while(seen.merging()) seen.service();
+    fs.setFree(1 << 30);
+    seen.sync();
+    ok = seen.segments() == 2 && seen.stats().merges == 2;
+    BootImageWriter w(fs, "/boot.img");
+    ok = ok && seen.addToImage(w) && w.commit();
+  }
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 64 * 1024, MEMTABLE);
+    BootImageReader img(fs, "/boot.img");
+    fromImage = img.begin() && seen.beginFromImage(img);
+    if(!fromImage) seen.begin();
+    lostBoot = missing(seen, keys);
+    ok = ok && fromImage && lostBoot == 0 && seen.size() == keys.size();
+  }
+  printf("short merge    %zu keys, 2 segments, newest the bigger; boot image %s, missing after reboot %zu -> %s\n",
+         keys.size(), fromImage ? "taken" : "REFUSED", lostBoot, ok ? "ok" : "FAILED");
+  fs.remove("/boot.img");
+  removeAll(inner);
+  return ok;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// Two version 1 segments, the smaller in slot 0, then a merge that takes
+// the smaller one in; the boot image after it must match at the reboot
+static bool benchOldFooters(PalFs &fs) {
+  const size_t REC = BssidJournal::RECORD_SIZE;
+  const size_t sizes[2] = { MEMTABLE / 2, 4 * MEMTABLE };
+  std::vector<uint64_t> keys;
+  uint64_t rng = 9;
+  for(size_t slot = 0; slot < 2; slot++){
+    std::vector<uint64_t> run;
+    for(size_t i=0; i<sizes[slot]; i++) run.push_back(nextMac(rng));
+    std::sort(run.begin(), run.end());
+    std::vector<uint8_t> buf(run.size() * REC + SeenIndex::FOOTER_V1_SIZE);
+    for(size_t i=0; i<run.size(); i++) keyToMac(run[i], &buf[i * REC]);
+    uint8_t* foot = &buf[run.size() * REC];
+    put32(foot, SeenIndex::SEGMENT_MAGIC);
+    put32(foot + 4, 1 | (uint32_t)REC << 16);
+    put32(foot + 8, (uint32_t)run.size());
+    put32(foot + 12, crc32(buf.data(), run.size() * REC));
+    std::unique_ptr<PalFile> f = fs.open(slot ? "/seen.seg.1" : "/seen.seg", "w");
+    if(!f || f->write(buf.data(), buf.size()) != buf.size()) return false;
+    keys.insert(keys.end(), run.begin(), run.end());
+  }
+  bool ok, fromImage = false;
+  size_t lostBoot;
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 64 * 1024, MEMTABLE);
+    ok = seen.begin() && seen.segments() == 2 && missing(seen, keys) == 0;
+    insertNew(seen, keys, MEMTABLE, rng);
+    while(seen.merging()) seen.service();
+    seen.sync();
+    ok = ok && seen.segments() == 2 && seen.stats().badSegments == 0;
+    BootImageWriter w(fs, "/boot.img");
+    ok = ok && seen.addToImage(w) && w.commit();
+  }
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", 64 * 1024, MEMTABLE);
+    BootImageReader img(fs, "/boot.img");
+    fromImage = img.begin() && seen.beginFromImage(img);
+    if(!fromImage) seen.begin();
+    lostBoot = missing(seen, keys);
+    ok = ok && fromImage && lostBoot == 0 && seen.size() == keys.size();
+  }
+  printf("old footers    %zu keys from 2 version 1 segments; boot image %s, missing after reboot %zu -> %s\n",
+         keys.size(), fromImage ? "taken" : "REFUSED", lostBoot, ok ? "ok" : "FAILED");
+  fs.remove("/boot.img");
+  removeAll(fs);
+  return ok;
+}
+
+// Bytes written by the time `keys` are in if every merge of a full
+// memtable rewrote one whole segment
+static double oneSegmentBytes(size_t keys) {
+  double merges = (double)(keys / FW_MEMTABLE);
+  return merges * (merges + 1) / 2 * FW_MEMTABLE * BssidJournal::RECORD_SIZE;
+}
+
+static void report(SeenIndex &seen, CountingPalFs &fs, uint64_t &probe) {
+  SeenIndex::Stats before = seen.stats();
+  for(size_t i=0; i<PROBES; i++) seen.contains(nextMac(probe));
+  const SeenIndex::Stats &after = seen.stats();
+  size_t keys = seen.size();
+  double passed = (double)(PROBES - (after.bloomRejects - before.bloomRejects)) / PROBES;
+  printf("  %7zu keys  %zu segs  %6.1f B/key written (one segment %7.1f)  "
+         "bloom %5zu B k=%d  fp %.4f (est %.4f)  %.3f reads/lookup  no room %u\n",
+         keys, seen.segments(), (double)fs.counters().bytesWritten / keys,
+         oneSegmentBytes(keys) / keys, seen.bloomBytes(), seen.bloomHashes(),
+         passed, seen.bloomFalsePositive(),
+         (double)(after.flashReads - before.flashReads) / PROBES, after.mergesNoRoom);
+}
+
+// Inserts without contains(): random 48-bit MACs practically never repeat.
+// Stops at `limit` keys or the first merge with no room.
+static bool benchScaling(const char* label, PalFs &inner, KvFs* kv, size_t limit) {
+  CountingPalFs fs(inner);
+  std::vector<uint64_t> sample;
+  uint64_t rng = 11, probe = 0x5eed;
+  size_t next = 10000, keys = 0, lost = 0, lostBoot = 0, booted = 0;
+  bool full = false;
+  printf("scaling, %s\n", label);
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", FW_BLOOM_BITS, FW_MEMTABLE);
+    seen.begin();
+    while(keys < limit && !full){
+      uint64_t mac = nextMac(rng);
+      seen.insert(mac);
+      if(++keys % 97 == 0) sample.push_back(mac);
+      if(keys % 40 == 0) seen.sync();
+      seen.service();
+      if(kv) kv->service();
+      full = seen.stats().mergesNoRoom > 0;
+      if(keys == next || full){
+        report(seen, fs, probe);
+        next *= 2;
+      }
+    }
+    while(seen.merging()) seen.service();
+    seen.sync();
+    lost = missing(seen, sample);
+    keys = seen.size();
+    if(kv) printf("  first merge short of room at %zu keys, %zu bytes free\n", keys, kv->freeBytes());
+  }
+  {
+    SeenIndex seen(fs, "/seen.seg", "/bssids.bin", FW_BLOOM_BITS, FW_MEMTABLE);
+    seen.begin();
+    lostBoot = missing(seen, sample);
+    booted = seen.size();
+  }
+  bool ok = lost == 0 && lostBoot == 0 && booted == keys && (!kv || full);
+  printf("  sampled %zu keys: missing %zu, after reboot %zu (%zu keys) -> %s\n",
+         sample.size(), lost, lostBoot, booted, ok ? "ok" : "FAILED");
+  removeAll(inner);
+  return ok;
+}
+
+int main() {
+  char dir[] = "/tmp/seen_bench_XXXXXX";
+  if(!mkdtemp(dir)){ perror("mkdtemp"); return 1; }
+  PosixPalFs fs(dir);
+
+  bool ok = benchMergeFailure(fs);
+  ok = benchShortMerge(fs) && ok;
+  ok = benchOldFooters(fs) && ok;
+  ok = benchScaling("host file system", fs, nullptr, 200000) && ok;
+  {
+    RamFlash flash(4096, 320);
+    LogKv kv(flash);
+    KvFs kvfs(kv);
+    kv.begin();
+    kvfs.begin();
+    ok = benchScaling("KvFs on a 1.25 MB RamFlash", kvfs, &kvfs, 400000) && ok;
+  }
+
+  rmdir(dir);
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+// bench_sessions.cpp
+// Host harness for SessionTable: N simulated players battling in parallel
+// threads on one table, checked for cross-talk, plus LRU eviction, a full
+// table of active players, the save snapshot round trip and the memory
+// each session costs, and the pre-session game on an upgraded board.
+//
+//   g++ -std=c++17 -O2 -pthread -Iinclude bench/bench_sessions.cpp src/session_table.cpp src/battle.cpp src/save_format.cpp src/api_schema.cpp src/json_stream.cpp src/pull_sink.cpp -o /tmp/bench_sessions
+//   /tmp/bench_sessions
+//
+// Each player is a thread doing what a phone does over HTTP: start a
+// battle, send actions until it ends, now and then swap party slots. Every
+// request takes the one state mutex and looks its session up by token, as
+// the handlers do with StateLock. Alongside, each player replays the same
+// requests on a private SaveGame with the same dice; its session must end
+// up identical, and every turn's message must match.
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "battle.h"
+#include "session_table.h"
+
+static const size_t SESSIONS = 8;   // SESSION_MAX in pals_core.cpp
+static const uint32_t MIN_IDLE_MS = 10UL * 60 * 1000;   // SESSION_MIN_IDLE_MS
+static const int BATTLES = 4000;
+typedef SessionTable<SESSIONS> Table;
+
+static double nowSec() {
+  using namespace std::chrono;
+  return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Rng {
+  uint32_t s;
+  explicit Rng(uint32_t seed) : s(seed ? seed : 1) {}
+  uint32_t next() {
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    return s;
+  }
+  int range(int lo, int hi) { return lo + (int)(next() % (uint32_t)(hi - lo)); }
+};
+
+static SavedMonster wildFor(uint32_t id) {
+  SavedMonster m;
+  char name[16];
+  snprintf(name, sizeof(name), "Wild%u", (unsigned)(id % 1000));
+  copyName(m.name, sizeof(m.name), name);
+  m.level = (uint16_t)(1 + id % 6);
+  recalcMonsterStats(m);
+  return m;
+}
+
+struct Player {
+  uint64_t token;
+  uint32_t seed;
+  SaveGame shadow;
+  uint32_t turns;
+  bool ok;
+};
+
+static void play(Table &table, std::mutex &lock, Player &p, int battles) {
+  Rng choose(p.seed), real(p.seed * 7 + 1), twin(p.seed * 7 + 1);
+  BattleDice realDice = [&real](int lo, int hi) { return real.range(lo, hi); };
+  BattleDice twinDice = [&twin](int lo, int hi) { return twin.range(lo, hi); };
+  BattleState twinBattle;
+  p.ok = true;
+  for(int b = 0; b < battles && p.ok; b++) {
+    uint32_t wildId = choose.next() | 1;
+    int idx = choose.range(0, p.shadow.partySize);
+    SavedMonster wild = wildFor(wildId);
+    {
+      std::lock_guard<std::mutex> g(lock);
+      Session* s = table.find(p.token);
+      p.ok = s && beginBattle(s->game, s->battle, idx, wildId, wild);
+    }
+    beginBattle(p.shadow, twinBattle, idx, wildId, wild);
+
+    bool end = false;
+    while(!end && p.ok) {
+      static const BattleAction ACTIONS[] = { BATTLE_ATTACK, BATTLE_ATTACK, BATTLE_DEFEND, BATTLE_CAPTURE, BATTLE_RUN };
+      BattleAction a = ACTIONS[choose.range(0, b % 10 ? 4 : 5)];
+      char msg[192] = "", want[192] = "";
+      {
+        std::lock_guard<std::mutex> g(lock);
+        Session* s = table.find(p.token);
+        if(!s || !s->battle.inProgress || s->battle.wildId != wildId) { p.ok = false; break; }
+        end = battleTurn(s->game, s->battle, a, realDice, msg, sizeof(msg)).battleEnd;
+      }
+      battleTurn(p.shadow, twinBattle, a, twinDice, want, sizeof(want));
+      p.ok = strcmp(msg, want) == 0;
+      p.turns++;
+    }
+
+    // a full party swaps, then releases a slot so captures keep happening
+    if(p.shadow.partySize > 1 && choose.range(0, 4) == 0) {
+      int s1 = choose.range(0, p.shadow.partySize), s2 = choose.range(0, p.shadow.partySize);
+      bool drop = p.shadow.partySize == SaveGame::PARTY_MAX;
+      std::lock_guard<std::mutex> g(lock);
+      Session* s = table.find(p.token);
+      if(!s) { p.ok = false; break; }
+      for(SaveGame* game : { &s->game, &p.shadow }) {
+        std::swap(game->party[s1], game->party[s2]);
+        if(drop) game->partySize--;
+      }
+    }
+  }
+  std::lock_guard<std::mutex> g(lock);
+  Session* s = table.find(p.token);
+  uint8_t a[SAVE_GAME_BYTES], b[SAVE_GAME_BYTES];
+  p.ok = p.ok && s && encodeSaveGame(s->game, a, sizeof(a)) && encodeSaveGame(p.shadow, b, sizeof(b)) &&
+         memcmp(a, b, sizeof(a)) == 0;
+}
+
+static Player join(Table &table, uint64_t token, uint32_t seed) {
+  Player p;
+  p.token = token;
+  p.seed = seed;
+  p.turns = 0;
+  p.ok = true;
+  newGame(p.shadow);
+  snprintf(p.shadow.playerName, sizeof(p.shadow.playerName), "P%u", (unsigned)seed);
+  table.open(token).game = p.shadow;
+  return p;
+}
+
+// N players on one table at once; false on any cross-talk
+static bool parallel(size_t players) {
+  Table table;
+  std::mutex lock;
+  std::vector<Player> ps;
+  for(size_t i = 0; i < players; i++) ps.push_back(join(table, (1ULL << 63) | (i * 0x9E3779B97F4A7C15ULL), 100 + i));
+  double t0 = nowSec();
+  std::vector<std::thread> threads;
+  for(Player &p : ps) threads.emplace_back(play, std::ref(table), std::ref(lock), std::ref(p), BATTLES);
+  for(std::thread &t : threads) t.join();
+  double sec = nowSec() - t0;
+  bool ok = true;
+  uint64_t turns = 0;
+  for(Player &p : ps) {
+    ok = ok && p.ok;
+    turns += p.turns;
+  }
+  printf("%2zu players  %7llu turns  %8.0f turns/s  %s\n", players, (unsigned long long)turns,
+         turns / sec, ok ? "no cross-talk" : "CROSS-TALK");
+  return ok && table.evictions() == 0;
+}
+
+// Four idle players, then four active ones keep playing while four new
+// phones join: only the idle sessions may go
+static bool lru() {
+  Table table;
+  std::mutex lock;
+  std::vector<Player> idle, active;
+  for(uint32_t i = 0; i < 4; i++) idle.push_back(join(table, 0x8000000000000100ULL + i, 200 + i));
+  for(uint32_t i = 0; i < 4; i++) active.push_back(join(table, 0x8000000000000200ULL + i, 300 + i));
+  for(Player &p : active) play(table, lock, p, 10);
+  for(uint32_t i = 0; i < 4; i++) join(table, 0x8000000000000300ULL + i, 400 + i);
+  bool ok = table.size() == SESSIONS && table.evictions() == 4;
+  for(Player &p : idle) ok = ok && !table.find(p.token);
+  for(Player &p : active) {
+    play(table, lock, p, 10);
+    ok = ok && p.ok;
+  }
+
+  // the snapshot keeps the games and their recency
+  uint8_t buf[SESSION_SAVE_BYTES(SESSIONS)];
+  size_t len = table.save(buf, sizeof(buf));
+  Table back;
+  ok = ok && len == sizeof(buf) && back.load(buf, len) && back.size() == SESSIONS;
+  for(Player &p : active) {
+    Session* s = back.find(p.token);
+    ok = ok && s && strcmp(s->game.playerName, p.shadow.playerName) == 0;
+  }
+  // the four active ones were just touched; the oldest is a joiner
+  back.open(0x8000000000000400ULL);
+  ok = ok && !back.find(0x8000000000000300ULL);
+  for(Player &p : active) ok = ok && back.find(p.token);
+  printf("lru:         %u evictions, idle sessions dropped, active kept, snapshot %zu B  %s\n",
+         table.evictions(), len, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// sessionFor() in pals_core.cpp: a known token is stamped; without one a
+// read-only request is shown the unclaimed pre-session game if there is
+// one, else the guest game (no slot), and a state-changing one claims that
+// game or gets a new session, if tryOpen() finds room. legacy: every
+// token-less request opened a session, as before SESSION_MIN_IDLE_MS.
+enum Arrival { KNOWN, UNCLAIMED, GUEST, CLAIMED, OPENED, REFUSED };
+static Arrival arrive(Table &table, uint64_t token, bool changes, uint32_t ms, bool legacy) {
+  Session* s = table.find(token);
+  if(s) {
+    s->lastMs = ms;
+    return KNOWN;
+  }
+  if(legacy) {
+    table.open(changes ? token : 0x8000000000000900ULL + table.evictions());
+    return OPENED;
+  }
+  if(!changes) return table.peek(Table::ORPHAN) ? UNCLAIMED : GUEST;
+  s = table.claimOrphan(token);
+  if(s) {
+    s->lastMs = ms;
+    return CLAIMED;
+  }
+  s = table.tryOpen(token, ms, MIN_IDLE_MS);
+  if(!s) return REFUSED;
+  newGame(s->game);
+  return OPENED;
+}
+
+// Eight players, each making a request every 5 s (the clock wraps on the
+// way), while a phone without a token polls /myParty once a second; lost
+// counts player requests whose game was gone. Then a ninth player tries
+// to start a battle, and again after one player has gone quiet for
+// MIN_IDLE_MS.
+static bool fullTable() {
+  uint32_t polls = 0, lost[2] = { 0, 0 };
+  bool ok = true;
+  for(int legacy = 1; legacy >= 0; legacy--) {
+    Table table;
+    uint32_t ms = 0xFFFF0000u;
+    for(uint32_t i = 0; i < SESSIONS; i++) ok = ok && arrive(table, 0x8000000000000500ULL + i, true, ms, false) == OPENED;
+    for(int sec = 0; sec < 120; sec++, ms += 1000) {
+      arrive(table, 0, false, ms, legacy);
+      polls += !legacy;
+      if(sec % 5 == 0) {
+        for(uint32_t i = 0; i < SESSIONS; i++) lost[legacy] += arrive(table, 0x8000000000000500ULL + i, true, ms, legacy) != KNOWN;
+      }
+    }
+    if(legacy) continue;
+
+    // everyone active: the newcomer waits, nobody is dropped
+    ok = ok && arrive(table, 0x8000000000000600ULL, true, ms, false) == REFUSED && table.evictions() == 0;
+    // player 0 stops; the rest carry on until it has been idle long enough
+    uint32_t quiet = ms;
+    for(; ms - quiet < MIN_IDLE_MS; ms += 5000) {
+      for(uint32_t i = 1; i < SESSIONS; i++) arrive(table, 0x8000000000000500ULL + i, true, ms, false);
+      if(ms - quiet < MIN_IDLE_MS - 5000) ok = ok && arrive(table, 0x8000000000000600ULL, true, ms, false) == REFUSED;
+    }
+    ok = ok && arrive(table, 0x8000000000000600ULL, true, ms, false) == OPENED && table.evictions() == 1 &&
+         !table.peek(0x8000000000000500ULL) && table.peek(0x8000000000000600ULL);
+    for(uint32_t i = 1; i < SESSIONS; i++) ok = ok && table.peek(0x8000000000000500ULL + i);
+  }
+  ok = ok && lost[0] == 0 && lost[1] > 0;
+  printf("full table:  %u token-less polls, player games lost %u (before: %u); "
+         "newcomer refused while all active, let in after %u s idle  %s\n",
+         polls, lost[0], lost[1], (unsigned)(MIN_IDLE_MS / 1000), ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// A board upgraded from single-player firmware: the old game waits under
+// ORPHAN. A phone's first reads must show that party, not the guest's,
+// since the battle it then starts is fought with the party it was shown.
+static bool upgraded() {
+  Table table;
+  Session &old = table.open(Table::ORPHAN);
+  newGame(old.game);
+  copyName(old.game.playerName, sizeof(old.game.playerName), "Ash");
+  old.game.partySize = 3;
+  uint32_t use = old.lastUse;
+  const uint64_t phone = 0x8000000000000700ULL;
+  bool ok = arrive(table, 0, false, 0, false) == UNCLAIMED && arrive(table, 0, false, 1000, false) == UNCLAIMED;
+  // watching it doesn't make it the most recent game
+  ok = ok && table.peek(Table::ORPHAN)->lastUse == use && table.size() == 1;
+  ok = ok && arrive(table, phone, true, 2000, false) == CLAIMED && table.size() == 1;
+  const Session* mine = table.peek(phone);
+  ok = ok && mine && mine->game.partySize == 3 && strcmp(mine->game.playerName, "Ash") == 0;
+  // once claimed, a phone without a token is a guest again
+  ok = ok && arrive(table, 0, false, 3000, false) == GUEST;
+  ok = ok && arrive(table, 0x8000000000000701ULL, true, 4000, false) == OPENED && table.size() == 2;
+  printf("upgraded:    token-less reads show the unclaimed game, the first battle claims it  %s\n",
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static bool tokens() {
+  char hex[17];
+  uint64_t t = 0, back = 0;
+  formatToken(0x8123456789abcdefULL, hex);
+  bool ok = strcmp(hex, "8123456789abcdef") == 0 && parseToken(hex, 16, back) && back == 0x8123456789abcdefULL;
+  ok = ok && cookieToken("theme=dark; pals=8123456789ABCDEF; x=1", "pals", t) && t == back;
+  ok = ok && !cookieToken("xpals=8123456789abcdef", "pals", t) && !cookieToken("pals=123", "pals", t);
+  ok = ok && !parseToken("0000000000000000", 16, t);
+  return ok;
+}
+
+int main() {
+  printf("memory: %zu B per session, %zu B for the %zu-slot table, %zu B save snapshot\n",
+         sizeof(Session), sizeof(Table), SESSIONS, (size_t)SESSION_SAVE_BYTES(SESSIONS));
+  bool ok = tokens();
+  for(size_t n : { 1, 2, 4, 8 }) ok = parallel(n) && ok;
+  ok = lru() && ok;
+  ok = fullTable() && ok;
+  ok = upgraded() && ok;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
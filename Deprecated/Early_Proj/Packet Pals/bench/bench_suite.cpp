@@ -0,0 +1,764 @@
+// bench_suite.cpp
+// Host microbenchmarks for the paths that run per network or per request,
+// with fixed seeds and machine-readable results, so a slowdown shows up as
+// a diff against bench/baseline.json before it reaches a board.
+//
+//   g++ -std=gnu++17 -O2 -pthread -Iinclude -Ibench -I"../HIDden 2/include" -I../UHFU/include bench/bench_suite.cpp $(ls src/*.cpp | grep -v 'main.cpp') "../HIDden 2/src/packet_pal.cpp" ../UHFU/src/scan_json.cpp -o /tmp/bench_suite
+//   /tmp/bench_suite --baseline bench/baseline.json
+//
+// Options:
+//   --json FILE       write the results as JSON ("-" for stdout)
+//   --baseline FILE   compare with an earlier --json; exits 1 on a regression
+//   --tolerance F     how much slower than the baseline counts, host drift
+//                     taken out (default 0.35: clean reruns on a shared
+//                     1-core host came within 24%)
+//   --repeat N        timed samples per case (default 9, or the baseline's)
+//   --filter TEXT     only the cases whose name contains TEXT
+//
+// Each case builds its state untimed, times `ops` operations and returns a
+// checksum of what they produced. The seeds are fixed, so the checksum is
+// the same on every host and every sample: a different checksum means the
+// code now computes something else (the case FAILS; if that was intended,
+// regenerate the baseline), a higher ns/op on the same host means it got
+// slower. The median and the fastest sample are both reported; the
+// baseline check compares medians, taken over as many samples as the
+// baseline was (its "repeat", unless --repeat says otherwise): the
+// fastest of a few samples swings with whatever else the host is doing,
+// the median much less. core/sweep sets up pals_core's globals, so each
+// of its samples runs in a forked child. Timings only compare on the
+// machine that wrote the baseline.
+//
+// The old names in the firmware map to these cases:
+//   StringHash seen-set        legacy/string_set_lookup (the reference) and
+//                              mac_set/* (what replaced it)
+//   appendWigleRow             wigle/add_row
+//   saveEncounteredBSSIDs      seen/insert_sync
+//   loadEncounteredBSSIDs      seen/begin
+//   party JSON                 party/json_store
+//   JSON response builders     api/battle_turn_json, api/monster_page_json
+//   /scan_wifi (UHFU)          uhfu/wifi_json and legacy/uhfu_wifi_concat
+//                              (the String += chain it replaced)
+//   /scan_bluetooth (UHFU)     uhfu/bluetooth_json
+//   createPacketPal (HIDden 2) hidden2/make_pal
+//   scaleMonster (HIDden 2)    hidden2/scale_pal
+//   all of it, per record      core/sweep (a scan trace through pals_core)
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+#include "api_schema.h"
+#include "flash_backend.h"
+#include "kv_fs.h"
+#include "log_kv.h"
+#include "loopback_http.h"
+#include "mac_addr.h"
+#include "mac_set.h"
+#include "packet_pal.h"
+#include "pals_core.h"
+#include "scan_json.h"
+#include "scan_trace.h"
+#include "seen_index.h"
+#include "wigle_log.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Brackets the timed part of a case
+struct Sample {
+  Clock::time_point t0;
+  double ns;
+  void start() { t0 = Clock::now(); }
+  void stop() { ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count(); }
+};
+
+struct Case {
+  const char* name;
+  size_t ops;
+  bool fork;   // leaves global state behind: each sample in a child process
+  uint64_t (*run)(Sample &s, size_t ops);
+};
+
+struct Result {
+  const char* name;
+  size_t ops;
+  double nsPerOp;      // median sample; what the baseline check compares
+  double minNsPerOp;   // fastest sample
+  uint64_t checksum;
+  bool stable;         // every sample computed the same checksum
+};
+
+static uint64_t fnv(uint64_t h, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  for(size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static const uint64_t FNV_BASIS = 0xcbf29ce484222325ULL;
+
+static uint64_t fnvInt(uint64_t h, uint64_t v) {
+  return fnv(h, &v, sizeof(v));
+}
+
+static uint64_t randomMac(SeededRng &rng) {
+  return (((uint64_t)rng.next() << 32) | rng.next()) & 0xFFFFFFFFFFFFULL;
+}
+
+static std::vector<uint64_t> randomMacs(uint64_t seed, size_t n) {
+  SeededRng rng(seed);
+  std::vector<uint64_t> v(n);
+  for(auto &k : v) k = randomMac(rng);
+  return v;
+}
+
+// Keeps nothing, hashes everything written to it
+class HashFs : public PalFs {
+public:
+  HashFs() : hash(FNV_BASIS), bytes(0) {}
+  std::unique_ptr<PalFile> open(const char*, const char* mode) override {
+    if(mode[0] == 'r') return nullptr;
+    return std::unique_ptr<PalFile>(new File(*this));
+  }
+  bool exists(const char*) override { return false; }
+  bool remove(const char*) override { return true; }
+  bool rename(const char*, const char*) override { return true; }
+
+  uint64_t hash;
+  uint64_t bytes;
+
+private:
+  class File : public PalFile {
+  public:
+    explicit File(HashFs &fs) : fs_(fs) {}
+    size_t read(uint8_t*, size_t) override { return 0; }
+    size_t write(const uint8_t* buf, size_t len) override {
+      fs_.hash = fnv(fs_.hash, buf, len);
+      fs_.bytes += len;
+      return len;
+    }
+    bool seek(size_t) override { return false; }
+    size_t size() override { return 0; }
+    void flush() override {}
+  private:
+    HashFs &fs_;
+  };
+};
+
+// The state partition as the board mounts it: KvFs on LogKv on RAM flash
+struct StateStore {
+  RamFlash flash;
+  LogKv kv;
+  KvFs fs;
+  StateStore() : flash(4096, 320), kv(flash), fs(kv) {
+    kv.begin();
+    fs.begin();
+  }
+};
+
+// --- cases ------------------------------------------------------------------
+
+static uint64_t macSetInsert(Sample &s, size_t ops) {
+  std::vector<uint64_t> keys = randomMacs(1, ops);
+  MacSet set;
+  s.start();
+  for(uint64_t k : keys) {
+    if(!set.contains(k)) set.insert(k);
+  }
+  s.stop();
+  return fnvInt(FNV_BASIS, set.size());
+}
+
+// Half the lookups hit, as on a drive past known networks
+static uint64_t macSetLookup(Sample &s, size_t ops) {
+  std::vector<uint64_t> keys = randomMacs(2, 20000);
+  std::vector<uint64_t> misses = randomMacs(3, 20000);
+  MacSet set;
+  for(uint64_t k : keys) set.insert(k);
+  size_t hits = 0;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    uint64_t k = (i & 1) ? misses[(i >> 1) % misses.size()] : keys[(i >> 1) % keys.size()];
+    hits += set.contains(k);
+  }
+  s.stop();
+  return fnvInt(FNV_BASIS, hits);
+}
+
+// The hasher Packet Pals and HIDden 2 used before MacSet
+struct StringHash {
+  size_t operator()(const std::string &key) const {
+    const char* str = key.c_str();
+    size_t hash = 0;
+    while (*str) {
+      hash = 37 * hash + (unsigned char)*str++;
+    }
+    return hash;
+  }
+};
+
+// The same lookups on the old unordered_set<String, StringHash> of
+// "AA:BB:.." text; kept as the reference MacSet is measured against
+static uint64_t legacyStringSetLookup(Sample &s, size_t ops) {
+  std::vector<uint64_t> keys = randomMacs(2, 20000);
+  std::vector<uint64_t> misses = randomMacs(3, 20000);
+  std::vector<std::string> keyStr, missStr;
+  char buf[18];
+  for(uint64_t k : keys)   { formatMac(k, buf); keyStr.push_back(buf); }
+  for(uint64_t k : misses) { formatMac(k, buf); missStr.push_back(buf); }
+  std::unordered_set<std::string, StringHash> set(keyStr.begin(), keyStr.end());
+  size_t hits = 0;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    const std::string &k = (i & 1) ? missStr[(i >> 1) % missStr.size()] : keyStr[(i >> 1) % keyStr.size()];
+    hits += set.count(k);
+  }
+  s.stop();
+  return fnvInt(FNV_BASIS, hits);
+}
+
+// A row per network, a flash append per scan of 40
+static uint64_t wigleAddRow(Sample &s, size_t ops) {
+  static const char* AUTHS[] = { "[OPEN]", "[WEP]", "[WPA_PSK]", "[WPA2_PSK]", "[WPA_WPA2_PSK]" };
+  HashFs fs;
+  WigleLog log(fs, "/wigle.csv");
+  log.setDurability(WigleLog::FLUSH_PER_SCAN);
+  std::vector<uint64_t> keys = randomMacs(4, ops);
+  char ssid[33];
+  char mac[18];
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    formatMac(keys[i], mac);
+    snprintf(ssid, sizeof(ssid), "net-%u", (unsigned)(keys[i] % 997));
+    log.addRow(mac, ssid, AUTHS[i % 5], 1 + (int)(i % 13), -30 - (int)(i % 70), (uint32_t)(i * 250));
+    if(i % 40 == 39) log.endScan();
+  }
+  log.flush();
+  s.stop();
+  return fnvInt(fs.hash, fs.bytes);
+}
+
+// New BSSIDs into the seen index, journaled once per scan of 40, the merge
+// advanced from loop() in between
+static uint64_t seenInsertSync(Sample &s, size_t ops) {
+  StateStore st;
+  SeenIndex seen(st.fs, "/seen.seg", "/bssids.bin");
+  seen.begin();
+  std::vector<uint64_t> keys = randomMacs(5, ops);
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    if(!seen.contains(keys[i])) seen.insert(keys[i]);
+    if(i % 40 == 39) {
+      seen.sync();
+      seen.service();
+    }
+  }
+  seen.sync();
+  s.stop();
+  return fnvInt(fnvInt(FNV_BASIS, seen.size()), st.flash.bytesProgrammed());
+}
+
+// Boot: the index rebuilt from its segment and journal; ops is the number
+// of BSSIDs on flash
+static uint64_t seenBegin(Sample &s, size_t ops) {
+  StateStore st;
+  std::vector<uint64_t> keys = randomMacs(6, ops);
+  {
+    SeenIndex seen(st.fs, "/seen.seg", "/bssids.bin");
+    seen.begin();
+    for(size_t i = 0; i < ops; i++) {
+      if(!seen.contains(keys[i])) seen.insert(keys[i]);
+      if(i % 40 == 39) seen.sync();
+      while(seen.merging()) seen.service(4096);
+    }
+    seen.sync();
+  }
+  SeenIndex seen(st.fs, "/seen.seg", "/bssids.bin");
+  s.start();
+  seen.begin();
+  s.stop();
+  size_t found = 0;
+  for(size_t i = 0; i < ops; i += 97) found += seen.contains(keys[i]);
+  return fnvInt(fnvInt(FNV_BASIS, seen.size()), found);
+}
+
+static void fillPartyView(Party &v, uint32_t n) {
+  static const char* NAMES[] = { "StarterPal", "Packapal", "Glitchgeist" };
+  v.partySize = 3;
+  v.partyCount = 3;
+  for(int i = 0; i < 3; i++) {
+    PartyMonster &m = v.party[i];
+    snprintf(m.name, sizeof(m.name), "%s", NAMES[i]);
+    m.level = 1 + (long)((n + i) % 40);
+    m.hp = 30 + 5 * (m.level - 1);
+    m.defense = 5 + (m.level - 1);
+  }
+}
+
+// The /myParty body rendered for a new party version
+static uint64_t partyJsonStore(Sample &s, size_t ops) {
+  static CachedJson<Party, 576> cache;
+  uint64_t h = FNV_BASIS;
+  Party v;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    fillPartyView(v, (uint32_t)i);
+    cache.store((uint32_t)i + 1, v);
+    h = fnvInt(h, cache.length());
+  }
+  s.stop();
+  return fnv(h, cache.data(), cache.length());
+}
+
+// The /battleAction body: message built, measured, rendered into a window
+static uint64_t battleTurnJson(Sample &s, size_t ops) {
+  uint8_t window[LoopbackHttp::WINDOW];
+  uint64_t h = FNV_BASIS;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    BattleTurn t;
+    t.message[0] = '\0';
+    appendField(t.message, sizeof(t.message), "Packapal dealt %d damage. ", (int)(i % 17) + 1);
+    appendField(t.message, sizeof(t.message), "Wild \"Bytebot\" dealt %d damage.", (int)(i % 11) + 1);
+    t.partyHP = 100 - (long)(i % 100);
+    t.wildHP = (long)(i % 60);
+    t.battleEnd = t.wildHP == 0;
+    JsonBody<BattleTurn> body(t);
+    size_t len = body.length();
+    size_t n = body.fill(window, sizeof(window));
+    h = fnvInt(h, len + n);
+  }
+  s.stop();
+  return h;
+}
+
+// A full /monsters page of 100, pulled a window at a time
+static uint64_t monsterPageJson(Sample &s, size_t ops) {
+  static MonsterPage page;
+  page.total = 2500;
+  page.monstersCount = 100;
+  for(int i = 0; i < 100; i++) {
+    WildEntry &e = page.monsters[i];
+    e.id = 1000 + i;
+    snprintf(e.name, sizeof(e.name), "%s%d", (i & 1) ? "Bytebot" : "Wave\"zard", i);
+    e.level = 1 + i % 30;
+  }
+  page.nextCursor = 1100;
+  uint8_t window[LoopbackHttp::WINDOW];
+  uint64_t h = FNV_BASIS;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    JsonBody<MonsterPage> body(page);
+    size_t left = body.length();
+    while(left > 0) {
+      size_t n = body.fill(window, sizeof(window));
+      if(n == 0) break;
+      h = fnv(h, window, 8);
+      left -= n;
+    }
+  }
+  s.stop();
+  return h;
+}
+
+// A scan's worth of networks, as UHFU's WiFiScanner fills them in
+// (encryption is String(wifi_auth_mode_t), a number)
+struct UhfuNetwork {
+  std::string ssid;
+  int rssi;
+  std::string encryption;
+  std::string bssid;
+};
+
+static std::vector<UhfuNetwork> uhfuNetworks(size_t n) {
+  std::vector<uint64_t> macs = randomMacs(11, n);
+  std::vector<UhfuNetwork> v(n);
+  char mac[18];
+  for(size_t i = 0; i < n; i++) {
+    formatMac(macs[i], mac);
+    v[i].ssid = "net-" + std::to_string(macs[i] % 9973);
+    v[i].rssi = -30 - (int)(i % 70);
+    v[i].encryption = std::to_string(i % 6);
+    v[i].bssid = mac;
+  }
+  return v;
+}
+
+// A /scan_wifi body of 40 networks
+static uint64_t uhfuWifiJson(Sample &s, size_t ops) {
+  std::vector<UhfuNetwork> nets = uhfuNetworks(40);
+  uint64_t h = FNV_BASIS;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    std::vector<WiFiScanRow> rows(nets.size());
+    for(size_t j = 0; j < nets.size(); j++) {
+      rows[j] = { nets[j].ssid.c_str(), nets[j].rssi, nets[j].encryption.c_str(), nets[j].bssid.c_str() };
+    }
+    std::string json;
+    wifiScanJson(rows.data(), rows.size(), json);
+    h = fnv(h, json.data(), json.size());
+  }
+  s.stop();
+  return h;
+}
+
+// The same body built as UHFU's main.cpp did before scan_json.cpp, with
+// std::string for String; same output on these inputs (nothing to escape)
+static uint64_t legacyUhfuWifiConcat(Sample &s, size_t ops) {
+  std::vector<UhfuNetwork> nets = uhfuNetworks(40);
+  uint64_t h = FNV_BASIS;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    std::string json = "[";
+    for(size_t j = 0; j < nets.size(); j++) {
+      json += "{";
+      json += "\"SSID\":\"" + nets[j].ssid + "\",";
+      json += "\"RSSI\":" + std::to_string(nets[j].rssi) + ",";
+      json += "\"Encryption\":\"" + nets[j].encryption + "\",";
+      json += "\"BSSID\":\"" + nets[j].bssid + "\"";
+      json += "}";
+      if(j < nets.size() - 1) json += ",";
+    }
+    json += "]";
+    h = fnv(h, json.data(), json.size());
+  }
+  s.stop();
+  return h;
+}
+
+// A /scan_bluetooth body of 20 devices, a few names needing escapes
+static uint64_t uhfuBluetoothJson(Sample &s, size_t ops) {
+  std::vector<uint64_t> macs = randomMacs(12, 20);
+  std::vector<std::string> names(20), addrs(20);
+  char mac[18];
+  for(size_t i = 0; i < 20; i++) {
+    formatMac(macs[i], mac);
+    addrs[i] = mac;
+    for(char &c : addrs[i]) c = (char)tolower((unsigned char)c);
+    names[i] = i % 5 == 0 ? "" : i % 7 == 0 ? "Bob's \"Buds\"" : "LE-" + std::to_string(macs[i] % 997);
+  }
+  uint64_t h = FNV_BASIS;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    BluetoothScanRow rows[20];
+    for(size_t j = 0; j < 20; j++) rows[j] = { names[j].c_str(), addrs[j].c_str(), -40 - (int)(j * 3) };
+    std::string json;
+    bluetoothScanJson(rows, 20, json);
+    h = fnv(h, json.data(), json.size());
+  }
+  s.stop();
+  return h;
+}
+
+static uint64_t palChecksum(uint64_t h, const PacketPal &p) {
+  int v[] = { p.prefix, p.suffix, p.rarity, p.ability, p.hp, p.attack, p.defense, p.level };
+  return fnv(h, v, sizeof(v));
+}
+
+// A monster per network, as HIDden 2's scanIntoRoster makes them
+static uint64_t hiddenMakePal(Sample &s, size_t ops) {
+  SeededRng rng(8);
+  PalDice dice = [&rng](int lo, int hi) { return rng.uniform(lo, hi); };
+  uint64_t h = FNV_BASIS;
+  char name[24];
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    PacketPal p = makePacketPal(-30 - (int)(i % 70), (int)(i % 7), dice);
+    palName(p, name, sizeof(name));
+    h = palChecksum(h, p) ^ (uint8_t)name[0];
+  }
+  s.stop();
+  return h;
+}
+
+static uint64_t hiddenScalePal(Sample &s, size_t ops) {
+  SeededRng rng(9);
+  PalDice dice = [&rng](int lo, int hi) { return rng.uniform(lo, hi); };
+  std::vector<PacketPal> pals;
+  for(size_t i = 0; i < ops; i++) pals.push_back(makePacketPal(-30 - (int)(i % 70), (int)(i % 7), dice));
+  uint64_t h = FNV_BASIS;
+  s.start();
+  for(size_t i = 0; i < ops; i++) {
+    scalePacketPal(pals[i], 1 + (int)(i % 99), dice);
+    h = palChecksum(h, pals[i]);
+  }
+  s.stop();
+  return h;
+}
+
+// Every record of a synthetic drive through the whole core: seen check,
+// Wigle row, new monster, saves and merges on their timers. palsBegin()
+// sets up globals, so each sample runs in a child of its own.
+static ManualClock gCoreClock;
+
+static void quietLog(const char*) {}
+
+static uint64_t coreSweep(Sample &s, size_t ops) {
+  static HashFs files;
+  static RamFlash flash(4096, 320);
+  static ScanTrace trace = ScanTrace::synthetic(10, ops, 600);
+  static TraceRadio radio(trace);
+  static SeededRng rng(10);
+  static StdLock lock;
+  PalHal hal = { &files, &flash, &radio, &rng, &gCoreClock, &lock, quietLog };
+  palsBegin(hal);
+  LoopbackHttp http(PALS_ROUTES, PALS_ROUTE_COUNT, palsServeStatic);
+
+  s.start();
+  uint32_t ms;
+  while(radio.nextMs(ms)) {
+    if(ms > gCoreClock.millis()) gCoreClock.set(ms);
+    http.exchange("GET /scan HTTP/1.1\r\n\r\n");
+    int passes = 0;
+    do {
+      palsLoop();
+      gCoreClock.advance(1);
+    } while(palsStats().scanning && ++passes < 100000);
+    // the loop across the gap, so saves and merges run on their timers
+    uint32_t until = 0;
+    if(!radio.nextMs(until)) until = gCoreClock.millis() + 5000;
+    while(gCoreClock.millis() + 100 < until) {
+      palsLoop();
+      gCoreClock.advance(100);
+    }
+  }
+  s.stop();
+  // per record, not per sweep
+  s.ns = s.ns * ops / (double)trace.records();
+
+  PalsStats st = palsStats();
+  uint64_t h = FNV_BASIS;
+  h = fnvInt(h, trace.records());
+  h = fnvInt(h, st.seen);
+  h = fnvInt(h, st.wild);
+  h = fnvInt(h, st.saveWrites);
+  h = fnvInt(h, st.wigleAppends);
+  return fnvInt(h, files.hash);
+}
+
+static const Case CASES[] = {
+  { "mac_set/insert",            20000,  false, macSetInsert },
+  { "mac_set/lookup",            200000, false, macSetLookup },
+  { "legacy/string_set_lookup",  200000, false, legacyStringSetLookup },
+  { "wigle/add_row",             20000,  false, wigleAddRow },
+  { "seen/insert_sync",          4000,   false, seenInsertSync },
+  { "seen/begin",                20000,  false, seenBegin },
+  { "party/json_store",          50000,  false, partyJsonStore },
+  { "api/battle_turn_json",      50000,  false, battleTurnJson },
+  { "api/monster_page_json",     2000,   false, monsterPageJson },
+  { "uhfu/wifi_json",            20000,  false, uhfuWifiJson },
+  { "legacy/uhfu_wifi_concat",   20000,  false, legacyUhfuWifiConcat },
+  { "uhfu/bluetooth_json",       20000,  false, uhfuBluetoothJson },
+  { "hidden2/make_pal",          200000, false, hiddenMakePal },
+  { "hidden2/scale_pal",         200000, false, hiddenScalePal },
+  { "core/sweep",                200,    true,  coreSweep },   // ops: sweeps; ns/op per record
+};
+static const size_t CASE_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+
+// c.run() in a child process, for cases that leave global state behind;
+// false if the child did not report back
+static bool runForked(const Case &c, Sample &s, uint64_t &sum) {
+  int fd[2];
+  if(pipe(fd) != 0) return false;
+  pid_t pid = fork();
+  if(pid == 0) {
+    close(fd[0]);
+    sum = c.run(s, c.ops);
+    bool sent = write(fd[1], &s.ns, sizeof(s.ns)) == sizeof(s.ns) && write(fd[1], &sum, sizeof(sum)) == sizeof(sum);
+    _exit(sent ? 0 : 1);
+  }
+  close(fd[1]);
+  bool got = pid > 0 && read(fd[0], &s.ns, sizeof(s.ns)) == sizeof(s.ns) && read(fd[0], &sum, sizeof(sum)) == sizeof(sum);
+  close(fd[0]);
+  if(pid > 0) waitpid(pid, nullptr, 0);
+  return got;
+}
+
+// Round -1 warms up, then each round takes one sample of every case, so a
+// burst of load on the host costs each case a sample rather than moving
+// one case's median
+static std::vector<Result> runCases(const std::vector<const Case*> &cases, int repeat) {
+  std::vector<Result> out;
+  std::vector<std::vector<double> > ns(cases.size());
+  for(const Case* c : cases) out.push_back({ c->name, c->ops, 0, 0, 0, true });
+  for(int round = -1; round < repeat; round++) {
+    for(size_t i = 0; i < cases.size(); i++) {
+      const Case &c = *cases[i];
+      Result &r = out[i];
+      Sample s = { Clock::now(), 0 };
+      uint64_t sum = 0;
+      if(c.fork) {
+        if(!runForked(c, s, sum)) r.stable = false;
+      } else {
+        sum = c.run(s, c.ops);
+      }
+      if(round < 0) {
+        r.checksum = sum;
+        continue;
+      }
+      if(sum != r.checksum) r.stable = false;
+      ns[i].push_back(s.ns / c.ops);
+    }
+  }
+  for(size_t i = 0; i < cases.size(); i++) {
+    std::sort(ns[i].begin(), ns[i].end());
+    out[i].nsPerOp = ns[i][ns[i].size() / 2];
+    out[i].minNsPerOp = ns[i][0];
+  }
+  return out;
+}
+
+// --- JSON out and baseline in -----------------------------------------------
+
+static void writeJson(FILE* f, const std::vector<Result> &results, int repeat) {
+  fprintf(f, "{\"suite\":\"packet-pals\",\"version\":1,\"repeat\":%d,\"results\":[\n", repeat);
+  for(size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    // one result per line, so baselines diff line by line
+    fprintf(f, "{\"name\":\"%s\",\"ops\":%u,\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,\"checksum\":\"%016llx\"}%s\n",
+            r.name, (unsigned)r.ops, r.nsPerOp, r.minNsPerOp, (unsigned long long)r.checksum,
+            i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "]}\n");
+}
+
+struct BaselineEntry {
+  std::string name;
+  double nsPerOp;
+  uint64_t checksum;
+};
+
+// Reads what writeJson() wrote: one result object per line; repeat is
+// left alone if the header has none
+static bool readBaseline(const char* path, std::vector<BaselineEntry> &out, int &repeat) {
+  FILE* f = fopen(path, "r");
+  if(!f) return false;
+  char line[512];
+  while(fgets(line, sizeof(line), f)) {
+    const char* rep = strstr(line, "\"repeat\":");
+    if(rep) repeat = std::max(1, atoi(rep + 9));
+    const char* name = strstr(line, "\"name\":\"");
+    const char* ns = strstr(line, "\"ns_per_op\":");
+    const char* sum = strstr(line, "\"checksum\":\"");
+    if(!name || !ns || !sum) continue;
+    name += 8;
+    const char* end = strchr(name, '"');
+    if(!end) continue;
+    BaselineEntry e;
+    e.name.assign(name, end - name);
+    e.nsPerOp = strtod(ns + 12, nullptr);
+    e.checksum = strtoull(sum + 12, nullptr, 16);
+    out.push_back(e);
+  }
+  fclose(f);
+  return true;
+}
+
+static const BaselineEntry* findBaseline(const std::vector<BaselineEntry> &baseline, const char* name) {
+  for(const auto &e : baseline) {
+    if(e.name == name) return &e;
+  }
+  return nullptr;
+}
+
+// How much slower the whole host runs than when the baseline was taken:
+// the median of the cases' ratios. Load and clock speed move every case
+// together by 20-40% from one run to the next; a regression moves one.
+// 1 with fewer than 5 cases to go on (--filter).
+static double hostFactor(const std::vector<Result> &results, const std::vector<BaselineEntry> &baseline) {
+  std::vector<double> ratios;
+  for(const Result &r : results) {
+    const BaselineEntry* b = findBaseline(baseline, r.name);
+    if(r.stable && b && b->checksum == r.checksum && b->nsPerOp > 0) ratios.push_back(r.nsPerOp / b->nsPerOp);
+  }
+  if(ratios.size() < 5) return 1.0;
+  std::sort(ratios.begin(), ratios.end());
+  return ratios[ratios.size() / 2];
+}
+
+int main(int argc, char** argv) {
+  const char* jsonPath = nullptr;
+  const char* baselinePath = nullptr;
+  const char* filter = nullptr;
+  double tolerance = 0.35;
+  int repeat = 9;
+  bool repeatGiven = false;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if(!v) { fprintf(stderr, "%s needs a value\n", a.c_str()); return 2; }
+    if(a == "--json") jsonPath = v;
+    else if(a == "--baseline") baselinePath = v;
+    else if(a == "--tolerance") tolerance = atof(v);
+    else if(a == "--repeat") { repeat = std::max(1, atoi(v)); repeatGiven = true; }
+    else if(a == "--filter") filter = v;
+    else { fprintf(stderr, "unknown option %s\n", a.c_str()); return 2; }
+    i++;
+  }
+
+  std::vector<BaselineEntry> baseline;
+  int baselineRepeat = repeat;
+  if(baselinePath && !readBaseline(baselinePath, baseline, baselineRepeat)) {
+    fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+    return 2;
+  }
+  if(!repeatGiven) repeat = baselineRepeat;
+
+  // a --json to stdout keeps the table off it
+  FILE* table = jsonPath && strcmp(jsonPath, "-") == 0 ? stderr : stdout;
+  fprintf(table, "%-26s %8s %12s %12s  %-16s %s\n", "case", "ops", "ns/op", "min ns/op", "checksum",
+          baselinePath ? "vs baseline" : "");
+  bool ok = true;
+  std::vector<const Case*> chosen;
+  for(size_t i = 0; i < CASE_COUNT; i++) {
+    if(!filter || strstr(CASES[i].name, filter)) chosen.push_back(&CASES[i]);
+  }
+  std::vector<Result> results = runCases(chosen, repeat);
+  double host = hostFactor(results, baseline);
+  if(baselinePath) {
+    fprintf(table, "host vs baseline: %+.0f%% (median over the cases; taken out of each case's ratio)\n",
+            (host - 1.0) * 100);
+  }
+  for(const Result &r : results) {
+    char verdict[64] = "";
+    bool bad = !r.stable;
+    if(!r.stable) snprintf(verdict, sizeof(verdict), "UNSTABLE checksum");
+    const BaselineEntry* b = findBaseline(baseline, r.name);
+    if(baselinePath && r.stable) {
+      if(!b) {
+        snprintf(verdict, sizeof(verdict), "new");
+      } else if(b->checksum != r.checksum) {
+        snprintf(verdict, sizeof(verdict), "CHANGED output");
+        bad = true;
+      } else {
+        double ratio = b->nsPerOp > 0 ? r.nsPerOp / b->nsPerOp / host : 1.0;
+        bool slower = ratio > 1.0 + tolerance;
+        snprintf(verdict, sizeof(verdict), "%+.0f%%%s", (ratio - 1.0) * 100, slower ? " SLOWER" : "");
+        bad = bad || slower;
+      }
+    }
+    ok = ok && !bad;
+    fprintf(table, "%-26s %8u %12.2f %12.2f  %016llx %s\n", r.name, (unsigned)r.ops, r.nsPerOp,
+            r.minNsPerOp, (unsigned long long)r.checksum, verdict);
+  }
+
+  if(jsonPath) {
+    FILE* f = strcmp(jsonPath, "-") == 0 ? stdout : fopen(jsonPath, "w");
+    if(!f) {
+      fprintf(stderr, "cannot write %s\n", jsonPath);
+      return 2;
+    }
+    writeJson(f, results, repeat);
+    if(f != stdout) fclose(f);
+  }
+  fprintf(table, "check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
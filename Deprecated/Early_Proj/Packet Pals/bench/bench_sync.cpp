@@ -0,0 +1,238 @@
+// bench_sync.cpp
+// Host harness for /sync?since=: bytes a client downloads to stay current
+// over a play session, incremental sync vs re-pulling /monsters and
+// /myParty, with the client's mirror checked against the device after
+// every poll.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_sync.cpp src/sync_feed.cpp src/api_schema.cpp src/json_stream.cpp src/pull_sink.cpp src/battle.cpp src/save_format.cpp -o /tmp/bench_sync
+//   /tmp/bench_sync
+//
+// The device side mirrors pals_core.cpp: a 256-monster roster (oldest
+// evicted), a 256-entry change log, one player whose battles change the
+// party and level, a scan every 10 s finding 0-12 new BSSIDs. Levels follow
+// MonsterGen's buckets as on the device. A client polls every POLL
+// seconds; "full" pulls the whole roster and party each time, "sync"
+// sends since=, applies wild/gone/party, and does a full pull only when
+// the answer says "full". Byte counts are response bodies.
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "battle.h"
+#include "change_log.h"
+#include "monster_gen.h"
+#include "sync_feed.h"
+#include "wild_roster.h"
+
+typedef WildRoster<256> Roster;
+
+static const int MINUTES = 60;
+static const uint64_t SCOPE = 0x123456789abcULL;
+static const MonsterGen gen(20, 20);
+
+class StringSink : public ByteSink {
+public:
+  std::string out;
+  bool write(const char* data, size_t len) override { out.append(data, len); return true; }
+};
+
+struct Device {
+  Roster roster;
+  Change ring[256];
+  ChangeLog log{ ring, 256 };
+  SaveGame game;
+  BattleState battle;
+  uint32_t epoch = 0x1a2b3c4d;
+
+  Device() { newGame(game); }
+
+  WildEntry entry(const WildMonster &m) const {
+    WildEntry e;
+    e.id = m.id;
+    snprintf(e.name, sizeof(e.name), "P%uS%u", m.prefix, m.suffix);
+    e.level = gen.levelFor(m.bssid, game.playerLevel);
+    return e;
+  }
+
+  void scan() {
+    int found = rand() % 13;
+    for(int i = 0; i < found; i++) {
+      uint64_t key = (((uint64_t)rand() << 24) ^ (uint64_t)rand()) & 0xFFFFFFFFFFFFULL;
+      log.append(CHANGE_SEEN, key);
+      MonsterTraits t = gen.derive(key, game.playerLevel);
+      uint32_t id = roster.add(t.prefix, t.suffix, t.level, key);
+      if(roster.lastEvicted()) log.append(CHANGE_WILD_GONE, roster.lastEvicted());
+      log.append(CHANGE_WILD_ADD, id);
+    }
+  }
+
+  // one battle to the end, logged as handleBattleAction does
+  void battleOnce() {
+    if(roster.size() == 0) return;
+    WildMonster w = roster.at(rand() % roster.size());
+    SavedMonster wild;
+    snprintf(wild.name, sizeof(wild.name), "P%uS%u", w.prefix, w.suffix);
+    wild.level = gen.levelFor(w.bssid, game.playerLevel);
+    recalcMonsterStats(wild);
+    beginBattle(game, battle, rand() % game.partySize, w.id, wild);
+    BattleDice dice = [](int lo, int hi) { return lo + rand() % (hi - lo); };
+    for(bool end = false; !end;) {
+      int level = game.playerLevel;
+      char msg[192] = "";
+      BattleAction a = rand() % 8 ? BATTLE_ATTACK : BATTLE_CAPTURE;
+      end = battleTurn(game, battle, a, dice, msg, sizeof(msg)).battleEnd;
+      log.append(CHANGE_PARTY, SCOPE);
+      if(game.playerLevel != level) {
+        log.append(CHANGE_PLAYER, SCOPE);
+        if(MonsterGen::levelBucket(level) != MonsterGen::levelBucket(game.playerLevel))
+          log.append(CHANGE_BUCKET, SCOPE);
+      }
+    }
+    if(game.partySize == SaveGame::PARTY_MAX && rand() % 2) {
+      game.partySize--;   // released one, as /removeFromParty
+      log.append(CHANGE_PARTY, SCOPE);
+    }
+  }
+
+  void party(Party &v) const {
+    v.partySize = game.partySize;
+    v.partyCount = game.partySize;
+    for(int i = 0; i < game.partySize; i++) {
+      copyName(v.party[i].name, sizeof(v.party[i].name), game.party[i].name);
+      v.party[i].level = game.party[i].level;
+      v.party[i].hp = game.party[i].hp;
+      v.party[i].defense = game.party[i].defense;
+    }
+  }
+};
+
+// What the client holds: roster id -> level, and the party
+struct Mirror {
+  std::map<uint32_t, long> wild;
+  std::string party;
+  uint32_t seq = 0;
+};
+
+static std::string partyJson(const Device &d) {
+  StringSink sink;
+  char buf[128];
+  JsonStream js(sink, buf, sizeof(buf));
+  Party p;
+  d.party(p);
+  writeJson(js, p);
+  js.flush();
+  return sink.out;
+}
+
+// /monsters (no limit) + /myParty; returns body bytes
+static size_t fullPull(const Device &d, Mirror &m) {
+  StringSink sink;
+  char buf[128];
+  JsonStream js(sink, buf, sizeof(buf));
+  js.beginObject();
+  js.field("total", (unsigned long)d.roster.size());
+  js.key("monsters");
+  js.beginArray();
+  m.wild.clear();
+  for(size_t s = 0; s < d.roster.size(); s++) {
+    WildEntry e = d.entry(d.roster.at(s));
+    writeJson(js, e);
+    m.wild[e.id] = e.level;
+  }
+  js.endArray();
+  js.key("nextCursor");
+  js.null();
+  js.endObject();
+  js.flush();
+  m.party = partyJson(d);
+  m.seq = d.log.seq();
+  return sink.out.size() + m.party.size();
+}
+
+// Numbers of a "name":[...] list in body
+static void numbers(const std::string &body, const char* name, std::map<uint32_t, long> &wild) {
+  std::string k = std::string("\"") + name + "\":[";
+  size_t p = body.find(k);
+  if(p == std::string::npos) return;
+  const char* c = body.c_str() + p + k.size();
+  while(*c != ']') {
+    wild.erase((uint32_t)strtoul(c, (char**)&c, 10));
+    if(*c == ',') c++;
+  }
+}
+
+static size_t sync(const Device &d, Mirror &m, bool &full) {
+  std::map<uint32_t, long> added;
+  bool partySent = false;
+  SyncFeed::Hooks h;
+  h.wild = [&](uint32_t id, WildEntry &e) {
+    WildMonster w;
+    if(!d.roster.find(id, w)) return false;
+    e = d.entry(w);
+    added[e.id] = e.level;
+    return true;
+  };
+  h.party = [&](Party &p) { d.party(p); partySent = true; return true; };
+  h.player = [&](SyncPlayer &p) {
+    copyName(p.name, sizeof(p.name), d.game.playerName);
+    p.level = d.game.playerLevel;
+    return true;
+  };
+  SyncFeed feed(d.log, d.epoch, m.seq, SCOPE, false, h);
+  StringSink sink;
+  char buf[128];
+  JsonStream js(sink, buf, sizeof(buf));
+  while(feed.step(js)) {}
+  js.flush();
+  full = feed.full();
+  if(full) return sink.out.size() + fullPull(d, m);
+  numbers(sink.out, "gone", m.wild);
+  for(auto &a : added) m.wild[a.first] = a.second;
+  if(partySent) m.party = partyJson(d);
+  m.seq = feed.upto();
+  return sink.out.size();
+}
+
+static bool same(const Device &d, const Mirror &m) {
+  if(m.wild.size() != d.roster.size() || m.party != partyJson(d)) return false;
+  for(size_t s = 0; s < d.roster.size(); s++) {
+    WildEntry e = d.entry(d.roster.at(s));
+    auto it = m.wild.find(e.id);
+    if(it == m.wild.end() || it->second != e.level) return false;
+  }
+  return true;
+}
+
+static bool run(int pollSeconds) {
+  srand(21);
+  Device d;
+  Mirror full, inc;
+  size_t fullBytes = fullPull(d, full), syncBytes = fullPull(d, inc);
+  int polls = 0, resyncs = 0;
+  bool ok = true;
+  for(int t = 1; t <= MINUTES * 60; t++) {
+    if(t % 10 == 0) d.scan();
+    if(t % 45 == 0) d.battleOnce();
+    if(t % pollSeconds == 0) {
+      bool wasFull;
+      fullBytes += fullPull(d, full);
+      syncBytes += sync(d, inc, wasFull);
+      resyncs += wasFull;
+      polls++;
+      ok = ok && same(d, inc);
+    }
+  }
+  printf("poll %3d s  %4d polls  full %9zu B  sync %8zu B  %5.1fx less  %3d full resyncs  %s\n",
+         pollSeconds, polls, fullBytes, syncBytes, (double)fullBytes / syncBytes, resyncs,
+         ok ? "mirror ok" : "MIRROR WRONG");
+  return ok;
+}
+
+int main() {
+  printf("%d min session, scan every 10 s, battle every 45 s, roster 256, log 256\n", MINUTES);
+  bool ok = true;
+  for(int poll : { 2, 5, 15, 60, 300 }) ok = run(poll) && ok;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// bench_wigle_log.cpp
+// Host harness: Wigle CSV cost inside one /scan request, old vs buffered.
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ibench bench/bench_wigle_log.cpp src/wigle_log.cpp src/pal_fs_posix.cpp -o /tmp/bench_wigle_log
+//   /tmp/bench_wigle_log
+//
+// "per-row" reproduces the old appendWigleRow(): open for append, check
+// size, build the row from String temporaries, write, close, per network.
+// Flash traffic is counted with CountingPalFs; host disk is far faster than
+// SPIFFS, so opens/writes per scan are the numbers that carry over.
+//
+// "flash full" runs the log into a FullPalFs that cuts writes short, then
+// gives the space back: the CSV must hold every row addRow() accepted,
+// once each and in order, and the rest must be counted as dropped.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include "counting_fs.h"
+#include "full_fs.h"
+#include "mac_addr.h"
+#include "wigle_log.h"
+
+static const int APS_PER_SCAN = 40;
+static const int SCANS = 200;
+
+struct Ap { char bssid[18]; std::string ssid; int channel; int rssi; };
+
+static double nowUs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static void makeScan(Ap* aps, uint64_t &rng) {
+  for(int i=0; i<APS_PER_SCAN; i++){
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    formatMac(rng >> 16, aps[i].bssid);
+    aps[i].ssid = "Net," + std::to_string((unsigned)(rng >> 40) % 10000);
+    aps[i].channel = 1 + (int)((rng >> 8) % 11);
+    aps[i].rssi = -30 - (int)((rng >> 20) % 60);
+  }
+}
+
+static void oldAppendWigleRow(PalFs &fs, const std::string &ssid, const std::string &bssid,
+                              const char* auth, int channel, int rssi) {
+  std::unique_ptr<PalFile> f = fs.open("/wigledata.csv", "a");
+  if(f->size() == 0) f->write((const uint8_t*)WigleLog::HEADER, strlen(WigleLog::HEADER));
+  std::string safeSSID = ssid;
+  for(char &c : safeSSID) if(c == ',') c = '_';
+  std::string row = bssid + "," + safeSSID + "," + auth
+                  + ",2023-01-01 00:00:00,"
+                  + std::to_string(channel) + "," + std::to_string(rssi)
+                  + ",0.00000,0.00000,WIFI\n";
+  f->write((const uint8_t*)row.data(), row.size());
+}
+
+static void report(const char* name, double us, const FsCounters &c) {
+  printf("%-16s %8.1f us/scan  opens=%5.1f/scan  writes=%5.1f/scan  bytes=%6.0f/scan\n",
+         name, us / SCANS, (double)c.opens / SCANS, (double)c.writes / SCANS,
+         (double)c.bytesWritten / SCANS);
+}
+
+static std::string readAll(PalFs &fs, const char* path) {
+  std::unique_ptr<PalFile> f = fs.open(path, "r");
+  if(!f) return std::string();
+  std::string s(f->size(), '\0');
+  f->read((uint8_t*)&s[0], s.size());
+  return s;
+}
+
+static bool benchFull(PalFs &disk) {
+  FullPalFs full(disk, 5000);
+  Ap aps[APS_PER_SCAN];
+  uint64_t rng = 7;
+  int offered = 0, accepted = 0;
+  {
+    WigleLog log(full, "/wigle_full.csv", 1024);
+    WigleLog ref(disk, "/wigle_ref.csv", 1024);
+    for(int s=0; s<10; s++){
+      makeScan(aps, rng);
+      for(int i=0; i<APS_PER_SCAN; i++){
+        offered++;
+        if(!log.addRow(aps[i].bssid, aps[i].ssid.c_str(), "WPA2", aps[i].channel, aps[i].rssi, 0)) continue;
+        ref.addRow(aps[i].bssid, aps[i].ssid.c_str(), "WPA2", aps[i].channel, aps[i].rssi, 0);
+        accepted++;
+      }
+      log.endScan();
+      ref.endScan();
+    }
+    full.setFree(1 << 30);
+    log.flush();
+    ref.flush();
+    bool ok = accepted + (int)log.droppedRows() == offered && log.droppedRows() > 0 &&
+              full.shortWrites() > 0 && readAll(disk, "/wigle_full.csv") == readAll(disk, "/wigle_ref.csv");
+    printf("flash full       %d rows offered, %d kept, %u dropped, %lu short writes -> %s\n",
+           offered, accepted, (unsigned)log.droppedRows(), full.shortWrites(), ok ? "ok" : "FAILED");
+    disk.remove("/wigle_full.csv");
+    disk.remove("/wigle_ref.csv");
+    return ok;
+  }
+}
+
+int main() {
+  char dir[] = "/tmp/wigle_bench_XXXXXX";
+  if(!mkdtemp(dir)){ perror("mkdtemp"); return 1; }
+  PosixPalFs disk(dir);
+  CountingPalFs fs(disk);
+  Ap aps[APS_PER_SCAN];
+
+  // old: one open/append/close per row
+  {
+    disk.remove("/wigledata.csv");
+    fs.reset();
+    uint64_t rng = 1;
+    double total = 0;
+    for(int s=0; s<SCANS; s++){
+      makeScan(aps, rng);
+      double t0 = nowUs();
+      for(int i=0; i<APS_PER_SCAN; i++)
+        oldAppendWigleRow(fs, aps[i].ssid, aps[i].bssid, "WPA2", aps[i].channel, aps[i].rssi);
+      total += nowUs() - t0;
+    }
+    report("per-row (old)", total, fs.counters());
+  }
+
+  const WigleLog::Durability modes[] = {
+    WigleLog::FLUSH_EACH_ROW, WigleLog::FLUSH_PER_SCAN, WigleLog::FLUSH_ON_TIMER };
+  const char* names[] = { "FLUSH_EACH_ROW", "FLUSH_PER_SCAN", "FLUSH_ON_TIMER" };
+  for(int m=0; m<3; m++){
+    disk.remove("/wigledata.csv");
+    fs.reset();
+    WigleLog log(fs, "/wigledata.csv");
+    log.setDurability(modes[m], 10000);
+    uint64_t rng = 1;
+    uint32_t clockMs = 0;
+    double total = 0;
+    for(int s=0; s<SCANS; s++){
+      makeScan(aps, rng);
+      double t0 = nowUs();
+      for(int i=0; i<APS_PER_SCAN; i++)
+        log.addRow(aps[i].bssid, aps[i].ssid.c_str(), "WPA2", aps[i].channel, aps[i].rssi, clockMs);
+      log.endScan();
+      total += nowUs() - t0;
+      clockMs += 3000;   // one scan every ~3 s
+      log.service(clockMs);
+    }
+    log.flush();
+    report(names[m], total, fs.counters());
+  }
+
+  disk.remove("/wigledata.csv");
+  bool ok = benchFull(disk);
+  rmdir(dir);
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
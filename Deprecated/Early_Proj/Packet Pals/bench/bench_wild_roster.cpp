@@ -0,0 +1,126 @@
+// bench_wild_roster.cpp
+// Host harness: memory of the wild-monster list over a long drive, the old
+// std::vector<Monster> (heap name per entry, unbounded) vs WildRoster.
+//
+//   g++ -std=c++17 -O2 -Iinclude bench/bench_wild_roster.cpp -o /tmp/bench_wild_roster
+//   /tmp/bench_wild_roster [finds]
+//
+// Heap use is read from mallinfo2 after every 10% of the drive. For the
+// vector, "reallocs" counts capacity changes: each one needs a single
+// contiguous block of the new size, which is what fails on a fragmented
+// ESP32 heap. For the roster the run checks that the size never exceeds
+// capacity and ids stay in order, then replays adds to confirm each
+// policy drops the monster it should (oldest, or oldest of the lowest
+// level present).
+#include <chrono>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "wild_roster.h"
+
+typedef WildRoster<256> Roster;
+
+struct Monster { std::string name; int level; int hp; int defense; };
+
+static const char* PREFIXES[] = { "Star", "Candy", "Turbo", "Spark", "Rainbow", "Mega", "Fizzy", "Funky" };
+static const char* SUFFIXES[] = { "Dino", "Bat", "Cat", "Dog", "Fish", "Dragon", "Bee", "Fairy" };
+
+static double nowUs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static size_t heapInUse() {
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+}
+
+static void runVector(uint32_t finds) {
+  size_t h0 = heapInUse();
+  std::vector<Monster> list;
+  size_t reallocs = 0, cap = 0;
+  srand(7);
+  printf("vector:");
+  double t0 = nowUs();
+  for(uint32_t i = 1; i <= finds; i++) {
+    Monster m;
+    // long enough to defeat the small-string buffer, like a heap String
+    m.name = std::string(PREFIXES[rand() % 8]) + SUFFIXES[rand() % 8] + "_______";
+    m.level = 1 + rand() % 10;
+    m.hp = 30 + 5 * (m.level - 1);
+    m.defense = 5 + (m.level - 1);
+    list.push_back(m);
+    if(list.capacity() != cap) { cap = list.capacity(); reallocs++; }
+    if(i % (finds / 10) == 0) printf(" %zuK", (heapInUse() - h0) / 1024);
+  }
+  printf("\n        %zu monsters, %zu reallocs, last block %zu B, %.0f ns/find\n",
+         list.size(), reallocs, cap * sizeof(Monster), (nowUs() - t0) * 1000.0 / finds);
+}
+
+static bool runRoster(uint32_t finds, Roster::Eviction policy, const char* label) {
+  size_t h0 = heapInUse();
+  static Roster roster;
+  roster.clear();
+  roster.setEviction(policy);
+  bool ok = true;
+  srand(7);
+  printf("%s:", label);
+  double t0 = nowUs();
+  for(uint32_t i = 1; i <= finds; i++) {
+    uint8_t level = 1 + rand() % 10;
+    roster.add(rand() % 8, rand() % 8, level);
+    if(roster.size() > Roster::capacity()) ok = false;
+    if(i % (finds / 10) == 0) printf(" %zuK", (heapInUse() - h0) / 1024);
+  }
+  double us = nowUs() - t0;
+  for(size_t s = 1; s < roster.size(); s++) {
+    if(roster.at(s - 1).id >= roster.at(s).id) ok = false;
+  }
+  unsigned histo[11] = {0};
+  for(size_t s = 0; s < roster.size(); s++) histo[roster.at(s).level]++;
+  printf("\n        %zu monsters, %u evicted, %zu B fixed, %.0f ns/find, levels 1..10:",
+         roster.size(), roster.evictions(), Roster::memoryBytes(), us * 1000.0 / finds);
+  for(int l = 1; l <= 10; l++) printf(" %u", histo[l]);
+  printf("\n");
+  return ok;
+}
+
+// Works out the expected victim before each add and checks it is gone
+static bool checkVictims(Roster::Eviction policy) {
+  static Roster roster;
+  roster.clear();
+  roster.setEviction(policy);
+  srand(11);
+  for(int i = 0; i < 20000; i++) {
+    uint8_t level = 1 + rand() % 10;
+    uint32_t expectGone = 0;
+    if(roster.size() == Roster::capacity()) {
+      size_t v = 0;
+      if(policy == Roster::EVICT_LOWEST_LEVEL) {
+        for(size_t s = 1; s < roster.size(); s++) {
+          if(roster.at(s).level < roster.at(v).level) v = s;
+        }
+      }
+      expectGone = roster.at(v).id;
+    }
+    uint32_t id = roster.add(0, 0, level);
+    WildMonster w;
+    if(!roster.find(id, w) || w.level != level) return false;
+    if(expectGone && roster.find(expectGone, w)) return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint32_t finds = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+  if(finds < 10) finds = 10;
+  runVector(finds);
+  bool ok = runRoster(finds, Roster::EVICT_OLDEST, "oldest");
+  ok = runRoster(finds, Roster::EVICT_LOWEST_LEVEL, "lowest") && ok;
+  ok = checkVictims(Roster::EVICT_OLDEST) && ok;
+  ok = checkVictims(Roster::EVICT_LOWEST_LEVEL) && ok;
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// counting_fs.h
+// PalFs decorator for host benchmarks: counts opens, write calls and bytes
+// so flash traffic can be compared independently of host disk speed.
+#ifndef COUNTING_FS_H
+#define COUNTING_FS_H
+
+#include "pal_fs.h"
+
+struct FsCounters {
+  unsigned long opens;
+  unsigned long writes;
+  unsigned long bytesWritten;
+  unsigned long reads;
+  unsigned long bytesRead;
+};
+
+class CountingPalFs : public PalFs {
+public:
+  explicit CountingPalFs(PalFs &inner) : inner_(inner), c_() {}
+
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override {
+    std::unique_ptr<PalFile> f = inner_.open(path, mode);
+    if(!f) return nullptr;
+    c_.opens++;
+    return std::unique_ptr<PalFile>(new File(std::move(f), c_));
+  }
+  bool exists(const char* path) override { return inner_.exists(path); }
+  bool remove(const char* path) override { return inner_.remove(path); }
+  bool rename(const char* from, const char* to) override { return inner_.rename(from, to); }
+  size_t freeBytes() override { return inner_.freeBytes(); }
+
+  const FsCounters& counters() const { return c_; }
+  void reset() { c_ = FsCounters(); }
+
+private:
+  class File : public PalFile {
+  public:
+    File(std::unique_ptr<PalFile> f, FsCounters &c) : f_(std::move(f)), c_(c) {}
+    size_t read(uint8_t* buf, size_t len) override {
+      c_.reads++;
+      size_t n = f_->read(buf, len);
+      c_.bytesRead += n;
+      return n;
+    }
+    size_t write(const uint8_t* buf, size_t len) override {
+      c_.writes++;
+      c_.bytesWritten += len;
+      return f_->write(buf, len);
+    }
+    bool seek(size_t pos) override { return f_->seek(pos); }
+    size_t size() override { return f_->size(); }
+    void flush() override { f_->flush(); }
+  private:
+    std::unique_ptr<PalFile> f_;
+    FsCounters &c_;
+  };
+
+  PalFs &inner_;
+  FsCounters c_;
+};
+
+#endif
@@ -0,0 +1,60 @@
+// full_fs.h
+// PalFs decorator for host benchmarks: a file system that fills up. Writes
+// draw on a byte budget and come back short once it runs out (cut at any
+// byte, as SPIFFS does); opening for "w" or "a" fails with nothing left.
+// Removing files gives nothing back: call setFree() to model space freed.
+// freeBytes() reports the budget unless hideFree() is set, for callers
+// that can't plan ahead and only find out from the short write.
+#ifndef FULL_FS_H
+#define FULL_FS_H
+
+#include <string.h>
+#include "pal_fs.h"
+
+class FullPalFs : public PalFs {
+public:
+  FullPalFs(PalFs &inner, size_t freeBytes)
+    : inner_(inner), free_(freeBytes), hideFree_(false), shortWrites_(0) {}
+
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override {
+    if(strcmp(mode, "r") != 0 && free_ == 0) return nullptr;
+    std::unique_ptr<PalFile> f = inner_.open(path, mode);
+    if(!f) return nullptr;
+    return std::unique_ptr<PalFile>(new File(std::move(f), *this));
+  }
+  bool exists(const char* path) override { return inner_.exists(path); }
+  bool remove(const char* path) override { return inner_.remove(path); }
+  bool rename(const char* from, const char* to) override { return inner_.rename(from, to); }
+  size_t freeBytes() override { return hideFree_ ? UNKNOWN_FREE : free_; }
+
+  void setFree(size_t bytes) { free_ = bytes; }
+  void hideFree(bool hide) { hideFree_ = hide; }
+  unsigned long shortWrites() const { return shortWrites_; }
+
+private:
+  class File : public PalFile {
+  public:
+    File(std::unique_ptr<PalFile> f, FullPalFs &fs) : f_(std::move(f)), fs_(fs) {}
+    size_t read(uint8_t* buf, size_t len) override { return f_->read(buf, len); }
+    size_t write(const uint8_t* buf, size_t len) override {
+      size_t n = len < fs_.free_ ? len : fs_.free_;
+      if(n < len) fs_.shortWrites_++;
+      n = n ? f_->write(buf, n) : 0;
+      fs_.free_ -= n;
+      return n;
+    }
+    bool seek(size_t pos) override { return f_->seek(pos); }
+    size_t size() override { return f_->size(); }
+    void flush() override { f_->flush(); }
+  private:
+    std::unique_ptr<PalFile> f_;
+    FullPalFs &fs_;
+  };
+
+  PalFs &inner_;
+  size_t free_;
+  bool hideFree_;
+  unsigned long shortWrites_;
+};
+
+#endif
@@ -0,0 +1,136 @@
+// steal_pool.h
+// Work-stealing thread pool for host tools. Each worker has its own deque:
+// it takes its newest task from the back, and when that runs dry steals
+// the oldest task from another worker's front, so a worker that drew
+// cheap tasks helps out instead of idling. Deques are mutex-guarded;
+// tasks are meant to be coarse (thousands of battles), where a lock per
+// task costs nothing measurable.
+#ifndef STEAL_POOL_H
+#define STEAL_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class StealPool {
+public:
+  // worker is 0..threads()-1, for per-thread scratch
+  typedef std::function<void(unsigned worker)> Task;
+
+  explicit StealPool(unsigned threads)
+    : queues_(threads ? threads : 1), pending_(0), next_(0), stop_(false), steals_(0)
+  {
+    for(unsigned i = 0; i < queues_.size(); i++) {
+      queues_[i].reset(new Queue());
+    }
+    for(unsigned i = 0; i < queues_.size(); i++) {
+      workers_.emplace_back([this, i]() { work(i); });
+    }
+  }
+
+  ~StealPool() {
+    {
+      std::lock_guard<std::mutex> lock(idleMutex_);
+      stop_ = true;
+    }
+    idle_.notify_all();
+    for(auto &t : workers_) t.join();
+  }
+
+  // Queued round-robin; stealing evens out the rest
+  void submit(Task task) {
+    {
+      std::lock_guard<std::mutex> idleLock(idleMutex_);
+      pending_++;
+      Queue &q = *queues_[next_++ % queues_.size()];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    idle_.notify_one();
+  }
+
+  // Until every submitted task has run
+  void wait() {
+    std::unique_lock<std::mutex> lock(idleMutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+  }
+
+  unsigned threads() const { return (unsigned)queues_.size(); }
+  uint64_t steals() const { return steals_.load(); }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool take(unsigned self, Task &task) {
+    {
+      Queue &q = *queues_[self];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if(!q.tasks.empty()) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+      }
+    }
+    for(size_t i = 1; i < queues_.size(); i++) {
+      Queue &q = *queues_[(self + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if(!q.tasks.empty()) {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        steals_++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void work(unsigned self) {
+    Task task;
+    for(;;) {
+      if(take(self, task)) {
+        task(self);
+        task = nullptr;
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        if(--pending_ == 0) done_.notify_all();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(idleMutex_);
+      if(stop_) return;
+      // submit() queues under idleMutex_, so nothing can arrive between
+      // this check and the wait
+      if(queued() > 0) continue;
+      idle_.wait(lock);
+    }
+  }
+
+  size_t queued() {
+    size_t n = 0;
+    for(auto &q : queues_) {
+      std::lock_guard<std::mutex> lock(q->mutex);
+      n += q->tasks.size();
+    }
+    return n;
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex idleMutex_;
+  std::condition_variable idle_;
+  std::condition_variable done_;
+  size_t pending_;
+  size_t next_;
+  bool stop_;
+  std::atomic<uint64_t> steals_;
+};
+
+#endif
@@ -29,7 +29,9 @@ const battleLog = document.getElementById("battleLog");
 ////////////////////
 // Global Data
 ////////////////////
-let allMonsters = [];
+let pageMonsters = [];   // monsters on the page being shown
+let totalMonsters = 0;
+let pageCursors = [0];   // server cursor where each visited page starts
 let myParty = [];
 let currentPage = 0;
 const PAGE_SIZE = 10;
@@ -185,28 +187,67 @@ async function clearWigle() {
 ////////////////////
 // Scanning & Listing
 ////////////////////
+const SCAN_POLL_MS = 500;
+
+function sleep(ms) {
+  return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+// /scan returns at once with a job id; poll /scan/status until it is done
+async function waitForScan() {
+  let resp = await fetch("/scan");
+  let status = await resp.json();
+  const jobId = status.jobId;
+  while (status.state === "sweeping" || status.state === "processing") {
+    monsterListDiv.textContent = status.state === "sweeping"
+      ? "Scanning..."
+      : `Scanning... ${status.processed}/${status.found} networks`;
+    await sleep(SCAN_POLL_MS);
+    resp = await fetch(`/scan/status?jobId=${jobId}`);
+    if (!resp.ok) throw new Error(await resp.text());
+    status = await resp.json();
+  }
+  if (status.state === "failed") throw new Error("scan failed");
+  return status;
+}
+
 async function doScanAndList() {
   monsterListDiv.textContent = "Scanning...";
   paginationDiv.style.display = "none";
   try {
-    await fetch("/scan");
-    let resp = await fetch("/monsters");
-    let data = await resp.json();
-    allMonsters = data.monsters || [];
+    let status = await waitForScan();
+    if (status.newMonsters > 0) {
+      showNotification(`${status.newMonsters} new monsters found!`, "success");
+    }
     currentPage = 0;
+    pageCursors = [0];
+    await loadPage(0);
     renderMonstersWithPagination();
   } catch (err) {
     monsterListDiv.textContent = "Error scanning: " + err;
   }
 }
+
+// Pages come from the device: /monsters?cursor=&limit= returns one page
+// plus the cursor (a monster id) of the next one.
+async function loadPage(pageIndex) {
+  let resp = await fetch(`/monsters?cursor=${pageCursors[pageIndex]}&limit=${PAGE_SIZE}`);
+  let data = await resp.json();
+  pageMonsters = data.monsters || [];
+  totalMonsters = data.total || 0;
+  if (data.nextCursor !== null && data.nextCursor !== undefined) {
+    pageCursors[pageIndex + 1] = data.nextCursor;
+  }
+}
+
 function renderMonstersWithPagination() {
   battleUI.style.display = "none";
-  if (allMonsters.length === 0) {
+  if (totalMonsters === 0) {
     monsterListDiv.textContent = "No monsters found.";
     paginationDiv.style.display = "none";
     return;
   }
-  if (allMonsters.length <= PAGE_SIZE) {
+  if (totalMonsters <= PAGE_SIZE) {
     paginationDiv.style.display = "none";
   } else {
     paginationDiv.style.display = "block";
@@ -216,12 +257,8 @@ function renderMonstersWithPagination() {
 
 function displayPage(pageIndex) {
   monsterListDiv.innerHTML = "";
-  let start = pageIndex * PAGE_SIZE;
-  let end = start + PAGE_SIZE;
-  let slice = allMonsters.slice(start, end);
-
-  slice.forEach((m, localIndex) => {
-    let wIdx = start + localIndex;
+  pageMonsters.forEach(m => {
+    let wIdx = m.id;
     const row = document.createElement("div");
     row.textContent = `[${wIdx}] ${m.name} (Lv ${m.level}) `;
     const battleBtn = document.createElement("button");
@@ -230,21 +267,23 @@ function displayPage(pageIndex) {
     row.appendChild(battleBtn);
     monsterListDiv.appendChild(row);
   });
-  let totalPages = Math.ceil(allMonsters.length / PAGE_SIZE);
+  let totalPages = Math.ceil(totalMonsters / PAGE_SIZE);
+  let start = pageIndex * PAGE_SIZE;
   pageInfoSpan.textContent =
-    `Page ${pageIndex + 1} of ${totalPages} (monsters ${start + 1}..${Math.min(end, allMonsters.length)})`;
+    `Page ${pageIndex + 1} of ${totalPages} (monsters ${start + 1}..${start + pageMonsters.length})`;
 }
 
-function goPrevPage() {
+async function goPrevPage() {
   if (currentPage > 0) {
     currentPage--;
+    await loadPage(currentPage);
     displayPage(currentPage);
   }
 }
-function goNextPage() {
-  let totalPages = Math.ceil(allMonsters.length / PAGE_SIZE);
-  if (currentPage < totalPages - 1) {
+async function goNextPage() {
+  if (pageCursors[currentPage + 1] !== undefined) {
     currentPage++;
+    await loadPage(currentPage);
     displayPage(currentPage);
   }
 }
@@ -253,7 +292,7 @@ function goNextPage() {
 // Battles
 ////////////////////
 async function startBattle(wIdx, pIdx) {
-  let url = `/startBattle?wildIndex=${wIdx}&partyIndex=${pIdx}`;
+  let url = `/startBattle?wildId=${wIdx}&partyIndex=${pIdx}`;
   try {
     let resp = await fetch(url);
     if (!resp.ok) {
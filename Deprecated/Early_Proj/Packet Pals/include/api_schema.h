@@ -0,0 +1,177 @@
+// api_schema.h
+#ifndef API_SCHEMA_H
+#define API_SCHEMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "json_stream.h"
+#include "pull_sink.h"
+
+// JSON responses of the Packet Pals web API, each described once as an
+// X-macro field list. From that list this header makes a fixed-size view
+// struct (no String, no heap) and writeJson(), which streams the view
+// field by field. scripts/gen_api_models.py reads the same lists and
+// writes the companion app's Dart models (lib/models/pals_api.dart), so
+// a renamed or added field shows up on both sides.
+//
+// Field kinds, in the order they appear in the JSON:
+//   STR(name, size)        char name[size], NUL-terminated
+//   INT(name)              long
+//   UINT(name)             unsigned long
+//   BOOL(name)             bool
+//   ID(name)               uint32_t; 0 is written as null (ids start at 1)
+//   LIST(name, Type, max)  Type name[max] plus uint8_t name##Count
+//
+// A list's X argument is a prefix; each field expands to X##_KIND(...).
+
+#define API_PARTY_MONSTER(X) \
+  X##_STR(name, 16) \
+  X##_INT(level) \
+  X##_INT(hp) \
+  X##_INT(defense)
+
+// /myParty
+#define API_PARTY(X) \
+  X##_INT(partySize) \
+  X##_LIST(party, PartyMonster, 3)
+
+// /removeFromParty, /swapPartySlots (sent as message + the cached Party)
+#define API_PARTY_CHANGE(X) \
+  X##_STR(message, 48) \
+  X##_INT(partySize) \
+  X##_LIST(party, PartyMonster, 3)
+
+// /startBattle
+#define API_BATTLE_START(X) \
+  X##_BOOL(inProgress) \
+  X##_STR(partyName, 16) \
+  X##_INT(partyLevel) \
+  X##_INT(partyHP) \
+  X##_STR(wildName, 16) \
+  X##_INT(wildLevel) \
+  X##_INT(wildHP)
+
+// /battleAction
+#define API_BATTLE_TURN(X) \
+  X##_STR(message, 192) \
+  X##_INT(partyHP) \
+  X##_INT(wildHP) \
+  X##_BOOL(battleEnd)
+
+// one element of /monsters
+#define API_WILD_ENTRY(X) \
+  X##_UINT(id) \
+  X##_STR(name, 16) \
+  X##_INT(level)
+
+// /monsters?cursor=&limit= (streamed a monster at a time, see MonsterPager)
+#define API_MONSTER_PAGE(X) \
+  X##_UINT(total) \
+  X##_LIST(monsters, WildEntry, 100) \
+  X##_ID(nextCursor)
+
+// "player" of /sync (the rest of it is streamed, see sync_feed.h)
+#define API_SYNC_PLAYER(X) \
+  X##_STR(name, 24) \
+  X##_INT(level)
+
+// Every schema, element types before the objects that list them
+#define API_SCHEMAS(S) \
+  S(PartyMonster, API_PARTY_MONSTER) \
+  S(Party,        API_PARTY) \
+  S(PartyChange,  API_PARTY_CHANGE) \
+  S(BattleStart,  API_BATTLE_START) \
+  S(BattleTurn,   API_BATTLE_TURN) \
+  S(WildEntry,    API_WILD_ENTRY) \
+  S(MonsterPage,  API_MONSTER_PAGE) \
+  S(SyncPlayer,   API_SYNC_PLAYER)
+
+// --- view structs ---------------------------------------------------------
+
+#define API_FIELD_STR(name, size)       char name[size];
+#define API_FIELD_INT(name)             long name;
+#define API_FIELD_UINT(name)            unsigned long name;
+#define API_FIELD_BOOL(name)            bool name;
+#define API_FIELD_ID(name)              uint32_t name;
+#define API_FIELD_LIST(name, Type, max) Type name[max]; uint8_t name##Count;
+
+#define API_STRUCT(Type, FIELDS) struct Type { FIELDS(API_FIELD) };
+API_SCHEMAS(API_STRUCT)
+#undef API_STRUCT
+
+#define API_WRITER(Type, FIELDS) void writeJson(JsonStream &js, const Type &v);
+API_SCHEMAS(API_WRITER)
+#undef API_WRITER
+
+// Appends printf output to a STR field, truncating if needed
+void appendField(char* dst, size_t size, const char* fmt, ...);
+
+// A view and its JSON rendering, for responses written straight into the
+// transport's send buffer. The body is rendered again for each window and
+// only the bytes that land in it are kept, so there is no document and no
+// body string; views are a few hundred bytes, so a window is one render.
+template<class T>
+class JsonBody {
+public:
+  JsonBody() : sent_(0) {}
+  explicit JsonBody(const T &v) : view(v), sent_(0) {}
+
+  size_t length() const {
+    WindowSink sink(nullptr, 0, 0);
+    render(sink);
+    return sink.total();
+  }
+
+  // Next room bytes of the body; 0 once all of it is out
+  size_t fill(uint8_t* out, size_t room) {
+    WindowSink sink(out, room, sent_);
+    render(sink);
+    sent_ += sink.filled();
+    return sink.filled();
+  }
+
+  T view;
+
+private:
+  void render(ByteSink &sink) const {
+    char buf[128];
+    JsonStream js(sink, buf, sizeof(buf));
+    writeJson(js, view);
+    js.flush();
+  }
+
+  size_t sent_;
+};
+
+// The rendered body of a view, kept for as long as the state it came from
+// is unchanged: store() it under the state's version, check fresh() with
+// the current one before reusing it. N must hold the longest rendering.
+template<class T, size_t N>
+class CachedJson {
+public:
+  CachedJson() : version_(0), len_(0) {}
+
+  bool fresh(uint32_t version) const { return len_ > 0 && version_ == version; }
+
+  // false (and nothing cached) if the body is longer than N
+  bool store(uint32_t version, const T &view) {
+    JsonBody<T> body(view);
+    len_ = 0;
+    size_t len = body.length();
+    if(len > N) return false;
+    body.fill(buf_, N);
+    version_ = version;
+    len_ = len;
+    return true;
+  }
+
+  const uint8_t* data() const { return buf_; }
+  size_t length() const { return len_; }
+
+private:
+  uint32_t version_;
+  size_t len_;
+  uint8_t buf_[N];
+};
+
+#endif
@@ -0,0 +1,60 @@
+// battle.h
+#ifndef BATTLE_H
+#define BATTLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "save_format.h"
+
+// The battle rules, on one player's SaveGame: pure C++, so the firmware's
+// handlers and the host benches play the same game.
+
+// A battle in progress. The wild monster is copied in, so its hp can drop
+// without touching the roster, and an eviction mid-battle cannot pull it
+// out from under us.
+struct BattleState {
+  bool     inProgress;
+  uint8_t  partyIndex;
+  uint32_t wildId;
+  SavedMonster wild;
+};
+
+enum BattleAction {
+  BATTLE_ATTACK,
+  BATTLE_DEFEND,
+  BATTLE_CAPTURE,
+  BATTLE_RUN,
+  BATTLE_UNKNOWN
+};
+
+// "attack", "defend", "capture", "run"
+BattleAction parseBattleAction(const char* s);
+
+// Arduino's random(lo, hi): lo <= r < hi
+typedef std::function<int(int lo, int hi)> BattleDice;
+
+struct TurnResult {
+  bool battleEnd;
+  bool saveDirty;   // a capture, a level up or the post-battle heal
+};
+
+// hp and defense follow from the level
+void recalcMonsterStats(SavedMonster &m);
+
+// Adds StarterPal if the player never got one; false if nothing changed
+bool giveStarter(SaveGame &g);
+
+// Fresh player: "NoName", level 1, StarterPal in the party
+void newGame(SaveGame &g);
+
+// False if partyIndex is not a party slot
+bool beginBattle(const SaveGame &g, BattleState &b, int partyIndex,
+                 uint32_t wildId, const SavedMonster &wild);
+
+// Plays one action of the battle in b (which must be in progress) and
+// appends what happened to msg. When the battle ends the party is healed.
+TurnResult battleTurn(SaveGame &g, BattleState &b, BattleAction a,
+                      const BattleDice &dice, char* msg, size_t msgSize);
+
+#endif
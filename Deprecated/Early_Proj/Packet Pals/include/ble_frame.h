@@ -0,0 +1,137 @@
+// ble_frame.h
+#ifndef BLE_FRAME_H
+#define BLE_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// Binary framing for the companion app's BLE link (one GATT characteristic,
+// notifications device -> app). Pure C++: the firmware sends through a
+// BleLink that notifies, the host benches through a loopback.
+//
+// Updates are records, queued into a batch and sent as one message, cut
+// into frames of at most mtu - 3 bytes (the ATT notification header):
+//
+//   frame    0 u8 seq     +1 per frame, wraps; a gap means frames were lost
+//            1 u8 flags   FRAME_START on a message's first frame,
+//                         FRAME_END on its last
+//            2 ...        the next piece of the message
+//   message  records back to back: u8 type, u8 len, len bytes
+//
+// A receiver that sees a gap drops the message in progress and skips
+// frames until the next FRAME_START; BleRx counts what it lost so the app
+// can ask for a resync.
+//
+// Record bodies (little-endian; names are not NUL-terminated):
+//   REC_WILD    u32 id, u8 level, name
+//   REC_ROSTER  u16 total, u32 first id (ids below it are gone)
+//   REC_PARTY   u16 player level, u8 count,
+//               count x { u16 level, i16 hp, i16 defense, u8 name len, name }
+enum BleRecordType : uint8_t {
+  REC_WILD   = 1,
+  REC_ROSTER = 2,
+  REC_PARTY  = 3
+};
+
+static const uint8_t FRAME_START = 0x01;
+static const uint8_t FRAME_END   = 0x02;
+static const size_t  FRAME_HEADER = 2;
+static const size_t  ATT_HEADER = 3;
+static const size_t  BLE_MTU_MIN = 23;    // before the app negotiates
+static const size_t  BLE_MTU_MAX = 517;
+static const size_t  RECORD_MAX = 255;
+
+// Where frames go: a characteristic notify on the device, a loopback on
+// the host. False if the frame could not be queued.
+class BleLink {
+public:
+  virtual ~BleLink() {}
+  virtual bool send(const uint8_t* frame, size_t len) = 0;
+};
+
+// Collects records into one batch and sends it as a framed message.
+// add() sends the batch first if the record would not fit; flush() sends
+// what is queued. service() flushes once the oldest record has waited
+// delayMs, so updates that arrive together share notifications.
+class BleBatcher {
+public:
+  static const size_t BATCH_MAX = 512;
+
+  struct Stats {
+    uint32_t messages, frames, records;
+    uint32_t recordBytes;   // record headers + bodies
+    uint32_t frameBytes;    // everything handed to the link
+    uint32_t failures;      // frames the link refused
+  };
+
+  explicit BleBatcher(BleLink &link, size_t mtu = BLE_MTU_MIN);
+
+  void setMtu(size_t mtu);
+  size_t mtu() const { return mtu_; }
+  void setDelay(uint32_t ms) { delayMs_ = ms; }
+
+  bool add(uint8_t type, const uint8_t* body, size_t len, uint32_t nowMs = 0);
+  bool flush();
+  void service(uint32_t nowMs);
+
+  size_t pending() const { return len_; }
+  // Drops the queued batch (the app went away)
+  void reset() { len_ = 0; }
+  const Stats &stats() const { return stats_; }
+
+private:
+  BleLink &link_;
+  size_t   mtu_;
+  uint32_t delayMs_;
+  uint32_t firstMs_;
+  uint8_t  seq_;
+  size_t   len_;
+  uint8_t  batch_[BATCH_MAX];
+  uint8_t  frame_[BLE_MTU_MAX];
+  Stats    stats_;
+};
+
+// Reassembles messages from frames and hands out their records
+class BleRx {
+public:
+  typedef std::function<void(uint8_t type, const uint8_t* body, size_t len)> OnRecord;
+
+  struct Stats {
+    uint32_t frames, messages, records;
+    uint32_t gaps;       // seq jumps seen
+    uint32_t dropped;    // messages abandoned because of a gap
+    uint32_t malformed;  // messages whose records did not parse
+  };
+
+  explicit BleRx(OnRecord fn) : fn_(fn), expect_(0), synced_(false), inMessage_(false), len_(0), stats_() {}
+
+  void receive(const uint8_t* frame, size_t len);
+  const Stats &stats() const { return stats_; }
+
+private:
+  void deliver();
+
+  OnRecord fn_;
+  uint8_t  expect_;
+  bool     synced_;
+  bool     inMessage_;
+  size_t   len_;
+  uint8_t  msg_[BleBatcher::BATCH_MAX];
+  Stats    stats_;
+};
+
+// Record body builders; each returns the body length, 0 if out is too small
+size_t wildRecord(uint8_t* out, size_t cap, uint32_t id, uint8_t level, const char* name);
+size_t rosterRecord(uint8_t* out, size_t cap, uint16_t total, uint32_t firstId);
+
+struct BlePartyMonster {
+  const char* name;
+  uint16_t level;
+  int16_t  hp;
+  int16_t  defense;
+};
+size_t partyRecord(uint8_t* out, size_t cap, uint16_t playerLevel,
+                   const BlePartyMonster* party, uint8_t count);
+
+#endif
@@ -0,0 +1,89 @@
+// bloom_filter.h
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Bloom filter over 48-bit MACs. Memory only changes on reset(); between
+// resets the false positive rate rises as more keys are added, which only
+// costs the caller an extra lookup further down, never a wrong "new" answer.
+class BloomFilter {
+public:
+  // bits is rounded up to a power of two
+  BloomFilter(size_t bits, int hashes)
+    : words_(nullptr), mask_(0), hashes_(hashes)
+  {
+    reset(bits, hashes);
+  }
+  ~BloomFilter() { free(words_); }
+  BloomFilter(const BloomFilter&) = delete;
+  BloomFilter& operator=(const BloomFilter&) = delete;
+
+  void add(uint64_t key) {
+    if(!words_) return;
+    uint64_t h = mix(key);
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for(int i=0; i<hashes_; i++){
+      size_t bit = (h1 + (uint32_t)i * h2) & mask_;
+      words_[bit >> 5] |= 1u << (bit & 31);
+    }
+  }
+
+  bool mightContain(uint64_t key) const {
+    if(!words_) return true;
+    uint64_t h = mix(key);
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for(int i=0; i<hashes_; i++){
+      size_t bit = (h1 + (uint32_t)i * h2) & mask_;
+      if(!(words_[bit >> 5] & (1u << (bit & 31)))) return false;
+    }
+    return true;
+  }
+
+  void clear() {
+    for(size_t i=0; i<memoryBytes()/4; i++) words_[i] = 0;
+  }
+
+  // Empty again at a new size; false (and no filter, so every key "might"
+  // be present) if the bits can't be allocated
+  bool reset(size_t bits, int hashes) {
+    size_t n = 64;
+    while(n < bits) n <<= 1;
+    hashes_ = hashes;
+    if(words_ && n == mask_ + 1){
+      clear();
+      return true;
+    }
+    free(words_);
+    words_ = (uint32_t*)calloc(n / 32, sizeof(uint32_t));
+    mask_ = words_ ? n - 1 : 0;
+    return words_ != nullptr;
+  }
+
+  size_t memoryBytes() const { return words_ ? (mask_ + 1) / 8 : 0; }
+  size_t bits() const { return words_ ? mask_ + 1 : 0; }
+  int hashes() const { return hashes_; }
+
+  // Raw bit array, memoryBytes() long, for saving and restoring as is
+  const uint32_t* data() const { return words_; }
+  uint32_t* data() { return words_; }
+
+private:
+  // murmur3 fmix64, split into two 32-bit hashes (Kirsch-Mitzenmacher)
+  static uint64_t mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+  }
+
+  uint32_t* words_;
+  size_t    mask_;
+  int       hashes_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+// boot_image.h
+#ifndef BOOT_IMAGE_H
+#define BOOT_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pal_fs.h"
+
+// One file holding state that is slow to rebuild at boot, laid out exactly
+// as it sits in RAM, so restoring it is a few bounded reads straight into
+// the live structures: no parsing, no per-entry work.
+//
+//   header:  magic, version, section count
+//   table:   { id, offset, length, crc32 } per section
+//   u32      crc32 of header + table
+//   sections, each at its offset
+//
+// Every section has its own CRC, checked as it is read, so a consumer
+// never applies damaged data. The image is a cache: anything missing,
+// stale or corrupt just sends the caller down the slow path.
+struct BootImage {
+  static const uint32_t MAGIC = 0x474d4950;   // "PIMG"
+  static const uint16_t VERSION = 1;
+  static const size_t MAX_SECTIONS = 8;
+
+  struct Entry {
+    uint32_t id;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t crc;
+  };
+};
+
+// Collects sections (by pointer; they must stay valid until commit()) and
+// writes them to "<path>.tmp", then renames it over the image
+class BootImageWriter {
+public:
+  BootImageWriter(PalFs &fs, const char* path);
+  bool add(uint32_t id, const void* data, size_t len);
+  bool commit();
+
+private:
+  PalFs &fs_;
+  const char* path_;
+  const void* data_[BootImage::MAX_SECTIONS];
+  BootImage::Entry entries_[BootImage::MAX_SECTIONS];
+  size_t count_;
+};
+
+class BootImageReader {
+public:
+  BootImageReader(PalFs &fs, const char* path);
+  // Reads and checks header and table; false if missing or damaged
+  bool begin();
+  // Section length, 0 if absent
+  size_t length(uint32_t id) const;
+  // Reads a whole section into dst (len must match) and checks its CRC
+  bool read(uint32_t id, void* dst, size_t len);
+
+private:
+  const BootImage::Entry* find(uint32_t id) const;
+
+  PalFs &fs_;
+  const char* path_;
+  std::unique_ptr<PalFile> f_;
+  BootImage::Entry entries_[BootImage::MAX_SECTIONS];
+  size_t count_;
+};
+
+#endif
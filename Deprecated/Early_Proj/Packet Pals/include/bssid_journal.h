@@ -0,0 +1,63 @@
+// bssid_journal.h
+#ifndef BSSID_JOURNAL_H
+#define BSSID_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "pal_fs.h"
+
+// Append-only log of encountered BSSIDs: one raw 6-byte MAC per record, no
+// framing. New BSSIDs are batched in RAM and appended with a single
+// open/write/close per flush(), so the cost of remembering a network no
+// longer depends on how many we already know. The file is only rewritten by
+// compaction (torn tail after a power cut, duplicate records).
+class BssidJournal {
+public:
+  static const size_t RECORD_SIZE   = 6;
+  static const size_t BATCH_RECORDS = 32;
+
+  BssidJournal(PalFs &fs, const char* path);
+
+  bool exists();
+  // Reads the journal front to back, calling onRecord per MAC. A partial
+  // trailing record is ignored and flags the journal for compaction.
+  size_t load(const std::function<void(uint64_t)> &onRecord);
+
+  // Queues one record; written on flush() or when the batch is full. False
+  // if the batch could not be written; when it is still full the record is
+  // dropped (see dropped()).
+  bool append(uint64_t mac);
+  // A short write keeps only the unwritten records queued. A partial record
+  // leaves a torn tail, and flush() then fails until a compaction.
+  bool flush();
+
+  // Records in the file plus those still pending
+  size_t records() const { return fileRecords_ + pending_; }
+  bool needsCompaction(size_t liveCount) const;
+  // Records never queued because flash was full or the tail torn
+  size_t dropped() const { return dropped_; }
+
+  // Rewrites the journal from the live set: beginCompaction(), one
+  // addCompacted() per live MAC, then commitCompaction(). The new file is
+  // written beside the old one and renamed over it, so a crash mid-way
+  // leaves the previous journal intact.
+  bool beginCompaction();
+  bool addCompacted(uint64_t mac);
+  bool commitCompaction();
+
+private:
+  PalFs &fs_;
+  const char* path_;
+  char tmpPath_[32];
+  std::unique_ptr<PalFile> compactFile_;
+  size_t compactRecords_;
+  size_t fileRecords_;
+  bool   tornTail_;
+  uint8_t batch_[BATCH_RECORDS * RECORD_SIZE];
+  size_t  pending_;
+  size_t  dropped_;
+  bool    unjournaled_;   // dropped since the last compaction
+};
+
+#endif
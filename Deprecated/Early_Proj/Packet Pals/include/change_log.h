@@ -0,0 +1,73 @@
+// change_log.h
+#ifndef CHANGE_LOG_H
+#define CHANGE_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What changed; ref says which one
+enum ChangeKind : uint8_t {
+  CHANGE_WILD_ADD  = 1,   // ref: roster id
+  CHANGE_WILD_GONE = 2,   // ref: roster id
+  CHANGE_SEEN      = 3,   // ref: 48-bit BSSID
+  CHANGE_PARTY     = 4,   // ref: sessionScope() of whose party
+  CHANGE_PLAYER    = 5,   // ref: sessionScope(); level or name
+  CHANGE_BUCKET    = 6    // ref: sessionScope(); the player's level moved
+                          // to another MonsterGen bucket, so every wild
+                          // level that player sees changed
+};
+
+struct Change {
+  uint32_t seq;
+  uint32_t refLo;
+  uint16_t refHi;
+  uint8_t  kind;
+
+  uint64_t ref() const { return ((uint64_t)refHi << 32) | refLo; }
+};
+
+// The 48 bits of a session token a change carries
+inline uint64_t sessionScope(uint64_t token) { return token & 0xFFFFFFFFFFFFULL; }
+
+// Bounded log of state changes for clients that sync incrementally. Every
+// change gets the next sequence number (the first is 1); the log keeps the
+// newest capacity of them (12 bytes each) in a caller-supplied ring, so a
+// client that asks for everything after a sequence number older than that
+// has to pull the full state instead.
+class ChangeLog {
+public:
+  ChangeLog(Change* ring, size_t capacity) : ring_(ring), cap_(capacity), seq_(0) {}
+
+  // Returns the change's sequence number
+  uint32_t append(uint8_t kind, uint64_t ref) {
+    Change &c = ring_[seq_ % cap_];
+    c.seq   = ++seq_;
+    c.kind  = kind;
+    c.refLo = (uint32_t)ref;
+    c.refHi = (uint16_t)(ref >> 32);
+    return seq_;
+  }
+
+  // Newest sequence number, 0 before the first change
+  uint32_t seq() const { return seq_; }
+  // Oldest sequence number still held (seq() + 1 when empty)
+  uint32_t oldest() const { return seq_ >= cap_ ? seq_ - (uint32_t)cap_ + 1 : 1; }
+  // True if every change after since is still held
+  bool covers(uint32_t since) const { return since <= seq_ && since + 1 >= oldest(); }
+
+  // The change numbered s; false if it is not held
+  bool at(uint32_t s, Change &out) const {
+    if(s == 0 || s > seq_ || s < oldest()) return false;
+    out = ring_[(s - 1) % cap_];
+    return true;
+  }
+
+  size_t capacity() const { return cap_; }
+
+private:
+  Change*  ring_;
+  size_t   cap_;
+  uint32_t seq_;
+};
+
+#endif
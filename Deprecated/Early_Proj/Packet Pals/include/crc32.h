@@ -0,0 +1,31 @@
+// crc32.h
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, same as zlib). Nibble table: 64 bytes of flash
+// instead of 1 KB, plenty fast for save slots of a few hundred bytes.
+// Pass the previous result as crc to continue over several buffers.
+inline uint32_t crc32Update(uint32_t crc, const void* data, size_t len) {
+  static const uint32_t TABLE[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+  };
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  for(size_t i = 0; i < len; i++) {
+    crc = TABLE[(crc ^ p[i]) & 0x0f] ^ (crc >> 4);
+    crc = TABLE[(crc ^ (p[i] >> 4)) & 0x0f] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+inline uint32_t crc32(const void* data, size_t len) {
+  return crc32Update(0, data, len);
+}
+
+#endif
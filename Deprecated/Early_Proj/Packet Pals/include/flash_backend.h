@@ -0,0 +1,100 @@
+// flash_backend.h
+#ifndef FLASH_BACKEND_H
+#define FLASH_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw NOR flash region, the layer under LogKv. Semantics are those of the
+// SPI flash chip, not of a file: erase sets a whole sector to 0xFF, write
+// can only clear bits (1 -> 0), so a byte is written once per erase.
+// Addresses are relative to the start of the region.
+class FlashBackend {
+public:
+  virtual ~FlashBackend() {}
+  virtual size_t sectorSize() const = 0;
+  virtual size_t sectorCount() const = 0;
+  virtual bool read(size_t addr, void* buf, size_t len) = 0;
+  virtual bool write(size_t addr, const void* buf, size_t len) = 0;
+  virtual bool erase(size_t sector) = 0;
+};
+
+#ifdef ARDUINO
+#include <esp_partition.h>
+// A data partition from the partition table, by label
+class PartitionFlash : public FlashBackend {
+public:
+  explicit PartitionFlash(const char* label) : label_(label), part_(nullptr) {}
+  // Looks the partition up; false if this partition table has none
+  bool begin();
+  size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+  size_t sectorCount() const override { return part_ ? part_->size / SPI_FLASH_SEC_SIZE : 0; }
+  bool read(size_t addr, void* buf, size_t len) override;
+  bool write(size_t addr, const void* buf, size_t len) override;
+  bool erase(size_t sector) override;
+private:
+  const char* label_;
+  const esp_partition_t* part_;
+};
+#else
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Flash emulator in RAM for host benchmarks. Enforces NOR rules (a write
+// that would set a bit fails), counts traffic per sector, and keeps a
+// modelled busy time using typical SPI NOR timings so latency can be
+// compared without the chip. tearAfter() simulates a power cut: once that
+// many more bytes are programmed, writes and erases stop half done.
+class RamFlash : public FlashBackend {
+public:
+  // Typical SPI NOR figures (W25Q32 class datasheet, typ. not max): a
+  // page program costs 30 us + 2.5 us per further byte, at most 400 us
+  static const uint32_t PAGE_BYTES = 256;
+  static const uint32_t PAGE_PROGRAM_US = 400;
+  static const uint32_t SECTOR_ERASE_US = 45000;
+
+  RamFlash(size_t sectorSize, size_t sectorCount);
+  size_t sectorSize() const override { return sectorSize_; }
+  size_t sectorCount() const override { return eraseCounts_.size(); }
+  bool read(size_t addr, void* buf, size_t len) override;
+  bool write(size_t addr, const void* buf, size_t len) override;
+  bool erase(size_t sector) override;
+
+  void tearAfter(size_t bytes) { tearLeft_ = bytes; tearing_ = true; }
+  bool torn() const { return tearing_ && tearLeft_ == 0; }
+  void repair() { tearing_ = false; }
+
+  uint64_t busyUs() const { return busyUs_; }
+  uint64_t bytesProgrammed() const { return programmed_; }
+  uint32_t eraseCount(size_t sector) const { return eraseCounts_[sector]; }
+  const std::vector<uint8_t>& image() const { return mem_; }
+
+protected:
+  std::vector<uint8_t> mem_;
+
+private:
+  size_t sectorSize_;
+  std::vector<uint32_t> eraseCounts_;
+  uint64_t busyUs_;
+  uint64_t programmed_;
+  size_t tearLeft_;
+  bool tearing_;
+};
+
+// RamFlash written through to a host file, so state survives between runs
+// (native build). A missing or short file reads as erased flash.
+class FileFlash : public RamFlash {
+public:
+  FileFlash(const std::string &path, size_t sectorSize, size_t sectorCount);
+  ~FileFlash() override;
+  bool ok() const { return f_ != nullptr; }
+  bool write(size_t addr, const void* buf, size_t len) override;
+  bool erase(size_t sector) override;
+private:
+  bool store(size_t addr, size_t len);
+  FILE* f_;
+};
+#endif
+
+#endif
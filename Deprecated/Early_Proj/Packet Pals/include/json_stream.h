@@ -0,0 +1,68 @@
+// json_stream.h
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Destination for streamed output (socket, file, counter...)
+class ByteSink {
+public:
+  virtual ~ByteSink() {}
+  virtual bool write(const char* data, size_t len) = 0;
+};
+
+// Writes JSON into a fixed buffer and hands it to a ByteSink each time the
+// buffer fills, so memory use is the buffer size no matter how long the
+// output is. Commas between members/elements are inserted automatically.
+//
+//   JsonStream js(sink, buf, sizeof(buf));
+//   js.beginObject();
+//   js.key("monsters"); js.beginArray();
+//   ...
+//   js.endArray(); js.endObject(); js.flush();
+class JsonStream {
+public:
+  JsonStream(ByteSink &sink, char* buf, size_t bufSize);
+
+  void beginObject();
+  void endObject();
+  void beginArray();
+  void endArray();
+  void key(const char* name);
+
+  void value(const char* s);
+  void value(long v);
+  void value(unsigned long v);
+  void value(int v)      { value((long)v); }
+  void value(unsigned v) { value((unsigned long)v); }
+  void value(bool v);
+  void null();
+
+  // key + value shorthands
+  template<typename T> void field(const char* name, T v) { key(name); value(v); }
+
+  bool flush();
+  bool ok() const { return ok_; }
+  size_t bytesOut() const { return total_ + used_; }
+
+private:
+  static const int MAX_DEPTH = 16;
+
+  void separator();
+  void put(char c);
+  void put(const char* s, size_t len);
+  void putEscaped(const char* s);
+
+  ByteSink &sink_;
+  char*  buf_;
+  size_t cap_;
+  size_t used_;
+  size_t total_;
+  uint32_t hasItems_;   // bit per nesting level: emitted an element already
+  int    depth_;
+  bool   afterKey_;
+  bool   ok_;
+};
+
+#endif
@@ -0,0 +1,75 @@
+// kv_fs.h
+#ifndef KV_FS_H
+#define KV_FS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pal_fs.h"
+#include "log_kv.h"
+
+// PalFs on top of LogKv, so the state files (save slots, seen-set segment
+// and journal, boot image) move off SPIFFS without their code changing.
+//
+// A file is a run of LogKv values of CHUNK_BYTES each, keyed by
+// (inode << 16 | chunk index); the directory, path -> inode, is a single
+// value of its own. Writes are buffered a chunk at a time and each full
+// (or flushed) chunk is one put(). Rewriting a small file such as a save
+// slot is therefore a single atomic record, and rename() is one directory
+// put, so it is atomic too. File sizes are rebuilt from the chunks at
+// begin(); chunks whose inode no directory entry owns are removed then.
+//
+// Removing a file (or renaming over one) only drops it from the directory;
+// its chunks are deleted a few per service() call, so the seen-set merge
+// dropping a 300 KB segment doesn't stall loop(). A reboot in between just
+// finds them orphaned at begin().
+class KvFs : public PalFs {
+public:
+  static const uint32_t DIR_KEY = 0x52494450;   // "PDIR"
+  static const size_t CHUNK_BYTES = 1008;        // 4 chunks + headers fill a 4 KB sector
+  static const size_t MAX_FILES = 16;
+  static const size_t MAX_PATH = 24;
+
+  explicit KvFs(LogKv &kv);
+  bool begin();
+
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override;
+  bool exists(const char* path) override;
+  bool remove(const char* path) override;
+  bool rename(const char* from, const char* to) override;
+  // What the log has left, less a record header per chunk. Removed files
+  // count as used until service() has deleted their chunks.
+  size_t freeBytes() override;
+
+  // Deletes up to `budget` chunks of removed files; call from loop()
+  void service(size_t budget = 8);
+
+  size_t fileCount() const { return count_; }
+
+private:
+  class File;
+  struct Entry {
+    char path[MAX_PATH];
+    uint8_t inode;
+    uint32_t size;      // RAM only, rebuilt from the chunks
+  };
+  struct Orphan {
+    uint8_t inode;
+    size_t chunks;      // left to delete, highest first
+  };
+
+  static uint32_t chunkKey(uint8_t inode, size_t chunk) { return ((uint32_t)inode << 16) | (uint32_t)chunk; }
+  Entry* find(const char* path);
+  Entry* byInode(uint8_t inode);
+  uint8_t freeInode() const;
+  bool saveDir();
+  void dropChunks(uint8_t inode, size_t from, size_t to);
+  void orphan(const Entry &e);
+
+  LogKv &kv_;
+  Entry files_[MAX_FILES];
+  size_t count_;
+  Orphan orphans_[MAX_FILES];
+  size_t orphanCount_;
+};
+
+#endif
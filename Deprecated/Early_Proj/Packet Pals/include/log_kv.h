@@ -0,0 +1,159 @@
+// log_kv.h
+#ifndef LOG_KV_H
+#define LOG_KV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "flash_backend.h"
+
+// Log-structured key-value store straight on a raw flash region.
+//
+// Every put() appends a record to the active sector; nothing is ever
+// rewritten in place, so a write is one program operation and a power cut
+// can only tear the last record (its CRC then fails and mount ignores it).
+// A sorted index in RAM maps each key to its newest record.
+//
+//   sector:  magic, erase count, crc of those, sequence (0xFFFFFFFF = free)
+//   record:  u32 key, u16 length, u16 kind, u32 crc, value, pad to 4
+//
+// When free sectors run low, service() compacts one used sector at a time
+// in the background: its live records are copied to the head of the log,
+// then it is erased. The victim is the sector with the least live data;
+// every WEAR_CHECK compactions, if erase counts have drifted apart by more
+// than WEAR_SPREAD, the least-worn used sector is taken instead so cold
+// data does not pin it. New sectors are taken least-worn first.
+//
+// put() only compacts itself (a foreground stall) when service() has not
+// kept up and the last spare sector would be needed.
+//
+// A sector erase is one 45 ms flash operation that can't be split, so the
+// background path leaves the emptied victim retired (still counted as used,
+// its stale records shadowed by their copies) and erases it on a later
+// service() call of its own. A caller that holds a lock around the store
+// can instead takeErase() under the lock, eraseFlash() without it and
+// finishErase() under it again; the store keeps working meanwhile.
+class LogKv {
+public:
+  static const uint32_t SECTOR_MAGIC = 0x53564b50;   // "PKVS"
+  static const size_t SECTOR_HEADER = 16;
+  static const size_t RECORD_HEADER = 12;
+  static const size_t NONE = (size_t)-1;
+  static const size_t RESERVE_SECTORS = 1;    // kept free for compaction
+  static const size_t BACKGROUND_FREE = 4;    // service() compacts below this
+                                              // (or 1/16 of the region)
+  static const uint32_t WEAR_CHECK = 16;
+  static const uint32_t WEAR_SPREAD = 16;
+
+  struct Stats {
+    uint64_t userBytes;     // value bytes passed to put()
+    uint64_t flashBytes;    // bytes programmed: records, copies, headers
+    uint32_t erases;
+    uint32_t compactions;
+    uint32_t foreground;    // compactions run inside put()
+    uint32_t wearMoves;     // compactions picked for wear, not garbage
+  };
+
+  explicit LogKv(FlashBackend &flash);
+
+  // Mounts: reads sector headers and replays the log into the index.
+  // Unformatted or foreign sectors are treated as free and erased when
+  // first used, so a blank partition needs no separate format step.
+  bool begin();
+  // Erases everything (erase counts carry over)
+  bool format();
+
+  // Value length, NONE if the key is absent
+  size_t length(uint32_t key) const;
+  // Reads len bytes of a value starting at offset
+  bool read(uint32_t key, size_t offset, void* buf, size_t len);
+  bool put(uint32_t key, const void* data, size_t len);
+  bool remove(uint32_t key);
+  void forEach(const std::function<void(uint32_t key, size_t len)> &fn) const;
+
+  // Background compaction: copies up to `budget` bytes of live records,
+  // or erases the victim emptied by an earlier call. Call from loop().
+  void service(size_t budget = 1024);
+  bool compacting() const { return victim_ >= 0 || retired_ >= 0; }
+
+  // The retired sector for the caller to erase, NONE if there is none or
+  // it is already taken. eraseFlash() touches only that sector and no
+  // store state, so it can run unlocked beside reads and puts (as long as
+  // the backend allows an erase next to them); finishErase() marks it free,
+  // or hands it back for another try if the erase failed.
+  size_t takeErase();
+  bool eraseFlash(size_t s) { return flash_.erase(s); }
+  bool finishErase(size_t s, bool erased);
+
+  size_t maxValue() const { return flash_.sectorSize() - SECTOR_HEADER - RECORD_HEADER; }
+  size_t freeSectors() const { return freeSectors_; }
+  // Record bytes that still fit once compaction has reclaimed every dead
+  // record, headers included, the reserve sectors left out
+  size_t freeBytes() const;
+  size_t keys() const { return index_.size(); }   // tombstones included
+  size_t memoryBytes() const;
+  const Stats& stats() const { return stats_; }
+
+private:
+  static const uint32_t FREE_SEQ = 0xFFFFFFFF;
+  enum { KIND_VALUE = 0, KIND_TOMBSTONE = 1 };
+
+  struct Sector {
+    uint32_t seq;
+    uint32_t eraseCount;
+    uint32_t live;         // bytes of records the index points at
+    uint16_t end;          // offset after the last valid record
+    bool sealed;           // damaged tail: no more appends
+    bool checked;          // free and known to be erased
+    bool foreign;          // header neither ours nor erased
+  };
+  static size_t recordSize(size_t len) { return (RECORD_HEADER + len + 3) & ~(size_t)3; }
+
+  // 8 bytes per key: record address / 4 in the low 20 bits (4 MB), value
+  // length in the top 12, TOMBSTONE_LEN marking a tombstone
+  static const uint32_t TOMBSTONE_LEN = 0xFFF;
+  struct Entry {
+    uint32_t key;
+    uint32_t loc;
+    uint32_t addr() const { return (loc & 0xFFFFF) << 2; }
+    size_t len() const { return loc >> 20; }
+    bool tombstone() const { return len() == TOMBSTONE_LEN; }
+    size_t bytes() const { return recordSize(tombstone() ? 0 : len()); }
+  };
+  size_t sectorOf(uint32_t addr) const { return addr / flash_.sectorSize(); }
+
+  Entry* find(uint32_t key);
+  const Entry* find(uint32_t key) const;
+  void setEntry(uint32_t key, uint32_t addr, size_t len, uint16_t kind);
+  void dropEntry(Entry* e);
+  void scanSector(size_t s, bool newest);
+  bool append(uint32_t key, uint16_t kind, const void* data, size_t len, uint32_t &addr);
+  bool copyRecord(uint32_t from, size_t size, uint32_t &addr);
+  bool reserve(size_t need, bool compaction);
+  bool openSector(bool compaction);
+  bool prepareFree(size_t s);
+  bool eraseSector(size_t s);
+  bool markErased(size_t s);
+  bool eraseRetired();
+  int pickVictim();
+  bool compactStep(size_t &budget, bool retire);
+  size_t oldestUsed() const;
+
+  FlashBackend &flash_;
+  std::vector<Sector> sectors_;
+  std::vector<Entry> index_;   // sorted by key
+  int active_;
+  size_t writeOff_;
+  uint32_t nextSeq_;
+  size_t freeSectors_;
+  size_t backgroundFree_;
+  int victim_;
+  int retired_;        // emptied, waiting for its erase
+  bool erasing_;       // retired_ handed out by takeErase()
+  size_t compactOff_;
+  uint32_t picks_;
+  Stats stats_;
+};
+
+#endif
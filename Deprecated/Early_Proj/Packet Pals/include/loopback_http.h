@@ -0,0 +1,49 @@
+// loopback_http.h
+#ifndef LOOPBACK_HTTP_H
+#define LOOPBACK_HTTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "pal_http.h"
+#include "pals_core.h"
+
+// A small HTTP/1.1 server for the native build: parses a request, picks a
+// route the way ESPAsyncWebServer does (GET only, a route also takes the
+// paths below it, first match wins, everything else to the fallback) and
+// writes the response, pulling the body WINDOW bytes at a time as the
+// board's TCP send window would. exchange() does one request in memory,
+// serve() answers real sockets on 127.0.0.1 so a browser or curl can play
+// against a replay. One connection at a time, closed after its response.
+class LoopbackHttp {
+public:
+  static const size_t WINDOW = 1436;   // one TCP segment's payload on the ESP32
+  typedef void (*Handler)(const HttpRequest &request, HttpResponse &response);
+
+  struct Stats {
+    uint32_t requests;
+    uint32_t malformed;   // answered 400 without reaching a handler
+    uint32_t fills;       // body pulls
+    uint64_t headBytes;
+    uint64_t bodyBytes;
+  };
+
+  LoopbackHttp(const PalsRoute* routes, size_t routeCount, Handler fallback);
+
+  // One raw request (start line and headers) in, the raw response out
+  std::string exchange(const std::string &raw);
+  // Answers connections on 127.0.0.1:port until none arrives for idleMs
+  // (0: never stops); tick runs between connections and every 10 ms while
+  // waiting, for the game's loop. False if the port cannot be bound.
+  bool serve(uint16_t port, uint32_t idleMs, void (*tick)());
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  const PalsRoute* routes_;
+  size_t routeCount_;
+  Handler fallback_;
+  Stats stats_;
+};
+
+#endif
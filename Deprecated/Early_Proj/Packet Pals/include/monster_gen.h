@@ -0,0 +1,69 @@
+// monster_gen.h
+#ifndef MONSTER_GEN_H
+#define MONSTER_GEN_H
+
+#include <stdint.h>
+
+// Wild monster attributes as a pure function of the BSSID, so a monster
+// never needs storing: the same access point always yields the same
+// monster, before and after a reboot, on any device with the same key.
+//
+// The name depends only on (key, BSSID). The level also depends on the
+// player's level bucket, so monsters keep up with the player in steps of
+// LEVEL_BUCKET instead of reshuffling on every level-up.
+struct MonsterTraits {
+  uint8_t prefix;
+  uint8_t suffix;
+  uint8_t level;
+};
+
+class MonsterGen {
+public:
+  static const uint64_t DEFAULT_KEY = 0x9e3779b97f4a7c15ULL;
+  static const int LEVEL_BUCKET = 4;
+  static const int LEVEL_SPREAD = 3;   // +- around the bucket's base level
+
+  MonsterGen(uint8_t prefixCount, uint8_t suffixCount, uint64_t key = DEFAULT_KEY)
+    : prefixCount_(prefixCount), suffixCount_(suffixCount), key_(key) {}
+
+  static int levelBucket(int playerLevel) {
+    return playerLevel < 1 ? 0 : (playerLevel - 1) / LEVEL_BUCKET;
+  }
+
+  MonsterTraits derive(uint64_t bssid, int playerLevel) const {
+    MonsterTraits t;
+    uint64_t h = mix(bssid ^ key_);
+    // 32 bits each: modulo bias is far below anything a player could notice
+    t.prefix = (uint8_t)((uint32_t)h % prefixCount_);
+    t.suffix = (uint8_t)((uint32_t)(h >> 32) % suffixCount_);
+    t.level  = levelFor(bssid, playerLevel);
+    return t;
+  }
+
+  uint8_t levelFor(uint64_t bssid, int playerLevel) const {
+    int bucket = levelBucket(playerLevel);
+    uint64_t h = mix(bssid ^ mix(key_ + (uint64_t)bucket + 1));
+    int base = bucket * LEVEL_BUCKET + 1 + LEVEL_BUCKET / 2;
+    int level = base - LEVEL_SPREAD + (int)((uint32_t)h % (2 * LEVEL_SPREAD + 1));
+    if(level < 1) level = 1;
+    if(level > 255) level = 255;
+    return (uint8_t)level;
+  }
+
+private:
+  // murmur3 fmix64
+  static uint64_t mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+  }
+
+  uint8_t  prefixCount_;
+  uint8_t  suffixCount_;
+  uint64_t key_;
+};
+
+#endif
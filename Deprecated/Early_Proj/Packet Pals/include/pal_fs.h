@@ -0,0 +1,79 @@
+// pal_fs.h
+#ifndef PAL_FS_H
+#define PAL_FS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+// Minimal file interface so the storage code can run against SPIFFS on the
+// device and against plain files on a Linux host (benchmarks).
+class PalFile {
+public:
+  virtual ~PalFile() {}
+  virtual size_t read(uint8_t* buf, size_t len) = 0;
+  virtual size_t write(const uint8_t* buf, size_t len) = 0;
+  virtual bool seek(size_t pos) = 0;
+  virtual size_t size() = 0;
+  virtual void flush() = 0;
+};
+
+class PalFs {
+public:
+  virtual ~PalFs() {}
+  // mode is "r", "w" (truncate) or "a" (append); returns nullptr on failure
+  virtual std::unique_ptr<PalFile> open(const char* path, const char* mode) = 0;
+  virtual bool exists(const char* path) = 0;
+  virtual bool remove(const char* path) = 0;
+  virtual bool rename(const char* from, const char* to) = 0;
+  // Bytes a new file could still take, or UNKNOWN_FREE if the store can't say
+  static const size_t UNKNOWN_FREE = (size_t)-1;
+  virtual size_t freeBytes() { return UNKNOWN_FREE; }
+};
+
+// Forwards to a file system picked at runtime, so globals built before
+// setup() can be pointed at whichever store actually mounted
+class PalFsRef : public PalFs {
+public:
+  explicit PalFsRef(PalFs &fs) : fs_(&fs) {}
+  void set(PalFs &fs) { fs_ = &fs; }
+  PalFs& get() const { return *fs_; }
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override { return fs_->open(path, mode); }
+  bool exists(const char* path) override { return fs_->exists(path); }
+  bool remove(const char* path) override { return fs_->remove(path); }
+  bool rename(const char* from, const char* to) override { return fs_->rename(from, to); }
+  size_t freeBytes() override { return fs_->freeBytes(); }
+private:
+  PalFs* fs_;
+};
+
+#ifdef ARDUINO
+#include <FS.h>
+// Wraps an Arduino fs::FS (SPIFFS, LittleFS)
+class ArduinoPalFs : public PalFs {
+public:
+  explicit ArduinoPalFs(fs::FS& fs) : fs_(fs) {}
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override;
+  bool exists(const char* path) override;
+  bool remove(const char* path) override;
+  bool rename(const char* from, const char* to) override;
+private:
+  fs::FS& fs_;
+};
+#else
+#include <string>
+// Maps "/name" onto files below a host directory
+class PosixPalFs : public PalFs {
+public:
+  explicit PosixPalFs(const std::string& root) : root_(root) {}
+  std::unique_ptr<PalFile> open(const char* path, const char* mode) override;
+  bool exists(const char* path) override;
+  bool remove(const char* path) override;
+  bool rename(const char* from, const char* to) override;
+private:
+  std::string hostPath(const char* path) const { return root_ + path; }
+  std::string root_;
+};
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+// pal_hal.h
+#ifndef PAL_HAL_H
+#define PAL_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pal_fs.h"
+#include "flash_backend.h"
+#include "scan_record.h"
+
+// What the game needs from the board besides files (pal_fs.h) and raw
+// flash (flash_backend.h): the WiFi radio's scanner, random numbers, a
+// millisecond clock and the lock around the game state. The ESP32 build
+// wires these to WiFi, esp_random(), millis() and a FreeRTOS mutex; the
+// native build to a recorded scan trace, a seeded generator and a clock
+// the replay drives, so a run is the same every time.
+
+// Sweeps for access points, in the shape of WiFi.scanNetworks()
+class PalRadio {
+public:
+  static const int SWEEP_RUNNING = -1;
+  static const int SWEEP_FAILED = -2;
+
+  virtual ~PalRadio() {}
+  // Starts a sweep. async: returns SWEEP_RUNNING (or SWEEP_FAILED) at once,
+  // sweepDone() tells when it has finished; otherwise blocks and returns
+  // the number of results.
+  virtual int sweep(bool async) = 0;
+  // Results of the last sweep, or SWEEP_RUNNING / SWEEP_FAILED
+  virtual int sweepDone() = 0;
+  virtual void result(int i, ScanRecord &rec) = 0;
+  // Frees the last sweep's results
+  virtual void release() = 0;
+};
+
+class PalRng {
+public:
+  virtual ~PalRng() {}
+  virtual uint32_t next() = 0;
+  // Uniform in [lo, hi), as Arduino's random(lo, hi); lo if the range is empty
+  int uniform(int lo, int hi) { return hi > lo ? lo + (int)(next() % (uint32_t)(hi - lo)) : lo; }
+};
+
+class PalClock {
+public:
+  virtual ~PalClock() {}
+  virtual uint32_t millis() = 0;
+};
+
+class PalLock {
+public:
+  virtual ~PalLock() {}
+  virtual void lock() = 0;
+  virtual void unlock() = 0;
+};
+
+// Everything pals_core.h runs on. files holds the web files, the Wigle CSV
+// and (without stateFlash) the game state; stateFlash is the raw "pals"
+// partition, nullptr if the board has none. log gets one line at a time,
+// without the newline.
+struct PalHal {
+  PalFs *files;
+  FlashBackend *stateFlash;
+  PalRadio *radio;
+  PalRng *rng;
+  PalClock *clock;
+  PalLock *lock;
+  void (*log)(const char* line);
+};
+
+#ifdef ARDUINO
+// WiFi.scanNetworks() and friends, hidden networks included
+class WifiRadio : public PalRadio {
+public:
+  int sweep(bool async) override;
+  int sweepDone() override;
+  void result(int i, ScanRecord &rec) override;
+  void release() override;
+};
+
+// esp_random(): the hardware RNG, what random() uses underneath
+class EspRng : public PalRng {
+public:
+  uint32_t next() override;
+};
+
+class EspClock : public PalClock {
+public:
+  uint32_t millis() override;
+};
+
+// FreeRTOS mutex; begin() it from setup(), before the scheduler hands
+// requests to the game
+class RtosLock : public PalLock {
+public:
+  RtosLock() : mutex_(nullptr) {}
+  void begin();
+  void lock() override;
+  void unlock() override;
+private:
+  void* mutex_;
+};
+#else
+#include <mutex>
+
+// SplitMix64: small, fast and the same sequence for the same seed
+class SeededRng : public PalRng {
+public:
+  explicit SeededRng(uint64_t seed) : state_(seed) {}
+  uint32_t next() override;
+private:
+  uint64_t state_;
+};
+
+// Time only moves when the caller says so
+class ManualClock : public PalClock {
+public:
+  ManualClock() : ms_(0) {}
+  uint32_t millis() override { return ms_; }
+  void set(uint32_t ms) { ms_ = ms; }
+  void advance(uint32_t ms) { ms_ += ms; }
+private:
+  uint32_t ms_;
+};
+
+class StdLock : public PalLock {
+public:
+  void lock() override { m_.lock(); }
+  void unlock() override { m_.unlock(); }
+private:
+  std::mutex m_;
+};
+#endif
+
+#endif
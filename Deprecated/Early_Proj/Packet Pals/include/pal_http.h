@@ -0,0 +1,99 @@
+// pal_http.h
+#ifndef PAL_HTTP_H
+#define PAL_HTTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <memory>
+#include "json_stream.h"
+
+// The game's handlers see requests and build responses through these,
+// whichever server parsed the request: ESPAsyncWebServer on the board,
+// the loopback front end (loopback_http.h) on a workstation.
+
+class HttpRequest {
+public:
+  virtual ~HttpRequest() {}
+  // Path without the query string
+  virtual const char* path() const = 0;
+  // HEAD: the response goes out without its body
+  virtual bool head() const = 0;
+  // Decoded query argument or request header; nullptr if absent
+  virtual const char* arg(const char* name) const = 0;
+  virtual const char* header(const char* name) const = 0;
+
+  // Argument as a number, as String::toInt() reads it; dflt if absent
+  long argLong(const char* name, long dflt) const {
+    const char* v = arg(name);
+    return v ? atol(v) : dflt;
+  }
+};
+
+// A response body, pulled by the server as the socket drains
+class HttpBody {
+public:
+  static const size_t CHUNKED = (size_t)-1;   // length not known up front
+
+  virtual ~HttpBody() {}
+  virtual size_t length() const = 0;
+  // Up to room bytes into out; 0 once the body is done
+  virtual size_t fill(uint8_t* out, size_t room) = 0;
+};
+
+// Small body assembled up front from pieces (a cached body plus a few
+// fields); it is a ByteSink so a JsonStream can write into it
+class CopiedBody : public HttpBody, public ByteSink {
+public:
+  static const size_t CAPACITY = 768;
+
+  CopiedBody() : len_(0), sent_(0) {}
+  bool write(const char* data, size_t len) override;
+  size_t length() const override { return len_; }
+  size_t fill(uint8_t* out, size_t room) override;
+
+private:
+  char body_[CAPACITY];
+  size_t len_;
+  size_t sent_;
+};
+
+// What a handler answers: status, content type, a few headers and the
+// body. Header values are copied; names and the type must be literals.
+class HttpResponse {
+public:
+  static const size_t MAX_HEADERS = 6;
+  static const size_t MAX_VALUE = 96;
+
+  HttpResponse() : code_(500), type_("text/plain"), headers_(0) {}
+
+  void send(int code, const char* type, std::unique_ptr<HttpBody> body) {
+    code_ = code;
+    type_ = type;
+    body_ = std::move(body);
+  }
+  // text is copied
+  void send(int code, const char* type, const char* text);
+  // No body (304)
+  void send(int code) { send(code, "text/plain", std::unique_ptr<HttpBody>()); }
+  // false if all MAX_HEADERS are taken; a longer value is cut short
+  bool addHeader(const char* name, const char* value);
+
+  int code() const { return code_; }
+  const char* type() const { return type_; }
+  HttpBody* body() const { return body_.get(); }
+  std::unique_ptr<HttpBody> takeBody() { return std::move(body_); }
+  size_t headerCount() const { return headers_; }
+  const char* headerName(size_t i) const { return names_[i]; }
+  const char* headerValue(size_t i) const { return values_[i]; }
+
+private:
+  int code_;
+  const char* type_;
+  std::unique_ptr<HttpBody> body_;
+  size_t headers_;
+  const char* names_[MAX_HEADERS];
+  char values_[MAX_HEADERS][MAX_VALUE];
+};
+
+#endif
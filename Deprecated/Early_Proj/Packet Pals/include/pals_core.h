@@ -0,0 +1,88 @@
+// pals_core.h
+#ifndef PALS_CORE_H
+#define PALS_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pal_hal.h"
+#include "pal_http.h"
+#include "ble_frame.h"
+#include "save_format.h"
+
+// The Packet Pals game without the board: seen-set, wild roster, sessions,
+// saves, scan processing and every web handler, on whatever PalHal it is
+// given. src/main.cpp runs it on the ESP32 (WiFi, SPIFFS, AsyncWebServer,
+// BLE); src/native_main.cpp on a Linux host from a recorded scan trace.
+//
+// Handlers may run on another task than palsLoop(); the core takes
+// hal.lock around the game state itself.
+
+// Reads a save from before the binary format into g: the JSON payload of
+// an old save slot (slot, len), or the old /player.json + /userparty.json
+// (slot empty). False if there is nothing to read. Those only exist on
+// boards that ran older firmware.
+typedef bool (*LegacySaveReader)(const uint8_t* slot, size_t len, SaveGame &g);
+
+// Mounts the state store and loads the seen-set, the saves and the roster
+void palsBegin(const PalHal &hal, LegacySaveReader legacy = nullptr);
+// Background work: scan results, seen-set merge, flash housekeeping,
+// saves. Call from loop(); each step holds the lock only for itself.
+void palsLoop();
+
+// CONTINUOUS_SCAN: sweeps come from palsSweep() on a task of their own
+// instead of /scan
+bool palsContinuousScan();
+// One blocking sweep, queued for palsLoop()
+void palsSweep();
+
+struct PalsRoute {
+  const char* path;   // also matches the paths below it
+  void (*handler)(const HttpRequest &request, HttpResponse &response);
+};
+// GET routes, in the order to register them (a longer path before the
+// path it starts with)
+extern const PalsRoute PALS_ROUTES[];
+extern const size_t PALS_ROUTE_COUNT;
+// Any request no route takes, any method: index.html, app.js and the
+// rest of data/
+void palsServeStatic(const HttpRequest &request, HttpResponse &response);
+// Request headers palsServeStatic() reads, for servers that only keep
+// the headers asked for
+extern const char* const PALS_STATIC_HEADERS[];
+extern const size_t PALS_STATIC_HEADER_COUNT;
+
+// What the companion app has asked for over BLE since the last call
+struct BleRequests {
+  bool connected;
+  bool resync;
+  uint16_t mtu;
+  uint64_t follow;   // 0: the most recent session
+};
+// One step of keeping the app in sync over BLE; call from loop()
+void palsServiceCompanion(BleBatcher &ble, const BleRequests &req);
+
+// Boot timing, one log line per phase as it ends
+void palsBootPhase(const char* name);
+void palsBootTotal();
+
+struct PalsStats {
+  size_t seen;           // BSSIDs in the seen-set
+  size_t wild;           // monsters in the roster
+  size_t sessions;
+  uint32_t scanJob;      // id of the latest sweep
+  uint32_t newMonsters;  // found by that sweep
+  bool scanning;         // a sweep is still being processed
+  uint32_t seenLookups;
+  uint32_t bloomRejects;
+  uint32_t segmentReads;
+  uint32_t merges;
+  size_t seenSegments;
+  uint32_t mergesNoRoom; // seen-set merges cut short or put off, flash full
+  uint32_t journalDrops; // seen BSSIDs not journaled for want of flash
+  uint32_t saveWrites;
+  uint32_t wigleAppends;
+  uint32_t wigleDrops;   // Wigle rows lost with the buffer full and flash too
+};
+PalsStats palsStats();
+
+#endif
@@ -0,0 +1,64 @@
+// pull_sink.h
+#ifndef PULL_SINK_H
+#define PULL_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "json_stream.h"
+
+// ByteSink for pull-style responses: the server hands over a window to fill
+// (the free TCP send space) and the body is produced a piece at a time
+// until the window is full. Whatever the last piece writes past the end of
+// the window is kept in a small spill buffer and goes out first next time.
+//
+//   sink.begin(out, room);
+//   while(!sink.full() && more) produceOnePiece();   // writes into sink
+//   return sink.filled();
+//
+// The spill buffer must hold the largest single piece.
+class PullSink : public ByteSink {
+public:
+  PullSink(char* spill, size_t spillSize);
+
+  // Starts a fill of out[0, room); spilled bytes are copied in first
+  void begin(uint8_t* out, size_t room);
+  bool write(const char* data, size_t len) override;
+
+  bool full() const { return used_ == room_; }
+  size_t filled() const { return used_; }
+  size_t pending() const { return spillLen_; }
+  // false once a piece did not fit the spill buffer (output is truncated)
+  bool ok() const { return ok_; }
+
+private:
+  char*    spill_;
+  size_t   spillCap_;
+  size_t   spillLen_;
+  uint8_t* out_;
+  size_t   room_;
+  size_t   used_;
+  bool     ok_;
+};
+
+// ByteSink that keeps bytes [skip, skip + room) of everything written to
+// it and drops the rest, for bodies rendered again on every window instead
+// of being buffered. total() counts all of it, so a pass with room 0 gives
+// the body length.
+class WindowSink : public ByteSink {
+public:
+  WindowSink(uint8_t* out, size_t room, size_t skip)
+    : out_(out), room_(room), skip_(skip), total_(0), used_(0) {}
+  bool write(const char* data, size_t len) override;
+
+  size_t filled() const { return used_; }
+  size_t total() const { return total_; }
+
+private:
+  uint8_t* out_;
+  size_t   room_;
+  size_t   skip_;
+  size_t   total_;
+  size_t   used_;
+};
+
+#endif
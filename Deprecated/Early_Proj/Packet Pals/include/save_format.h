@@ -0,0 +1,52 @@
+// save_format.h
+#ifndef SAVE_FORMAT_H
+#define SAVE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "pal_fs.h"
+
+// Fixed-layout binary save of the player and party, the payload SaveStore
+// puts in its CRC-checked slots. All fields little-endian, names
+// NUL-padded; a version 1 save is always SAVE_GAME_BYTES long.
+//
+//   0  u16 version        2  u16 reserved
+//   4  char[24] player name
+//  28  u16 player level  30  u8 hasStarter  31  u8 party size
+//  32  3 x { char[16] name, u16 level, i16 hp, i16 defense, u16 reserved }
+struct SavedMonster {
+  char     name[16];
+  uint16_t level;
+  int16_t  hp;
+  int16_t  defense;
+};
+
+struct SaveGame {
+  static const int PARTY_MAX = 3;
+
+  char     playerName[24];
+  uint16_t playerLevel;
+  bool     hasStarter;
+  uint8_t  partySize;
+  SavedMonster party[PARTY_MAX];
+};
+
+static const uint16_t SAVE_FORMAT_VERSION = 1;
+static const size_t SAVE_GAME_BYTES = 32 + SaveGame::PARTY_MAX * 24;
+
+// Returns SAVE_GAME_BYTES, or 0 if cap is too small
+size_t encodeSaveGame(const SaveGame &g, uint8_t* buf, size_t cap);
+// False for unknown versions or short buffers. Older versions are upgraded
+// here as the format moves on.
+bool decodeSaveGame(const uint8_t* buf, size_t len, SaveGame &g);
+
+// Copies a string into a fixed NUL-padded field, truncating if needed
+void copyName(char* dst, size_t dstSize, const char* src);
+
+// Streams every "xx:xx:xx:xx:xx:xx" string out of a JSON file (the old
+// /bssids.json) without building a document, so any file size imports.
+// Returns the number of MACs found.
+size_t forEachJsonMac(PalFile &f, const std::function<void(uint64_t)> &fn);
+
+#endif
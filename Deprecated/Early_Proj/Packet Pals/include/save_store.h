@@ -0,0 +1,69 @@
+// save_store.h
+#ifndef SAVE_STORE_H
+#define SAVE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "pal_fs.h"
+
+// Write-behind storage for the game save (player + party).
+//
+// Handlers call markDirty() and return; service() writes one snapshot once
+// the state has been dirty for delayMs, however many changes came in
+// meanwhile. sync() writes right away (boot, before a risky operation).
+//
+// Snapshots alternate between two slot files, each with a header carrying
+// a sequence number and a CRC32 of the payload. A power cut mid-write can
+// only tear the slot being written; load() then falls back to the other
+// one, so at most the last delay window is lost.
+class SaveStore {
+public:
+  // Fills buf with the current state; returns bytes used, 0 on failure
+  typedef std::function<size_t(uint8_t* buf, size_t cap)> Encoder;
+
+  static const uint32_t MAGIC = 0x56415350;   // "PSAV"
+  static const size_t HEADER_SIZE = 16;       // magic, seq, len, crc
+
+  SaveStore(PalFs &fs, const char* slotA, const char* slotB,
+            size_t maxPayload = 1024);
+  ~SaveStore();
+  SaveStore(const SaveStore&) = delete;
+  SaveStore& operator=(const SaveStore&) = delete;
+
+  void setEncoder(Encoder e) { encoder_ = e; }
+  void setDelay(uint32_t ms) { delayMs_ = ms; }
+
+  // Newest valid snapshot; returns its length, 0 if neither slot is valid.
+  // Also decides which slot the next write goes to.
+  size_t load(uint8_t* buf, size_t cap);
+
+  void markDirty(uint32_t nowMs);
+  bool dirty() const { return dirty_; }
+  // Writes if the state has been dirty for delayMs; call from loop()
+  void service(uint32_t nowMs);
+  // Writes now if dirty
+  bool sync();
+
+  uint32_t writes() const { return writes_; }
+  uint32_t marks() const { return marks_; }
+  uint32_t failures() const { return failures_; }
+
+private:
+  bool readSlot(const char* path, uint32_t &seq, uint8_t* buf, size_t cap, size_t &len);
+  bool writeSlot(const uint8_t* payload, size_t len);
+
+  PalFs &fs_;
+  const char* slots_[2];
+  uint8_t* buf_;
+  size_t cap_;
+  Encoder encoder_;
+  uint32_t delayMs_;
+  uint32_t seq_;        // sequence of the newest snapshot on flash
+  int      next_;       // slot the next snapshot goes to
+  bool     dirty_;
+  uint32_t dirtySinceMs_;
+  uint32_t writes_, marks_, failures_;
+};
+
+#endif
@@ -0,0 +1,31 @@
+// scan_record.h
+#ifndef SCAN_RECORD_H
+#define SCAN_RECORD_H
+
+#include <stdint.h>
+
+// ScanRecord::auth, numbered as the ESP32's wifi_auth_mode_t
+enum ScanAuth {
+  SCAN_AUTH_OPEN = 0,
+  SCAN_AUTH_WEP,
+  SCAN_AUTH_WPA_PSK,
+  SCAN_AUTH_WPA2_PSK,
+  SCAN_AUTH_WPA_WPA2_PSK,
+  SCAN_AUTH_WPA2_ENTERPRISE
+};
+
+// One access point from a sweep, small enough to copy through a queue.
+struct ScanRecord {
+  enum {
+    END_OF_SWEEP = 0x01  // marker after the last AP of a sweep (no AP data)
+  };
+  uint8_t bssid[6];
+  int8_t  rssi;
+  uint8_t channel;
+  uint8_t auth;       // ScanAuth
+  uint8_t flags;
+  uint8_t ssidLen;
+  char    ssid[33];   // NUL-terminated, 802.11 SSIDs are at most 32 bytes
+};
+
+#endif
@@ -0,0 +1,100 @@
+// scan_trace.h
+#ifndef SCAN_TRACE_H
+#define SCAN_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "pal_fs.h"
+#include "pal_hal.h"
+#include "scan_record.h"
+
+// Recorded WiFi sweeps, so the game can be run on a workstation against
+// what a board actually heard. Text, one line per access point:
+//
+//   # anything after '#' is a comment
+//   @12000                                   a sweep, ms since boot
+//   A4:2B:B0:11:22:33 -67 6 3 Cafe\x20Wifi   bssid rssi channel auth ssid
+//
+// auth is the ScanAuth number. Bytes outside printable ASCII, spaces, '#'
+// and backslashes in the SSID are written \xNN, so any SSID survives a
+// round trip.
+
+struct ScanSweep {
+  uint32_t ms;
+  std::vector<ScanRecord> aps;
+};
+
+class ScanTrace {
+public:
+  // Appends the sweeps in path; false if it cannot be read or a line is
+  // malformed (the sweeps before it are kept)
+  bool load(PalFs &fs, const char* path);
+  bool save(PalFs &fs, const char* path) const;
+  // One sweep line plus its records, as save() writes them
+  static bool writeSweep(PalFile &f, const ScanSweep &s);
+
+  // A walk past `sweeps` sweeps, periodMs apart, through a neighbourhood
+  // of about `aps` access points: each sweep hears the ones around the
+  // current position (and so mostly ones it heard before), now and then a
+  // distant one, with RSSI jitter. Same seed, same trace.
+  static ScanTrace synthetic(uint64_t seed, size_t sweeps, size_t aps, uint32_t periodMs = 5000);
+
+  const std::vector<ScanSweep>& sweeps() const { return sweeps_; }
+  std::vector<ScanSweep>& sweeps() { return sweeps_; }
+  size_t records() const;
+
+private:
+  std::vector<ScanSweep> sweeps_;
+};
+
+// PalRadio that hands out the trace's sweeps in order, one per sweep();
+// an async sweep is done on the next sweepDone(). Past the last sweep
+// every sweep finds nothing.
+class TraceRadio : public PalRadio {
+public:
+  explicit TraceRadio(const ScanTrace &trace) : trace_(trace), next_(0), current_(nullptr) {}
+
+  int sweep(bool async) override;
+  int sweepDone() override;
+  void result(int i, ScanRecord &rec) override;
+  void release() override { current_ = nullptr; }
+
+  // Time stamp of the sweep the next sweep() returns, for the clock
+  bool nextMs(uint32_t &ms) const;
+  size_t remaining() const { return trace_.sweeps().size() - next_; }
+
+private:
+  const ScanTrace &trace_;
+  size_t next_;
+  const ScanSweep* current_;
+};
+
+// Passes another radio through and appends every sweep it returns to a
+// trace file, with the clock's time: what builds a trace on the board.
+class RecordingRadio : public PalRadio {
+public:
+  RecordingRadio(PalRadio &radio, PalClock &clock, PalFs &fs, const char* path)
+    : radio_(radio), clock_(clock), fs_(fs), path_(path), pending_(false), recorded_(0) {}
+
+  int sweep(bool async) override;
+  int sweepDone() override;
+  void result(int i, ScanRecord &rec) override { radio_.result(i, rec); }
+  void release() override { radio_.release(); }
+
+  uint32_t sweepsRecorded() const { return recorded_; }
+
+private:
+  // Copies the finished sweep's n results to the file
+  void record(int n);
+
+  PalRadio &radio_;
+  PalClock &clock_;
+  PalFs &fs_;
+  const char* path_;
+  bool pending_;
+  uint32_t recorded_;
+};
+
+#endif
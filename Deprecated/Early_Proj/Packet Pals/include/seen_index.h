@@ -0,0 +1,187 @@
+// seen_index.h
+#ifndef SEEN_INDEX_H
+#define SEEN_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "pal_fs.h"
+#include "mac_set.h"
+#include "bloom_filter.h"
+#include "bssid_journal.h"
+
+class BootImageWriter;
+class BootImageReader;
+
+// Tiered set of every BSSID ever seen, with bounded RAM.
+//
+//   RAM:   Bloom filter over all keys, a small MacSet "memtable" of recent
+//          inserts (backed by the BssidJournal so nothing is lost on a
+//          power cut) and one fence key per segment block.
+//   Flash: up to MAX_SEGMENTS immutable sorted segments of 6-byte MACs,
+//          each followed by a footer (magic, version, record count, CRC32
+//          of the records, merge sequence number). Segment files are the
+//          segment path itself and then "<path>.1" ... "<path>.6"; the
+//          sequence number, not the slot or the size, gives their age.
+//          Segments from before it (version 1 footer, or none) count as
+//          older than any that have one, largest first.
+//
+// When the memtable fills it is frozen (sorted in RAM) and written out as
+// a new segment, merged with the newest segments as long as each is no
+// bigger than what has been gathered so far, like carries in a binary
+// counter: a key is rewritten about log2(N / memtable) times over its
+// life, not once per merge, and a merge only needs free flash for the
+// segments it takes in. A merge runs a few hundred records per service()
+// call, into a free slot, and its inputs are removed only after the
+// rename, so a reboot at any point loses nothing.
+//
+// A merge that free flash can't hold (PalFs::freeBytes()) takes fewer
+// segments, or is put off with its keys kept frozen in RAM and journaled;
+// stats().mergesNoRoom counts both.
+//
+// The Bloom filter is sized at BLOOM_BITS_PER_KEY bits per key for twice
+// the keys there are, and rebuilt with a pass over the segments when they
+// outgrow that, up to the bloomMaxBits given to the constructor. Past the
+// cap it is rebuilt with fewer hashes instead, but false positives climb
+// (bench_seen_index, 32 KB: 0.2% to 20 K keys, 4% at 40 K, 20% at 80 K)
+// and each costs a block read per segment the MAC falls inside.
+//
+// Flash bounds the set too: 6 bytes per key plus room for the largest
+// merge's output. On the 1.25 MB "pals" partition merges start running
+// short of room at about 130 K BSSIDs; millions would need a bigger
+// partition.
+class SeenIndex {
+public:
+  static const size_t BLOCK_RECORDS = 512;   // 3 KB per segment block
+  static const size_t MAX_SEGMENTS = 5;
+  static const size_t SEGMENT_SLOTS = MAX_SEGMENTS + 2;   // merge output, reboot mid-merge
+  static const size_t MERGE_BUF_RECORDS = 128;            // per merge input
+  static const size_t BLOOM_BITS_PER_KEY = 10;            // ~1% false positives
+  static const uint32_t SEGMENT_MAGIC = 0x47455350;   // "PSEG"
+  static const uint16_t SEGMENT_VERSION = 2;
+  static const size_t FOOTER_SIZE = 20;
+  static const size_t FOOTER_V1_SIZE = 16;   // no sequence number
+
+  struct Stats {
+    uint32_t lookups;
+    uint32_t bloomRejects;
+    uint32_t flashReads;
+    uint32_t merges;
+    uint32_t badSegments;   // footer or CRC check failed at begin()
+    uint32_t journalDrops;  // inserts not journaled (flash full); kept in RAM
+    uint32_t mergesNoRoom;  // merges cut short or put off for want of flash
+    uint32_t bloomRebuilds;
+  };
+
+  // bloomMaxBits: RAM cap for the Bloom filter
+  // memtableCap: recent inserts kept in RAM before a merge is started
+  SeenIndex(PalFs &fs, const char* segmentPath, const char* journalPath,
+            size_t bloomMaxBits = 256 * 1024, size_t memtableCap = 1024);
+
+  // Builds Bloom/fence index from the segments, replays the journal.
+  // Returns false if a segment failed its CRC check; its records are
+  // still used (a damaged MAC only means one network counts as new again).
+  bool begin();
+  // Fast boot: takes Bloom bits and fences from a boot image instead of
+  // reading every segment. False if the image does not match the segments
+  // on flash; the caller then runs begin().
+  bool beginFromImage(BootImageReader &r);
+  // Adds this index's sections to an image (false while merging). The
+  // sections point into the index; commit the writer before the next
+  // insert.
+  bool addToImage(BootImageWriter &w);
+
+  bool contains(uint64_t mac);
+  // Adds a MAC the caller has just checked with contains()
+  bool insert(uint64_t mac);
+  // Flushes journaled inserts; call once per scan
+  bool sync();
+  // Advances a pending merge by up to `budget` records; call from loop()
+  void service(size_t budget = 256);
+  bool merging() const { return merger_.active; }
+  // Calls fn for every key: the segments oldest first (each in MAC order),
+  // then the keys not yet merged, so the most recent finds come last
+  void forEach(const std::function<void(uint64_t)> &fn);
+  // Only the keys not in a segment yet
+  void forEachRecent(const std::function<void(uint64_t)> &fn);
+
+  size_t size() const { return segmentRecords() + frozen_.size() + memtable_.size(); }
+  size_t segments() const { return segs_.size(); }
+  size_t segmentRecords() const;
+  size_t memoryBytes() const;
+  size_t bloomBytes() const { return bloom_.memoryBytes(); }
+  int bloomHashes() const { return bloom_.hashes(); }
+  // Expected share of unseen MACs the Bloom filter lets through
+  double bloomFalsePositive() const;
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Segment {
+    uint8_t slot;
+    bool footer;
+    size_t records;
+    uint32_t crc;
+    uint32_t seq;                  // 0: older footer or none
+    uint64_t last;                 // highest key
+    std::vector<uint64_t> fence;   // first key of each block
+    std::unique_ptr<PalFile> reader;
+  };
+  // A merge input reads through its segment's reader, seeking each refill,
+  // so lookups can share it and no extra files are held open
+  struct Input {
+    size_t seg;
+    size_t next;           // next record to read from the file
+    size_t pos, len;       // within buf
+    uint8_t buf[MERGE_BUF_RECORDS * BssidJournal::RECORD_SIZE];
+  };
+  struct Merger {
+    bool active;
+    size_t first;          // segs_[first..] are being merged in
+    uint8_t slot;          // where the output goes
+    std::vector<std::unique_ptr<Input> > inputs;
+    size_t frozenPos;
+    std::unique_ptr<PalFile> out;
+    size_t written;
+    uint64_t last;
+    std::vector<uint64_t> fence;
+    uint8_t outBuf[BLOCK_RECORDS * BssidJournal::RECORD_SIZE];
+    size_t outLen;
+    uint32_t crc;
+  };
+
+  void reset();
+  void slotPath(size_t slot, char* out) const;
+  void loadSegments();
+  bool scanSegment(Segment &s, bool index);
+  void replayJournal();
+  void sizeBloom(size_t keys);
+  void rebuildBloom();
+  bool segmentContains(Segment &s, uint64_t mac);
+  size_t readFooter(PalFile &f, uint32_t &crc, uint32_t &seq, bool &hasFooter);
+  bool startMerge();
+  bool emit(uint64_t mac);
+  void abandonMerge();
+  bool finishMerge();
+  bool rewriteJournal();
+
+  PalFs &fs_;
+  const char* segPath_;
+  char tmpPath_[32];
+  BssidJournal journal_;
+  BloomFilter bloom_;
+  size_t bloomMaxBits_;
+  size_t bloomKeys_;               // key count the filter was sized for
+  MacSet memtable_;
+  size_t memtableCap_;
+  std::vector<uint64_t> frozen_;   // sorted, being merged (or waiting for room)
+  std::vector<Segment> segs_;      // oldest first
+  uint32_t nextSeq_;               // for the next merge's output
+  std::vector<uint32_t> imageMeta_;
+  std::vector<uint64_t> imageFence_;
+  uint8_t blockBuf_[BLOCK_RECORDS * BssidJournal::RECORD_SIZE];
+  Merger merger_;
+  Stats stats_;
+};
+
+#endif
@@ -0,0 +1,189 @@
+// session_table.h
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include "battle.h"
+#include "save_format.h"
+
+// One client's game: who it is (a random 64-bit token the client sends
+// back as a cookie), its player and party, and its battle. Fixed size, no
+// String, no heap.
+struct Session {
+  uint64_t token;          // 0: free slot
+  uint32_t lastUse;        // table clock at the last request
+  uint32_t lastMs;         // caller's millis() at the last request; not saved
+  uint32_t partyVersion;   // see partyChanged() in pals_core.cpp
+  SaveGame game;
+  BattleState battle;
+};
+
+// Snapshot of every session, the payload SaveStore keeps (little-endian):
+//
+//   0  u16 SESSION_SAVE_VERSION   2  u16 count
+//   4  count x { u64 token, SAVE_GAME_BYTES save_format.h game }
+//
+// least recently used first. Battles are not saved. The version is not
+// SAVE_FORMAT_VERSION, so a single-player save still decodes as a SaveGame.
+static const uint16_t SESSION_SAVE_VERSION = 0x5301;
+static const size_t SESSION_RECORD_BYTES = 8 + SAVE_GAME_BYTES;
+#define SESSION_SAVE_BYTES(n) (4 + (n) * SESSION_RECORD_BYTES)
+
+// Returns bytes used, 0 if cap is too small
+size_t encodeSessions(const Session* const* sessions, size_t n, uint8_t* buf, size_t cap);
+// False unless buf holds a session snapshot; fn gets each record in order
+bool decodeSessions(const uint8_t* buf, size_t len,
+                    const std::function<void(uint64_t token, const SaveGame &g)> &fn);
+
+// Tokens travel as 16 lowercase hex digits; out needs 17 bytes
+void formatToken(uint64_t token, char* out);
+// Exactly 16 hex digits, not 0
+bool parseToken(const char* s, size_t len, uint64_t &token);
+// The token in "name=<hex>" of a Cookie header
+bool cookieToken(const char* cookies, const char* name, uint64_t &token);
+
+// Fixed table of N sessions. A request finds its session by token; a new
+// client gets a free slot or, when all N are taken, the least recently
+// used session's slot (that game is dropped). Recency is a request
+// counter, not a clock, so it survives millis() wrapping and a reboot
+// (save() writes sessions oldest first and load() replays that order).
+// tryOpen() only drops a game whose lastMs is old enough; lastMs is 0
+// after load(), so a game restored at boot counts as idle since then.
+//
+// The game from before sessions existed is kept under ORPHAN until the
+// first new client claims it.
+template<size_t N>
+class SessionTable {
+  static_assert(N > 0 && N <= 255, "SessionTable capacity out of range");
+public:
+  static const uint64_t ORPHAN = 1;
+
+  SessionTable() : clock_(0), evictions_(0) { clear(); }
+
+  void clear() {
+    memset(slots_, 0, sizeof(slots_));
+    clock_ = 0;
+  }
+
+  // The session with token, marked as just used; nullptr if there is none
+  Session* find(uint64_t token) {
+    if(token == 0) return nullptr;
+    for(Session &s : slots_) {
+      if(s.token == token) {
+        s.lastUse = ++clock_;
+        return &s;
+      }
+    }
+    return nullptr;
+  }
+
+  // Like find() but leaves the recency alone (a watcher, not the player)
+  const Session* peek(uint64_t token) const {
+    if(token == 0) return nullptr;
+    for(const Session &s : slots_) {
+      if(s.token == token) return &s;
+    }
+    return nullptr;
+  }
+  Session* peek(uint64_t token) {
+    return const_cast<Session*>(static_cast<const SessionTable*>(this)->peek(token));
+  }
+
+  // The session that made the last request; nullptr if the table is empty
+  const Session* mostRecent() const {
+    const Session* best = nullptr;
+    for(const Session &s : slots_) {
+      if(s.token != 0 && (!best || s.lastUse > best->lastUse)) best = &s;
+    }
+    return best;
+  }
+
+  // A cleared session for token. *evicted tells whether a live session
+  // had to make room.
+  Session& open(uint64_t token, bool* evicted = nullptr) {
+    Session* slot = victim();
+    bool full = slot->token != 0;
+    if(full) evictions_++;
+    if(evicted) *evicted = full;
+    memset(slot, 0, sizeof(*slot));
+    slot->token = token;
+    slot->lastUse = ++clock_;
+    return *slot;
+  }
+
+  // Like open(), but a live session only makes room once it has been idle
+  // for minIdleMs; nullptr (nothing dropped) while all N are more recent
+  Session* tryOpen(uint64_t token, uint32_t nowMs, uint32_t minIdleMs, bool* evicted = nullptr) {
+    const Session* slot = victim();
+    if(slot->token != 0 && nowMs - slot->lastMs < minIdleMs) return nullptr;
+    Session &s = open(token, evicted);
+    s.lastMs = nowMs;
+    return &s;
+  }
+
+  // Re-keys the ORPHAN session to token; nullptr if there is none
+  Session* claimOrphan(uint64_t token) {
+    Session* s = find(ORPHAN);
+    if(s) s->token = token;
+    return s;
+  }
+
+  size_t size() const {
+    size_t n = 0;
+    for(const Session &s : slots_) n += s.token != 0;
+    return n;
+  }
+
+  static size_t capacity() { return N; }
+  uint32_t evictions() const { return evictions_; }
+
+  template<class F>
+  void forEach(F fn) {
+    for(Session &s : slots_) {
+      if(s.token != 0) fn(s);
+    }
+  }
+
+  size_t save(uint8_t* buf, size_t cap) const {
+    const Session* order[N];
+    size_t n = 0;
+    for(const Session &s : slots_) {
+      if(s.token == 0) continue;
+      size_t i = n++;
+      for(; i > 0 && order[i - 1]->lastUse > s.lastUse; i--) order[i] = order[i - 1];
+      order[i] = &s;
+    }
+    return encodeSessions(order, n, buf, cap);
+  }
+
+  // Replaces the table with a snapshot; false (table untouched) if buf is
+  // not one. Records beyond N evict the oldest, as open() would.
+  bool load(const uint8_t* buf, size_t len) {
+    if(!decodeSessions(buf, len, [](uint64_t, const SaveGame &) {})) return false;
+    clear();
+    decodeSessions(buf, len, [this](uint64_t token, const SaveGame &g) {
+      open(token).game = g;
+    });
+    return true;
+  }
+
+private:
+  // A free slot, else the least recently used session
+  Session* victim() {
+    Session* slot = nullptr;
+    for(Session &s : slots_) {
+      if(s.token == 0) return &s;
+      if(!slot || s.lastUse < slot->lastUse) slot = &s;
+    }
+    return slot;
+  }
+
+  Session slots_[N];
+  uint32_t clock_;
+  uint32_t evictions_;
+};
+
+#endif
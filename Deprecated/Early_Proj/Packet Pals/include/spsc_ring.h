@@ -0,0 +1,54 @@
+// spsc_ring.h
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring of N slots (N a power of
+// two). One task may push() and one other task may pop(); neither ever
+// blocks. A push into a full ring is dropped and counted, so a slow
+// consumer costs data, never a stalled producer.
+template<typename T, size_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+public:
+  SpscRing() : head_(0), tail_(0), drops_(0) {}
+
+  // Producer side
+  bool push(const T &item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if(head - tail_.load(std::memory_order_acquire) == N){
+      drops_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    slots_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T &item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if(tail == head_.load(std::memory_order_acquire)) return false;
+    item = slots_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+  uint32_t drops() const { return drops_.load(std::memory_order_relaxed); }
+  static size_t capacity() { return N; }
+
+private:
+  // head_ and tail_ are written by different cores; keep them apart
+  alignas(32) std::atomic<size_t> head_;
+  alignas(32) std::atomic<size_t> tail_;
+  std::atomic<uint32_t> drops_;
+  T slots_[N];
+};
+
+#endif
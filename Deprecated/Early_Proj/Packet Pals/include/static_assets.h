@@ -0,0 +1,63 @@
+// static_assets.h
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "pal_fs.h"
+
+// One file from data/, as described by the build-time manifest
+// (scripts/prepare_assets.py writes /assets.txt next to the files)
+struct StaticAsset {
+  static const size_t MAX_PATH = 48;
+
+  char     path[MAX_PATH];
+  uint32_t size;
+  uint32_t gzSize;     // 0: no "<path>.gz" variant
+  uint32_t crc;        // CRC32 of the uncompressed file
+  const char* mime;
+  const char* cacheControl;
+
+  // Strong ETag; the gzip variant is a different representation so it
+  // gets its own tag. out needs 16 bytes.
+  void etag(bool gz, char* out) const;
+};
+
+// In-RAM index of the static files, so a request needs no SPIFFS.exists()
+// and the headers (length, ETag) are known before the file is opened
+class AssetTable {
+public:
+  static const char* MANIFEST;
+
+  // false if the manifest is missing or unreadable (table stays empty)
+  bool load(PalFs &fs, const char* manifest = MANIFEST);
+  const StaticAsset* find(const char* path) const;
+  size_t count() const { return assets_.size(); }
+
+private:
+  bool parseLine(const char* line);
+
+  std::vector<StaticAsset> assets_;
+};
+
+const char* mimeForPath(const char* path);
+const char* cacheControlForPath(const char* path);
+
+// True if an If-None-Match header lists etag (or is "*")
+bool etagMatches(const char* ifNoneMatch, const char* etag);
+// True if an Accept-Encoding header allows gzip
+bool acceptsGzip(const char* acceptEncoding);
+
+enum RangeResult {
+  RANGE_NONE,           // no header, or one we do not handle: send 200
+  RANGE_OK,             // send 206 for [first, last]
+  RANGE_UNSATISFIABLE   // send 416
+};
+
+// Single "bytes=" range against a file of size bytes. Multi-range requests
+// are answered with the whole file, which RFC 9110 allows.
+RangeResult parseByteRange(const char* header, uint32_t size,
+                           uint32_t &first, uint32_t &last);
+
+#endif
@@ -0,0 +1,62 @@
+// sync_feed.h
+#ifndef SYNC_FEED_H
+#define SYNC_FEED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "api_schema.h"
+#include "change_log.h"
+
+// The /sync?since= response: what changed after sequence number since, up
+// to the log's newest change when the feed was made, coalesced so each
+// monster, BSSID and the party appear once, with their current values:
+//
+//   {"epoch":"1a2b3c4d","since":120,
+//    "wild":[WildEntry...],"gone":[ids...],"seen":["aa:bb:cc:dd:ee:ff"...],
+//    "party":Party,"player":SyncPlayer,        (only if they changed)
+//    "seq":180,"full":false}
+//
+// The client passes seq back as its next since. "full":true means the
+// changes are no longer all in the log (or were overwritten while the
+// response went out; ignore what came before it), the device rebooted
+// (epoch differs), or the caller's wild levels moved to another bucket:
+// pull /monsters and /myParty, then sync from seq.
+// A monster added and evicted in the range is only listed in "gone".
+//
+// Written a piece at a time, like MonsterPager: step() writes at most one
+// entry, so a fill stops as soon as the send window is full.
+class SyncFeed {
+public:
+  struct Hooks {
+    std::function<bool(uint32_t id, WildEntry &e)> wild;   // false: no longer in the roster
+    std::function<bool(Party &p)> party;                   // false: caller has no session
+    std::function<bool(SyncPlayer &p)> player;
+  };
+
+  // scope: sessionScope() of the caller, 0 if it has none. resync forces
+  // "full" (epoch mismatch). The log must stay locked while the feed runs
+  // a step.
+  SyncFeed(const ChangeLog &log, uint32_t epoch, uint32_t since, uint64_t scope,
+           bool resync, const Hooks &hooks);
+
+  // Writes the next piece; false once the response is complete
+  bool step(JsonStream &js);
+
+  uint32_t upto() const { return upto_; }
+  bool full() const { return full_; }
+
+private:
+  enum Phase { HEAD, WILD, GONE, SEEN, PARTY, TAIL, DONE };
+  bool next(uint8_t kind, Change &c);
+  void beginList(JsonStream &js, const char* name, Phase phase);
+
+  const ChangeLog &log_;
+  Hooks hooks_;
+  uint32_t epoch_, since_, upto_, cursor_;
+  uint64_t scope_;
+  Phase phase_;
+  bool full_, party_, player_;
+};
+
+#endif
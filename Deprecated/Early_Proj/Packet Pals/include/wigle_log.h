@@ -0,0 +1,62 @@
+// wigle_log.h
+#ifndef WIGLE_LOG_H
+#define WIGLE_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pal_fs.h"
+
+// Buffered writer for the Wigle CSV. Rows are encoded straight into a fixed
+// RAM buffer (no String temporaries) and appended to flash in one
+// open/write/close, instead of one per network.
+class WigleLog {
+public:
+  // How long a row may sit in RAM before it must reach flash
+  enum Durability {
+    FLUSH_EACH_ROW,  // old behaviour: every row hits flash immediately
+    FLUSH_PER_SCAN,  // one append per endScan() (or when the buffer fills)
+    FLUSH_ON_TIMER   // append when the oldest buffered row is maxAgeMs old
+  };
+
+  static const char* HEADER;
+
+  WigleLog(PalFs &fs, const char* path, size_t bufferBytes = 4096);
+  ~WigleLog();
+
+  void setDurability(Durability d, uint32_t maxAgeMs = 10000);
+
+  // False if the row could not be kept: the buffer is full and flash
+  // takes none of it (counted in droppedRows())
+  bool addRow(const char* bssid, const char* ssid, const char* auth,
+              int channel, int rssi, uint32_t nowMs);
+  // End of a scan batch
+  bool endScan();
+  // Timer flush; call from loop()
+  void service(uint32_t nowMs);
+  // A short write keeps only the bytes flash didn't take; a row cut in
+  // two is finished by the next append
+  bool flush();
+  // Drops buffered rows (file is being deleted)
+  void discard() { used_ = 0; }
+
+  size_t buffered() const { return used_; }
+  uint32_t flashAppends() const { return flashAppends_; }
+  uint32_t droppedRows() const { return droppedRows_; }
+
+private:
+  size_t encodeRow(char* out, size_t room, const char* bssid, const char* ssid,
+                   const char* auth, int channel, int rssi);
+
+  PalFs &fs_;
+  const char* path_;
+  char*  buf_;
+  size_t cap_;
+  size_t used_;
+  Durability durability_;
+  uint32_t maxAgeMs_;
+  uint32_t oldestMs_;
+  uint32_t flashAppends_;
+  uint32_t droppedRows_;
+};
+
+#endif
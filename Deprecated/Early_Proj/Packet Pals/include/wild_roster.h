@@ -0,0 +1,142 @@
+// wild_roster.h
+#ifndef WILD_ROSTER_H
+#define WILD_ROSTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A wild monster as the roster hands it out. The name is an index pair
+// into the prefix/suffix tables; hp and defense follow from the level.
+// bssid is the access point it came from (0 if unknown).
+struct WildMonster {
+  uint32_t id;
+  uint64_t bssid;
+  uint8_t  prefix;
+  uint8_t  suffix;
+  uint8_t  level;
+};
+
+// Fixed-capacity roster of wild monsters, stored as parallel arrays
+// (13 bytes per monster, no heap). When it is full, add() evicts one
+// monster according to the policy, so memory never grows.
+//
+// Every monster gets an id that is never reused. Slots are kept in id
+// order, so an id works as a pagination cursor (lowerBound) and as a
+// battle target that cannot silently turn into a different monster.
+template<size_t N>
+class WildRoster {
+  static_assert(N > 0 && N <= 65535, "WildRoster capacity out of range");
+public:
+  enum Eviction {
+    EVICT_OLDEST,        // drop the first monster found
+    EVICT_LOWEST_LEVEL   // drop the weakest; oldest among equals
+  };
+
+  WildRoster() : count_(0), nextId_(1), evictions_(0), lastEvicted_(0), policy_(EVICT_OLDEST) {}
+
+  void setEviction(Eviction e) { policy_ = e; }
+  Eviction eviction() const { return policy_; }
+
+  // Returns the new monster's id
+  uint32_t add(uint8_t prefix, uint8_t suffix, uint8_t level, uint64_t bssid = 0) {
+    lastEvicted_ = 0;
+    if(count_ == N) {
+      size_t v = victim();
+      lastEvicted_ = id_[v];
+      removeSlot(v);
+      evictions_++;
+    }
+    size_t s = count_++;
+    id_[s]     = nextId_++;
+    prefix_[s] = prefix;
+    suffix_[s] = suffix;
+    level_[s]  = level;
+    macLo_[s]  = (uint32_t)bssid;
+    macHi_[s]  = (uint16_t)(bssid >> 32);
+    return id_[s];
+  }
+
+  bool find(uint32_t id, WildMonster &out) const {
+    size_t s = lowerBound(id);
+    if(s == count_ || id_[s] != id) return false;
+    out = at(s);
+    return true;
+  }
+
+  bool remove(uint32_t id) {
+    size_t s = lowerBound(id);
+    if(s == count_ || id_[s] != id) return false;
+    removeSlot(s);
+    return true;
+  }
+
+  // First slot whose id is >= id (count() if none)
+  size_t lowerBound(uint32_t id) const {
+    size_t lo = 0, hi = count_;
+    while(lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if(id_[mid] < id) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  WildMonster at(size_t slot) const {
+    WildMonster m;
+    m.id     = id_[slot];
+    m.bssid  = ((uint64_t)macHi_[slot] << 32) | macLo_[slot];
+    m.prefix = prefix_[slot];
+    m.suffix = suffix_[slot];
+    m.level  = level_[slot];
+    return m;
+  }
+
+  // Ids keep counting up, so old cursors never match a new monster
+  void clear() { count_ = 0; evictions_ = 0; }
+
+  size_t size() const { return count_; }
+  static size_t capacity() { return N; }
+  uint32_t evictions() const { return evictions_; }
+  // Id of the monster the last add() evicted, 0 if there was room
+  uint32_t lastEvicted() const { return lastEvicted_; }
+  static size_t memoryBytes() {
+    return N * (2 * sizeof(uint32_t) + sizeof(uint16_t) + 3 * sizeof(uint8_t));
+  }
+
+private:
+  size_t victim() const {
+    if(policy_ == EVICT_OLDEST) return 0;
+    size_t best = 0;
+    for(size_t s = 1; s < count_; s++) {
+      if(level_[s] < level_[best]) best = s;
+    }
+    return best;
+  }
+
+  // Keeps id order; N is small, so the shift is a few hundred bytes
+  void removeSlot(size_t s) {
+    size_t tail = count_ - s - 1;
+    memmove(&id_[s],     &id_[s + 1],     tail * sizeof(id_[0]));
+    memmove(&prefix_[s], &prefix_[s + 1], tail);
+    memmove(&suffix_[s], &suffix_[s + 1], tail);
+    memmove(&level_[s],  &level_[s + 1],  tail);
+    memmove(&macLo_[s],  &macLo_[s + 1],  tail * sizeof(macLo_[0]));
+    memmove(&macHi_[s],  &macHi_[s + 1],  tail * sizeof(macHi_[0]));
+    count_--;
+  }
+
+  uint32_t id_[N];
+  uint8_t  prefix_[N];
+  uint8_t  suffix_[N];
+  uint8_t  level_[N];
+  uint32_t macLo_[N];
+  uint16_t macHi_[N];
+  size_t   count_;
+  uint32_t nextId_;
+  uint32_t evictions_;
+  uint32_t lastEvicted_;
+  Eviction policy_;
+};
+
+#endif
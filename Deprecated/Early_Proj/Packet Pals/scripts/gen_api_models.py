@@ -0,0 +1,108 @@
+# gen_api_models.py
+# Writes the WD_Companion app's Dart models for the Packet Pals web API
+# from the X-macro schemas in include/api_schema.h, so the firmware and the
+# app read one definition of every response.
+#
+#   python scripts/gen_api_models.py            # rewrite the Dart file
+#   python scripts/gen_api_models.py --check    # exit 1 if it is stale
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SCHEMA = os.path.join(HERE, "..", "include", "api_schema.h")
+OUTPUT = os.path.join(HERE, "..", "..", "..", "..", "Nonfunctional - WIP",
+                      "WD_Companion", "lib", "models", "pals_api.dart")
+
+FIELD_RE = re.compile(r"X##_(STR|INT|UINT|BOOL|ID|LIST)\(([^)]*)\)")
+DEFINE_RE = re.compile(r"#define (API_\w+)\(X\)((?:.*\\\n)*.*)")
+SCHEMA_RE = re.compile(r"S\((\w+),\s*(API_\w+)\)")
+
+
+def parse(path):
+    with open(path) as f:
+        text = f.read()
+    lists = {}
+    for macro, body in DEFINE_RE.findall(text):
+        lists[macro] = [(kind, [a.strip() for a in args.split(",")])
+                        for kind, args in FIELD_RE.findall(body)]
+    block = text[text.index("#define API_SCHEMAS(S)"):]
+    block = block[:block.index("\n\n")]
+    return [(name, lists[macro]) for name, macro in SCHEMA_RE.findall(block)]
+
+
+def dart_type(kind, args):
+    if kind == "STR":
+        return "String"
+    if kind == "BOOL":
+        return "bool"
+    if kind == "ID":
+        return "int?"   # null at the end of the roster
+    if kind == "LIST":
+        return "List<%s>" % args[1]
+    return "int"
+
+
+def from_json(kind, args):
+    key = "json['%s']" % args[0]
+    if kind == "LIST":
+        return ("(%s as List)\n            .map((e) => %s.fromJson(e as Map<String, dynamic>))\n"
+                "            .toList()" % (key, args[1]))
+    return "%s as %s" % (key, dart_type(kind, args))
+
+
+def to_json(kind, args):
+    if kind == "LIST":
+        return "%s.map((e) => e.toJson()).toList()" % args[0]
+    return args[0]
+
+
+def generate(schemas):
+    out = ["// lib/models/pals_api.dart",
+           "// GENERATED from Packet Pals include/api_schema.h by",
+           "// scripts/gen_api_models.py. Do not edit: change the schema and rerun.",
+           "// Field order and names match the JSON the device sends.",
+           ""]
+    for name, fields in schemas:
+        out.append("class %s {" % name)
+        for kind, args in fields:
+            out.append("  final %s %s;" % (dart_type(kind, args), args[0]))
+        out.append("")
+        out.append("  const %s({" % name)
+        for kind, args in fields:
+            out.append("    %sthis.%s," % ("" if kind == "ID" else "required ", args[0]))
+        out.append("  });")
+        out.append("")
+        out.append("  factory %s.fromJson(Map<String, dynamic> json) => %s(" % (name, name))
+        for kind, args in fields:
+            out.append("        %s: %s," % (args[0], from_json(kind, args)))
+        out.append("      );")
+        out.append("")
+        out.append("  Map<String, dynamic> toJson() => {")
+        for kind, args in fields:
+            out.append("        '%s': %s," % (args[0], to_json(kind, args)))
+        out.append("      };")
+        out.append("}")
+        out.append("")
+    return "\n".join(out)
+
+
+def main():
+    schemas = parse(SCHEMA)
+    text = generate(schemas)
+    old = None
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            old = f.read()
+    if "--check" in sys.argv:
+        if text != old:
+            print("gen_api_models: %s is out of date" % os.path.normpath(OUTPUT))
+            sys.exit(1)
+        return
+    if text != old:
+        with open(OUTPUT, "w", newline="\n") as f:
+            f.write(text)
+    print("gen_api_models: %d models in %s" % (len(schemas), os.path.basename(OUTPUT)))
+
+
+main()
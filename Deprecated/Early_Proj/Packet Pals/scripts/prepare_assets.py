@@ -0,0 +1,70 @@
+# prepare_assets.py
+# PlatformIO pre-script: gzips the text assets in data/ and writes
+# data/assets.txt, the manifest the firmware loads at boot (see
+# include/static_assets.h). Runs on every pio invocation; files are only
+# rewritten when their source changed, so it is cheap.
+#
+# Manifest line: "<path> <size> <crc32 hex> <gz size or 0>"
+import gzip
+import os
+import zlib
+
+GZIP_SUFFIXES = (".html", ".js", ".css", ".json", ".svg")
+MANIFEST = "assets.txt"
+
+
+def crc32_of(path):
+    crc = 0
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(65536), b""):
+            crc = zlib.crc32(block, crc)
+    return crc & 0xFFFFFFFF
+
+
+def write_gzip(src, dst):
+    if os.path.exists(dst) and os.path.getmtime(dst) >= os.path.getmtime(src):
+        return
+    with open(src, "rb") as f:
+        raw = f.read()
+    # mtime=0 keeps the output (and its size in the manifest) reproducible
+    with open(dst, "wb") as out:
+        with gzip.GzipFile(filename="", mode="wb", fileobj=out, compresslevel=9, mtime=0) as gz:
+            gz.write(raw)
+
+
+def prepare(data_dir):
+    lines = []
+    for root, _, files in os.walk(data_dir):
+        for name in sorted(files):
+            if name.endswith(".gz") or name == MANIFEST:
+                continue
+            src = os.path.join(root, name)
+            url = "/" + os.path.relpath(src, data_dir).replace(os.sep, "/")
+            gz_size = 0
+            if name.endswith(GZIP_SUFFIXES):
+                write_gzip(src, src + ".gz")
+                gz_size = os.path.getsize(src + ".gz")
+                # not worth a second copy on flash
+                if gz_size >= os.path.getsize(src):
+                    os.remove(src + ".gz")
+                    gz_size = 0
+            lines.append("%s %d %08x %d" % (url, os.path.getsize(src), crc32_of(src), gz_size))
+
+    text = "\n".join(sorted(lines)) + "\n"
+    manifest = os.path.join(data_dir, MANIFEST)
+    old = None
+    if os.path.exists(manifest):
+        with open(manifest) as f:
+            old = f.read()
+    if text != old:
+        with open(manifest, "w", newline="\n") as f:
+            f.write(text)
+    print("prepare_assets: %d files in %s" % (len(lines), MANIFEST))
+
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO)
+    prepare(env.subst("$PROJECT_DATA_DIR"))  # noqa: F821
+except NameError:
+    # plain "python scripts/prepare_assets.py" from the project directory
+    prepare(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "data"))
@@ -0,0 +1,35 @@
+// api_schema.cpp
+#include "api_schema.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define API_WRITE_STR(name, size)       js.field(#name, (const char*)v.name);
+#define API_WRITE_INT(name)             js.field(#name, v.name);
+#define API_WRITE_UINT(name)            js.field(#name, v.name);
+#define API_WRITE_BOOL(name)            js.field(#name, v.name);
+#define API_WRITE_ID(name)              js.key(#name); \
+                                        if(v.name) js.value((unsigned long)v.name); \
+                                        else js.null();
+#define API_WRITE_LIST(name, Type, max) js.key(#name); \
+                                        js.beginArray(); \
+                                        for(size_t i = 0; i < v.name##Count && i < max; i++) \
+                                          writeJson(js, v.name[i]); \
+                                        js.endArray();
+
+#define API_WRITER(Type, FIELDS) \
+  void writeJson(JsonStream &js, const Type &v) { \
+    js.beginObject(); \
+    FIELDS(API_WRITE) \
+    js.endObject(); \
+  }
+API_SCHEMAS(API_WRITER)
+
+void appendField(char* dst, size_t size, const char* fmt, ...) {
+  size_t used = strnlen(dst, size);
+  if(used + 1 >= size) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(dst + used, size - used, fmt, ap);
+  va_end(ap);
+}
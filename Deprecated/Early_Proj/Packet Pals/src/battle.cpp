@@ -0,0 +1,122 @@
+// battle.cpp
+#include "battle.h"
+#include "api_schema.h"
+#include <string.h>
+
+BattleAction parseBattleAction(const char* s) {
+  if(strcmp(s, "attack") == 0) return BATTLE_ATTACK;
+  if(strcmp(s, "defend") == 0) return BATTLE_DEFEND;
+  if(strcmp(s, "capture") == 0) return BATTLE_CAPTURE;
+  if(strcmp(s, "run") == 0) return BATTLE_RUN;
+  return BATTLE_UNKNOWN;
+}
+
+void recalcMonsterStats(SavedMonster &m) {
+  if(m.level < 1) m.level = 1;
+  m.hp = 30 + 5 * (m.level - 1);
+  m.defense = 5 + (m.level - 1);
+}
+
+bool giveStarter(SaveGame &g) {
+  if(g.hasStarter) return false;
+  if(g.partySize < SaveGame::PARTY_MAX) {
+    SavedMonster &st = g.party[g.partySize++];
+    copyName(st.name, sizeof(st.name), "StarterPal");
+    st.level = 1;
+    recalcMonsterStats(st);
+  }
+  g.hasStarter = true;
+  return true;
+}
+
+void newGame(SaveGame &g) {
+  memset(&g, 0, sizeof(g));
+  copyName(g.playerName, sizeof(g.playerName), "NoName");
+  g.playerLevel = 1;
+  giveStarter(g);
+}
+
+bool beginBattle(const SaveGame &g, BattleState &b, int partyIndex,
+                 uint32_t wildId, const SavedMonster &wild) {
+  if(partyIndex < 0 || partyIndex >= g.partySize) return false;
+  b.inProgress = true;
+  b.partyIndex = (uint8_t)partyIndex;
+  b.wildId = wildId;
+  b.wild = wild;
+  return true;
+}
+
+TurnResult battleTurn(SaveGame &g, BattleState &b, BattleAction a,
+                      const BattleDice &dice, char* msg, size_t msgSize) {
+  TurnResult r = { false, false };
+  SavedMonster &partyMon = g.party[b.partyIndex];
+  SavedMonster &wildMon = b.wild;
+  // the capture below may copy wildMon over a party slot's name buffer
+  char pName[sizeof(partyMon.name)], wName[sizeof(wildMon.name)];
+  memcpy(pName, partyMon.name, sizeof(pName));
+  memcpy(wName, wildMon.name, sizeof(wName));
+
+  switch(a) {
+  case BATTLE_ATTACK: {
+    int pDmg = dice(1, 6);
+    int wDmg = dice(1, 5);
+    wildMon.hp -= pDmg;
+    appendField(msg, msgSize, "%s attacked for %d dmg. ", pName, pDmg);
+    if(wildMon.hp > 0) {
+      partyMon.hp -= wDmg;
+      appendField(msg, msgSize, "%s countered for %d dmg. ", wName, wDmg);
+    }
+    break;
+  }
+  case BATTLE_DEFEND: {
+    int wDmg = dice(1, 5) / 2;
+    if(wDmg < 1) wDmg = 1;
+    partyMon.hp -= wDmg;
+    appendField(msg, msgSize, "%s defended. %s hits for %d dmg.", pName, wName, wDmg);
+    break;
+  }
+  case BATTLE_CAPTURE:
+    if(g.partySize >= SaveGame::PARTY_MAX) {
+      appendField(msg, msgSize, "Party is full! Can't capture!");
+    } else if(dice(0, 100) < 30) {
+      appendField(msg, msgSize, "Capture success! %s joined your party.", wName);
+      r.battleEnd = true;
+      g.party[g.partySize++] = wildMon;
+      r.saveDirty = true;
+    } else {
+      int wDmg = dice(1, 5);
+      partyMon.hp -= wDmg;
+      appendField(msg, msgSize, "Capture failed! %s hits for %d dmg.", wName, wDmg);
+    }
+    break;
+  case BATTLE_RUN:
+    appendField(msg, msgSize, "Ran away from battle!");
+    r.battleEnd = true;
+    break;
+  default:
+    return r;
+  }
+
+  // check faint
+  if(wildMon.hp <= 0) {
+    appendField(msg, msgSize, " %s fainted! Your monster wins!", wName);
+    partyMon.level++;
+    recalcMonsterStats(partyMon);
+    g.playerLevel++;
+    r.saveDirty = true;
+    r.battleEnd = true;
+  }
+  if(partyMon.hp <= 0) {
+    appendField(msg, msgSize, " %s fainted! The wild monster wins!", pName);
+    r.battleEnd = true;
+  }
+
+  if(r.battleEnd) {
+    b.inProgress = false;
+    // the roster entry never lost hp; only the battle copy did
+    // heal entire party
+    for(int i = 0; i < g.partySize; i++) recalcMonsterStats(g.party[i]);
+    r.saveDirty = true;
+  }
+  return r;
+}
@@ -0,0 +1,153 @@
+// ble_frame.cpp
+#include "ble_frame.h"
+#include <string.h>
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v; p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// --- BleBatcher ----------------------------------------------------------
+
+BleBatcher::BleBatcher(BleLink &link, size_t mtu)
+  : link_(link), mtu_(BLE_MTU_MIN), delayMs_(0), firstMs_(0), seq_(0), len_(0), stats_() {
+  setMtu(mtu);
+}
+
+void BleBatcher::setMtu(size_t mtu) {
+  if(mtu < BLE_MTU_MIN) mtu = BLE_MTU_MIN;
+  if(mtu > BLE_MTU_MAX) mtu = BLE_MTU_MAX;
+  mtu_ = mtu;
+}
+
+bool BleBatcher::add(uint8_t type, const uint8_t* body, size_t len, uint32_t nowMs) {
+  if(len > RECORD_MAX) return false;
+  bool ok = true;
+  if(len_ + 2 + len > BATCH_MAX) ok = flush();
+  if(len_ == 0) firstMs_ = nowMs;
+  batch_[len_++] = type;
+  batch_[len_++] = (uint8_t)len;
+  memcpy(batch_ + len_, body, len);
+  len_ += len;
+  stats_.records++;
+  stats_.recordBytes += 2 + len;
+  return ok;
+}
+
+bool BleBatcher::flush() {
+  if(len_ == 0) return true;
+  size_t room = mtu_ - ATT_HEADER - FRAME_HEADER;
+  bool ok = true;
+  for(size_t off = 0; off < len_; off += room) {
+    size_t n = len_ - off < room ? len_ - off : room;
+    frame_[0] = seq_++;
+    frame_[1] = (off == 0 ? FRAME_START : 0) | (off + n == len_ ? FRAME_END : 0);
+    memcpy(frame_ + FRAME_HEADER, batch_ + off, n);
+    // a refused frame still used its seq, so the app sees the gap
+    if(!link_.send(frame_, FRAME_HEADER + n)) {
+      stats_.failures++;
+      ok = false;
+    }
+    stats_.frames++;
+    stats_.frameBytes += FRAME_HEADER + n;
+  }
+  stats_.messages++;
+  len_ = 0;
+  return ok;
+}
+
+void BleBatcher::service(uint32_t nowMs) {
+  if(len_ > 0 && nowMs - firstMs_ >= delayMs_) flush();
+}
+
+// --- BleRx ---------------------------------------------------------------
+
+void BleRx::receive(const uint8_t* frame, size_t len) {
+  if(len < FRAME_HEADER) return;
+  stats_.frames++;
+  uint8_t seq = frame[0], flags = frame[1];
+  if(synced_ && seq != expect_) {
+    stats_.gaps++;
+    if(inMessage_) stats_.dropped++;
+    inMessage_ = false;
+  }
+  synced_ = true;
+  expect_ = (uint8_t)(seq + 1);
+
+  if(flags & FRAME_START) {
+    if(inMessage_) stats_.dropped++;   // an END went missing without a gap
+    inMessage_ = true;
+    len_ = 0;
+  }
+  if(!inMessage_) return;   // the rest of a message we lost the start of
+  size_t n = len - FRAME_HEADER;
+  if(len_ + n > sizeof(msg_)) {
+    stats_.malformed++;
+    inMessage_ = false;
+    return;
+  }
+  memcpy(msg_ + len_, frame + FRAME_HEADER, n);
+  len_ += n;
+  if(flags & FRAME_END) {
+    inMessage_ = false;
+    deliver();
+  }
+}
+
+void BleRx::deliver() {
+  // check the whole message first so a bad one delivers nothing
+  size_t off = 0;
+  while(off + 2 <= len_) off += 2 + msg_[off + 1];
+  if(off != len_) {
+    stats_.malformed++;
+    return;
+  }
+  stats_.messages++;
+  for(off = 0; off < len_; off += 2 + msg_[off + 1]) {
+    stats_.records++;
+    fn_(msg_[off], msg_ + off + 2, msg_[off + 1]);
+  }
+}
+
+// --- records -------------------------------------------------------------
+
+size_t wildRecord(uint8_t* out, size_t cap, uint32_t id, uint8_t level, const char* name) {
+  size_t n = strlen(name);
+  if(n > RECORD_MAX - 5) n = RECORD_MAX - 5;
+  if(cap < 5 + n) return 0;
+  put32(out, id);
+  out[4] = level;
+  memcpy(out + 5, name, n);
+  return 5 + n;
+}
+
+size_t rosterRecord(uint8_t* out, size_t cap, uint16_t total, uint32_t firstId) {
+  if(cap < 6) return 0;
+  put16(out, total);
+  put32(out + 2, firstId);
+  return 6;
+}
+
+size_t partyRecord(uint8_t* out, size_t cap, uint16_t playerLevel,
+                   const BlePartyMonster* party, uint8_t count) {
+  if(cap < 3) return 0;
+  put16(out, playerLevel);
+  out[2] = count;
+  size_t len = 3;
+  for(uint8_t i = 0; i < count; i++) {
+    size_t n = strlen(party[i].name);
+    if(n > 32) n = 32;
+    if(len + 7 + n > cap || len + 7 + n > RECORD_MAX) return 0;
+    uint8_t* p = out + len;
+    put16(p, party[i].level);
+    put16(p + 2, (uint16_t)party[i].hp);
+    put16(p + 4, (uint16_t)party[i].defense);
+    p[6] = (uint8_t)n;
+    memcpy(p + 7, party[i].name, n);
+    len += 7 + n;
+  }
+  return len;
+}
@@ -0,0 +1,131 @@
+// boot_image.cpp
+#include "boot_image.h"
+#include "crc32.h"
+#include <stdio.h>
+#include <string.h>
+
+static const size_t FIXED_HEADER = 8;     // magic, version, count
+static const size_t ENTRY_BYTES = 16;
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static size_t headerBytes(size_t count) {
+  return FIXED_HEADER + count * ENTRY_BYTES + 4;
+}
+
+BootImageWriter::BootImageWriter(PalFs &fs, const char* path)
+  : fs_(fs), path_(path), count_(0)
+{
+}
+
+bool BootImageWriter::add(uint32_t id, const void* data, size_t len) {
+  if(count_ == BootImage::MAX_SECTIONS) return false;
+  data_[count_] = data;
+  entries_[count_].id = id;
+  entries_[count_].length = (uint32_t)len;
+  entries_[count_].crc = crc32(data, len);
+  count_++;
+  return true;
+}
+
+bool BootImageWriter::commit() {
+  uint8_t head[FIXED_HEADER + BootImage::MAX_SECTIONS * ENTRY_BYTES + 4];
+  size_t headLen = headerBytes(count_);
+  // sections start 4-aligned so they can be read straight into word arrays
+  uint32_t offset = (uint32_t)((headLen + 3) & ~(size_t)3);
+  put32(head, BootImage::MAGIC);
+  head[4] = (uint8_t)BootImage::VERSION;
+  head[5] = (uint8_t)(BootImage::VERSION >> 8);
+  head[6] = (uint8_t)count_;
+  head[7] = 0;
+  for(size_t i = 0; i < count_; i++) {
+    entries_[i].offset = offset;
+    uint8_t* e = head + FIXED_HEADER + i * ENTRY_BYTES;
+    put32(e,      entries_[i].id);
+    put32(e + 4,  entries_[i].offset);
+    put32(e + 8,  entries_[i].length);
+    put32(e + 12, entries_[i].crc);
+    offset += (entries_[i].length + 3) & ~3u;
+  }
+  put32(head + headLen - 4, crc32(head, headLen - 4));
+
+  char tmp[40];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path_);
+  std::unique_ptr<PalFile> f = fs_.open(tmp, "w");
+  if(!f) return false;
+  static const uint8_t zeros[4] = {0, 0, 0, 0};
+  bool ok = f->write(head, headLen) == headLen;
+  size_t pos = headLen;
+  for(size_t i = 0; ok && i < count_; i++) {
+    size_t pad = entries_[i].offset - pos;
+    ok = f->write(zeros, pad) == pad &&
+         f->write((const uint8_t*)data_[i], entries_[i].length) == entries_[i].length;
+    pos = entries_[i].offset + entries_[i].length;
+  }
+  f->flush();
+  f.reset();
+  if(!ok) {
+    fs_.remove(tmp);
+    return false;
+  }
+  fs_.remove(path_);
+  return fs_.rename(tmp, path_);
+}
+
+BootImageReader::BootImageReader(PalFs &fs, const char* path)
+  : fs_(fs), path_(path), count_(0)
+{
+}
+
+bool BootImageReader::begin() {
+  count_ = 0;
+  f_ = fs_.open(path_, "r");
+  if(!f_) return false;
+  uint8_t head[FIXED_HEADER + BootImage::MAX_SECTIONS * ENTRY_BYTES + 4];
+  if(f_->read(head, FIXED_HEADER) != FIXED_HEADER) return false;
+  size_t count = head[6];
+  if(get32(head) != BootImage::MAGIC ||
+     (head[4] | (head[5] << 8)) != BootImage::VERSION ||
+     count > BootImage::MAX_SECTIONS) return false;
+  size_t headLen = headerBytes(count);
+  size_t rest = headLen - FIXED_HEADER;
+  if(f_->read(head + FIXED_HEADER, rest) != rest) return false;
+  if(crc32(head, headLen - 4) != get32(head + headLen - 4)) return false;
+  size_t fileSize = f_->size();
+  for(size_t i = 0; i < count; i++) {
+    const uint8_t* e = head + FIXED_HEADER + i * ENTRY_BYTES;
+    entries_[i].id     = get32(e);
+    entries_[i].offset = get32(e + 4);
+    entries_[i].length = get32(e + 8);
+    entries_[i].crc    = get32(e + 12);
+    if((size_t)entries_[i].offset + entries_[i].length > fileSize) return false;
+  }
+  count_ = count;
+  return true;
+}
+
+const BootImage::Entry* BootImageReader::find(uint32_t id) const {
+  for(size_t i = 0; i < count_; i++) {
+    if(entries_[i].id == id) return &entries_[i];
+  }
+  return nullptr;
+}
+
+size_t BootImageReader::length(uint32_t id) const {
+  const BootImage::Entry* e = find(id);
+  return e ? e->length : 0;
+}
+
+bool BootImageReader::read(uint32_t id, void* dst, size_t len) {
+  const BootImage::Entry* e = find(id);
+  if(!e || e->length != len || !f_) return false;
+  if(!f_->seek(e->offset)) return false;
+  if(f_->read((uint8_t*)dst, len) != len) return false;
+  return crc32(dst, len) == e->crc;
+}
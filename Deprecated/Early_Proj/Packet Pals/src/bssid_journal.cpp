@@ -0,0 +1,123 @@
+// bssid_journal.cpp
+#include "bssid_journal.h"
+#include "mac_addr.h"
+#include <string.h>
+#include <stdio.h>
+
+BssidJournal::BssidJournal(PalFs &fs, const char* path)
+  : fs_(fs), path_(path), compactRecords_(0), fileRecords_(0),
+    tornTail_(false), pending_(0), dropped_(0), unjournaled_(false)
+{
+  snprintf(tmpPath_, sizeof(tmpPath_), "%s.tmp", path);
+}
+
+bool BssidJournal::exists() {
+  return fs_.exists(path_) || fs_.exists(tmpPath_);
+}
+
+size_t BssidJournal::load(const std::function<void(uint64_t)> &onRecord) {
+  fileRecords_ = 0;
+  tornTail_    = false;
+  // A compaction that died between remove and rename leaves only the
+  // finished temp file behind
+  if(!fs_.exists(path_) && fs_.exists(tmpPath_)){
+    fs_.rename(tmpPath_, path_);
+  }
+  std::unique_ptr<PalFile> f = fs_.open(path_, "r");
+  if(!f) return 0;
+
+  // Read in whole-record chunks; SPIFFS is much happier with 504-byte
+  // reads than with one call per record.
+  uint8_t buf[84 * RECORD_SIZE];
+  size_t carry = 0;
+  for(;;){
+    size_t got = f->read(buf + carry, sizeof(buf) - carry);
+    if(got == 0) break;
+    size_t have = carry + got;
+    size_t whole = have - (have % RECORD_SIZE);
+    for(size_t off=0; off<whole; off+=RECORD_SIZE){
+      onRecord(macToKey(buf + off));
+      fileRecords_++;
+    }
+    carry = have - whole;
+    memmove(buf, buf + whole, carry);
+  }
+  if(carry != 0) tornTail_ = true;
+  return fileRecords_;
+}
+
+bool BssidJournal::append(uint64_t mac) {
+  // A failed flush leaves the batch full: retry it, and if the file still
+  // won't take it, drop the record rather than overrun the batch. The MAC
+  // stays in the caller's live set and is rewritten by the next compaction.
+  if(pending_ == BATCH_RECORDS && !flush()){
+    dropped_++;
+    unjournaled_ = true;
+    return false;
+  }
+  keyToMac(mac, batch_ + pending_ * RECORD_SIZE);
+  pending_++;
+  if(pending_ == BATCH_RECORDS) return flush();
+  return true;
+}
+
+bool BssidJournal::flush() {
+  if(pending_ == 0) return true;
+  // Anything appended after a partial record would be read back shifted;
+  // only a compaction can clear the torn tail
+  if(tornTail_) return false;
+  std::unique_ptr<PalFile> f = fs_.open(path_, "a");
+  if(!f) return false;
+  size_t len = pending_ * RECORD_SIZE;
+  size_t wrote = f->write(batch_, len);
+  // Whole records that made it are in the file; keep only the rest queued
+  // so a retry doesn't append them twice
+  size_t whole = wrote / RECORD_SIZE;
+  fileRecords_ += whole;
+  pending_ -= whole;
+  memmove(batch_, batch_ + whole * RECORD_SIZE, pending_ * RECORD_SIZE);
+  if(wrote % RECORD_SIZE != 0) tornTail_ = true;
+  return wrote == len;
+}
+
+bool BssidJournal::needsCompaction(size_t liveCount) const {
+  // torn tail, or records the live set holds but the file never got
+  if(tornTail_ || unjournaled_) return true;
+  // Duplicates only appear after legacy imports, so allow some slack
+  // before paying for a rewrite.
+  return records() > liveCount + liveCount / 4 + 64;
+}
+
+bool BssidJournal::beginCompaction() {
+  compactFile_ = fs_.open(tmpPath_, "w");
+  compactRecords_ = 0;
+  return (bool)compactFile_;
+}
+
+bool BssidJournal::addCompacted(uint64_t mac) {
+  if(!compactFile_) return false;
+  uint8_t rec[RECORD_SIZE];
+  keyToMac(mac, rec);
+  if(compactFile_->write(rec, RECORD_SIZE) != RECORD_SIZE){
+    compactFile_.reset();
+    return false;
+  }
+  compactRecords_++;
+  return true;
+}
+
+bool BssidJournal::commitCompaction() {
+  if(!compactFile_){
+    fs_.remove(tmpPath_);
+    return false;
+  }
+  compactFile_.reset();
+  fs_.remove(path_);
+  if(!fs_.rename(tmpPath_, path_)) return false;
+  // The live set already holds anything that was pending
+  fileRecords_ = compactRecords_;
+  pending_     = 0;
+  tornTail_    = false;
+  unjournaled_ = false;
+  return true;
+}
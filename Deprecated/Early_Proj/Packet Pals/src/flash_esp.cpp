@@ -0,0 +1,22 @@
+// flash_esp.cpp
+#ifdef ARDUINO
+#include "flash_backend.h"
+
+bool PartitionFlash::begin() {
+  part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label_);
+  return part_ != nullptr;
+}
+
+bool PartitionFlash::read(size_t addr, void* buf, size_t len) {
+  return part_ && esp_partition_read(part_, addr, buf, len) == ESP_OK;
+}
+
+bool PartitionFlash::write(size_t addr, const void* buf, size_t len) {
+  return part_ && esp_partition_write(part_, addr, buf, len) == ESP_OK;
+}
+
+bool PartitionFlash::erase(size_t sector) {
+  return part_ && esp_partition_erase_range(part_, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+#endif
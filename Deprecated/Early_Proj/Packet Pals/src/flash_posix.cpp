@@ -0,0 +1,94 @@
+// flash_posix.cpp
+#ifndef ARDUINO
+#include "flash_backend.h"
+#include <string.h>
+
+RamFlash::RamFlash(size_t sectorSize, size_t sectorCount)
+  : mem_(sectorSize * sectorCount, 0xFF), sectorSize_(sectorSize),
+    eraseCounts_(sectorCount, 0), busyUs_(0), programmed_(0),
+    tearLeft_(0), tearing_(false)
+{
+}
+
+bool RamFlash::read(size_t addr, void* buf, size_t len) {
+  if(addr + len > mem_.size()) return false;
+  memcpy(buf, &mem_[addr], len);
+  return true;
+}
+
+bool RamFlash::write(size_t addr, const void* buf, size_t len) {
+  if(addr + len > mem_.size() || torn()) return false;
+  const uint8_t* p = (const uint8_t*)buf;
+  for(size_t i = 0; i < len; i++) {
+    // NOR can only clear bits; anything else is a bug in the caller
+    if((mem_[addr + i] & p[i]) != p[i]) return false;
+  }
+  size_t n = len;
+  if(tearing_ && n > tearLeft_) n = tearLeft_;
+  for(size_t i = 0; i < n; i++) mem_[addr + i] &= p[i];
+  if(tearing_) tearLeft_ -= n;
+  programmed_ += n;
+  for(size_t off = 0; off < n; ) {
+    size_t page = PAGE_BYTES - (addr + off) % PAGE_BYTES;
+    if(page > n - off) page = n - off;
+    uint64_t us = 30 + (page - 1) * 5 / 2;
+    busyUs_ += us < PAGE_PROGRAM_US ? us : PAGE_PROGRAM_US;
+    off += page;
+  }
+  return n == len;
+}
+
+bool RamFlash::erase(size_t sector) {
+  if(sector >= eraseCounts_.size() || torn()) return false;
+  // an interrupted erase leaves the sector partly erased
+  size_t n = sectorSize_;
+  if(tearing_ && n > tearLeft_) n = tearLeft_;
+  memset(&mem_[sector * sectorSize_], 0xFF, n);
+  if(tearing_) tearLeft_ -= n;
+  if(n < sectorSize_) return false;
+  eraseCounts_[sector]++;
+  busyUs_ += SECTOR_ERASE_US;
+  return true;
+}
+
+FileFlash::FileFlash(const std::string &path, size_t sectorSize, size_t sectorCount)
+  : RamFlash(sectorSize, sectorCount), f_(nullptr)
+{
+  f_ = fopen(path.c_str(), "r+b");
+  if(f_) {
+    size_t n = fread(&mem_[0], 1, mem_.size(), f_);
+    (void)n;   // a short file is erased flash past its end
+  } else {
+    f_ = fopen(path.c_str(), "w+b");
+  }
+  if(f_ && !store(0, mem_.size())) {
+    fclose(f_);
+    f_ = nullptr;
+  }
+}
+
+FileFlash::~FileFlash() {
+  if(f_) fclose(f_);
+}
+
+bool FileFlash::store(size_t addr, size_t len) {
+  if(!f_) return false;
+  if(fseek(f_, (long)addr, SEEK_SET) != 0) return false;
+  bool ok = fwrite(&mem_[addr], 1, len, f_) == len;
+  fflush(f_);
+  return ok;
+}
+
+bool FileFlash::write(size_t addr, const void* buf, size_t len) {
+  bool ok = RamFlash::write(addr, buf, len);
+  store(addr, len);
+  return ok;
+}
+
+bool FileFlash::erase(size_t sector) {
+  bool ok = RamFlash::erase(sector);
+  store(sector * sectorSize(), sectorSize());
+  return ok;
+}
+
+#endif
@@ -0,0 +1,38 @@
+// hal_esp.cpp
+#ifdef ARDUINO
+#include "pal_hal.h"
+#include <Arduino.h>
+#include <WiFi.h>
+
+static_assert(PalRadio::SWEEP_RUNNING == WIFI_SCAN_RUNNING, "sweep codes follow WiFi.scanComplete()");
+static_assert(PalRadio::SWEEP_FAILED == WIFI_SCAN_FAILED, "sweep codes follow WiFi.scanComplete()");
+static_assert(SCAN_AUTH_WPA2_ENTERPRISE == (int)WIFI_AUTH_WPA2_ENTERPRISE, "ScanAuth follows wifi_auth_mode_t");
+
+int WifiRadio::sweep(bool async) { return WiFi.scanNetworks(async, true); }
+int WifiRadio::sweepDone() { return WiFi.scanComplete(); }
+void WifiRadio::release() { WiFi.scanDelete(); }
+
+// Copies result i of the last sweep into a compact record
+void WifiRadio::result(int i, ScanRecord &rec) {
+  memcpy(rec.bssid, WiFi.BSSID(i), 6);
+  rec.rssi    = (int8_t)WiFi.RSSI(i);
+  rec.channel = (uint8_t)WiFi.channel(i);
+  rec.auth    = (uint8_t)WiFi.encryptionType(i);
+  rec.flags   = 0;
+  String ssid = WiFi.SSID(i);
+  size_t len = ssid.length();
+  if(len > sizeof(rec.ssid) - 1) len = sizeof(rec.ssid) - 1;
+  memcpy(rec.ssid, ssid.c_str(), len);
+  rec.ssid[len] = '\0';
+  rec.ssidLen = (uint8_t)len;
+}
+
+uint32_t EspRng::next() { return esp_random(); }
+
+uint32_t EspClock::millis() { return ::millis(); }
+
+void RtosLock::begin() { mutex_ = xSemaphoreCreateMutex(); }
+void RtosLock::lock() { xSemaphoreTake((SemaphoreHandle_t)mutex_, portMAX_DELAY); }
+void RtosLock::unlock() { xSemaphoreGive((SemaphoreHandle_t)mutex_); }
+
+#endif
@@ -0,0 +1,12 @@
+// hal_posix.cpp
+#ifndef ARDUINO
+#include "pal_hal.h"
+
+uint32_t SeededRng::next() {
+  uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+#endif
@@ -0,0 +1,143 @@
+// json_stream.cpp
+#include "json_stream.h"
+#include <stdio.h>
+#include <string.h>
+
+JsonStream::JsonStream(ByteSink &sink, char* buf, size_t bufSize)
+  : sink_(sink), buf_(buf), cap_(bufSize), used_(0), total_(0),
+    hasItems_(0), depth_(0), afterKey_(false), ok_(true)
+{
+}
+
+bool JsonStream::flush() {
+  if(used_ > 0){
+    if(!sink_.write(buf_, used_)) ok_ = false;
+    total_ += used_;
+    used_ = 0;
+  }
+  return ok_;
+}
+
+void JsonStream::put(char c) {
+  if(used_ == cap_) flush();
+  buf_[used_++] = c;
+}
+
+void JsonStream::put(const char* s, size_t len) {
+  while(len > 0){
+    if(used_ == cap_) flush();
+    size_t n = cap_ - used_;
+    if(n > len) n = len;
+    memcpy(buf_ + used_, s, n);
+    used_ += n;
+    s += n;
+    len -= n;
+  }
+}
+
+void JsonStream::putEscaped(const char* s) {
+  put('"');
+  for(;;){
+    // copy the run of characters that need no escaping in one go
+    const char* run = s;
+    while((unsigned char)*s >= 0x20 && *s != '"' && *s != '\\') s++;
+    if(s > run) put(run, (size_t)(s - run));
+    unsigned char c = (unsigned char)*s;
+    if(c == 0) break;
+    if(c == '"' || c == '\\'){
+      put('\\');
+      put((char)c);
+    } else {
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      put(esc, 6);
+    }
+    s++;
+  }
+  put('"');
+}
+
+// Emits the ',' owed before a new element at the current level
+void JsonStream::separator() {
+  if(afterKey_){
+    afterKey_ = false;
+    return;
+  }
+  uint32_t bit = 1u << depth_;
+  if(hasItems_ & bit) put(',');
+  hasItems_ |= bit;
+}
+
+void JsonStream::beginObject() {
+  separator();
+  put('{');
+  if(depth_ < MAX_DEPTH) depth_++;
+  hasItems_ &= ~(1u << depth_);
+}
+
+void JsonStream::endObject() {
+  put('}');
+  if(depth_ > 0) depth_--;
+}
+
+void JsonStream::beginArray() {
+  separator();
+  put('[');
+  if(depth_ < MAX_DEPTH) depth_++;
+  hasItems_ &= ~(1u << depth_);
+}
+
+void JsonStream::endArray() {
+  put(']');
+  if(depth_ > 0) depth_--;
+}
+
+void JsonStream::key(const char* name) {
+  separator();
+  putEscaped(name);
+  put(':');
+  afterKey_ = true;
+}
+
+void JsonStream::value(const char* s) {
+  separator();
+  putEscaped(s);
+}
+
+// Digits of v, written backwards from end; returns the first one
+static char* formatUnsigned(unsigned long v, char* end) {
+  do {
+    *--end = (char)('0' + v % 10);
+    v /= 10;
+  } while(v);
+  return end;
+}
+
+void JsonStream::value(long v) {
+  separator();
+  char num[21];
+  char* end = num + sizeof(num);
+  // negate as unsigned so LONG_MIN works
+  char* p = formatUnsigned(v < 0 ? 0UL - (unsigned long)v : (unsigned long)v, end);
+  if(v < 0) *--p = '-';
+  put(p, (size_t)(end - p));
+}
+
+void JsonStream::value(unsigned long v) {
+  separator();
+  char num[21];
+  char* end = num + sizeof(num);
+  char* p = formatUnsigned(v, end);
+  put(p, (size_t)(end - p));
+}
+
+void JsonStream::value(bool v) {
+  separator();
+  if(v) put("true", 4);
+  else  put("false", 5);
+}
+
+void JsonStream::null() {
+  separator();
+  put("null", 4);
+}
@@ -0,0 +1,283 @@
+// kv_fs.cpp
+#include "kv_fs.h"
+#include <string.h>
+
+static size_t chunksFor(size_t size) {
+  return (size + KvFs::CHUNK_BYTES - 1) / KvFs::CHUNK_BYTES;
+}
+
+class KvFs::File : public PalFile {
+public:
+  File(KvFs &fs, uint8_t inode, bool writing, size_t pos, size_t oldChunks)
+    : fs_(fs), inode_(inode), writing_(writing), pos_(pos), oldChunks_(oldChunks),
+      bufChunk_((size_t)-1), bufLen_(0), dirty_(false) {}
+  ~File() override { flush(); }
+
+  size_t read(uint8_t* buf, size_t len) override {
+    Entry* e = fs_.byInode(inode_);
+    if(!e) return 0;
+    size_t done = 0;
+    while(done < len && pos_ < e->size) {
+      size_t chunk = pos_ / CHUNK_BYTES, off = pos_ % CHUNK_BYTES;
+      size_t n = CHUNK_BYTES - off;
+      if(n > len - done) n = len - done;
+      if(n > e->size - pos_) n = e->size - pos_;
+      if(!fs_.kv_.read(chunkKey(inode_, chunk), off, buf + done, n)) break;
+      done += n;
+      pos_ += n;
+    }
+    return done;
+  }
+
+  size_t write(const uint8_t* buf, size_t len) override {
+    if(!writing_) return 0;
+    size_t done = 0;
+    while(done < len) {
+      size_t chunk = pos_ / CHUNK_BYTES, off = pos_ % CHUNK_BYTES;
+      if(chunk != bufChunk_ && !load(chunk)) break;
+      size_t n = CHUNK_BYTES - off;
+      if(n > len - done) n = len - done;
+      memcpy(buf_.get() + off, buf + done, n);
+      if(off + n > bufLen_) bufLen_ = off + n;
+      dirty_ = true;
+      done += n;
+      pos_ += n;
+      if(bufLen_ == CHUNK_BYTES && !store()) break;
+    }
+    return done;
+  }
+
+  bool seek(size_t pos) override {
+    if(pos > size()) return false;
+    pos_ = pos;
+    return true;
+  }
+
+  size_t size() override {
+    Entry* e = fs_.byInode(inode_);
+    size_t s = e ? e->size : 0;
+    if(dirty_ && bufChunk_ * CHUNK_BYTES + bufLen_ > s) s = bufChunk_ * CHUNK_BYTES + bufLen_;
+    return s;
+  }
+
+  void flush() override {
+    if(!writing_) return;
+    store();
+    // "w" on an existing file: chunks past the new end go now
+    Entry* e = fs_.byInode(inode_);
+    if(e && oldChunks_ > chunksFor(e->size)) {
+      fs_.dropChunks(inode_, chunksFor(e->size), oldChunks_);
+      oldChunks_ = 0;
+    }
+  }
+
+private:
+  // Starts buffering a chunk, with whatever of it the file already holds
+  bool load(size_t chunk) {
+    if(!store()) return false;
+    if(!buf_) buf_.reset(new uint8_t[CHUNK_BYTES]);
+    Entry* e = fs_.byInode(inode_);
+    if(!e) return false;
+    bufChunk_ = chunk;
+    bufLen_ = 0;
+    if(e->size > chunk * CHUNK_BYTES) {
+      bufLen_ = e->size - chunk * CHUNK_BYTES;
+      if(bufLen_ > CHUNK_BYTES) bufLen_ = CHUNK_BYTES;
+      if(!fs_.kv_.read(chunkKey(inode_, chunk), 0, buf_.get(), bufLen_)) return false;
+    }
+    return true;
+  }
+
+  bool store() {
+    if(!dirty_) return true;
+    Entry* e = fs_.byInode(inode_);
+    if(!e || !fs_.kv_.put(chunkKey(inode_, bufChunk_), buf_.get(), bufLen_)) return false;
+    dirty_ = false;
+    if(bufChunk_ * CHUNK_BYTES + bufLen_ > e->size) e->size = bufChunk_ * CHUNK_BYTES + bufLen_;
+    return true;
+  }
+
+  KvFs &fs_;
+  uint8_t inode_;
+  bool writing_;
+  size_t pos_;
+  size_t oldChunks_;
+  std::unique_ptr<uint8_t[]> buf_;
+  size_t bufChunk_;
+  size_t bufLen_;
+  bool dirty_;
+};
+
+KvFs::KvFs(LogKv &kv)
+  : kv_(kv), count_(0), orphanCount_(0)
+{
+}
+
+// Directory value: u8 count, then { u8 inode, u8 path length, path } each
+bool KvFs::begin() {
+  count_ = 0;
+  orphanCount_ = 0;
+  size_t len = kv_.length(DIR_KEY);
+  if(len != LogKv::NONE && len > 0) {
+    uint8_t buf[1 + MAX_FILES * (2 + MAX_PATH)];
+    if(len > sizeof(buf) || !kv_.read(DIR_KEY, 0, buf, len)) return false;
+    size_t pos = 1;
+    for(size_t i = 0; i < buf[0] && count_ < MAX_FILES && pos + 2 <= len; i++) {
+      uint8_t inode = buf[pos], plen = buf[pos + 1];
+      if(plen >= MAX_PATH || pos + 2 + plen > len) break;
+      Entry &e = files_[count_++];
+      e.inode = inode;
+      memcpy(e.path, buf + pos + 2, plen);
+      e.path[plen] = 0;
+      e.size = 0;
+      pos += 2 + plen;
+    }
+  }
+  // sizes from the chunks; anything no entry owns is left over from a crash
+  std::vector<uint32_t> orphans;
+  kv_.forEach([&](uint32_t key, size_t vlen) {
+    if(key == DIR_KEY) return;
+    Entry* e = byInode((uint8_t)(key >> 16));
+    if(!e || key >> 24) { orphans.push_back(key); return; }
+    size_t end = (key & 0xFFFF) * CHUNK_BYTES + vlen;
+    if(end > e->size) e->size = (uint32_t)end;
+  });
+  for(uint32_t key : orphans) kv_.remove(key);
+  return true;
+}
+
+KvFs::Entry* KvFs::find(const char* path) {
+  for(size_t i = 0; i < count_; i++) {
+    if(strcmp(files_[i].path, path) == 0) return &files_[i];
+  }
+  return nullptr;
+}
+
+KvFs::Entry* KvFs::byInode(uint8_t inode) {
+  for(size_t i = 0; i < count_; i++) {
+    if(files_[i].inode == inode) return &files_[i];
+  }
+  return nullptr;
+}
+
+uint8_t KvFs::freeInode() const {
+  for(unsigned inode = 1; inode < 256; inode++) {
+    bool used = false;
+    for(size_t i = 0; i < count_ && !used; i++) used = files_[i].inode == inode;
+    // a removed file's chunks may still be going; don't reuse its inode
+    for(size_t i = 0; i < orphanCount_ && !used; i++) used = orphans_[i].inode == inode;
+    if(!used) return (uint8_t)inode;
+  }
+  return 0;
+}
+
+bool KvFs::saveDir() {
+  uint8_t buf[1 + MAX_FILES * (2 + MAX_PATH)];
+  size_t pos = 1;
+  buf[0] = (uint8_t)count_;
+  for(size_t i = 0; i < count_; i++) {
+    size_t plen = strlen(files_[i].path);
+    buf[pos] = files_[i].inode;
+    buf[pos + 1] = (uint8_t)plen;
+    memcpy(buf + pos + 2, files_[i].path, plen);
+    pos += 2 + plen;
+  }
+  return kv_.put(DIR_KEY, buf, pos);
+}
+
+void KvFs::dropChunks(uint8_t inode, size_t from, size_t to) {
+  for(size_t c = from; c < to; c++) kv_.remove(chunkKey(inode, c));
+}
+
+void KvFs::orphan(const Entry &e) {
+  size_t chunks = chunksFor(e.size);
+  if(chunks == 0) return;
+  if(orphanCount_ == MAX_FILES) {
+    dropChunks(e.inode, 0, chunks);
+    return;
+  }
+  orphans_[orphanCount_].inode = e.inode;
+  orphans_[orphanCount_].chunks = chunks;
+  orphanCount_++;
+}
+
+size_t KvFs::freeBytes() {
+  return kv_.freeBytes() / (CHUNK_BYTES + LogKv::RECORD_HEADER) * CHUNK_BYTES;
+}
+
+void KvFs::service(size_t budget) {
+  while(budget > 0 && orphanCount_ > 0) {
+    Orphan &o = orphans_[0];
+    kv_.remove(chunkKey(o.inode, --o.chunks));
+    budget--;
+    if(o.chunks == 0) orphans_[0] = orphans_[--orphanCount_];
+  }
+}
+
+std::unique_ptr<PalFile> KvFs::open(const char* path, const char* mode) {
+  Entry* e = find(path);
+  if(mode[0] == 'r') {
+    if(!e) return nullptr;
+    return std::unique_ptr<PalFile>(new File(*this, e->inode, false, 0, 0));
+  }
+  if(!e) {
+    uint8_t inode = freeInode();
+    if(count_ == MAX_FILES || inode == 0 || strlen(path) >= MAX_PATH) return nullptr;
+    e = &files_[count_++];
+    strcpy(e->path, path);
+    e->inode = inode;
+    e->size = 0;
+    if(!saveDir()) {
+      count_--;
+      return nullptr;
+    }
+  }
+  if(mode[0] == 'a') {
+    return std::unique_ptr<PalFile>(new File(*this, e->inode, true, e->size, 0));
+  }
+  size_t oldChunks = chunksFor(e->size);
+  e->size = 0;
+  return std::unique_ptr<PalFile>(new File(*this, e->inode, true, 0, oldChunks));
+}
+
+bool KvFs::exists(const char* path) {
+  return find(path) != nullptr;
+}
+
+bool KvFs::remove(const char* path) {
+  Entry* e = find(path);
+  if(!e) return false;
+  Entry gone = *e;
+  *e = files_[--count_];
+  if(!saveDir()) {
+    files_[count_++] = *e;
+    *e = gone;
+    return false;
+  }
+  orphan(gone);
+  return true;
+}
+
+bool KvFs::rename(const char* from, const char* to) {
+  Entry* src = find(from);
+  if(!src || strlen(to) >= MAX_PATH) return false;
+  Entry* dst = find(to);
+  Entry replaced;
+  bool hadDst = dst != nullptr;
+  if(hadDst) {
+    replaced = *dst;
+    *dst = files_[--count_];
+    if(src == &files_[count_]) src = dst;
+  }
+  char oldPath[MAX_PATH];
+  strcpy(oldPath, src->path);
+  strcpy(src->path, to);
+  // one directory put: the new name appears and the old file goes together
+  if(!saveDir()) {
+    strcpy(src->path, oldPath);
+    if(hadDst) files_[count_++] = replaced;
+    return false;
+  }
+  if(hadDst) orphan(replaced);
+  return true;
+}
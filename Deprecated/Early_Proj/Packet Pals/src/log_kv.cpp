@@ -0,0 +1,449 @@
+// log_kv.cpp
+#include "log_kv.h"
+#include "crc32.h"
+#include <algorithm>
+#include <string.h>
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool allErased(const uint8_t* p, size_t len) {
+  for(size_t i = 0; i < len; i++) if(p[i] != 0xFF) return false;
+  return true;
+}
+
+static bool allZero(const uint8_t* p, size_t len) {
+  for(size_t i = 0; i < len; i++) if(p[i] != 0) return false;
+  return true;
+}
+
+// Record header with its CRC over header fields + value
+static void recordHeader(uint8_t* h, uint32_t key, uint16_t len, uint16_t kind, const void* data) {
+  put32(h, key);
+  h[4] = (uint8_t)len; h[5] = (uint8_t)(len >> 8);
+  h[6] = (uint8_t)kind; h[7] = (uint8_t)(kind >> 8);
+  put32(h + 8, crc32Update(crc32(h, 8), data, len));
+}
+
+LogKv::LogKv(FlashBackend &flash)
+  : flash_(flash), active_(-1), writeOff_(0), nextSeq_(0), freeSectors_(0),
+    backgroundFree_(BACKGROUND_FREE), victim_(-1), retired_(-1),
+    erasing_(false), compactOff_(0), picks_(0), stats_()
+{
+}
+
+bool LogKv::begin() {
+  size_t count = flash_.sectorCount();
+  // Entry packing: values under 4 KB, addresses under 4 MB
+  if(count < RESERVE_SECTORS + 2 || flash_.sectorSize() > 4096 ||
+     count * flash_.sectorSize() > (1u << 22)) return false;
+  backgroundFree_ = std::max((size_t)BACKGROUND_FREE, count / 16);
+  sectors_.assign(count, Sector());
+  index_.clear();
+  active_ = -1;
+  victim_ = -1;
+  retired_ = -1;
+  erasing_ = false;
+  nextSeq_ = 0;
+  freeSectors_ = 0;
+  uint32_t maxErase = 0;
+  std::vector<size_t> used;
+  for(size_t s = 0; s < count; s++) {
+    Sector &sec = sectors_[s];
+    uint8_t h[SECTOR_HEADER];
+    sec.seq = FREE_SEQ;
+    sec.eraseCount = 0;
+    sec.end = SECTOR_HEADER;
+    if(!flash_.read(s * flash_.sectorSize(), h, sizeof(h))) return false;
+    bool valid = get32(h) == SECTOR_MAGIC && get32(h + 8) == crc32(h, 8);
+    if(valid) {
+      sec.eraseCount = get32(h + 4);
+      sec.seq = get32(h + 12);
+      maxErase = std::max(maxErase, sec.eraseCount);
+    }
+    // a free header is only written after a completed erase
+    sec.checked = valid;
+    sec.foreign = !valid && !allErased(h, sizeof(h));
+    if(sec.seq == FREE_SEQ) freeSectors_++;
+    else used.push_back(s);
+  }
+  // sectors whose count was lost (blank, foreign) are as worn as the worst
+  for(Sector &sec : sectors_) {
+    if(!sec.checked && sec.seq == FREE_SEQ) sec.eraseCount = maxErase;
+  }
+  std::sort(used.begin(), used.end(), [this](size_t a, size_t b) {
+    return sectors_[a].seq < sectors_[b].seq;
+  });
+  for(size_t i = 0; i < used.size(); i++) scanSector(used[i], i + 1 == used.size());
+  for(const Entry &e : index_) sectors_[sectorOf(e.addr())].live += e.bytes();
+  if(!used.empty()) {
+    size_t s = used.back();
+    nextSeq_ = sectors_[s].seq + 1;
+    // a torn tail can't be written over; the next put opens a new sector
+    if(!sectors_[s].sealed) {
+      active_ = (int)s;
+      writeOff_ = sectors_[s].end;
+    }
+  }
+  return true;
+}
+
+// Replays one sector's records into the index. Only the newest sector can
+// hold a torn record, so only its values are read back for the CRC; the
+// others are checked for sane headers. A torn record gets its header
+// programmed to zeros, which later scans take as the end of the sector,
+// so it stays dead once newer sectors exist.
+void LogKv::scanSector(size_t s, bool newest) {
+  Sector &sec = sectors_[s];
+  size_t base = s * flash_.sectorSize();
+  size_t off = SECTOR_HEADER;
+  sec.sealed = false;
+  uint8_t h[RECORD_HEADER];
+  uint8_t buf[256];
+  while(off + RECORD_HEADER <= flash_.sectorSize()) {
+    if(!flash_.read(base + off, h, sizeof(h))) break;
+    uint32_t key = get32(h);
+    uint16_t len = h[4] | (h[5] << 8);
+    uint16_t kind = h[6] | (h[7] << 8);
+    if(key == 0xFFFFFFFF && len == 0xFFFF) break;   // erased: end of log
+    if(allZero(h, sizeof(h))) { sec.sealed = true; break; }
+    size_t size = recordSize(len);
+    bool bad = off + size > flash_.sectorSize() || kind > KIND_TOMBSTONE;
+    if(newest && !bad) {
+      uint32_t crc = crc32(h, 8);
+      for(size_t done = 0; done < len; ) {
+        size_t n = std::min(sizeof(buf), (size_t)len - done);
+        if(!flash_.read(base + off + RECORD_HEADER + done, buf, n)) break;
+        crc = crc32Update(crc, buf, n);
+        done += n;
+      }
+      bad = crc != get32(h + 8);
+    }
+    if(bad) {
+      static const uint8_t dead[RECORD_HEADER] = {0};
+      if(newest) flash_.write(base + off, dead, sizeof(dead));
+      sec.sealed = true;
+      break;
+    }
+    setEntry(key, (uint32_t)(base + off), len, kind);
+    off += size;
+  }
+  sec.end = (uint16_t)off;
+}
+
+bool LogKv::format() {
+  for(size_t s = 0; s < flash_.sectorCount(); s++) {
+    if(!eraseSector(s)) return false;
+  }
+  return begin();
+}
+
+LogKv::Entry* LogKv::find(uint32_t key) {
+  auto it = std::lower_bound(index_.begin(), index_.end(), key,
+    [](const Entry &e, uint32_t k) { return e.key < k; });
+  return it != index_.end() && it->key == key ? &*it : nullptr;
+}
+
+const LogKv::Entry* LogKv::find(uint32_t key) const {
+  return const_cast<LogKv*>(this)->find(key);
+}
+
+void LogKv::setEntry(uint32_t key, uint32_t addr, size_t len, uint16_t kind) {
+  auto it = std::lower_bound(index_.begin(), index_.end(), key,
+    [](const Entry &e, uint32_t k) { return e.key < k; });
+  if(it == index_.end() || it->key != key) it = index_.insert(it, Entry());
+  it->key = key;
+  it->loc = (addr >> 2) | ((uint32_t)(kind == KIND_TOMBSTONE ? TOMBSTONE_LEN : len) << 20);
+}
+
+void LogKv::dropEntry(Entry* e) {
+  index_.erase(index_.begin() + (e - &index_[0]));
+}
+
+size_t LogKv::length(uint32_t key) const {
+  const Entry* e = find(key);
+  return e && !e->tombstone() ? e->len() : NONE;
+}
+
+bool LogKv::read(uint32_t key, size_t offset, void* buf, size_t len) {
+  const Entry* e = find(key);
+  if(!e || e->tombstone() || offset + len > e->len()) return false;
+  return flash_.read(e->addr() + RECORD_HEADER + offset, buf, len);
+}
+
+bool LogKv::put(uint32_t key, const void* data, size_t len) {
+  if(key == 0xFFFFFFFF || len > maxValue()) return false;
+  uint32_t addr;
+  if(!append(key, KIND_VALUE, data, len, addr)) return false;
+  Entry* old = find(key);
+  if(old) sectors_[sectorOf(old->addr())].live -= old->bytes();
+  setEntry(key, addr, len, KIND_VALUE);
+  sectors_[sectorOf(addr)].live += recordSize(len);
+  stats_.userBytes += len;
+  return true;
+}
+
+bool LogKv::remove(uint32_t key) {
+  Entry* old = find(key);
+  if(!old || old->tombstone()) return true;
+  uint32_t addr;
+  if(!append(key, KIND_TOMBSTONE, nullptr, 0, addr)) return false;
+  old = find(key);   // append may have compacted
+  sectors_[sectorOf(old->addr())].live -= old->bytes();
+  setEntry(key, addr, 0, KIND_TOMBSTONE);
+  sectors_[sectorOf(addr)].live += recordSize(0);
+  return true;
+}
+
+void LogKv::forEach(const std::function<void(uint32_t key, size_t len)> &fn) const {
+  for(const Entry &e : index_) {
+    if(!e.tombstone()) fn(e.key, e.len());
+  }
+}
+
+bool LogKv::append(uint32_t key, uint16_t kind, const void* data, size_t len, uint32_t &addr) {
+  size_t size = recordSize(len);
+  if(!reserve(size, false)) return false;
+  uint8_t h[RECORD_HEADER];
+  recordHeader(h, key, (uint16_t)len, kind, data);
+  addr = (uint32_t)(active_ * flash_.sectorSize() + writeOff_);
+  // header first: a record cut short after it fails its CRC, one cut
+  // inside the header reads as damage, never as free space
+  bool ok = flash_.write(addr, h, sizeof(h)) &&
+            (len == 0 || flash_.write(addr + RECORD_HEADER, data, len));
+  writeOff_ += size;
+  sectors_[active_].end = (uint16_t)writeOff_;
+  stats_.flashBytes += RECORD_HEADER + len;
+  return ok;
+}
+
+bool LogKv::copyRecord(uint32_t from, size_t size, uint32_t &addr) {
+  if(!reserve(size, true)) return false;
+  addr = (uint32_t)(active_ * flash_.sectorSize() + writeOff_);
+  uint8_t buf[256];
+  bool ok = true;
+  for(size_t done = 0; ok && done < size; ) {
+    size_t n = std::min(sizeof(buf), size - done);
+    ok = flash_.read(from + done, buf, n);
+    // trailing pad is still 0xFF; programming it again is a no-op
+    ok = ok && flash_.write(addr + done, buf, n);
+    done += n;
+  }
+  writeOff_ += size;
+  sectors_[active_].end = (uint16_t)writeOff_;
+  stats_.flashBytes += size;
+  return ok;
+}
+
+// Makes room for `need` bytes at the head of the log
+bool LogKv::reserve(size_t need, bool compaction) {
+  if(active_ >= 0 && writeOff_ + need <= flash_.sectorSize()) return true;
+  return openSector(compaction);
+}
+
+bool LogKv::openSector(bool compaction) {
+  if(!compaction) {
+    // service() fell behind: compact here rather than use the spare
+    bool counted = false;
+    while(freeSectors_ <= RESERVE_SECTORS) {
+      if(!counted) { stats_.foreground++; counted = true; }
+      if(retired_ >= 0 && !erasing_) {
+        if(!eraseRetired()) return false;
+        continue;
+      }
+      size_t budget = (size_t)-1;
+      if(!compactStep(budget, false)) return false;   // full
+    }
+  }
+  int best = -1;
+  for(size_t s = 0; s < sectors_.size(); s++) {
+    if(sectors_[s].seq != FREE_SEQ) continue;
+    if(best < 0 || sectors_[s].eraseCount < sectors_[best].eraseCount) best = (int)s;
+  }
+  if(best < 0 || !prepareFree(best)) return false;
+  Sector &sec = sectors_[best];
+  uint8_t h[SECTOR_HEADER];
+  put32(h, SECTOR_MAGIC);
+  put32(h + 4, sec.eraseCount);
+  put32(h + 8, crc32(h, 8));
+  put32(h + 12, nextSeq_);
+  // a free sector already has the first three words; rewriting equal
+  // bits is harmless on NOR, so the whole header goes out either way
+  if(!flash_.write(best * flash_.sectorSize(), h, sizeof(h))) return false;
+  stats_.flashBytes += SECTOR_HEADER;
+  sec.seq = nextSeq_++;
+  sec.live = 0;
+  sec.end = SECTOR_HEADER;
+  sec.sealed = false;
+  sec.checked = false;
+  freeSectors_--;
+  active_ = best;
+  writeOff_ = SECTOR_HEADER;
+  return true;
+}
+
+// Free sectors found blank or foreign at mount are checked (and erased if
+// need be) only when first used, keeping mount to one header read each
+bool LogKv::prepareFree(size_t s) {
+  Sector &sec = sectors_[s];
+  if(sec.checked) return true;
+  bool clean = !sec.foreign;
+  uint8_t buf[256];
+  for(size_t off = SECTOR_HEADER; clean && off < flash_.sectorSize(); off += sizeof(buf)) {
+    size_t n = std::min(sizeof(buf), flash_.sectorSize() - off);
+    clean = flash_.read(s * flash_.sectorSize() + off, buf, n) && allErased(buf, n);
+  }
+  if(!clean) {
+    freeSectors_--;   // eraseSector() counts it back in
+    if(!eraseSector(s)) { freeSectors_++; return false; }
+  }
+  sec.checked = true;
+  return true;
+}
+
+bool LogKv::eraseSector(size_t s) {
+  return flash_.erase(s) && markErased(s);
+}
+
+// The bookkeeping after sector s was erased, and its wear header
+bool LogKv::markErased(size_t s) {
+  Sector &sec = sectors_[s];
+  bool wasFree = sec.seq == FREE_SEQ;
+  stats_.erases++;
+  sec.eraseCount++;
+  sec.seq = FREE_SEQ;
+  sec.live = 0;
+  sec.end = SECTOR_HEADER;
+  sec.sealed = false;
+  sec.checked = true;
+  sec.foreign = false;
+  if(!wasFree) freeSectors_++;
+  if(active_ == (int)s) active_ = -1;
+  // keep the wear count across the erase; seq stays erased until use
+  uint8_t h[SECTOR_HEADER - 4];
+  put32(h, SECTOR_MAGIC);
+  put32(h + 4, sec.eraseCount);
+  put32(h + 8, crc32(h, 8));
+  stats_.flashBytes += sizeof(h);
+  return flash_.write(s * flash_.sectorSize(), h, sizeof(h));
+}
+
+size_t LogKv::oldestUsed() const {
+  size_t best = NONE;
+  for(size_t s = 0; s < sectors_.size(); s++) {
+    if(sectors_[s].seq == FREE_SEQ) continue;
+    if(best == NONE || sectors_[s].seq < sectors_[best].seq) best = s;
+  }
+  return best;
+}
+
+int LogKv::pickVictim() {
+  size_t capacity = flash_.sectorSize() - SECTOR_HEADER;
+  int best = -1;
+  int coldest = -1;
+  uint32_t maxErase = 0;
+  for(size_t s = 0; s < sectors_.size(); s++) {
+    const Sector &sec = sectors_[s];
+    maxErase = std::max(maxErase, sec.eraseCount);
+    if(sec.seq == FREE_SEQ || (int)s == active_ || (int)s == retired_) continue;
+    if(best < 0 || sec.live < sectors_[best].live ||
+       (sec.live == sectors_[best].live && sec.eraseCount < sectors_[best].eraseCount)) best = (int)s;
+    if(coldest < 0 || sec.eraseCount < sectors_[coldest].eraseCount) coldest = (int)s;
+  }
+  if(++picks_ % WEAR_CHECK == 0 && coldest >= 0 &&
+     maxErase - sectors_[coldest].eraseCount > WEAR_SPREAD) {
+    stats_.wearMoves++;
+    return coldest;
+  }
+  // nothing to gain from a sector that is all live data
+  if(best >= 0 && sectors_[best].live >= capacity) return -1;
+  return best;
+}
+
+// Moves live records out of the victim, then erases it or (retire) leaves
+// it for a later erase; false if there was nothing to do or the copy failed
+bool LogKv::compactStep(size_t &budget, bool retire) {
+  if(victim_ < 0) {
+    victim_ = pickVictim();
+    if(victim_ < 0) return false;
+    compactOff_ = SECTOR_HEADER;
+  }
+  size_t base = victim_ * flash_.sectorSize();
+  bool oldest = oldestUsed() == (size_t)victim_;
+  while(compactOff_ < sectors_[victim_].end) {
+    uint8_t h[RECORD_HEADER];
+    if(!flash_.read(base + compactOff_, h, sizeof(h))) return false;
+    uint32_t addr = (uint32_t)(base + compactOff_);
+    size_t size = recordSize(h[4] | (h[5] << 8));
+    Entry* e = find(get32(h));
+    if(e && e->addr() == addr) {
+      sectors_[victim_].live -= size;
+      if(e->tombstone() && oldest) {
+        dropEntry(e);   // nothing older left for it to hide
+      } else {
+        uint32_t to;
+        if(!copyRecord(addr, size, to)) return false;
+        e = find(get32(h));
+        e->loc = (e->loc & ~0xFFFFFu) | (to >> 2);
+        sectors_[sectorOf(to)].live += size;
+      }
+      budget = budget > size ? budget - size : 0;
+    }
+    compactOff_ += size;
+    if(budget == 0 && compactOff_ < sectors_[victim_].end) return true;
+  }
+  size_t done = victim_;
+  victim_ = -1;
+  stats_.compactions++;
+  if(!retire) return eraseSector(done);
+  retired_ = (int)done;
+  return true;
+}
+
+bool LogKv::eraseRetired() {
+  if(!eraseSector(retired_)) return false;
+  retired_ = -1;
+  return true;
+}
+
+// One bounded piece of work per call: a copy slice or the erase, never both
+void LogKv::service(size_t budget) {
+  if(sectors_.empty()) return;
+  if(retired_ >= 0) {
+    if(!erasing_) eraseRetired();
+    return;
+  }
+  if(victim_ < 0 && freeSectors_ >= backgroundFree_) return;
+  compactStep(budget, true);
+}
+
+size_t LogKv::takeErase() {
+  if(retired_ < 0 || erasing_) return NONE;
+  erasing_ = true;
+  return retired_;
+}
+
+bool LogKv::finishErase(size_t s, bool erased) {
+  if(!erasing_ || (int)s != retired_) return false;
+  erasing_ = false;
+  if(!erased) return false;
+  retired_ = -1;
+  return markErased(s);
+}
+
+size_t LogKv::freeBytes() const {
+  if(sectors_.size() <= RESERVE_SECTORS) return 0;
+  size_t room = (sectors_.size() - RESERVE_SECTORS) * (flash_.sectorSize() - SECTOR_HEADER);
+  size_t live = 0;
+  for(const Sector &sec : sectors_) live += sec.live;
+  return live < room ? room - live : 0;
+}
+
+size_t LogKv::memoryBytes() const {
+  return sizeof(*this) + sectors_.capacity() * sizeof(Sector) + index_.capacity() * sizeof(Entry);
+}
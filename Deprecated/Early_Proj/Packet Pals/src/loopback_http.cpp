@@ -0,0 +1,248 @@
+// loopback_http.cpp
+#ifndef ARDUINO
+#include "loopback_http.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include "mac_addr.h"
+
+namespace {
+typedef std::vector<std::pair<std::string, std::string>> Fields;
+
+void urlDecode(const char* s, size_t len, std::string &out) {
+  out.clear();
+  for(size_t i = 0; i < len; i++) {
+    int hi = -1, lo = -1;
+    if(s[i] == '%' && i + 2 < len) {
+      hi = hexNibble(s[i + 1]);
+      lo = hi < 0 ? -1 : hexNibble(s[i + 2]);
+    }
+    if(lo >= 0) {
+      out += (char)(hi * 16 + lo);
+      i += 2;
+    } else {
+      out += s[i] == '+' ? ' ' : s[i];
+    }
+  }
+}
+
+class LoopbackRequest : public HttpRequest {
+public:
+  bool parse(const std::string &raw) {
+    size_t eol = raw.find("\r\n");
+    if(eol == std::string::npos) return false;
+    std::string start = raw.substr(0, eol);
+    size_t sp1 = start.find(' ');
+    size_t sp2 = sp1 == std::string::npos ? sp1 : start.find(' ', sp1 + 1);
+    if(sp2 == std::string::npos || start.compare(sp2 + 1, 5, "HTTP/") != 0) return false;
+    method_ = start.substr(0, sp1);
+    std::string target = start.substr(sp1 + 1, sp2 - sp1 - 1);
+    if(target.empty() || target[0] != '/') return false;
+
+    size_t q = target.find('?');
+    urlDecode(target.data(), q == std::string::npos ? target.size() : q, path_);
+    if(q != std::string::npos) {
+      size_t pos = q + 1;
+      while(pos <= target.size()) {
+        size_t amp = target.find('&', pos);
+        if(amp == std::string::npos) amp = target.size();
+        size_t eq = target.find('=', pos);
+        if(eq > amp) eq = amp;
+        if(eq > pos) {
+          std::string name, value;
+          urlDecode(target.data() + pos, eq - pos, name);
+          if(eq < amp) urlDecode(target.data() + eq + 1, amp - eq - 1, value);
+          args_.push_back(std::make_pair(name, value));
+        }
+        pos = amp + 1;
+      }
+    }
+
+    size_t pos = eol + 2;
+    while(pos < raw.size()) {
+      eol = raw.find("\r\n", pos);
+      if(eol == std::string::npos) eol = raw.size();
+      if(eol == pos) break;   // end of the headers
+      size_t colon = raw.find(':', pos);
+      if(colon == std::string::npos || colon > eol) return false;
+      size_t v = colon + 1;
+      while(v < eol && raw[v] == ' ') v++;
+      headers_.push_back(std::make_pair(raw.substr(pos, colon - pos), raw.substr(v, eol - v)));
+      pos = eol + 2;
+    }
+    return true;
+  }
+
+  const std::string& method() const { return method_; }
+  const char* path() const override { return path_.c_str(); }
+  bool head() const override { return method_ == "HEAD"; }
+  const char* arg(const char* name) const override { return find(args_, name, false); }
+  const char* header(const char* name) const override { return find(headers_, name, true); }
+
+private:
+  static const char* find(const Fields &fields, const char* name, bool anyCase) {
+    for(const auto &f : fields) {
+      if(anyCase ? strcasecmp(f.first.c_str(), name) == 0 : f.first == name) return f.second.c_str();
+    }
+    return nullptr;
+  }
+
+  std::string method_;
+  std::string path_;
+  Fields args_;
+  Fields headers_;
+};
+
+const char* reason(int code) {
+  switch(code) {
+    case 200: return "OK";
+    case 206: return "Partial Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 416: return "Range Not Satisfiable";
+    case 500: return "Internal Server Error";
+    default:  return "Unknown";
+  }
+}
+
+// A route takes its own path and the paths below it
+bool routeMatches(const char* route, const char* path) {
+  size_t n = strlen(route);
+  return strncmp(route, path, n) == 0 && (path[n] == '\0' || path[n] == '/');
+}
+
+bool sendAll(int fd, const std::string &data) {
+  size_t off = 0;
+  while(off < data.size()) {
+    ssize_t n = ::send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+    if(n <= 0) return false;
+    off += (size_t)n;
+  }
+  return true;
+}
+}
+
+LoopbackHttp::LoopbackHttp(const PalsRoute* routes, size_t routeCount, Handler fallback)
+  : routes_(routes), routeCount_(routeCount), fallback_(fallback)
+{
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+std::string LoopbackHttp::exchange(const std::string &raw) {
+  stats_.requests++;
+  LoopbackRequest request;
+  HttpResponse response;
+  if(!request.parse(raw)) {
+    stats_.malformed++;
+    response.send(400, "text/plain", "Malformed request");
+  } else {
+    Handler h = fallback_;
+    if(request.method() == "GET") {
+      for(size_t i = 0; i < routeCount_; i++) {
+        if(routeMatches(routes_[i].path, request.path())) {
+          h = routes_[i].handler;
+          break;
+        }
+      }
+    }
+    h(request, response);
+  }
+
+  HttpBody* body = response.body();
+  bool chunked = body && body->length() == HttpBody::CHUNKED;
+  char line[160];
+  std::string out;
+  snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n",
+           response.code(), reason(response.code()), response.type());
+  out += line;
+  for(size_t i = 0; i < response.headerCount(); i++) {
+    snprintf(line, sizeof(line), "%s: %s\r\n", response.headerName(i), response.headerValue(i));
+    out += line;
+  }
+  if(chunked) {
+    out += "Transfer-Encoding: chunked\r\n";
+  } else {
+    snprintf(line, sizeof(line), "Content-Length: %u\r\n", (unsigned)(body ? body->length() : 0));
+    out += line;
+  }
+  out += "Connection: close\r\n\r\n";
+  stats_.headBytes += out.size();
+  if(!body || request.head()) return out;
+
+  // pulled a send window at a time, as AsyncWebServer does on the board
+  uint8_t window[WINDOW];
+  size_t left = chunked ? (size_t)-1 : body->length();
+  while(left > 0) {
+    size_t room = chunked ? WINDOW - 8 : (left < WINDOW ? left : WINDOW);
+    size_t n = body->fill(window, room);
+    stats_.fills++;
+    if(n == 0) break;
+    stats_.bodyBytes += n;
+    if(chunked) {
+      snprintf(line, sizeof(line), "%x\r\n", (unsigned)n);
+      out += line;
+      out.append((const char*)window, n);
+      out += "\r\n";
+    } else {
+      out.append((const char*)window, n);
+      left -= n;
+    }
+  }
+  if(chunked) out += "0\r\n\r\n";
+  return out;
+}
+
+bool LoopbackHttp::serve(uint16_t port, uint32_t idleMs, void (*tick)()) {
+  int srv = socket(AF_INET, SOCK_STREAM, 0);
+  if(srv < 0) return false;
+  int on = 1;
+  setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(bind(srv, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(srv, 8) != 0) {
+    close(srv);
+    return false;
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point lastActive = Clock::now();
+  for(;;) {
+    if(tick) tick();
+    pollfd p = { srv, POLLIN, 0 };
+    if(poll(&p, 1, 10) <= 0) {
+      uint64_t idle = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lastActive).count();
+      if(idleMs && idle >= idleMs) break;
+      continue;
+    }
+    int fd = accept(srv, nullptr, nullptr);
+    if(fd < 0) continue;
+    std::string raw;
+    char buf[1024];
+    while(raw.find("\r\n\r\n") == std::string::npos && raw.size() < 8192) {
+      pollfd c = { fd, POLLIN, 0 };
+      if(poll(&c, 1, 2000) <= 0) break;
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if(n <= 0) break;
+      raw.append(buf, (size_t)n);
+    }
+    if(!raw.empty()) sendAll(fd, exchange(raw));
+    close(fd);
+    lastActive = Clock::now();
+  }
+  close(srv);
+  return true;
+}
+
+#endif
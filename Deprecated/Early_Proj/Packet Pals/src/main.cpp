@@ -1,147 +1,189 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
-#include <vector>
-#include <unordered_set>
-#include <esp_wifi.h> // for wifi_auth_mode_t if needed
+#include <memory>
+#include "pal_fs.h"
+#include "pal_hal.h"
+#include "pal_http.h"
+#include "pals_core.h"
+#include "flash_backend.h"
+#include "save_format.h"
+#include "ble_frame.h"
+#include "session_table.h"
+#include "scan_trace.h"
+
+// The game itself is in pals_core.cpp, on the PalHal interfaces; this file
+// is the ESP32 around it: WiFi, SPIFFS and the "pals" partition, the
+// AsyncWebServer front end, the BLE companion link and the scan task.
+// src/native_main.cpp is the same core on a Linux host.
 
 // -------------------------------------------------------------------
 // 0) GLOBAL SERVER
-WebServer server(80);
+// Requests are parsed and answered on the AsyncTCP task, so any number of
+// clients can be mid-request at once and a slow one no longer holds up
+// the rest. Handlers and loop() both touch the game state; the core takes
+// gLock around it (a handler only while it builds its response, loop()
+// around each service step).
+AsyncWebServer server(80);
+
+static ArduinoPalFs gFs(SPIFFS);
+static PartitionFlash gStateFlash("pals");
+static WifiRadio gWifi;
+static EspRng gRng;
+static EspClock gClock;
+static RtosLock gLock;
+
+// SCAN_TRACE_RECORD: every sweep is also appended to /scans.trace on
+// SPIFFS (scan_trace.h), for replaying on a workstation with the native
+// build. /downloadScans fetches it.
+#ifndef SCAN_TRACE_RECORD
+#define SCAN_TRACE_RECORD 0
+#endif
+static const char* SCAN_TRACE_FILE = "/scans.trace";
+static RecordingRadio gRecorder(gWifi, gClock, gFs, SCAN_TRACE_FILE);
+
+void logLine(const char* line){
+  Serial.println(line);
+}
 
 // -------------------------------------------------------------------
-// 1) Custom Hasher & Equality for Arduino String
-struct StringHash {
-  size_t operator()(const String &key) const {
-    const char* str = key.c_str();
-    size_t hash = 0;
-    while (*str) {
-      hash = 37 * hash + (unsigned char)*str++;
-    }
-    return hash;
-  }
-};
+// 1) Requests and responses
+// The core sees an AsyncWebServerRequest through HttpRequest and answers
+// with an HttpResponse, whose body is pulled as the socket drains.
+class AsyncHttpRequest : public HttpRequest {
+public:
+  explicit AsyncHttpRequest(AsyncWebServerRequest *r) : r_(r) {}
 
-struct StringEqual {
-  bool operator()(const String &a, const String &b) const {
-    return a == b;
+  const char* path() const override { return r_->url().c_str(); }
+  bool head() const override { return r_->method()==HTTP_HEAD; }
+  const char* arg(const char* name) const override {
+    return r_->hasArg(name) ? r_->arg(name).c_str() : nullptr;
+  }
+  const char* header(const char* name) const override {
+    return r_->hasHeader(name) ? r_->header(name).c_str() : nullptr;
   }
-};
 
-// -------------------------------------------------------------------
-// 2) Data Structures
-struct Monster {
-  String name;
-  int level;
-  int hp;
-  int defense;
+private:
+  AsyncWebServerRequest *r_;
 };
 
-struct Player {
-  String name;
-  int level;
-  bool hasStarter;
-};
+// A body of known length. headOnly (HEAD) announces the length but sends
+// no body.
+class BodyResponse : public AsyncAbstractResponse {
+public:
+  BodyResponse(std::unique_ptr<HttpBody> body, int code, const char* type, bool headOnly)
+    : body_(std::move(body)), headOnly_(headOnly)
+  {
+    _code= code;
+    _contentType= type;
+    _contentLength= body_->length();
+  }
 
-// The user’s 3-monster party
-static Monster userParty[3];
-static int userPartySize = 0;
-static Player gPlayer = { "NoName", 1, false };
+  bool _sourceValid() const override { return true; }
 
-// The "wild" monsters discovered by scanning
-static std::vector<Monster> gMonsters;
+  size_t _fillBuffer(uint8_t *buf, size_t maxLen) override {
+    return body_->fill(buf, maxLen);
+  }
 
-// BSSIDs we've encountered. We'll persist them so we skip old networks even after reboot.
-static std::unordered_set<String, StringHash, StringEqual> encounteredBSSIDs;
+  void _respond(AsyncWebServerRequest *request) override {
+    if(!headOnly_){
+      AsyncAbstractResponse::_respond(request);
+      return;
+    }
+    addHeader("Connection","close");
+    String head= _assembleHead(request->version());
+    _headLength= head.length();
+    _state= RESPONSE_WAIT_ACK;
+    _writtenLength+= request->client()->write(head.c_str(), _headLength);
+  }
 
-// -------------------------------------------------------------------
-// 3) Filenames
-static const char* PLAYER_FILE  = "/player.json";
-static const char* PARTY_FILE   = "/userparty.json";
-static const char* WIGLE_FILE   = "/wigledata.csv";
-static const char* BSSID_FILE   = "/bssids.json"; // store encountered BSSIDs
+private:
+  std::unique_ptr<HttpBody> body_;
+  bool headOnly_;
+};
 
-// -------------------------------------------------------------------
-// 4) Load/Save BSSIDs in /bssids.json
-bool saveEncounteredBSSIDs() {
-  File f = SPIFFS.open(BSSID_FILE, "w");
-  if(!f){
-    Serial.println("Failed open /bssids.json for writing");
-    return false;
-  }
-  DynamicJsonDocument doc(8192);
-  JsonArray arr= doc.createNestedArray("bssids");
-  for(const auto &bssid : encounteredBSSIDs){
-    arr.add(bssid);
+void sendAsync(AsyncWebServerRequest *request, bool head, HttpResponse &response){
+  std::unique_ptr<HttpBody> body= response.takeBody();
+  AsyncWebServerResponse *r;
+  if(!body){
+    r= request->beginResponse(response.code());
+  } else if(body->length()==HttpBody::CHUNKED){
+    // HTTP chunks, pulled by the AsyncTCP task
+    std::shared_ptr<HttpBody> pager(std::move(body));
+    r= request->beginChunkedResponse(response.type(),
+      [pager](uint8_t *buf, size_t maxLen, size_t) -> size_t {
+        return pager->fill(buf, maxLen);
+      });
+    r->setCode(response.code());
+  } else {
+    r= new BodyResponse(std::move(body), response.code(), response.type(), head);
   }
-  if(serializeJson(doc, f)==0){
-    Serial.println("Fail write /bssids.json");
-    f.close();
-    return false;
+  for(size_t i=0; i<response.headerCount(); i++){
+    r->addHeader(response.headerName(i), response.headerValue(i));
   }
-  f.close();
-  return true;
+  request->send(r);
 }
 
-bool loadEncounteredBSSIDs() {
-  if(!SPIFFS.exists(BSSID_FILE)){
-    Serial.println("No /bssids.json found; starting empty.");
+void answer(AsyncWebServerRequest *request,
+            void (*handler)(const HttpRequest&, HttpResponse&)){
+  AsyncHttpRequest req(request);
+  HttpResponse response;
+  handler(req, response);
+  sendAsync(request, req.head(), response);
+}
+
+// Everything no route claims, any method, as the old onNotFound did.
+// Added last so the routes are tried first. The request headers the
+// static path needs are only kept if asked for before they are parsed,
+// which is what canHandle() is for.
+class StaticFileHandler : public AsyncWebHandler {
+public:
+  bool canHandle(AsyncWebServerRequest *request) override {
+    for(size_t i=0; i<PALS_STATIC_HEADER_COUNT; i++){
+      request->addInterestingHeader(PALS_STATIC_HEADERS[i]);
+    }
     return true;
   }
-  File f= SPIFFS.open(BSSID_FILE,"r");
-  if(!f){
-    Serial.println("Failed open /bssids.json for read");
-    return false;
-  }
-  DynamicJsonDocument doc(8192);
-  DeserializationError err= deserializeJson(doc,f);
-  f.close();
-  if(err){
-    Serial.println("Fail parse /bssids.json");
-    return false;
-  }
-  JsonArray arr= doc["bssids"].as<JsonArray>();
-  if(!arr.isNull()){
-    for(const auto &elem : arr){
-      encounteredBSSIDs.insert(elem.as<String>());
-    }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    answer(request, palsServeStatic);
   }
-  Serial.printf("Loaded %u BSSIDs from /bssids.json\n",(unsigned)encounteredBSSIDs.size());
-  return true;
-}
+};
 
 // -------------------------------------------------------------------
-// 5) Recalculate a monster's HP/defense from its level
-void recalcMonsterStats(Monster &mon) {
-  if(mon.level<1) mon.level=1;
-  mon.hp = 30 + 5*(mon.level -1);
-  mon.defense = 5 + (mon.level -1);
+// 2) Saves from older firmware
+// JSON readers below are only used to migrate older saves; the core hands
+// them whatever it finds that is not the binary format.
+static const char* PLAYER_FILE = "/player.json";
+static const char* PARTY_FILE  = "/userparty.json";
+static const size_t LEGACY_SLOT_DOC = 1536;   // JSON save slots were at most 768 bytes
+
+void applyPlayerJson(JsonObject o, SaveGame &g){
+  String name= o["name"] | "NoName";
+  copyName(g.playerName, sizeof(g.playerName), name.c_str());
+  g.playerLevel= o["level"]      | 1;
+  g.hasStarter = o["hasStarter"] | false;
 }
 
-// -------------------------------------------------------------------
-// 6) Load/Save Player
-bool savePlayer() {
-  File f = SPIFFS.open(PLAYER_FILE, "w");
-  if(!f){
-    Serial.println("Failed to open /player.json for write");
-    return false;
-  }
-  DynamicJsonDocument doc(256);
-  doc["name"]       = gPlayer.name;
-  doc["level"]      = gPlayer.level;
-  doc["hasStarter"] = gPlayer.hasStarter;
-  if(serializeJson(doc, f)==0){
-    Serial.println("Fail write /player.json");
-    f.close();
-    return false;
+// {"partySize":n,"party":[...]}: both the snapshot and /userparty.json
+void applyPartyJson(DynamicJsonDocument &doc, SaveGame &g){
+  JsonArray arr= doc["party"].as<JsonArray>();
+  int idx=0;
+  for(JsonObject o : arr){
+    if(idx>=SaveGame::PARTY_MAX) break;
+    String name= o["name"].as<String>();
+    copyName(g.party[idx].name, sizeof(g.party[idx].name), name.c_str());
+    g.party[idx].level  = o["level"].as<int>();
+    g.party[idx].hp     = o["hp"]   |30;
+    g.party[idx].defense= o["defense"]|5;
+    idx++;
   }
-  f.close();
-  return true;
+  g.partySize= idx;
 }
 
-bool loadPlayer() {
+bool loadLegacyPlayer(SaveGame &g) {
   if(!SPIFFS.exists(PLAYER_FILE)){
     Serial.println("No /player.json, defaults used.");
     return true;
@@ -158,45 +200,14 @@ bool loadPlayer() {
     Serial.println("Fail parse /player.json");
     return false;
   }
-  gPlayer.name       = doc["name"]       | "NoName";
-  gPlayer.level      = doc["level"]      | 1;
-  gPlayer.hasStarter = doc["hasStarter"] | false;
-  Serial.printf("Loaded Player: name=%s, level=%d, hasStarter=%d\n",
-    gPlayer.name.c_str(), gPlayer.level, gPlayer.hasStarter);
+  applyPlayerJson(doc.as<JsonObject>(), g);
   return true;
 }
 
-// -------------------------------------------------------------------
-// 7) Load/Save Party
-bool saveUserParty() {
-  File f= SPIFFS.open(PARTY_FILE,"w");
-  if(!f){
-    Serial.println("Failed open /userparty.json write");
-    return false;
-  }
-  DynamicJsonDocument doc(512);
-  doc["partySize"] = userPartySize;
-  JsonArray arr= doc.createNestedArray("party");
-  for(int i=0; i<userPartySize; i++){
-    JsonObject o= arr.createNestedObject();
-    o["name"]    = userParty[i].name;
-    o["level"]   = userParty[i].level;
-    o["hp"]      = userParty[i].hp;
-    o["defense"] = userParty[i].defense;
-  }
-  if(serializeJson(doc,f)==0){
-    Serial.println("Fail write /userparty.json");
-    f.close();
-    return false;
-  }
-  f.close();
-  return true;
-}
-
-bool loadUserParty() {
+bool loadLegacyParty(SaveGame &g) {
   if(!SPIFFS.exists(PARTY_FILE)){
     Serial.println("No /userparty.json, empty party");
-    userPartySize=0;
+    g.partySize=0;
     return true;
   }
   File f= SPIFFS.open(PARTY_FILE,"r");
@@ -211,507 +222,209 @@ bool loadUserParty() {
     Serial.println("Fail parse /userparty.json");
     return false;
   }
-  int size= doc["partySize"] | 0;
-  if(size<0) size=0;
-  if(size>3) size=3;
-  userPartySize= size;
-  JsonArray arr= doc["party"].as<JsonArray>();
-  int idx=0;
-  for(JsonObject o : arr){
-    if(idx>=3) break;
-    userParty[idx].name    = o["name"].as<String>();
-    userParty[idx].level   = o["level"].as<int>();
-    userParty[idx].hp      = o["hp"]   |30;
-    userParty[idx].defense = o["defense"]|5;
-    idx++;
-  }
-  userPartySize= idx;
-  Serial.printf("Loaded userParty, size=%d\n", userPartySize);
+  applyPartyJson(doc, g);
   return true;
 }
 
-// -------------------------------------------------------------------
-// 8) Possibly assign a starter monster
-void checkStarterMonster() {
-  if(!gPlayer.hasStarter){
-    if(userPartySize<3){
-      Monster st;
-      st.name  = "StarterPal";
-      st.level = 1;
-      recalcMonsterStats(st);
-      userParty[userPartySize++]= st;
-      saveUserParty();
-    }
-    gPlayer.hasStarter= true;
-    savePlayer();
-    Serial.println("Assigned starter monster on first run.");
+// LegacySaveReader: a JSON save slot, else the old files
+bool readLegacySave(const uint8_t* slot, size_t len, SaveGame &g){
+  if(slot){
+    DynamicJsonDocument doc(LEGACY_SLOT_DOC);
+    if(deserializeJson(doc, (const char*)slot, len)) return false;
+    applyPlayerJson(doc["player"].as<JsonObject>(), g);
+    applyPartyJson(doc, g);
+    return true;
   }
+  bool player= loadLegacyPlayer(g);
+  bool party= loadLegacyParty(g);
+  return player && party;
 }
 
 // -------------------------------------------------------------------
-// 9) Original multi-column Wigle CSV
-// columns: MAC,SSID,AuthMode,FirstSeen,Channel,RSSI,CurrentLatitude,CurrentLongitude,Type
-String encryptionTypeToString(wifi_auth_mode_t auth){
-  switch(auth){
-    case WIFI_AUTH_OPEN:         return "Open";
-    case WIFI_AUTH_WEP:          return "WEP";
-    case WIFI_AUTH_WPA_PSK:      return "WPA";
-    case WIFI_AUTH_WPA2_PSK:     return "WPA2";
-    case WIFI_AUTH_WPA_WPA2_PSK: return "WPA_WPA2";
-    case WIFI_AUTH_WPA2_ENTERPRISE: return "WPA2_ENTERPRISE";
-    default: return "Unknown";
-  }
-}
-
-void appendWigleRow(const String& ssid, const String& bssid, wifi_auth_mode_t auth,
-                    int channel, int rssi) 
-{
-  File f= SPIFFS.open(WIGLE_FILE,"a");
-  if(!f){
-    Serial.println("Fail open wigledata.csv for append");
-    return;
-  }
-  // If empty, write the original columns
-  if(f.size()==0){
-    f.println("MAC,SSID,AuthMode,FirstSeen,Channel,RSSI,CurrentLatitude,CurrentLongitude,Type");
-  }
-  // Build row
-  // If you need to replace commas in SSID, do it here
-  String safeSSID= ssid;
-  safeSSID.replace(",","_");
-  // placeholder date/time, lat/lon
-  String row = bssid + "," + safeSSID + "," + encryptionTypeToString(auth)
-             + ",2023-01-01 00:00:00,"
-             + String(channel) + "," + String(rssi)
-             + ",0.00000,0.00000,WIFI\n";
-  f.print(row);
-  f.close();
-}
+// 3) Continuous scanning
+// CONTINUOUS_SCAN (pals_core.cpp): a task pinned to core 0 sweeps over
+// and over; the core drains what it finds on the loop task (core 1).
+static const uint32_t SCAN_PAUSE_MS = 2000;  // between continuous sweeps, lets AP clients catch up
 
-void handleDownloadWigle(){
-  if(!SPIFFS.exists(WIGLE_FILE)){
-    server.send(404,"text/plain","No wigle data found");
-    return;
-  }
-  File ff= SPIFFS.open(WIGLE_FILE,"r");
-  if(!ff){
-    server.send(500,"text/plain","Failed open wigledata.csv");
-    return;
-  }
-  server.sendHeader("Content-Disposition","attachment; filename=\"wigledata.csv\"");
-  server.streamFile(ff,"text/csv");
-  ff.close();
-}
-
-void handleClearWigle(){
-  if(SPIFFS.exists(WIGLE_FILE)){
-    SPIFFS.remove(WIGLE_FILE);
-    server.send(200,"text/plain","Cleared wigle data");
-  } else {
-    server.send(404,"text/plain","No wigle data file found");
+void scanTask(void*){
+  for(;;){
+    palsSweep();
+    vTaskDelay(pdMS_TO_TICKS(SCAN_PAUSE_MS));
   }
 }
 
 // -------------------------------------------------------------------
-// 10) Monster Name arrays
-static const char* FUN_PREFIXES[]={
-  "Star","Candy","Turbo","Spark","Rainbow",
-  "Mega","Fizzy","Funky","Magic","Cosmic",
-  "Butter","Jolly","Mighty","Sunny","Lava"
-};
-static const char* FUN_SUFFIXES[]={
-  "Dino","Bat","Cat","Dog","Fish",
-  "Dragon","Bee","Fairy","Ghost","Bear",
-  "Zard","Robot","Frog","Pup","Wizard"
-};
-String generateKidFriendlyName(){
-  int pCount= sizeof(FUN_PREFIXES)/sizeof(FUN_PREFIXES[0]);
-  int sCount= sizeof(FUN_SUFFIXES)/sizeof(FUN_SUFFIXES[0]);
-  String pr= FUN_PREFIXES[random(pCount)];
-  String sf= FUN_SUFFIXES[random(sCount)];
-  return pr + sf;
-}
-
-// -------------------------------------------------------------------
-// 11) Scan with ignoring old BSSIDs, Original wigle CSV
-void scanNetworks(){
-  Serial.println("Scanning networks...");
-  int n= WiFi.scanNetworks(false,true);
-  if(n<=0){
-    Serial.println("No networks found.");
-    return;
-  }
-  Serial.printf("Found %d networks.\n", n);
-
-  for(int i=0; i<n;i++){
-    String bssid= WiFi.BSSIDstr(i);
-    if(encounteredBSSIDs.find(bssid)!= encounteredBSSIDs.end()){
-      // skip duplicates
-      continue;
-    }
-    // new BSSID => log
-    encounteredBSSIDs.insert(bssid);
-    saveEncounteredBSSIDs();
-
-    wifi_auth_mode_t auth= WiFi.encryptionType(i);
-    int channel= WiFi.channel(i);
-    int rssi   = WiFi.RSSI(i);
-    String ssid= WiFi.SSID(i);
-
-    // original multi-col approach
-    appendWigleRow(ssid,bssid,auth,channel,rssi);
-
-    // create scaled monster
-    Monster mon;
-    mon.name= generateKidFriendlyName();
-    int base= gPlayer.level;
-    int minL= base-3; if(minL<1) minL=1;
-    int maxL= base+3;
-    int newLevel= random(minL, maxL+1);
-    if(newLevel<1) newLevel=1;
-    mon.level= newLevel;
-    recalcMonsterStats(mon);
-
-    gMonsters.push_back(mon);
-  }
-  Serial.println("Monsters updated after scanning.");
-}
-
-void handleScan(){
-  scanNetworks();
-  server.send(200,"text/plain","Scan done, monsters updated, wigle data logged.");
-}
-
-void handleMonsters(){
-  DynamicJsonDocument doc(2048);
-  JsonArray arr= doc["monsters"].to<JsonArray>();
-  for(auto &mm: gMonsters){
-    JsonObject o= arr.createNestedObject();
-    o["name"]= mm.name;
-    o["level"]= mm.level;
+// 4) Companion app over BLE
+// WD_Companion (ble_service.dart) connects to PacketPals_Device and
+// subscribes to one characteristic. The roster and a party go out as
+// ble_frame.h records (palsServiceCompanion()), batched for BLE_BATCH_MS
+// so what a scan finds shares notifications. The app writes commands to
+// the same characteristic:
+//   "R"          send everything again (after BleRx saw a seq gap)
+//   "S<token>"   follow that session's party; by default the party shown
+//                is that of the phone that played last
+// BLE callbacks run on the Bluetooth task and only leave requests in
+// bleReq; loop() hands them to the core.
+//
+// BLE_COMPANION is off by default: the Bluedroid stack adds several
+// hundred KB of code, and with WiFi and AsyncWebServer the image no longer
+// fits app0 (1.25 MB in partitions.csv). Building with -DBLE_COMPANION=1
+// needs a partition table with a bigger app slot.
+#ifndef BLE_COMPANION
+#define BLE_COMPANION 0
+#endif
+#if BLE_COMPANION
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLE2902.h>
+
+static const char* BLE_NAME         = "PacketPals_Device";
+static const char* BLE_SERVICE_UUID = "12345678-1234-1234-1234-123456789abc";
+static const char* BLE_CHAR_UUID    = "abcd1234-5678-90ab-cdef-1234567890ab";
+static const uint32_t BLE_BATCH_MS = 50;
+
+static BLECharacteristic *gBleChar= nullptr;
+
+class NotifyLink : public BleLink {
+public:
+  bool send(const uint8_t* frame, size_t len) override {
+    gBleChar->setValue((uint8_t*)frame, len);
+    gBleChar->notify();
+    return true;
   }
-  String out; 
-  serializeJson(doc,out);
-  server.send(200,"application/json", out);
-}
-
-// -------------------------------------------------------------------
-// 12) Battle logic
-struct BattleState {
-  bool inProgress;
-  int partyIndex;
-  int wildIndex;
 };
-
-static BattleState battleState= {false,-1,-1};
-
-void handleStartBattle(){
-  if(!server.hasArg("wildIndex")|| !server.hasArg("partyIndex")){
-    server.send(400,"text/plain","Need wildIndex & partyIndex");
-    return;
-  }
-  int wIdx= server.arg("wildIndex").toInt();
-  int pIdx= server.arg("partyIndex").toInt();
-  if(wIdx<0|| wIdx>=(int)gMonsters.size()){
-    server.send(400,"text/plain","Invalid wildIndex");
-    return;
-  }
-  if(pIdx<0|| pIdx>=userPartySize){
-    server.send(400,"text/plain","Invalid partyIndex");
-    return;
-  }
-  battleState.inProgress= true;
-  battleState.wildIndex= wIdx;
-  battleState.partyIndex= pIdx;
-
-  Monster &pm= userParty[pIdx];
-  Monster &wm= gMonsters[wIdx];
-
-  DynamicJsonDocument doc(256);
-  doc["inProgress"]= true;
-  doc["partyName"] = pm.name;
-  doc["partyLevel"]= pm.level;
-  doc["partyHP"]   = pm.hp;
-  doc["wildName"]  = wm.name;
-  doc["wildLevel"] = wm.level;
-  doc["wildHP"]    = wm.hp;
-
-  String out;
-  serializeJson(doc,out);
-  server.send(200,"application/json", out);
-}
-
-void handleBattleAction(){
-  if(!battleState.inProgress){
-    server.send(400,"text/plain","No battle in progress");
-    return;
-  }
-  if(!server.hasArg("action")){
-    server.send(400,"text/plain","Missing action param");
-    return;
-  }
-  String action= server.arg("action");
-  bool battleEnd= false;
-  String msg;
-
-  Monster &partyMon= userParty[battleState.partyIndex];
-  Monster &wildMon = gMonsters[battleState.wildIndex];
-
-  if(action=="attack"){
-    int pDmg= random(1,6);
-    int wDmg= random(1,5);
-    wildMon.hp -= pDmg;
-    msg += partyMon.name + " attacked for "+ String(pDmg)+" dmg. ";
-    if(wildMon.hp>0){
-      partyMon.hp -= wDmg;
-      msg += wildMon.name + " countered for "+ String(wDmg)+" dmg. ";
-    }
-  } else if(action=="defend"){
-    int wDmg= random(1,5)/2;
-    if(wDmg<1) wDmg=1;
-    partyMon.hp-= wDmg;
-    msg += partyMon.name + " defended. "+ wildMon.name+" hits for "+String(wDmg)+" dmg.";
-  } else if(action=="capture"){
-    if(userPartySize>=3){
-      msg+="Party is full! Can't capture!";
-    } else {
-      int chance= random(0,100);
-      if(chance<30){
-        msg+="Capture success! " + wildMon.name + " joined your party.";
-        battleEnd= true;
-        userParty[userPartySize].name   = wildMon.name;
-        userParty[userPartySize].level  = wildMon.level;
-        userParty[userPartySize].hp     = wildMon.hp;
-        userParty[userPartySize].defense= wildMon.defense;
-        userPartySize++;
-        saveUserParty();
-      } else {
-        int wDmg= random(1,5);
-        partyMon.hp-= wDmg;
-        msg+="Capture failed! "+ wildMon.name+" hits for "+ String(wDmg)+ " dmg.";
-      }
-    }
-  } else if(action=="run"){
-    msg+="Ran away from battle!";
-    battleEnd= true;
-  } else {
-    server.send(400,"text/plain","Unknown action");
-    return;
+static NotifyLink gBleLink;
+static BleBatcher gBle(gBleLink);
+
+static BleRequests bleReq= { false, false, BLE_MTU_MIN, 0 };
+static portMUX_TYPE bleMux= portMUX_INITIALIZER_UNLOCKED;
+
+class BleServerEvents : public BLEServerCallbacks {
+  void onConnect(BLEServer*) override {
+    portENTER_CRITICAL(&bleMux);
+    bleReq.connected= true;
+    bleReq.mtu= BLE_MTU_MIN;
+    portEXIT_CRITICAL(&bleMux);
+  }
+  void onDisconnect(BLEServer *srv) override {
+    portENTER_CRITICAL(&bleMux);
+    bleReq.connected= false;
+    bleReq.follow= 0;
+    portEXIT_CRITICAL(&bleMux);
+    srv->startAdvertising();
+  }
+  void onMtuChanged(BLEServer*, esp_ble_gatts_cb_param_t *param) override {
+    portENTER_CRITICAL(&bleMux);
+    bleReq.mtu= param->mtu.mtu;
+    portEXIT_CRITICAL(&bleMux);
   }
+};
 
-  // check faint
-  if(wildMon.hp<=0){
-    msg+=" "+ wildMon.name+" fainted! Your monster wins!";
-    partyMon.level++;
-    recalcMonsterStats(partyMon);
-    gPlayer.level++;
-    savePlayer();
-    battleEnd= true;
-  }
-  if(partyMon.hp<=0){
-    msg+=" "+ partyMon.name+" fainted! The wild monster wins!";
-    battleEnd= true;
-  }
-  DynamicJsonDocument doc(512);
-  doc["message"]= msg;
-  doc["partyHP"]= partyMon.hp;
-  doc["wildHP"] = wildMon.hp;
-  doc["battleEnd"]= battleEnd;
-
-  if(battleEnd){
-    battleState.inProgress= false;
-    // restore wild if not captured
-    if(action!="capture"){
-      recalcMonsterStats(wildMon);
-    }
-    // heal entire party
-    for(int i=0; i<userPartySize; i++){
-      recalcMonsterStats(userParty[i]);
+class BleCommands : public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic *c) override {
+    auto v= c->getValue();
+    const char* cmd= v.c_str();
+    uint64_t token;
+    if(v.length()==1 && cmd[0]=='R'){
+      portENTER_CRITICAL(&bleMux);
+      bleReq.resync= true;
+      portEXIT_CRITICAL(&bleMux);
+    } else if(v.length()>1 && cmd[0]=='S' && parseToken(cmd+1, v.length()-1, token)){
+      portENTER_CRITICAL(&bleMux);
+      bleReq.follow= token;
+      portEXIT_CRITICAL(&bleMux);
     }
-    saveUserParty();
-  }
-
-  String out;
-  serializeJson(doc,out);
-  server.send(200,"application/json", out);
-}
-
-// -------------------------------------------------------------------
-// 13) Party endpoints
-void handleMyParty(){
-  DynamicJsonDocument doc(1024);
-  doc["partySize"]= userPartySize;
-  JsonArray arr= doc["party"].to<JsonArray>();
-  for(int i=0;i<userPartySize;i++){
-    JsonObject o= arr.createNestedObject();
-    o["name"]  = userParty[i].name;
-    o["level"] = userParty[i].level;
-    o["hp"]    = userParty[i].hp;
-    o["defense"] = userParty[i].defense;
   }
-  String out;
-  serializeJson(doc,out);
-  server.send(200,"application/json", out);
-}
-
-void handleRemoveFromParty(){
-  if(!server.hasArg("slot")){
-    server.send(400,"text/plain","Missing slot");
-    return;
-  }
-  int slot= server.arg("slot").toInt();
-  if(slot<0||slot>=userPartySize){
-    server.send(400,"text/plain","Invalid slot");
-    return;
-  }
-  // cannot remove last monster
-  if(userPartySize<=1){
-    server.send(400,"text/plain","You cannot remove your final monster!");
-    return;
-  }
-  for(int i=slot; i<userPartySize-1; i++){
-    userParty[i]= userParty[i+1];
-  }
-  userPartySize--;
-  saveUserParty();
-
-  DynamicJsonDocument doc(256);
-  doc["message"]= "Removed monster at slot "+String(slot);
-  doc["partySize"]= userPartySize;
-  JsonArray arr= doc.createNestedArray("party");
-  for(int i=0;i<userPartySize;i++){
-    JsonObject o= arr.createNestedObject();
-    o["name"]   = userParty[i].name;
-    o["level"]  = userParty[i].level;
-    o["hp"]     = userParty[i].hp;
-    o["defense"]= userParty[i].defense;
-  }
-  String out;
-  serializeJson(doc,out);
-  server.send(200,"application/json", out);
-}
-
-void handleSwapPartySlots(){
-  if(!server.hasArg("slot1")||!server.hasArg("slot2")){
-    server.send(400,"text/plain","Need slot1 & slot2");
-    return;
-  }
-  int s1= server.arg("slot1").toInt();
-  int s2= server.arg("slot2").toInt();
-  if(s1<0||s1>=userPartySize|| s2<0|| s2>=userPartySize){
-    server.send(400,"text/plain","Invalid slot indices");
-    return;
-  }
-  Monster tmp= userParty[s1];
-  userParty[s1]= userParty[s2];
-  userParty[s2]= tmp;
-  saveUserParty();
-
-  DynamicJsonDocument doc(256);
-  doc["message"]= "Swapped slots "+String(s1)+" and "+String(s2);
-  doc["partySize"]= userPartySize;
-  JsonArray arr= doc.createNestedArray("party");
-  for(int i=0;i<userPartySize;i++){
-    JsonObject o= arr.createNestedObject();
-    o["name"]= userParty[i].name;
-    o["level"]= userParty[i].level;
-    o["hp"]= userParty[i].hp;
-    o["defense"]= userParty[i].defense;
-  }
-  String out; 
-  serializeJson(doc,out);
-  server.send(200,"application/json", out);
-}
+};
 
-// -------------------------------------------------------------------
-// 14) Serve index.html, app.js
-void handleRoot(){
-  File ff= SPIFFS.open("/index.html","r");
-  if(!ff){
-    server.send(404,"text/plain","index.html not found");
-    return;
-  }
-  server.streamFile(ff,"text/html");
-  ff.close();
+void beginBle(){
+  BLEDevice::init(BLE_NAME);
+  BLEDevice::setMTU(BLE_MTU_MAX);
+  BLEServer *srv= BLEDevice::createServer();
+  srv->setCallbacks(new BleServerEvents());
+  BLEService *svc= srv->createService(BLE_SERVICE_UUID);
+  gBleChar= svc->createCharacteristic(BLE_CHAR_UUID,
+    BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_WRITE);
+  gBleChar->addDescriptor(new BLE2902());
+  gBleChar->setCallbacks(new BleCommands());
+  svc->start();
+  gBle.setDelay(BLE_BATCH_MS);
+  BLEDevice::getAdvertising()->addServiceUUID(BLE_SERVICE_UUID);
+  BLEDevice::startAdvertising();
 }
 
-void handleAppJS(){
-  File ff= SPIFFS.open("/app.js","r");
-  if(!ff){
-    server.send(404,"text/plain","app.js not found");
-    return;
-  }
-  server.streamFile(ff,"text/javascript");
-  ff.close();
-}
-
-void handleNotFound(){
-  String path= server.uri();
-  if(!path.startsWith("/")) path= "/"+ path;
-  if(!SPIFFS.exists(path)){
-    server.send(404,"text/plain","File not found");
-    return;
-  }
-  File fl= SPIFFS.open(path,"r");
-  if(!fl){
-    server.send(500,"text/plain","Fail open file");
-    return;
-  }
-  if(path.endsWith(".css")){
-    server.streamFile(fl,"text/css");
-  } else if(path.endsWith(".js")){
-    server.streamFile(fl,"text/javascript");
-  } else {
-    server.streamFile(fl,"text/html");
-  }
-  fl.close();
+// One step of keeping the app in sync; call from loop()
+void serviceBle(){
+  BleRequests req;
+  portENTER_CRITICAL(&bleMux);
+  req= bleReq;
+  bleReq.resync= false;
+  portEXIT_CRITICAL(&bleMux);
+  palsServiceCompanion(gBle, req);
 }
+#endif
 
 // -------------------------------------------------------------------
-// 15) Setup & Loop
+// 5) Setup & Loop
 void setup(){
   Serial.begin(115200);
   delay(500);
+  gLock.begin();
 
-  if(!SPIFFS.begin(true)){
+  // 16 open files, not 10: without a "pals" partition the seen-set keeps a
+  // reader open per segment (up to 6) beside the web and Wigle files
+  if(!SPIFFS.begin(true, "/spiffs", 16)){
     Serial.println("SPIFFS mount failed.");
     return;
   }
-  // load encountered BSSIDs first
-  loadEncounteredBSSIDs();
-  loadPlayer();
-  loadUserParty();
-  checkStarterMonster();
+  PalRadio *radio= SCAN_TRACE_RECORD ? (PalRadio*)&gRecorder : (PalRadio*)&gWifi;
+  PalHal hal= { &gFs, gStateFlash.begin() ? &gStateFlash : nullptr,
+                radio, &gRng, &gClock, &gLock, logLine };
+  palsBegin(hal, readLegacySave);
 
   WiFi.mode(WIFI_AP);
   WiFi.softAP("PacketPals-AP");
   Serial.print("AP IP: ");
   Serial.println(WiFi.softAPIP());
+  palsBootPhase("wifi");
 
-  randomSeed(analogRead(0));
-
-  server.on("/",               HTTP_GET, handleRoot);
-  server.on("/app.js",         HTTP_GET, handleAppJS);
-
-  server.on("/scan",           HTTP_GET, handleScan);
-  server.on("/monsters",       HTTP_GET, handleMonsters);
-
-  server.on("/downloadWigle",  HTTP_GET, handleDownloadWigle);
-  server.on("/clearWigle",     HTTP_GET, handleClearWigle);
+#if BLE_COMPANION
+  beginBle();
+  palsBootPhase("ble");
+#endif
 
-  server.on("/myParty",        HTTP_GET, handleMyParty);
-  server.on("/removeFromParty",HTTP_GET, handleRemoveFromParty);
-  server.on("/swapPartySlots", HTTP_GET, handleSwapPartySlots);
-
-  server.on("/startBattle",    HTTP_GET, handleStartBattle);
-  server.on("/battleAction",   HTTP_GET, handleBattleAction);
+  // PALS_ROUTES is already ordered longest path first
+  for(size_t i=0; i<PALS_ROUTE_COUNT; i++){
+    void (*handler)(const HttpRequest&, HttpResponse&)= PALS_ROUTES[i].handler;
+    server.on(PALS_ROUTES[i].path, HTTP_GET, [handler](AsyncWebServerRequest *request){
+      answer(request, handler);
+    });
+  }
+  if(SCAN_TRACE_RECORD){
+    server.on("/downloadScans", HTTP_GET, [](AsyncWebServerRequest *request){
+      if(!SPIFFS.exists(SCAN_TRACE_FILE)) request->send(404,"text/plain","No scans recorded");
+      else request->send(SPIFFS, SCAN_TRACE_FILE, "text/plain", true);
+    });
+  }
 
-  server.onNotFound(handleNotFound);
+  // "/", "/app.js" and the rest of data/
+  server.addHandler(new StaticFileHandler());
   server.begin();
+  palsBootPhase("http");
+  palsBootTotal();
+
+  if(palsContinuousScan()){
+    // radio sweeps on core 0, the game on the loop task (core 1), the web
+    // server on the AsyncTCP task
+    xTaskCreatePinnedToCore(scanTask, "scan", 4096, nullptr, 1, nullptr, 0);
+  }
 
   Serial.println("Server started. Connect to 'PacketPals-AP', open http://192.168.4.1/");
 }
 
 void loop(){
-  server.handleClient();
+  palsLoop();
+#if BLE_COMPANION
+  serviceBle();
+#endif
 }
@@ -0,0 +1,287 @@
+// native_main.cpp
+// The Packet Pals core on a Linux host: replays a scan trace through the
+// game as the board would see it, drives a scripted play session through
+// the loopback HTTP front end, and reports host timings next to the
+// core's own counters. The state store runs on FileFlash (a file-backed
+// NOR emulator with the chip's rules and modelled timings), so a second
+// run boots from what the first one left, as a reboot would.
+//
+//   pio run -e native && .pio/build/native/program --synth 300
+//   g++ -std=gnu++17 -O2 -pthread -DCONTINUOUS_SCAN=0 -Iinclude $(ls src/*.cpp | grep -v '/main.cpp') -o /tmp/pals_native
+//   /tmp/pals_native --synth 300 --seed 7 --state /tmp/pals_state
+//
+// Options:
+//   --state DIR          web files, Wigle CSV and the flash image (default ./pals_state)
+//   --flash FILE|ram|none  state partition: file-backed (default DIR/pals.bin),
+//                        in RAM only, or none (state on DIR like a board without it)
+//   --trace FILE         sweeps to replay (scan_trace.h)
+//   --synth N            N synthetic sweeps instead (default 200)
+//   --aps N              access points in the synthetic neighbourhood (default 600)
+//   --seed S             seeds the synthetic walk and the game's RNG (default 1)
+//   --write-trace FILE   save the trace being replayed
+//   --serve PORT         afterwards, play on http://127.0.0.1:PORT/ until Ctrl-C
+//   --quiet              no core log lines
+#ifndef ARDUINO
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "pals_core.h"
+#include "scan_trace.h"
+#include "loopback_http.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static ManualClock gClock;
+static bool gQuiet= false;
+
+static void logLine(const char* line){
+  if(!gQuiet) printf("  | %s\n", line);
+}
+
+static double usSince(Clock::time_point t0){
+  return std::chrono::duration<double, std::micro>(Clock::now()-t0).count();
+}
+
+static double percentile(std::vector<double> v, double p){
+  if(v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[(size_t)(p*(v.size()-1))];
+}
+
+// One scripted request through the front end, timed
+struct Exchange {
+  int code;
+  std::string head;
+  std::string body;
+  double us;
+};
+
+static Exchange request(LoopbackHttp &http, const std::string &target, const std::string &token,
+                        const char* extra= ""){
+  std::string raw= "GET "+ target +" HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+  if(!token.empty()) raw+= "X-Pals-Session: "+ token +"\r\n";
+  raw+= extra;
+  raw+= "\r\n";
+  Clock::time_point t0= Clock::now();
+  std::string out= http.exchange(raw);
+  Exchange x;
+  x.us= usSince(t0);
+  x.code= atoi(out.c_str()+9);
+  size_t split= out.find("\r\n\r\n");
+  x.head= out.substr(0, split);
+  x.body= split==std::string::npos ? "" : out.substr(split+4);
+  return x;
+}
+
+static std::string headerValue(const Exchange &x, const char* name){
+  std::string key= std::string("\r\n")+ name +": ";
+  size_t at= x.head.find(key);
+  if(at==std::string::npos) return "";
+  size_t end= x.head.find("\r\n", at+key.size());
+  return x.head.substr(at+key.size(), end-at-key.size());
+}
+
+// First "id": in a JSON body
+static long firstId(const std::string &body){
+  size_t at= body.find("\"id\":");
+  return at==std::string::npos ? 0 : atol(body.c_str()+at+5);
+}
+
+static void printTimes(const char* what, const std::vector<double> &us){
+  printf("  %-22s n=%-5u p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", what,
+    (unsigned)us.size(), percentile(us, 0.5), percentile(us, 0.99), percentile(us, 1.0));
+}
+
+static Clock::time_point gServeStart;
+static uint32_t gServeBaseMs= 0;
+
+static void serveTick(){
+  gClock.set(gServeBaseMs+ (uint32_t)(usSince(gServeStart)/1000));
+  palsLoop();
+}
+
+int main(int argc, char** argv){
+  std::string stateDir= "pals_state", flashArg, tracePath, writeTrace;
+  size_t synthSweeps= 200, synthAps= 600;
+  uint64_t seed= 1;
+  int servePort= 0;
+  for(int i=1; i<argc; i++){
+    std::string a= argv[i];
+    const char* v= i+1<argc ? argv[i+1] : nullptr;
+    if(a=="--quiet"){ gQuiet= true; continue; }
+    if(!v){ fprintf(stderr, "%s needs a value\n", a.c_str()); return 2; }
+    if(a=="--state") stateDir= v;
+    else if(a=="--flash") flashArg= v;
+    else if(a=="--trace") tracePath= v;
+    else if(a=="--synth") synthSweeps= strtoul(v, nullptr, 10);
+    else if(a=="--aps") synthAps= strtoul(v, nullptr, 10);
+    else if(a=="--seed") seed= strtoull(v, nullptr, 10);
+    else if(a=="--write-trace") writeTrace= v;
+    else if(a=="--serve") servePort= atoi(v);
+    else { fprintf(stderr, "unknown option %s\n", a.c_str()); return 2; }
+    i++;
+  }
+
+  mkdir(stateDir.c_str(), 0755);
+  PosixPalFs files(stateDir);
+  PosixPalFs host("");
+
+  std::unique_ptr<RamFlash> flash;
+  if(flashArg=="ram"){
+    flash.reset(new RamFlash(4096, 320));
+  } else if(flashArg!="none"){
+    // the "pals" partition of partitions.csv: 0x140000 bytes
+    std::string path= flashArg.empty() ? stateDir+"/pals.bin" : flashArg;
+    FileFlash *f= new FileFlash(path, 4096, 320);
+    flash.reset(f);
+    if(!f->ok()){
+      fprintf(stderr, "cannot open %s\n", path.c_str());
+      return 1;
+    }
+  }
+
+  ScanTrace trace;
+  if(!tracePath.empty()){
+    if(!trace.load(host, tracePath.c_str())){
+      fprintf(stderr, "cannot read trace %s\n", tracePath.c_str());
+      return 1;
+    }
+  } else {
+    trace= ScanTrace::synthetic(seed, synthSweeps, synthAps);
+  }
+  if(!writeTrace.empty() && !trace.save(host, writeTrace.c_str())){
+    fprintf(stderr, "cannot write %s\n", writeTrace.c_str());
+    return 1;
+  }
+
+  TraceRadio radio(trace);
+  SeededRng rng(seed);
+  StdLock lock;
+  PalHal hal= { &files, flash.get(), &radio, &rng, &gClock, &lock, logLine };
+
+  printf("pals native: %u sweeps, %u records, state %s, flash %s\n",
+    (unsigned)trace.sweeps().size(), (unsigned)trace.records(), stateDir.c_str(),
+    flash ? (flashArg=="ram" ? "ram" : "file") : "none");
+
+  Clock::time_point t0= Clock::now();
+  palsBegin(hal);
+  double bootUs= usSince(t0);
+  LoopbackHttp http(PALS_ROUTES, PALS_ROUTE_COUNT, palsServeStatic);
+
+  // replay: each sweep at its recorded time, /scan as the page asks for it,
+  // the loop run until the sweep is processed and then across the gap to
+  // the next one (saves and merges happen on their timers)
+  std::vector<double> sweepUs, scanReqUs, loopUs;
+  uint32_t ms;
+  t0= Clock::now();
+  while(radio.nextMs(ms)){
+    if(ms>gClock.millis()) gClock.set(ms);
+    Exchange x= request(http, "/scan", "");
+    scanReqUs.push_back(x.us);
+    Clock::time_point s0= Clock::now();
+    int passes= 0;
+    do {
+      palsLoop();
+      gClock.advance(1);
+    } while(palsStats().scanning && ++passes<100000);
+    sweepUs.push_back(usSince(s0));
+
+    uint32_t until= 0;
+    if(!radio.nextMs(until)) until= gClock.millis()+ 5000;
+    while(gClock.millis()+100<until){
+      Clock::time_point l0= Clock::now();
+      palsLoop();
+      loopUs.push_back(usSince(l0));
+      gClock.advance(100);
+    }
+  }
+  double replayUs= usSince(t0);
+
+  // a phone playing against what was found; it gets its token with its
+  // first battle, reads before that start no session
+  std::vector<double> reqUs;
+  size_t sessionsBefore= palsStats().sessions;
+  Exchange x= request(http, "/myParty", "");
+  reqUs.push_back(x.us);
+  bool guestToken= !headerValue(x, "X-Pals-Session").empty();
+  std::string etag= headerValue(x, "ETag");
+  x= request(http, "/myParty", "", ("If-None-Match: "+ etag +"\r\n").c_str());
+  reqUs.push_back(x.us);
+  bool notModified= x.code==304;
+  bool readOnlyMinted= guestToken || palsStats().sessions!=sessionsBefore;
+  std::string token;
+  x= request(http, "/monsters?limit=20", token);
+  reqUs.push_back(x.us);
+  long wild= firstId(x.body);
+  size_t monstersBytes= x.body.size();
+  int turns= 0;
+  if(wild>0){
+    x= request(http, "/startBattle?wildId="+ std::to_string(wild) +"&partyIndex=0", token);
+    reqUs.push_back(x.us);
+    token= headerValue(x, "X-Pals-Session");
+    while(x.code==200 && turns<30 && x.body.find("\"battleEnd\":true")==std::string::npos){
+      x= request(http, "/battleAction?action=attack", token);
+      reqUs.push_back(x.us);
+      turns++;
+    }
+  }
+  x= request(http, "/sync?since=0", token);
+  reqUs.push_back(x.us);
+  size_t syncBytes= x.body.size();
+  x= request(http, "/monsters", token);
+  reqUs.push_back(x.us);
+  size_t rosterBytes= x.body.size();
+  // let the write-behind save land
+  for(int i=0; i<40; i++){ gClock.advance(100); palsLoop(); }
+
+  PalsStats st= palsStats();
+  const LoopbackHttp::Stats &hs= http.stats();
+  printf("\nhost timings\n");
+  printf("  boot                   %10.1f us\n", bootUs);
+  printf("  replay                 %10.1f us  (%.0f records/s)\n", replayUs,
+    replayUs>0 ? trace.records()*1e6/replayUs : 0.0);
+  printTimes("/scan request", scanReqUs);
+  printTimes("sweep processed", sweepUs);
+  printTimes("idle loop pass", loopUs);
+  printTimes("session requests", reqUs);
+  printf("\ngame\n");
+  printf("  seen %u, wild %u, sessions %u, last sweep #%u found %u new\n",
+    (unsigned)st.seen, (unsigned)st.wild, (unsigned)st.sessions, (unsigned)st.scanJob,
+    (unsigned)st.newMonsters);
+  printf("  seen lookups %u, Bloom rejects %u, segment reads %u, merges %u (%u short of room), %u segments\n",
+    (unsigned)st.seenLookups, (unsigned)st.bloomRejects, (unsigned)st.segmentReads,
+    (unsigned)st.merges, (unsigned)st.mergesNoRoom, (unsigned)st.seenSegments);
+  printf("  save writes %u, Wigle appends %u (%u rows dropped), journal drops %u\n",
+         (unsigned)st.saveWrites, (unsigned)st.wigleAppends, (unsigned)st.wigleDrops,
+         (unsigned)st.journalDrops);
+  printf("  session: token-less reads started one %s, 304 on unchanged party %s, %d battle turns, /monsters?limit=20 %u B, /monsters %u B, /sync %u B\n",
+    readOnlyMinted ? "YES" : "no", notModified ? "yes" : "NO", turns, (unsigned)monstersBytes, (unsigned)rosterBytes, (unsigned)syncBytes);
+  printf("\nhttp: %u requests (%u malformed), %u body pulls, %llu head + %llu body bytes\n",
+    (unsigned)hs.requests, (unsigned)hs.malformed, (unsigned)hs.fills,
+    (unsigned long long)hs.headBytes, (unsigned long long)hs.bodyBytes);
+  if(flash){
+    printf("flash: %llu bytes programmed, modelled busy %.1f ms\n",
+      (unsigned long long)flash->bytesProgrammed(), flash->busyUs()/1000.0);
+  }
+
+  if(servePort){
+    printf("\nserving http://127.0.0.1:%d/ (Ctrl-C to stop)\n", servePort);
+    gServeStart= Clock::now();
+    gServeBaseMs= gClock.millis();
+    if(!http.serve((uint16_t)servePort, 0, serveTick)){
+      fprintf(stderr, "cannot bind port %d\n", servePort);
+      return 1;
+    }
+  }
+  bool ok= !readOnlyMinted && notModified && (wild==0 || (!token.empty() && turns>0));
+  printf("check:  %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+#endif
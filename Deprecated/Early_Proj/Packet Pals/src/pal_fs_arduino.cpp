@@ -0,0 +1,30 @@
+// pal_fs_arduino.cpp
+#ifdef ARDUINO
+#include "pal_fs.h"
+
+namespace {
+class ArduinoPalFile : public PalFile {
+public:
+  explicit ArduinoPalFile(fs::File f) : f_(f) {}
+  ~ArduinoPalFile() override { f_.close(); }
+  size_t read(uint8_t* buf, size_t len) override { return f_.read(buf, len); }
+  size_t write(const uint8_t* buf, size_t len) override { return f_.write(buf, len); }
+  bool seek(size_t pos) override { return f_.seek(pos); }
+  size_t size() override { return f_.size(); }
+  void flush() override { f_.flush(); }
+private:
+  fs::File f_;
+};
+}
+
+std::unique_ptr<PalFile> ArduinoPalFs::open(const char* path, const char* mode) {
+  fs::File f = fs_.open(path, mode);
+  if(!f) return nullptr;
+  return std::unique_ptr<PalFile>(new ArduinoPalFile(f));
+}
+
+bool ArduinoPalFs::exists(const char* path) { return fs_.exists(path); }
+bool ArduinoPalFs::remove(const char* path) { return fs_.remove(path); }
+bool ArduinoPalFs::rename(const char* from, const char* to) { return fs_.rename(from, to); }
+
+#endif
@@ -0,0 +1,49 @@
+// pal_fs_posix.cpp
+#ifndef ARDUINO
+#include "pal_fs.h"
+#include <stdio.h>
+
+namespace {
+class PosixPalFile : public PalFile {
+public:
+  explicit PosixPalFile(FILE* f) : f_(f) {}
+  ~PosixPalFile() override { fclose(f_); }
+  size_t read(uint8_t* buf, size_t len) override { return fread(buf, 1, len, f_); }
+  size_t write(const uint8_t* buf, size_t len) override { return fwrite(buf, 1, len, f_); }
+  bool seek(size_t pos) override { return fseek(f_, (long)pos, SEEK_SET) == 0; }
+  size_t size() override {
+    long cur = ftell(f_);
+    fseek(f_, 0, SEEK_END);
+    long end = ftell(f_);
+    fseek(f_, cur, SEEK_SET);
+    return end < 0 ? 0 : (size_t)end;
+  }
+  void flush() override { fflush(f_); }
+private:
+  FILE* f_;
+};
+}
+
+std::unique_ptr<PalFile> PosixPalFs::open(const char* path, const char* mode) {
+  const char* m = "rb";
+  if(mode[0] == 'w') m = "wb";
+  else if(mode[0] == 'a') m = "ab";
+  FILE* f = fopen(hostPath(path).c_str(), m);
+  if(!f) return nullptr;
+  return std::unique_ptr<PalFile>(new PosixPalFile(f));
+}
+
+bool PosixPalFs::exists(const char* path) {
+  FILE* f = fopen(hostPath(path).c_str(), "rb");
+  if(!f) return false;
+  fclose(f);
+  return true;
+}
+
+bool PosixPalFs::remove(const char* path) { return ::remove(hostPath(path).c_str()) == 0; }
+
+bool PosixPalFs::rename(const char* from, const char* to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+#endif
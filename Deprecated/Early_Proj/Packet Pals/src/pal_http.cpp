@@ -0,0 +1,50 @@
+// pal_http.cpp
+#include "pal_http.h"
+#include <string.h>
+
+namespace {
+class TextBody : public HttpBody {
+public:
+  explicit TextBody(const char* text) : len_(strlen(text)), sent_(0), text_(new char[len_ + 1]) {
+    memcpy(text_.get(), text, len_ + 1);
+  }
+  size_t length() const override { return len_; }
+  size_t fill(uint8_t* out, size_t room) override {
+    size_t n = len_ - sent_ < room ? len_ - sent_ : room;
+    memcpy(out, text_.get() + sent_, n);
+    sent_ += n;
+    return n;
+  }
+private:
+  size_t len_;
+  size_t sent_;
+  std::unique_ptr<char[]> text_;
+};
+}
+
+bool CopiedBody::write(const char* data, size_t len) {
+  if(len > CAPACITY - len_) return false;
+  memcpy(body_ + len_, data, len);
+  len_ += len;
+  return true;
+}
+
+size_t CopiedBody::fill(uint8_t* out, size_t room) {
+  size_t n = len_ - sent_ < room ? len_ - sent_ : room;
+  memcpy(out, body_ + sent_, n);
+  sent_ += n;
+  return n;
+}
+
+void HttpResponse::send(int code, const char* type, const char* text) {
+  send(code, type, std::unique_ptr<HttpBody>(new TextBody(text)));
+}
+
+bool HttpResponse::addHeader(const char* name, const char* value) {
+  if(headers_ == MAX_HEADERS) return false;
+  names_[headers_] = name;
+  strncpy(values_[headers_], value, MAX_VALUE - 1);
+  values_[headers_][MAX_VALUE - 1] = '\0';
+  headers_++;
+  return true;
+}
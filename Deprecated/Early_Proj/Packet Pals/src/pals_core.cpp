@@ -0,0 +1,1577 @@
+// pals_core.cpp
+#include "pals_core.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include "mac_addr.h"
+#include "seen_index.h"
+#include "wigle_log.h"
+#include "scan_record.h"
+#include "spsc_ring.h"
+#include "json_stream.h"
+#include "static_assets.h"
+#include "wild_roster.h"
+#include "monster_gen.h"
+#include "save_store.h"
+#include "boot_image.h"
+#include "log_kv.h"
+#include "kv_fs.h"
+#include "pull_sink.h"
+#include "api_schema.h"
+#include "battle.h"
+#include "session_table.h"
+#include "change_log.h"
+#include "sync_feed.h"
+
+// -------------------------------------------------------------------
+// 0) Platform
+// Everything the board provides comes through gHal (pal_hal.h). Handlers
+// run on the server's task and palsLoop() on the loop task; both touch the
+// game state below, and each takes the state lock for as long as it does
+// (a handler only while it builds its response, palsLoop() around each
+// service step).
+static PalHal gHal;
+static LegacySaveReader gLegacySave= nullptr;
+
+class StateLock {
+public:
+  StateLock(){ gHal.lock->lock(); }
+  ~StateLock(){ gHal.lock->unlock(); }
+};
+
+static uint32_t nowMs(){
+  return gHal.clock->millis();
+}
+
+static void logf(const char* fmt, ...){
+  char line[160];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if(gHal.log) gHal.log(line);
+}
+
+static const char* headerOf(const HttpRequest &request, const char* name){
+  const char* v= request.header(name);
+  return v ? v : "";
+}
+
+// Until palsBegin() points the stores at the board's
+class NoFs : public PalFs {
+public:
+  std::unique_ptr<PalFile> open(const char*, const char*) override { return nullptr; }
+  bool exists(const char*) override { return false; }
+  bool remove(const char*) override { return false; }
+  bool rename(const char*, const char*) override { return false; }
+};
+static NoFs gNoFs;
+
+// Body straight from a PalFile, read as the socket drains: len bytes from
+// offset first
+class FileBody : public HttpBody {
+public:
+  FileBody(std::unique_ptr<PalFile> f, uint32_t first, uint32_t len)
+    : f_(std::move(f)), len_(len), left_(len)
+  {
+    if(f_ && !f_->seek(first)) f_.reset();
+  }
+
+  bool ok() const { return f_!=nullptr; }
+  size_t length() const override { return len_; }
+
+  size_t fill(uint8_t *out, size_t room) override {
+    if(!f_) return 0;
+    size_t n= f_->read(out, room<left_ ? room : left_);
+    left_-= n;
+    return n;
+  }
+
+private:
+  std::unique_ptr<PalFile> f_;
+  size_t len_;
+  size_t left_;
+};
+
+// JSON body of an api_schema.h view, rendered straight into the send
+// window as the socket drains; the view is copied in, so the state lock
+// can be dropped as soon as the handler returns.
+template<class T>
+class SchemaBody : public HttpBody {
+public:
+  explicit SchemaBody(const T &view) : body_(view), len_(body_.length()) {}
+  size_t length() const override { return len_; }
+  size_t fill(uint8_t *out, size_t room) override { return body_.fill(out, room); }
+
+private:
+  JsonBody<T> body_;
+  size_t len_;
+};
+
+template<class T>
+std::unique_ptr<HttpBody> schemaBody(const T &view){
+  return std::unique_ptr<HttpBody>(new SchemaBody<T>(view));
+}
+
+// -------------------------------------------------------------------
+// 1) BSSIDs we've encountered, as raw 48-bit MACs. Recent ones live in RAM
+// (journaled to /bssids.bin), older ones in a few sorted segments on flash
+// (/seen.seg, /seen.seg.1, ...) with a Bloom filter in front, so we skip
+// old networks even after reboot and RAM stays bounded however many we've
+// seen. Flash doesn't: see seen_index.h for what the partition holds.
+//
+// Game state (these files, the save slots, the boot image) lives on the raw
+// "pals" partition through LogKv, away from SPIFFS and its GC stalls;
+// SPIFFS keeps the web files and the Wigle CSV. gStateFs falls back to
+// SPIFFS if the partition table has no "pals" partition.
+static const char* SEEN_SEGMENT_FILE = "/seen.seg";
+static const char* BSSID_FILE        = "/bssids.bin";  // journal of recent BSSIDs
+static const char* LEGACY_BSSID_FILE = "/bssids.json"; // pre-journal format, migrated on boot
+
+static PalFsRef gFs(gNoFs);
+static std::unique_ptr<LogKv> gStateKv;
+static std::unique_ptr<KvFs> gKvFs;
+static PalFsRef gStateFs(gNoFs);
+static SeenIndex encounteredBSSIDs(gStateFs, SEEN_SEGMENT_FILE, BSSID_FILE);
+
+// -------------------------------------------------------------------
+// 2) Data Structures
+// Every phone on the AP plays its own game: player, 3-monster party and
+// battle live in a Session (session_table.h), found by the token cookie
+// the phone got with its first request that changes its game; reads from
+// a phone without one are answered from a guest game that is never
+// stored. When all SESSION_MAX slots are taken, a new phone gets the
+// least recently used one if it has been idle SESSION_MIN_IDLE_MS, else a
+// 503.
+#ifndef SESSION_MAX
+#define SESSION_MAX 8
+#endif
+#ifndef SESSION_MIN_IDLE_MS
+#define SESSION_MIN_IDLE_MS (10UL*60*1000)
+#endif
+typedef SessionTable<SESSION_MAX> Sessions;
+static Sessions gSessions;
+static const char* SESSION_COOKIE = "pals";
+static const char* SESSION_HEADER = "X-Pals-Session";   // for clients without cookies
+
+// The "wild" monsters discovered by scanning: fixed capacity, the oldest
+// (or weakest) one makes room for a new find
+#ifndef WILD_ROSTER_CAPACITY
+#define WILD_ROSTER_CAPACITY 256
+#endif
+typedef WildRoster<WILD_ROSTER_CAPACITY> Roster;
+static const Roster::Eviction WILD_EVICTION = Roster::EVICT_OLDEST;
+static Roster gMonsters;
+
+// Every change to the roster, the seen-set, a party or a player, numbered
+// for /sync?since= (change_log.h)
+#ifndef CHANGE_LOG_SIZE
+#define CHANGE_LOG_SIZE 256
+#endif
+static Change gChangeRing[CHANGE_LOG_SIZE];
+static ChangeLog gChanges(gChangeRing, CHANGE_LOG_SIZE);
+
+// -------------------------------------------------------------------
+// 3) Filenames
+static const char* PLAYER_FILE  = "/player.json";     // pre-SaveStore saves,
+static const char* PARTY_FILE   = "/userparty.json";  // read once to migrate
+static const char* WIGLE_FILE   = "/wigledata.csv";
+static const char* SAVE_SLOT_A  = "/save.a";
+static const char* SAVE_SLOT_B  = "/save.b";
+static const char* BOOT_IMAGE_FILE = "/boot.img";
+
+// Every session's player + party are saved together, write-behind:
+// handlers only mark the state dirty and palsLoop() writes one snapshot
+// SAVE_DELAY_MS later
+static const uint32_t SAVE_DELAY_MS = 2000;
+static const size_t SAVE_MAX_BYTES = SESSION_SAVE_BYTES(SESSION_MAX);
+static_assert(SAVE_MAX_BYTES>=768, "room for the JSON saves being migrated");
+static SaveStore saveStore(gStateFs, SAVE_SLOT_A, SAVE_SLOT_B, SAVE_MAX_BYTES);
+
+// -------------------------------------------------------------------
+// 4) Load/Save encountered BSSIDs
+
+// Copies a state file older firmware kept on SPIFFS onto the partition
+// (via a temp name, so a reboot midway just copies again), then drops it
+bool moveStateFile(const char* path){
+  if(!gFs.exists(path) || gKvFs->exists(path)) return true;
+  char tmp[KvFs::MAX_PATH];
+  snprintf(tmp, sizeof(tmp), "%s.mv", path);
+  std::unique_ptr<PalFile> in= gFs.open(path,"r");
+  std::unique_ptr<PalFile> out= gKvFs->open(tmp,"w");
+  if(!in || !out) return false;
+  uint8_t buf[256];
+  size_t n;
+  while((n= in->read(buf, sizeof(buf)))>0){
+    if(out->write(buf, n)!=n) return false;
+  }
+  out.reset();
+  in.reset();
+  if(!gKvFs->rename(tmp, path)) return false;
+  gFs.remove(path);
+  return true;
+}
+
+bool mountStateStore(){
+  if(!gHal.stateFlash){
+    logf("No 'pals' partition; game state stays on SPIFFS");
+    return false;
+  }
+  gStateKv.reset(new LogKv(*gHal.stateFlash));
+  gKvFs.reset(new KvFs(*gStateKv));
+  if(!gStateKv->begin() || !gKvFs->begin()){
+    logf("'pals' partition mount failed; game state stays on SPIFFS");
+    gKvFs.reset();
+    gStateKv.reset();
+    return false;
+  }
+  gStateFs.set(*gKvFs);
+  const char* files[]= { SEEN_SEGMENT_FILE, BSSID_FILE, SAVE_SLOT_A, SAVE_SLOT_B, BOOT_IMAGE_FILE };
+  for(const char* path : files){
+    if(!moveStateFile(path)) logf("Could not move %s off SPIFFS", path);
+  }
+  for(size_t i=1; i<SeenIndex::SEGMENT_SLOTS; i++){
+    char path[KvFs::MAX_PATH];
+    snprintf(path, sizeof(path), "%s.%u", SEEN_SEGMENT_FILE, (unsigned)i);
+    if(!moveStateFile(path)) logf("Could not move %s off SPIFFS", path);
+  }
+  logf("State partition: %u files, %u free sectors, index RAM %u bytes",
+    (unsigned)gKvFs->fileCount(), (unsigned)gStateKv->freeSectors(),
+    (unsigned)gStateKv->memoryBytes());
+  return true;
+}
+// Called once per scan: pushes queued journal records
+bool saveEncounteredBSSIDs() {
+  if(!encounteredBSSIDs.sync()){
+    logf("Fail append /bssids.bin");
+    return false;
+  }
+  return true;
+}
+
+void rememberBSSID(uint64_t key) {
+  encounteredBSSIDs.insert(key);
+}
+
+// One-time import of the old /bssids.json. Streamed, so files that no
+// longer fit the old 8 KB DynamicJsonDocument import completely too.
+bool migrateLegacyBSSIDs() {
+  std::unique_ptr<PalFile> f= gFs.open(LEGACY_BSSID_FILE,"r");
+  if(!f){
+    logf("Failed open /bssids.json for read");
+    return false;
+  }
+  forEachJsonMac(*f, [](uint64_t key){
+    if(!encounteredBSSIDs.contains(key)) rememberBSSID(key);
+  });
+  f.reset();
+  if(!saveEncounteredBSSIDs()) return false;
+  gFs.remove(LEGACY_BSSID_FILE);
+  logf("Migrated %u BSSIDs from /bssids.json",(unsigned)encounteredBSSIDs.size());
+  return true;
+}
+
+// img: boot image to restore the index from, if one was found
+static bool seenFromImage= false;
+
+bool loadEncounteredBSSIDs(BootImageReader *img) {
+  seenFromImage= img && encounteredBSSIDs.beginFromImage(*img);
+  if(seenFromImage){
+    logf("Seen-set index restored from boot image");
+  } else if(!encounteredBSSIDs.begin()){
+    logf("A seen-set segment failed its CRC check; using what was readable");
+  }
+  if(gFs.exists(LEGACY_BSSID_FILE)){
+    return migrateLegacyBSSIDs();
+  }
+  logf("Loaded %u BSSIDs (index RAM %u bytes)",
+    (unsigned)encounteredBSSIDs.size(), (unsigned)encounteredBSSIDs.memoryBytes());
+  return true;
+}
+
+// -------------------------------------------------------------------
+// 5) Sessions: which game a request plays
+void markSaveDirty(){
+  saveStore.markDirty(nowMs());
+}
+
+// Bumped on every change to a session's party, hp included, and handed
+// to that session, so a version names one party state of one session; the
+// cached party JSON and /myParty's ETag are keyed by it. The boot tag,
+// also in the ETag, keeps a tag from before a reboot from matching a party
+// that has changed since.
+static uint32_t gPartyVersion= 0;
+static uint32_t gBootTag= 0;
+
+void partyChanged(Session &s){
+  s.partyVersion= ++gPartyVersion;
+  gChanges.append(CHANGE_PARTY, sessionScope(s.token));
+}
+
+// Never 0 (free slot) or Sessions::ORPHAN
+uint64_t newSessionToken(){
+  uint64_t t= ((uint64_t)gHal.rng->next()<<32) | gHal.rng->next();
+  return t | (1ULL<<63);
+}
+
+// The request's token: cookie, else the header; false if it sent neither
+bool requestToken(const HttpRequest &request, uint64_t &token){
+  const char* cookies= request.header("Cookie");
+  if(cookies && cookieToken(cookies, SESSION_COOKIE, token)) return true;
+  const char* h= request.header(SESSION_HEADER);
+  return h && parseToken(h, strlen(h), token);
+}
+
+// created: the session is new and the response must hand out its token
+struct SessionRef {
+  Session *s;
+  bool created;
+};
+
+// What a phone without a session sees: a fresh player with a starter,
+// made once and never stored or changed
+Session* guestSession(){
+  static Session guest;
+  if(guest.partyVersion==0){
+    newGame(guest.game);
+    guest.partyVersion= ++gPartyVersion;
+  }
+  return &guest;
+}
+
+// The request's session. Without one, create=false (read-only requests)
+// shows the game from before sessions while nobody has claimed it, since
+// the next create=true takes that one over, else the guest game;
+// create=true starts one: that same unclaimed game, else a fresh player
+// with a starter. s is nullptr if every slot holds a game played too
+// recently to drop.
+SessionRef sessionFor(const HttpRequest &request, bool create){
+  uint64_t token;
+  if(requestToken(request, token)){
+    Session *s= gSessions.find(token);
+    if(s){
+      s->lastMs= nowMs();
+      return { s, false };
+    }
+  }
+  if(!create){
+    // peek: looking at the unclaimed game doesn't count as playing it
+    Session *orphan= gSessions.peek(Sessions::ORPHAN);
+    return { orphan ? orphan : guestSession(), false };
+  }
+  token= newSessionToken();
+  Session *s= gSessions.claimOrphan(token);
+  if(!s){
+    bool evicted;
+    s= gSessions.tryOpen(token, nowMs(), SESSION_MIN_IDLE_MS, &evicted);
+    if(!s){
+      logf("Session table full, every game active; new player turned away");
+      return { nullptr, false };
+    }
+    newGame(s->game);
+    if(evicted) logf("Session table full; dropped the least recently used game");
+  }
+  s->lastMs= nowMs();
+  partyChanged(*s);
+  markSaveDirty();
+  logf("New session, %u of %u in use", (unsigned)gSessions.size(), (unsigned)Sessions::capacity());
+  return { s, true };
+}
+
+// Highest player level on the AP; wild monsters are generated for it
+int worldLevel(){
+  int level= 1;
+  gSessions.forEach([&level](Session &s){
+    if(s.game.playerLevel>level) level= s.game.playerLevel;
+  });
+  return level;
+}
+
+// A new session's token goes out with whatever the response is
+void handOutToken(HttpResponse &response, const SessionRef &ref){
+  if(ref.created){
+    char hex[17], cookie[80];
+    formatToken(ref.s->token, hex);
+    snprintf(cookie, sizeof(cookie), "%s=%s; Path=/; Max-Age=31536000; SameSite=Strict", SESSION_COOKIE, hex);
+    response.addHeader("Set-Cookie", cookie);
+    response.addHeader(SESSION_HEADER, hex);
+  }
+}
+
+void sendTo(HttpResponse &response, const SessionRef &ref, int code, const char* type,
+            std::unique_ptr<HttpBody> body){
+  handOutToken(response, ref);
+  response.send(code, type, std::move(body));
+}
+
+void sendTo(HttpResponse &response, const SessionRef &ref, int code, const char* text){
+  handOutToken(response, ref);
+  response.send(code, "text/plain", text);
+}
+
+// sessionFor() found no slot for a new player
+void sendNoSession(HttpResponse &response){
+  response.addHeader("Retry-After", "60");
+  response.send(503, "text/plain", "Every game slot is in use; try again later");
+}
+
+// -------------------------------------------------------------------
+// 6) Save state: every session's player + party in one snapshot
+// SaveStore encoder, binary (session_table.h)
+size_t encodeSaveState(uint8_t* buf, size_t cap){
+  return gSessions.save(buf, cap);
+}
+
+// The single-player game from before sessions: kept as the orphan
+// session, which the first phone to connect takes over
+void adoptLegacyGame(SaveGame &g){
+  giveStarter(g);
+  Session &s= gSessions.open(Sessions::ORPHAN);
+  s.game= g;
+  partyChanged(s);
+  markSaveDirty();
+  saveStore.sync();   // boot-time: no handler waiting on this
+  logf("Kept pre-session player: name=%s, level=%d, party=%d",
+    g.playerName, g.playerLevel, g.partySize);
+}
+
+// Newest valid save slot, else the old JSON files. Anything that is not
+// the current binary format is rewritten as one right away.
+bool loadSaveState() {
+  saveStore.setEncoder(encodeSaveState);
+  saveStore.setDelay(SAVE_DELAY_MS);
+
+  uint8_t buf[SAVE_MAX_BYTES];
+  size_t len= saveStore.load(buf, sizeof(buf));
+  SaveGame g;
+  memset(&g, 0, sizeof(g));
+  copyName(g.playerName, sizeof(g.playerName), "NoName");
+  g.playerLevel= 1;
+  if(len>0 && gSessions.load(buf, len)){
+    gSessions.forEach([](Session &s){ partyChanged(s); });
+  } else if(len>0 && decodeSaveGame(buf, len, g)){
+    // single-player binary save
+    adoptLegacyGame(g);
+  } else if(len>0 && buf[0]=='{'){
+    // slot written by the JSON-payload firmware
+    if(gLegacySave) gLegacySave(buf, len, g);
+    adoptLegacyGame(g);
+  } else if(gFs.exists(PLAYER_FILE) || gFs.exists(PARTY_FILE)){
+    // first boot with SaveStore: take over the old files (left in place)
+    if(gLegacySave) gLegacySave(nullptr, 0, g);
+    adoptLegacyGame(g);
+  }
+  logf("Loaded %u sessions (%u bytes each)",
+    (unsigned)gSessions.size(), (unsigned)sizeof(Session));
+  return true;
+}
+
+// -------------------------------------------------------------------
+// 7) Original multi-column Wigle CSV, buffered in RAM
+// columns: MAC,SSID,AuthMode,FirstSeen,Channel,RSSI,CurrentLatitude,CurrentLongitude,Type
+// FLUSH_PER_SCAN appends once per scan; FLUSH_EACH_ROW is the old
+// write-per-network behaviour, FLUSH_ON_TIMER batches across scans.
+static const WigleLog::Durability WIGLE_DURABILITY = WigleLog::FLUSH_PER_SCAN;
+static const uint32_t WIGLE_MAX_AGE_MS = 10000;
+static WigleLog wigleLog(gFs, WIGLE_FILE);
+
+const char* encryptionTypeToString(uint8_t auth){
+  switch(auth){
+    case SCAN_AUTH_OPEN:         return "Open";
+    case SCAN_AUTH_WEP:          return "WEP";
+    case SCAN_AUTH_WPA_PSK:      return "WPA";
+    case SCAN_AUTH_WPA2_PSK:     return "WPA2";
+    case SCAN_AUTH_WPA_WPA2_PSK: return "WPA_WPA2";
+    case SCAN_AUTH_WPA2_ENTERPRISE: return "WPA2_ENTERPRISE";
+    default: return "Unknown";
+  }
+}
+
+void appendWigleRow(const char* ssid, const char* bssid, uint8_t auth,
+                    int channel, int rssi)
+{
+  if(!wigleLog.addRow(bssid, ssid, encryptionTypeToString(auth), channel, rssi, nowMs())){
+    logf("Fail append wigledata.csv");
+  }
+}
+
+void handleDownloadWigle(const HttpRequest &, HttpResponse &response){
+  {
+    StateLock lock;
+    wigleLog.flush();
+  }
+  if(!gFs.exists(WIGLE_FILE)){
+    response.send(404,"text/plain","No wigle data found");
+    return;
+  }
+  std::unique_ptr<PalFile> f= gFs.open(WIGLE_FILE,"r");
+  if(!f){
+    response.send(500,"text/plain","Failed open wigledata.csv");
+    return;
+  }
+  uint32_t size= f->size();
+  response.send(200, "text/csv", std::unique_ptr<HttpBody>(new FileBody(std::move(f), 0, size)));
+  response.addHeader("Content-Disposition","attachment; filename=\"wigledata.csv\"");
+}
+
+void handleClearWigle(const HttpRequest &, HttpResponse &response){
+  StateLock lock;
+  // rows still buffered in RAM count as data too
+  bool hadRows= wigleLog.buffered()>0;
+  wigleLog.discard();
+  if(gFs.exists(WIGLE_FILE) || hadRows){
+    gFs.remove(WIGLE_FILE);
+    response.send(200,"text/plain","Cleared wigle data");
+  } else {
+    response.send(404,"text/plain","No wigle data file found");
+  }
+}
+
+// -------------------------------------------------------------------
+// 8) Monster Name arrays
+static const char* FUN_PREFIXES[]={
+  "Star","Candy","Turbo","Spark","Rainbow",
+  "Mega","Fizzy","Funky","Magic","Cosmic",
+  "Butter","Jolly","Mighty","Sunny","Lava"
+};
+static const char* FUN_SUFFIXES[]={
+  "Dino","Bat","Cat","Dog","Fish",
+  "Dragon","Bee","Fairy","Ghost","Bear",
+  "Zard","Robot","Frog","Pup","Wizard"
+};
+static const int PREFIX_COUNT= sizeof(FUN_PREFIXES)/sizeof(FUN_PREFIXES[0]);
+static const int SUFFIX_COUNT= sizeof(FUN_SUFFIXES)/sizeof(FUN_SUFFIXES[0]);
+static const size_t MAX_NAME= 16;
+static_assert(sizeof(WildEntry::name)>=MAX_NAME, "API_WILD_ENTRY name too short");
+
+void pickKidFriendlyName(uint8_t &prefix, uint8_t &suffix){
+  prefix= gHal.rng->uniform(0, PREFIX_COUNT);
+  suffix= gHal.rng->uniform(0, SUFFIX_COUNT);
+}
+
+// out needs MAX_NAME bytes
+void wildMonsterName(const WildMonster &w, char* out){
+  snprintf(out, MAX_NAME, "%s%s", FUN_PREFIXES[w.prefix], FUN_SUFFIXES[w.suffix]);
+}
+
+// DETERMINISTIC_MONSTERS: name and level are a keyed hash of the BSSID
+// (and the player's level bucket) instead of random(). Nothing about a
+// wild monster needs saving; the roster is rebuilt from the seen-set at
+// boot, and levels are re-derived whenever a monster is shown.
+#ifndef DETERMINISTIC_MONSTERS
+#define DETERMINISTIC_MONSTERS 1
+#endif
+static const MonsterGen monsterGen(PREFIX_COUNT, SUFFIX_COUNT);
+
+// Brings a roster entry up to the player's current level bucket
+WildMonster currentWild(WildMonster w, int playerLevel){
+  if(DETERMINISTIC_MONSTERS && w.bssid!=0){
+    w.level= monsterGen.levelFor(w.bssid, playerLevel);
+  }
+  return w;
+}
+
+void rebuildRosterFromSeen(){
+  uint32_t t0= nowMs();
+  gMonsters.clear();
+  int level= worldLevel();
+  encounteredBSSIDs.forEach([level](uint64_t key){
+    MonsterTraits t= monsterGen.derive(key, level);
+    gMonsters.add(t.prefix, t.suffix, t.level, key);
+  });
+  logf("Rebuilt %u wild monsters from %u BSSIDs in %u ms",
+    (unsigned)gMonsters.size(), (unsigned)encounteredBSSIDs.size(),
+    (unsigned)(nowMs()-t0));
+}
+
+// Full monster (name, hp, defense) for battles and capture
+SavedMonster wildToMonster(const WildMonster &w){
+  static_assert(sizeof(SavedMonster::name)>=MAX_NAME, "party names too short");
+  SavedMonster mon;
+  wildMonsterName(w, mon.name);
+  mon.level= w.level;
+  recalcMonsterStats(mon);
+  return mon;
+}
+
+// -------------------------------------------------------------------
+// 9) Scan with ignoring old BSSIDs, Original wigle CSV
+// Two ways to feed scan results to the game, both ending in
+// processScanRecord() on the loop task (core 1):
+//  - CONTINUOUS_SCAN: palsSweep() on a task pinned to core 0 sweeps over
+//    and over and pushes ScanRecords into a lock-free SPSC ring that
+//    palsLoop() drains.
+//  - on demand: /scan starts an async sweep and returns a job id;
+//    palsLoop() polls the radio and then handles SCAN_SLICE results per
+//    pass.
+// Either way the web server keeps answering during a 2-4 s sweep.
+// /scan/status reports progress. The native build has no second core to
+// spare and replays sweeps on demand.
+#ifndef CONTINUOUS_SCAN
+#ifdef ARDUINO
+#define CONTINUOUS_SCAN 1
+#else
+#define CONTINUOUS_SCAN 0
+#endif
+#endif
+
+enum ScanPhase { SCAN_IDLE, SCAN_SWEEPING, SCAN_PROCESSING, SCAN_DONE, SCAN_FAILED };
+
+struct ScanJob {
+  uint32_t  id;
+  ScanPhase phase;
+  int found;        // networks reported by the sweep
+  int processed;    // results handled so far
+  int newMonsters;
+  uint32_t startedMs;
+};
+
+static const int SCAN_SLICE = 4;
+static const int SCAN_DRAIN_SLICE = 8;
+static ScanJob scanJob = { 0, SCAN_IDLE, 0, 0, 0, 0 };
+static SpscRing<ScanRecord, 64> scanRing;
+
+const char* scanPhaseName(ScanPhase p){
+  switch(p){
+    case SCAN_SWEEPING:   return "sweeping";
+    case SCAN_PROCESSING: return "processing";
+    case SCAN_DONE:       return "done";
+    case SCAN_FAILED:     return "failed";
+    default:              return "idle";
+  }
+}
+
+bool scanBusy(){
+  return scanJob.phase==SCAN_SWEEPING || scanJob.phase==SCAN_PROCESSING;
+}
+
+// Handles one scan result: dedup, Wigle row, new monster
+void processScanRecord(const ScanRecord &rec){
+  uint64_t key= macToKey(rec.bssid);
+  if(encounteredBSSIDs.contains(key)){
+    // skip duplicates
+    return;
+  }
+  // new BSSID => log
+  rememberBSSID(key);
+  gChanges.append(CHANGE_SEEN, key);
+  char bssid[18];
+  formatMac(key, bssid);
+
+  // original multi-col approach
+  appendWigleRow(rec.ssid,bssid,rec.auth,rec.channel,rec.rssi);
+
+  // create scaled monster
+  uint32_t id;
+  if(DETERMINISTIC_MONSTERS){
+    MonsterTraits t= monsterGen.derive(key, worldLevel());
+    id= gMonsters.add(t.prefix, t.suffix, t.level, key);
+  } else {
+    uint8_t prefix, suffix;
+    pickKidFriendlyName(prefix, suffix);
+    int base= worldLevel();
+    int minL= base-3; if(minL<1) minL=1;
+    int maxL= base+3;
+    int newLevel= gHal.rng->uniform(minL, maxL+1);
+    if(newLevel<1) newLevel=1;
+    if(newLevel>255) newLevel=255;
+    id= gMonsters.add(prefix, suffix, (uint8_t)newLevel, key);
+  }
+  if(gMonsters.lastEvicted()) gChanges.append(CHANGE_WILD_GONE, gMonsters.lastEvicted());
+  gChanges.append(CHANGE_WILD_ADD, id);
+  scanJob.newMonsters++;
+}
+
+void finishScan(){
+  // one journal append and one CSV append for the whole scan
+  saveEncounteredBSSIDs();
+  wigleLog.endScan();
+  scanJob.phase= SCAN_DONE;
+  logf("Monsters updated after scanning: %d new in %lu ms.",
+    scanJob.newMonsters, (unsigned long)(nowMs()-scanJob.startedMs));
+}
+
+void beginScanJob(){
+  scanJob.id++;
+  scanJob.found= 0;
+  scanJob.processed= 0;
+  scanJob.newMonsters= 0;
+  scanJob.startedMs= nowMs();
+}
+
+// --- continuous mode (core 0 producer, palsLoop() consumer) ---
+bool palsContinuousScan(){
+  return CONTINUOUS_SCAN;
+}
+
+void palsSweep(){
+  ScanRecord rec;
+  int n= gHal.radio->sweep(false);
+  for(int i=0; i<n; i++){
+    gHal.radio->result(i, rec);
+    scanRing.push(rec);
+  }
+  gHal.radio->release();
+  memset(&rec, 0, sizeof(rec));
+  rec.flags= ScanRecord::END_OF_SWEEP;
+  scanRing.push(rec);
+}
+
+void drainScanRing(){
+  ScanRecord rec;
+  for(int k=0; k<SCAN_DRAIN_SLICE && scanRing.pop(rec); k++){
+    if(scanJob.phase!=SCAN_PROCESSING){
+      beginScanJob();
+      scanJob.phase= SCAN_PROCESSING;
+    }
+    if(rec.flags & ScanRecord::END_OF_SWEEP){
+      finishScan();
+      continue;
+    }
+    scanJob.found++;
+    processScanRecord(rec);
+    scanJob.processed++;
+  }
+}
+
+// --- on-demand mode ---
+void startScan(){
+  logf("Scanning networks...");
+  beginScanJob();
+  gHal.radio->release();
+  int rc= gHal.radio->sweep(true);
+  scanJob.phase= (rc==PalRadio::SWEEP_FAILED) ? SCAN_FAILED : SCAN_SWEEPING;
+}
+
+// Called every palsLoop() pass
+void serviceScan(){
+  if(CONTINUOUS_SCAN){
+    drainScanRing();
+    return;
+  }
+  if(scanJob.phase==SCAN_SWEEPING){
+    int n= gHal.radio->sweepDone();
+    if(n==PalRadio::SWEEP_RUNNING) return;
+    if(n<0){
+      logf("Scan failed.");
+      scanJob.phase= SCAN_FAILED;
+      return;
+    }
+    logf("Found %d networks.", n);
+    scanJob.found= n;
+    scanJob.phase= SCAN_PROCESSING;
+  }
+  if(scanJob.phase==SCAN_PROCESSING){
+    int end= scanJob.processed + SCAN_SLICE;
+    if(end>scanJob.found) end= scanJob.found;
+    ScanRecord rec;
+    for(int i=scanJob.processed; i<end; i++){
+      gHal.radio->result(i, rec);
+      processScanRecord(rec);
+    }
+    scanJob.processed= end;
+    if(scanJob.processed>=scanJob.found){
+      gHal.radio->release();
+      finishScan();
+    }
+  }
+}
+
+void sendScanStatus(HttpResponse &response){
+  CopiedBody *body= new CopiedBody();
+  response.send(200, "application/json", std::unique_ptr<HttpBody>(body));
+  char buf[64];
+  JsonStream js(*body, buf, sizeof(buf));
+  js.beginObject();
+  js.field("jobId",       (unsigned long)scanJob.id);
+  js.field("state",       scanPhaseName(scanJob.phase));
+  js.field("found",       scanJob.found);
+  js.field("processed",   scanJob.processed);
+  js.field("newMonsters", scanJob.newMonsters);
+  js.field("continuous",  (bool)CONTINUOUS_SCAN);
+  if(CONTINUOUS_SCAN){
+    js.field("queued",    (unsigned long)scanRing.size());
+    js.field("dropped",   (unsigned long)scanRing.drops());
+  }
+  js.endObject();
+  js.flush();
+}
+
+void handleScan(const HttpRequest &, HttpResponse &response){
+  StateLock lock;
+  // a sweep already running is shared rather than restarted; in
+  // continuous mode the scan task owns the radio
+  if(!CONTINUOUS_SCAN && !scanBusy()){
+    startScan();
+  }
+  sendScanStatus(response);
+}
+
+void handleScanStatus(const HttpRequest &request, HttpResponse &response){
+  StateLock lock;
+  // continuous sweeps roll the job id on their own
+  if(!CONTINUOUS_SCAN && request.arg("jobId")
+     && (uint32_t)request.argLong("jobId", 0)!=scanJob.id){
+    response.send(404,"text/plain","Unknown scan job");
+    return;
+  }
+  sendScanStatus(response);
+}
+
+// /monsters?cursor=N&limit=M
+// The cursor is a monster id: the page starts at the first monster whose
+// id is >= cursor. Ids are never reused and the roster keeps them in
+// order, so a cursor stays valid across scans and evictions. Without
+// limit the whole roster is streamed.
+static const uint32_t MONSTER_PAGE_MAX = 100;
+
+// One /monsters response (API_MONSTER_PAGE), written as the socket drains
+// (HTTP chunks).
+// Each fill renders monsters one at a time into the free send space; the
+// position is kept as the next id rather than a roster slot, since scans
+// may add or evict monsters between fills.
+class MonsterPager : public HttpBody {
+public:
+  MonsterPager(uint32_t cursor, uint32_t limit, int playerLevel)
+    : sink_(spill_, sizeof(spill_)), js_(sink_, buf_, sizeof(buf_)),
+      nextId_(cursor), left_(limit), level_(playerLevel), started_(false), done_(false) {}
+
+  size_t length() const override { return CHUNKED; }
+
+  size_t fill(uint8_t *out, size_t room) override {
+    sink_.begin(out, room);
+    while(!sink_.full() && !done_){
+      StateLock lock;
+      step();
+      js_.flush();
+    }
+    return sink_.filled();
+  }
+
+private:
+  void step(){
+    if(!started_){
+      js_.beginObject();
+      js_.field("total", (unsigned long)gMonsters.size());
+      js_.key("monsters");
+      js_.beginArray();
+      started_= true;
+      return;
+    }
+    size_t slot= gMonsters.lowerBound(nextId_);
+    if(left_>0 && slot<gMonsters.size()){
+      WildMonster w= currentWild(gMonsters.at(slot), level_);
+      WildEntry e;
+      e.id= w.id;
+      wildMonsterName(w, e.name);
+      e.level= w.level;
+      writeJson(js_, e);
+      nextId_= w.id+1;
+      left_--;
+      return;
+    }
+    js_.endArray();
+    js_.key("nextCursor");
+    if(left_==0 && slot<gMonsters.size()) js_.value(gMonsters.at(slot).id);
+    else js_.null();
+    js_.endObject();
+    done_= true;
+  }
+
+  char spill_[384];   // one monster object, escaped, plus a JsonStream buffer
+  char buf_[128];
+  PullSink sink_;
+  JsonStream js_;
+  uint32_t nextId_;
+  uint32_t left_;
+  int level_;
+  bool started_;
+  bool done_;
+};
+
+void handleMonsters(const HttpRequest &request, HttpResponse &response){
+  long cursor= request.argLong("cursor", 0);
+  if(cursor<0) cursor= 0;
+  uint32_t limit;
+  int level;
+  {
+    // listed at the caller's level; browsing does not start a session
+    StateLock lock;
+    limit= gMonsters.size();
+    uint64_t token;
+    Session *s= requestToken(request, token) ? gSessions.find(token) : nullptr;
+    level= s ? s->game.playerLevel : worldLevel();
+  }
+  if(request.arg("limit")){
+    long l= request.argLong("limit", 1);
+    if(l<1) l= 1;
+    if(l>(long)MONSTER_PAGE_MAX) l= MONSTER_PAGE_MAX;
+    limit= l;
+  }
+  response.send(200, "application/json",
+    std::unique_ptr<HttpBody>(new MonsterPager((uint32_t)cursor, limit, level)));
+}
+
+// -------------------------------------------------------------------
+// 10) Battle logic
+// The rules are in battle.cpp; each session has its own battle, so two
+// phones can fight at once.
+void handleStartBattle(const HttpRequest &request, HttpResponse &response){
+  StateLock lock;
+  SessionRef ref= sessionFor(request, true);
+  if(!ref.s){
+    sendNoSession(response);
+    return;
+  }
+  Session &sess= *ref.s;
+  if(!request.arg("wildId")|| !request.arg("partyIndex")){
+    sendTo(response, ref, 400, "Need wildId & partyIndex");
+    return;
+  }
+  long wId= request.argLong("wildId", 0);
+  int pIdx= request.argLong("partyIndex", 0);
+  WildMonster w;
+  if(wId<=0|| !gMonsters.find((uint32_t)wId, w)){
+    sendTo(response, ref, 400, "Invalid wildId");
+    return;
+  }
+  SavedMonster wild= wildToMonster(currentWild(w, sess.game.playerLevel));
+  if(!beginBattle(sess.game, sess.battle, pIdx, w.id, wild)){
+    sendTo(response, ref, 400, "Invalid partyIndex");
+    return;
+  }
+
+  const SavedMonster &pm= sess.game.party[pIdx];
+  const SavedMonster &wm= sess.battle.wild;
+
+  BattleStart v;
+  v.inProgress= true;
+  copyName(v.partyName, sizeof(v.partyName), pm.name);
+  v.partyLevel= pm.level;
+  v.partyHP   = pm.hp;
+  copyName(v.wildName, sizeof(v.wildName), wm.name);
+  v.wildLevel = wm.level;
+  v.wildHP    = wm.hp;
+  sendTo(response, ref, 200, "application/json", schemaBody(v));
+}
+
+void handleBattleAction(const HttpRequest &request, HttpResponse &response){
+  StateLock lock;
+  SessionRef ref= sessionFor(request, false);
+  Session &sess= *ref.s;
+  if(!sess.battle.inProgress){
+    sendTo(response, ref, 400, "No battle in progress");
+    return;
+  }
+  if(!request.arg("action")){
+    sendTo(response, ref, 400, "Missing action param");
+    return;
+  }
+  BattleAction action= parseBattleAction(request.arg("action"));
+  if(action==BATTLE_UNKNOWN){
+    sendTo(response, ref, 400, "Unknown action");
+    return;
+  }
+  BattleTurn v;
+  v.message[0]= 0;
+  static const BattleDice dice= [](int lo, int hi){ return gHal.rng->uniform(lo, hi); };
+  int level= sess.game.playerLevel;
+  TurnResult r= battleTurn(sess.game, sess.battle, action, dice, v.message, sizeof(v.message));
+  if(r.saveDirty) markSaveDirty();
+  // every action moves hp or the roster of the party
+  partyChanged(sess);
+  if(sess.game.playerLevel!=level){
+    gChanges.append(CHANGE_PLAYER, sessionScope(sess.token));
+    if(DETERMINISTIC_MONSTERS &&
+       MonsterGen::levelBucket(level)!=MonsterGen::levelBucket(sess.game.playerLevel)){
+      gChanges.append(CHANGE_BUCKET, sessionScope(sess.token));
+    }
+  }
+
+  v.partyHP= sess.game.party[sess.battle.partyIndex].hp;
+  v.wildHP = sess.battle.wild.hp;
+  v.battleEnd= r.battleEnd;
+  sendTo(response, ref, 200, "application/json", schemaBody(v));
+}
+
+// -------------------------------------------------------------------
+// 11) Party endpoints
+// The party JSON (API_PARTY) is rendered once per party version and
+// reused by all three endpoints; /myParty answers a matching
+// If-None-Match with 304 and no body, so polling an unchanged party
+// costs a header exchange. Versions are unique across sessions, so the
+// one cached body is never another phone's party.
+static const size_t PARTY_JSON_MAX= 576;   // 3 monsters, every name escaped
+static CachedJson<Party, PARTY_JSON_MAX> gPartyJson;
+
+void fillParty(const SaveGame &g, Party &v){
+  v.partySize= g.partySize;
+  v.partyCount= g.partySize;
+  for(int i=0;i<g.partySize;i++){
+    copyName(v.party[i].name, sizeof(v.party[i].name), g.party[i].name);
+    v.party[i].level  = g.party[i].level;
+    v.party[i].hp     = g.party[i].hp;
+    v.party[i].defense= g.party[i].defense;
+  }
+}
+
+const CachedJson<Party, PARTY_JSON_MAX>& partyJson(const Session &sess){
+  if(!gPartyJson.fresh(sess.partyVersion)){
+    Party v;
+    fillParty(sess.game, v);
+    gPartyJson.store(sess.partyVersion, v);
+  }
+  return gPartyJson;
+}
+
+// out needs 24 bytes
+void partyEtag(const Session &sess, char* out){
+  snprintf(out, 24, "\"p%08x-%x\"", (unsigned)gBootTag, (unsigned)sess.partyVersion);
+}
+
+// The cached party, or with message: {"message":...,"partySize":...}
+// (API_PARTY_CHANGE) spliced from it
+void sendParty(HttpResponse &response, const SessionRef &ref, const char* message){
+  const CachedJson<Party, PARTY_JSON_MAX> &party= partyJson(*ref.s);
+  if(party.length()==0){
+    sendTo(response, ref, 500, "Party too large");
+    return;
+  }
+  CopiedBody *r= new CopiedBody();
+  std::unique_ptr<HttpBody> body(r);
+  const char* json= (const char*)party.data();
+  size_t len= party.length();
+  if(message){
+    char buf[64];
+    JsonStream js(*r, buf, sizeof(buf));
+    js.beginObject();
+    js.field("message", message);
+    js.flush();
+    r->write(",", 1);
+    json++;   // past the party's own '{'
+    len--;
+  }
+  r->write(json, len);
+  char tag[24];
+  partyEtag(*ref.s, tag);
+  response.addHeader("ETag", tag);
+  response.addHeader("Cache-Control", "no-cache");
+  sendTo(response, ref, 200, "application/json", std::move(body));
+}
+
+void handleMyParty(const HttpRequest &request, HttpResponse &response){
+  StateLock lock;
+  SessionRef ref= sessionFor(request, false);
+  char tag[24];
+  partyEtag(*ref.s, tag);
+  if(etagMatches(headerOf(request, "If-None-Match"), tag)){
+    response.addHeader("ETag", tag);
+    response.addHeader("Cache-Control", "no-cache");
+    sendTo(response, ref, 304, "text/plain", nullptr);
+    return;
+  }
+  sendParty(response, ref, nullptr);
+}
+
+void handleRemoveFromParty(const HttpRequest &request, HttpResponse &response){
+  StateLock lock;
+  SessionRef ref= sessionFor(request, true);
+  if(!ref.s){
+    sendNoSession(response);
+    return;
+  }
+  SaveGame &g= ref.s->game;
+  if(!request.arg("slot")){
+    sendTo(response, ref, 400, "Missing slot");
+    return;
+  }
+  int slot= request.argLong("slot", 0);
+  if(slot<0||slot>=g.partySize){
+    sendTo(response, ref, 400, "Invalid slot");
+    return;
+  }
+  // cannot remove last monster
+  if(g.partySize<=1){
+    sendTo(response, ref, 400, "You cannot remove your final monster!");
+    return;
+  }
+  for(int i=slot; i<g.partySize-1; i++){
+    g.party[i]= g.party[i+1];
+  }
+  g.partySize--;
+  partyChanged(*ref.s);
+  markSaveDirty();
+
+  char msg[48];
+  snprintf(msg, sizeof(msg), "Removed monster at slot %d", slot);
+  sendParty(response, ref, msg);
+}
+
+void handleSwapPartySlots(const HttpRequest &request, HttpResponse &response){
+  StateLock lock;
+  SessionRef ref= sessionFor(request, true);
+  if(!ref.s){
+    sendNoSession(response);
+    return;
+  }
+  SaveGame &g= ref.s->game;
+  if(!request.arg("slot1")||!request.arg("slot2")){
+    sendTo(response, ref, 400, "Need slot1 & slot2");
+    return;
+  }
+  int s1= request.argLong("slot1", 0);
+  int s2= request.argLong("slot2", 0);
+  if(s1<0||s1>=g.partySize|| s2<0|| s2>=g.partySize){
+    sendTo(response, ref, 400, "Invalid slot indices");
+    return;
+  }
+  SavedMonster tmp= g.party[s1];
+  g.party[s1]= g.party[s2];
+  g.party[s2]= tmp;
+  partyChanged(*ref.s);
+  markSaveDirty();
+
+  char msg[48];
+  snprintf(msg, sizeof(msg), "Swapped slots %d and %d", s1, s2);
+  sendParty(response, ref, msg);
+}
+
+// -------------------------------------------------------------------
+// 12) Incremental sync
+// /sync?since=<seq>&epoch=<epoch> sends only what changed after seq
+// (sync_feed.h), so a client that already has the roster and its party
+// keeps them current for a few hundred bytes instead of pulling
+// /monsters and /myParty again. epoch is the one from the last /sync; a
+// different one means the device rebooted and the log started over.
+class SyncPager : public HttpBody {
+public:
+  SyncPager(uint32_t since, bool resync, uint64_t token)
+    : sink_(spill_, sizeof(spill_)), js_(sink_, buf_, sizeof(buf_)), token_(token),
+      feed_(gChanges, gBootTag, since, token ? sessionScope(token) : 0, resync, hooks()),
+      done_(false) {}
+
+  size_t length() const override { return CHUNKED; }
+
+  size_t fill(uint8_t *out, size_t room) override {
+    sink_.begin(out, room);
+    while(!sink_.full() && !done_){
+      StateLock lock;
+      done_= !feed_.step(js_);
+      js_.flush();
+    }
+    return sink_.filled();
+  }
+
+private:
+  SyncFeed::Hooks hooks(){
+    SyncFeed::Hooks h;
+    h.wild= [this](uint32_t id, WildEntry &e){
+      WildMonster w;
+      if(!gMonsters.find(id, w)) return false;
+      const Session *s= gSessions.peek(token_);
+      w= currentWild(w, s ? s->game.playerLevel : worldLevel());
+      e.id= w.id;
+      wildMonsterName(w, e.name);
+      e.level= w.level;
+      return true;
+    };
+    h.party= [this](Party &p){
+      const Session *s= gSessions.peek(token_);
+      if(s) fillParty(s->game, p);
+      return s!=nullptr;
+    };
+    h.player= [this](SyncPlayer &p){
+      const Session *s= gSessions.peek(token_);
+      if(!s) return false;
+      copyName(p.name, sizeof(p.name), s->game.playerName);
+      p.level= s->game.playerLevel;
+      return true;
+    };
+    return h;
+  }
+
+  char spill_[384];   // one entry (or the party), escaped, plus a JsonStream buffer
+  char buf_[128];
+  PullSink sink_;
+  JsonStream js_;
+  uint64_t token_;
+  SyncFeed feed_;
+  bool done_;
+};
+
+void handleSync(const HttpRequest &request, HttpResponse &response){
+  long since= request.argLong("since", 0);
+  if(since<0) since= 0;
+  bool resync= false;
+  if(request.arg("epoch")){
+    resync= strtoul(request.arg("epoch"), nullptr, 16)!=gBootTag;
+  }
+  std::unique_ptr<HttpBody> pager;
+  {
+    // syncing does not start a session
+    StateLock lock;
+    uint64_t token;
+    if(!requestToken(request, token) || !gSessions.peek(token)) token= 0;
+    pager.reset(new SyncPager((uint32_t)since, resync, token));
+  }
+  response.send(200, "application/json", std::move(pager));
+  response.addHeader("Cache-Control", "no-store");
+}
+
+// -------------------------------------------------------------------
+// 13) Serve index.html, app.js and the other files in data/
+// scripts/prepare_assets.py writes gzip variants and /assets.txt at build
+// time; the table is read once at boot.
+static AssetTable gAssets;
+const char* const PALS_STATIC_HEADERS[] = { "Accept-Encoding", "If-None-Match", "Range", "If-Range" };
+const size_t PALS_STATIC_HEADER_COUNT = sizeof(PALS_STATIC_HEADERS)/sizeof(PALS_STATIC_HEADERS[0]);
+
+void sendFile(HttpResponse &response, int code, const char* type, const char* path,
+              uint32_t first, uint32_t len){
+  std::unique_ptr<FileBody> body(new FileBody(gFs.open(path,"r"), first, len));
+  if(!body->ok()){
+    response.send(500,"text/plain","File not readable");
+    return;
+  }
+  response.send(code, type, std::move(body));
+}
+
+// Files that were uploaded without the manifest: old behaviour, no caching
+static void sendUnindexedFile(HttpResponse &response, const char* path){
+  std::unique_ptr<PalFile> f= gFs.open(path,"r");
+  if(!f){
+    response.send(404,"text/plain","File not found");
+    return;
+  }
+  uint32_t size= f->size();
+  response.send(200, mimeForPath(path), std::unique_ptr<HttpBody>(new FileBody(std::move(f), 0, size)));
+}
+
+void palsServeStatic(const HttpRequest &request, HttpResponse &response){
+  char path[StaticAsset::MAX_PATH+4];
+  const char* url= request.path();
+  snprintf(path, sizeof(path), "%s%s", url[0]=='/' ? "" : "/", url);
+  if(strcmp(path, "/")==0) snprintf(path, sizeof(path), "/index.html");
+
+  const StaticAsset *a= gAssets.find(path);
+  if(!a){
+    if(gAssets.count()==0) sendUnindexedFile(response, path);
+    else response.send(404,"text/plain","File not found");
+    return;
+  }
+  const char* range= headerOf(request, "Range");
+  const char* ifRange= headerOf(request, "If-Range");
+  // a range applies to the plain file; gzip is only used for whole bodies
+  bool gz= a->gzSize>0 && !*range && acceptsGzip(headerOf(request, "Accept-Encoding"));
+  char tag[16];
+  a->etag(gz, tag);
+
+  if(etagMatches(headerOf(request, "If-None-Match"), tag)){
+    response.send(304);
+  } else if(gz){
+    char gzPath[sizeof(path)+3];
+    snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+    sendFile(response, 200, a->mime, gzPath, 0, a->gzSize);
+    response.addHeader("Content-Encoding","gzip");
+  } else {
+    uint32_t first= 0, last= a->size ? a->size-1 : 0;
+    RangeResult rr= RANGE_NONE;
+    if(*range && (!*ifRange || strcmp(ifRange, tag)==0)){
+      rr= parseByteRange(range, a->size, first, last);
+    }
+    char contentRange[48];
+    if(rr==RANGE_UNSATISFIABLE){
+      response.send(416,"text/plain","");
+      snprintf(contentRange, sizeof(contentRange), "bytes */%u", (unsigned)a->size);
+      response.addHeader("Content-Range", contentRange);
+    } else {
+      uint32_t len= a->size ? last-first+1 : 0;
+      sendFile(response, rr==RANGE_OK ? 206 : 200, a->mime, a->path, first, len);
+      if(rr==RANGE_OK){
+        snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u",
+          (unsigned)first, (unsigned)last, (unsigned)a->size);
+        response.addHeader("Content-Range", contentRange);
+      }
+    }
+    response.addHeader("Accept-Ranges","bytes");
+  }
+  response.addHeader("ETag", tag);
+  response.addHeader("Cache-Control", a->cacheControl);
+  if(a->gzSize>0) response.addHeader("Vary", "Accept-Encoding");
+}
+
+// a route also matches the paths below it ("/scan" takes "/scan/x"), and
+// servers try routes in the order added: the longer one goes first
+const PalsRoute PALS_ROUTES[] = {
+  { "/scan/status",     handleScanStatus },
+  { "/scan",            handleScan },
+  { "/monsters",        handleMonsters },
+  { "/sync",            handleSync },
+
+  { "/downloadWigle",   handleDownloadWigle },
+  { "/clearWigle",      handleClearWigle },
+
+  { "/myParty",         handleMyParty },
+  { "/removeFromParty", handleRemoveFromParty },
+  { "/swapPartySlots",  handleSwapPartySlots },
+
+  { "/startBattle",     handleStartBattle },
+  { "/battleAction",    handleBattleAction },
+};
+const size_t PALS_ROUTE_COUNT = sizeof(PALS_ROUTES)/sizeof(PALS_ROUTES[0]);
+
+// -------------------------------------------------------------------
+// 14) Companion app over BLE
+// The roster and a party go out as ble_frame.h records, a slice of the
+// roster per pass, batched by the caller's BleBatcher so what a scan finds
+// shares notifications. The board's BLE callbacks only collect requests
+// (BleRequests); this runs on the loop task under the state lock.
+static const int BLE_ROSTER_SLICE = 16;
+
+// What the app has been sent
+static bool bleLinked= false;
+static uint32_t bleNextId= 1;        // roster ids below this went out
+static uint32_t bleRosterFirst= 0;
+static size_t bleRosterTotal= 0;
+static uint32_t blePartyVersion= 0;
+
+void queueBleParty(BleBatcher &ble, const Session &sess){
+  const SaveGame &g= sess.game;
+  BlePartyMonster party[SaveGame::PARTY_MAX];
+  for(int i=0; i<g.partySize; i++){
+    party[i]= { g.party[i].name, g.party[i].level, g.party[i].hp, g.party[i].defense };
+  }
+  uint8_t body[RECORD_MAX];
+  size_t n= partyRecord(body, sizeof(body), g.playerLevel, party, g.partySize);
+  if(n>0) ble.add(REC_PARTY, body, n, nowMs());
+}
+
+void palsServiceCompanion(BleBatcher &ble, const BleRequests &req){
+  StateLock lock;
+  if(!req.connected){
+    if(bleLinked) ble.reset();
+    bleLinked= false;
+    return;
+  }
+  if(!bleLinked || req.resync){
+    // a new subscriber, or one that lost frames: everything again
+    bleLinked= true;
+    bleNextId= 1;
+    bleRosterTotal= (size_t)-1;
+    blePartyVersion= 0;
+  }
+  ble.setMtu(req.mtu);
+  uint32_t now= nowMs();
+
+  const Session *sess= req.follow ? gSessions.peek(req.follow) : gSessions.mostRecent();
+  int level= sess ? sess->game.playerLevel : worldLevel();
+  uint8_t body[RECORD_MAX];
+  size_t slot= gMonsters.lowerBound(bleNextId);
+  for(int i=0; i<BLE_ROSTER_SLICE && slot<gMonsters.size(); i++, slot++){
+    WildMonster w= currentWild(gMonsters.at(slot), level);
+    char name[MAX_NAME];
+    wildMonsterName(w, name);
+    size_t n= wildRecord(body, sizeof(body), w.id, w.level, name);
+    ble.add(REC_WILD, body, n, now);
+    bleNextId= w.id+1;
+  }
+  if(slot==gMonsters.size()){
+    uint32_t first= gMonsters.size() ? gMonsters.at(0).id : bleNextId;
+    if(gMonsters.size()!=bleRosterTotal || first!=bleRosterFirst){
+      bleRosterTotal= gMonsters.size();
+      bleRosterFirst= first;
+      size_t n= rosterRecord(body, sizeof(body), (uint16_t)bleRosterTotal, first);
+      ble.add(REC_ROSTER, body, n, now);
+    }
+  }
+  if(sess && sess->partyVersion!=blePartyVersion){
+    blePartyVersion= sess->partyVersion;
+    queueBleParty(ble, *sess);
+  }
+  ble.service(now);
+}
+
+// -------------------------------------------------------------------
+// 15) Fast-boot image
+// /boot.img caches what is slow to rebuild: the seen-set's Bloom bits and
+// fence keys, and (DETERMINISTIC_MONSTERS) the BSSIDs behind the roster.
+// Boot then reads a fixed ~33 KB instead of the whole segment. It is
+// rewritten after every segment merge; a missing, stale or corrupt image
+// only means the slow path runs and writes a fresh one.
+static const uint32_t IMAGE_ROSTER = 0x52545352;   // "RSTR"
+static uint64_t imageRosterKeys[WILD_ROSTER_CAPACITY];
+static uint32_t imageMerges = 0;
+
+bool writeBootImage(){
+  uint32_t t0= nowMs();
+  BootImageWriter w(gStateFs, BOOT_IMAGE_FILE);
+  if(!encounteredBSSIDs.addToImage(w)) return false;
+  size_t n= 0;
+  if(DETERMINISTIC_MONSTERS){
+    for(; n<gMonsters.size(); n++) imageRosterKeys[n]= gMonsters.at(n).bssid;
+    w.add(IMAGE_ROSTER, imageRosterKeys, n*sizeof(uint64_t));
+  }
+  bool ok= w.commit();
+  imageMerges= encounteredBSSIDs.stats().merges;
+  logf("Boot image %s (%u roster keys, %u ms)",
+    ok ? "written" : "write failed", (unsigned)n, (unsigned)(nowMs()-t0));
+  return ok;
+}
+
+// Roster from the image plus every find since it was written
+bool restoreRosterFromImage(BootImageReader &img){
+  size_t len= img.length(IMAGE_ROSTER);
+  if(len % sizeof(uint64_t) || len > sizeof(imageRosterKeys)) return false;
+  size_t n= len / sizeof(uint64_t);
+  if(!img.read(IMAGE_ROSTER, imageRosterKeys, len)) return false;
+  gMonsters.clear();
+  int level= worldLevel();
+  for(size_t i=0; i<n; i++){
+    MonsterTraits t= monsterGen.derive(imageRosterKeys[i], level);
+    gMonsters.add(t.prefix, t.suffix, t.level, imageRosterKeys[i]);
+  }
+  encounteredBSSIDs.forEachRecent([n, level](uint64_t key){
+    for(size_t i=0; i<n; i++) if(imageRosterKeys[i]==key) return;
+    MonsterTraits t= monsterGen.derive(key, level);
+    gMonsters.add(t.prefix, t.suffix, t.level, key);
+  });
+  return true;
+}
+
+// Keeps the image in step with the segments; call from palsLoop()
+void serviceBootImage(){
+  if(encounteredBSSIDs.stats().merges!=imageMerges && !encounteredBSSIDs.merging()){
+    writeBootImage();
+  }
+}
+
+// Says so, once per event, when the seen-set outgrows the state partition
+static uint32_t seenNoRoom= 0;
+
+void reportSeenRoom(){
+  const SeenIndex::Stats &st= encounteredBSSIDs.stats();
+  if(st.mergesNoRoom==seenNoRoom) return;
+  seenNoRoom= st.mergesNoRoom;
+  logf("Seen-set merge short of flash: %u BSSIDs in %u segments, %u not merged yet",
+    (unsigned)encounteredBSSIDs.size(), (unsigned)encounteredBSSIDs.segments(),
+    (unsigned)(encounteredBSSIDs.size()-encounteredBSSIDs.segmentRecords()));
+}
+
+// Boot-phase timing, printed as each phase ends
+static uint32_t bootStartMs= 0, bootPhaseMs= 0;
+
+void palsBootPhase(const char* name){
+  uint32_t now= nowMs();
+  logf("boot: %-8s %5u ms", name, (unsigned)(now-bootPhaseMs));
+  bootPhaseMs= now;
+}
+
+void palsBootTotal(){
+  logf("boot: total    %5u ms", (unsigned)(nowMs()-bootStartMs));
+}
+
+// -------------------------------------------------------------------
+// 16) Begin & Loop
+void palsBegin(const PalHal &hal, LegacySaveReader legacy){
+  gHal= hal;
+  gLegacySave= legacy;
+  gFs.set(*hal.files);
+  gStateFs.set(*hal.files);
+  gBootTag= hal.rng->next();
+  bootStartMs= bootPhaseMs= nowMs();
+
+  mountStateStore();
+  palsBootPhase("mount");
+  {
+    BootImageReader img(gStateFs, BOOT_IMAGE_FILE);
+    // load encountered BSSIDs first
+    loadEncounteredBSSIDs(img.begin() ? &img : nullptr);
+    palsBootPhase(seenFromImage ? "seen/img" : "seen");
+    loadSaveState();
+    palsBootPhase("save");
+    gMonsters.setEviction(WILD_EVICTION);
+    bool imageFresh= seenFromImage;
+    if(DETERMINISTIC_MONSTERS){
+      // the roster keys are only as current as the index they came with
+      if(!seenFromImage || !restoreRosterFromImage(img)){
+        rebuildRosterFromSeen();
+        imageFresh= false;
+      }
+    }
+    palsBootPhase("roster");
+    // first boot, stale/corrupt image, or a merge ran during boot
+    if(!imageFresh || encounteredBSSIDs.stats().merges>0){
+      writeBootImage();
+      palsBootPhase("image");
+    }
+    imageMerges= encounteredBSSIDs.stats().merges;
+  }
+  wigleLog.setDurability(WIGLE_DURABILITY, WIGLE_MAX_AGE_MS);
+  if(!gAssets.load(gFs)){
+    logf("No /assets.txt; static files served without caching.");
+  }
+  palsBootPhase("assets");
+}
+
+void palsLoop(){
+  // handlers run on the server's task; each step here holds the state
+  // lock only for itself so a request waits for one step at most
+  {
+    StateLock lock;
+    serviceScan();
+  }
+  {
+    // background merge of the seen-BSSID memtable into its flash segments
+    StateLock lock;
+    encounteredBSSIDs.service();
+    serviceBootImage();
+    reportSeenRoom();
+  }
+  if(gKvFs){
+    // state partition housekeeping: removed files' chunks, then a bounded
+    // compaction slice. A sector erase (45 ms) runs outside the lock;
+    // handlers keep reading and writing the other sectors meanwhile.
+    size_t erase;
+    {
+      StateLock lock;
+      gKvFs->service();
+      erase= gStateKv->takeErase();
+      if(erase==LogKv::NONE) gStateKv->service();
+    }
+    if(erase!=LogKv::NONE){
+      bool erased= gStateKv->eraseFlash(erase);
+      StateLock lock;
+      gStateKv->finishErase(erase, erased);
+    }
+  }
+  {
+    StateLock lock;
+    wigleLog.service(nowMs());
+    // coalesced save of every session
+    saveStore.service(nowMs());
+  }
+}
+
+PalsStats palsStats(){
+  StateLock lock;
+  const SeenIndex::Stats &seen= encounteredBSSIDs.stats();
+  PalsStats s;
+  s.seen= encounteredBSSIDs.size();
+  s.wild= gMonsters.size();
+  s.sessions= gSessions.size();
+  s.scanJob= scanJob.id;
+  s.newMonsters= scanJob.newMonsters;
+  s.scanning= scanBusy();
+  s.seenLookups= seen.lookups;
+  s.bloomRejects= seen.bloomRejects;
+  s.segmentReads= seen.flashReads;
+  s.merges= seen.merges;
+  s.seenSegments= encounteredBSSIDs.segments();
+  s.mergesNoRoom= seen.mergesNoRoom;
+  s.journalDrops= seen.journalDrops;
+  s.saveWrites= saveStore.writes();
+  s.wigleAppends= wigleLog.flashAppends();
+  s.wigleDrops= wigleLog.droppedRows();
+  return s;
+}
@@ -0,0 +1,49 @@
+// pull_sink.cpp
+#include "pull_sink.h"
+#include <string.h>
+
+PullSink::PullSink(char* spill, size_t spillSize)
+  : spill_(spill), spillCap_(spillSize), spillLen_(0),
+    out_(nullptr), room_(0), used_(0), ok_(true)
+{
+}
+
+void PullSink::begin(uint8_t* out, size_t room) {
+  out_ = out;
+  room_ = room;
+  used_ = spillLen_ < room ? spillLen_ : room;
+  memcpy(out_, spill_, used_);
+  spillLen_ -= used_;
+  memmove(spill_, spill_ + used_, spillLen_);
+}
+
+bool PullSink::write(const char* data, size_t len) {
+  size_t n = room_ - used_;
+  if(n > len) n = len;
+  memcpy(out_ + used_, data, n);
+  used_ += n;
+  data += n;
+  len -= n;
+  if(len > spillCap_ - spillLen_) {
+    ok_ = false;
+    return false;
+  }
+  memcpy(spill_ + spillLen_, data, len);
+  spillLen_ += len;
+  return true;
+}
+
+bool WindowSink::write(const char* data, size_t len) {
+  size_t from = total_;
+  total_ += len;
+  if(total_ <= skip_ || used_ == room_) return true;
+  if(from < skip_) {
+    data += skip_ - from;
+    len -= skip_ - from;
+  }
+  size_t n = room_ - used_;
+  if(n > len) n = len;
+  memcpy(out_ + used_, data, n);
+  used_ += n;
+  return true;
+}
@@ -0,0 +1,93 @@
+// save_format.cpp
+#include "save_format.h"
+#include "mac_addr.h"
+#include <string.h>
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v; p[1] = v >> 8;
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+void copyName(char* dst, size_t dstSize, const char* src) {
+  memset(dst, 0, dstSize);
+  if(src) strncpy(dst, src, dstSize - 1);
+}
+
+size_t encodeSaveGame(const SaveGame &g, uint8_t* buf, size_t cap) {
+  if(cap < SAVE_GAME_BYTES) return 0;
+  memset(buf, 0, SAVE_GAME_BYTES);
+  put16(buf, SAVE_FORMAT_VERSION);
+  memcpy(buf + 4, g.playerName, sizeof(g.playerName));
+  buf[4 + sizeof(g.playerName) - 1] = 0;
+  put16(buf + 28, g.playerLevel);
+  buf[30] = g.hasStarter ? 1 : 0;
+  buf[31] = g.partySize;
+  for(int i = 0; i < SaveGame::PARTY_MAX; i++) {
+    uint8_t* p = buf + 32 + i * 24;
+    const SavedMonster &m = g.party[i];
+    if(i >= g.partySize) continue;
+    memcpy(p, m.name, sizeof(m.name));
+    p[sizeof(m.name) - 1] = 0;
+    put16(p + 16, m.level);
+    put16(p + 18, (uint16_t)m.hp);
+    put16(p + 20, (uint16_t)m.defense);
+  }
+  return SAVE_GAME_BYTES;
+}
+
+bool decodeSaveGame(const uint8_t* buf, size_t len, SaveGame &g) {
+  if(len < 2 || get16(buf) != SAVE_FORMAT_VERSION || len < SAVE_GAME_BYTES) return false;
+  memset(&g, 0, sizeof(g));
+  memcpy(g.playerName, buf + 4, sizeof(g.playerName));
+  g.playerName[sizeof(g.playerName) - 1] = 0;
+  g.playerLevel = get16(buf + 28);
+  g.hasStarter  = buf[30] != 0;
+  g.partySize   = buf[31] > SaveGame::PARTY_MAX ? SaveGame::PARTY_MAX : buf[31];
+  for(int i = 0; i < g.partySize; i++) {
+    const uint8_t* p = buf + 32 + i * 24;
+    SavedMonster &m = g.party[i];
+    memcpy(m.name, p, sizeof(m.name));
+    m.name[sizeof(m.name) - 1] = 0;
+    m.level   = get16(p + 16);
+    m.hp      = (int16_t)get16(p + 18);
+    m.defense = (int16_t)get16(p + 20);
+  }
+  return true;
+}
+
+size_t forEachJsonMac(PalFile &f, const std::function<void(uint64_t)> &fn) {
+  uint8_t buf[256];
+  char str[18];
+  size_t strLen = 0;
+  bool inString = false, escaped = false;
+  size_t found = 0;
+  for(;;) {
+    size_t n = f.read(buf, sizeof(buf));
+    if(n == 0) break;
+    for(size_t i = 0; i < n; i++) {
+      char c = (char)buf[i];
+      if(!inString) {
+        if(c == '"') { inString = true; strLen = 0; }
+        continue;
+      }
+      if(escaped) { escaped = false; strLen = sizeof(str); continue; }
+      if(c == '\\') { escaped = true; continue; }
+      if(c == '"') {
+        inString = false;
+        uint64_t key;
+        if(strLen == 17) {
+          str[17] = 0;
+          if(parseMac(str, key)) { fn(key); found++; }
+        }
+        continue;
+      }
+      // longer than a MAC: not one, just skip to the closing quote
+      if(strLen < 17) str[strLen] = c;
+      if(strLen < sizeof(str)) strLen++;
+    }
+  }
+  return found;
+}
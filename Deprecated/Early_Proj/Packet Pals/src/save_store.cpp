@@ -0,0 +1,108 @@
+// save_store.cpp
+#include "save_store.h"
+#include "crc32.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+SaveStore::SaveStore(PalFs &fs, const char* slotA, const char* slotB, size_t maxPayload)
+  : fs_(fs), buf_((uint8_t*)malloc(HEADER_SIZE + maxPayload)),
+    cap_(buf_ ? maxPayload : 0), delayMs_(2000), seq_(0), next_(0),
+    dirty_(false), dirtySinceMs_(0), writes_(0), marks_(0), failures_(0)
+{
+  slots_[0] = slotA;
+  slots_[1] = slotB;
+}
+
+SaveStore::~SaveStore() {
+  free(buf_);
+}
+
+bool SaveStore::readSlot(const char* path, uint32_t &seq, uint8_t* buf, size_t cap, size_t &len) {
+  std::unique_ptr<PalFile> f = fs_.open(path, "r");
+  if(!f) return false;
+  uint8_t h[HEADER_SIZE];
+  if(f->read(h, HEADER_SIZE) != HEADER_SIZE) return false;
+  if(get32(h) != MAGIC) return false;
+  seq = get32(h + 4);
+  len = get32(h + 8);
+  if(len == 0 || len > cap) return false;
+  if(f->read(buf, len) != len) return false;
+  return crc32(buf, len) == get32(h + 12);
+}
+
+size_t SaveStore::load(uint8_t* buf, size_t cap) {
+  // Read both into our buffer first so a bad newer slot can't clobber buf
+  uint32_t seqA = 0, seqB = 0;
+  size_t lenA = 0, lenB = 0;
+  bool okA = buf_ && readSlot(slots_[0], seqA, buf_ + HEADER_SIZE, cap_, lenA);
+  bool okB = buf_ && readSlot(slots_[1], seqB, buf_ + HEADER_SIZE, cap_, lenB);
+  // seq wraps after 4 billion saves; compare by difference
+  int pick = -1;
+  if(okA && okB) pick = (int32_t)(seqB - seqA) > 0 ? 1 : 0;
+  else if(okA) pick = 0;
+  else if(okB) pick = 1;
+  if(pick < 0) {
+    seq_ = 0;
+    next_ = 0;
+    return 0;
+  }
+  size_t len = 0;
+  if(!readSlot(slots_[pick], seq_, buf_ + HEADER_SIZE, cap_, len) || len > cap) return 0;
+  memcpy(buf, buf_ + HEADER_SIZE, len);
+  next_ = 1 - pick;
+  return len;
+}
+
+void SaveStore::markDirty(uint32_t nowMs) {
+  marks_++;
+  if(!dirty_) {
+    dirty_ = true;
+    dirtySinceMs_ = nowMs;
+  }
+}
+
+void SaveStore::service(uint32_t nowMs) {
+  if(!dirty_ || nowMs - dirtySinceMs_ < delayMs_) return;
+  // on failure stay dirty and retry one window later, not every loop()
+  if(!sync()) dirtySinceMs_ = nowMs;
+}
+
+bool SaveStore::sync() {
+  if(!dirty_) return true;
+  if(!buf_ || !encoder_) return false;
+  size_t len = encoder_(buf_ + HEADER_SIZE, cap_);
+  if(len == 0 || len > cap_ || !writeSlot(buf_ + HEADER_SIZE, len)) {
+    failures_++;
+    return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+bool SaveStore::writeSlot(const uint8_t* payload, size_t len) {
+  uint32_t seq = seq_ + 1;
+  put32(buf_, MAGIC);
+  put32(buf_ + 4, seq);
+  put32(buf_ + 8, len);
+  put32(buf_ + 12, crc32(payload, len));
+
+  std::unique_ptr<PalFile> f = fs_.open(slots_[next_], "w");
+  if(!f) return false;
+  size_t total = HEADER_SIZE + len;
+  bool ok = f->write(buf_, total) == total;
+  f->flush();
+  f.reset();
+  if(!ok) return false;
+  seq_ = seq;
+  next_ = 1 - next_;
+  writes_++;
+  return true;
+}
@@ -0,0 +1,260 @@
+// scan_trace.cpp
+#include "scan_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mac_addr.h"
+
+namespace {
+// SplitMix64, so a synthetic trace is the same on every host
+struct Mix {
+  uint64_t s;
+  uint32_t next() {
+    uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+  }
+  int below(int n) { return n > 0 ? (int)(next() % (uint32_t)n) : 0; }
+};
+
+bool plainSsidByte(uint8_t c) {
+  return c > ' ' && c < 0x7F && c != '\\' && c != '#';
+}
+
+void escapeSsid(const ScanRecord &rec, std::string &out) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  for(size_t i = 0; i < rec.ssidLen; i++) {
+    uint8_t c = (uint8_t)rec.ssid[i];
+    if(plainSsidByte(c)) {
+      out += (char)c;
+    } else {
+      out += "\\x";
+      out += HEX_DIGITS[c >> 4];
+      out += HEX_DIGITS[c & 0xF];
+    }
+  }
+}
+
+bool unescapeSsid(const char* s, ScanRecord &rec) {
+  size_t n = 0;
+  while(*s) {
+    if(n == sizeof(rec.ssid) - 1) return false;
+    if(s[0] == '\\') {
+      if(s[1] != 'x') return false;
+      int hi = hexNibble(s[2]);
+      int lo = hi < 0 ? -1 : hexNibble(s[3]);
+      if(lo < 0) return false;
+      rec.ssid[n++] = (char)(hi * 16 + lo);
+      s += 4;
+    } else {
+      rec.ssid[n++] = *s++;
+    }
+  }
+  rec.ssid[n] = '\0';
+  rec.ssidLen = (uint8_t)n;
+  return true;
+}
+
+// "BSSID rssi channel auth [ssid]"
+bool parseRecord(char* line, ScanRecord &rec) {
+  memset(&rec, 0, sizeof(rec));
+  char* fields[5] = { nullptr };
+  int n = 0;
+  char* p = line;
+  while(n < 5 && *p) {
+    fields[n++] = p;
+    while(*p && *p != ' ') p++;
+    if(*p) *p++ = '\0';
+    while(*p == ' ') p++;
+  }
+  if(n < 4) return false;
+  uint64_t key;
+  if(!parseMac(fields[0], key)) return false;
+  keyToMac(key, rec.bssid);
+  rec.rssi = (int8_t)atoi(fields[1]);
+  rec.channel = (uint8_t)atoi(fields[2]);
+  rec.auth = (uint8_t)atoi(fields[3]);
+  return unescapeSsid(n == 5 ? fields[4] : "", rec);
+}
+
+bool writeAll(PalFile &f, const std::string &s) {
+  return f.write((const uint8_t*)s.data(), s.size()) == s.size();
+}
+}
+
+bool ScanTrace::load(PalFs &fs, const char* path) {
+  std::unique_ptr<PalFile> f = fs.open(path, "r");
+  if(!f) return false;
+  std::string text;
+  uint8_t buf[512];
+  size_t n;
+  while((n = f->read(buf, sizeof(buf))) > 0) text.append((const char*)buf, n);
+
+  ScanSweep* sweep = nullptr;
+  size_t pos = 0;
+  while(pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if(end == std::string::npos) end = text.size();
+    std::string line = text.substr(pos, end - pos);
+    pos = end + 1;
+    size_t hash = line.find('#');
+    if(hash != std::string::npos) line.erase(hash);
+    while(!line.empty() && (line.back() == ' ' || line.back() == '\r')) line.pop_back();
+    if(line.empty()) continue;
+
+    if(line[0] == '@') {
+      sweeps_.push_back(ScanSweep());
+      sweep = &sweeps_.back();
+      sweep->ms = (uint32_t)strtoul(line.c_str() + 1, nullptr, 10);
+      continue;
+    }
+    ScanRecord rec;
+    if(!sweep || !parseRecord(&line[0], rec)) return false;
+    sweep->aps.push_back(rec);
+  }
+  return true;
+}
+
+bool ScanTrace::writeSweep(PalFile &f, const ScanSweep &s) {
+  std::string out;
+  char head[48];
+  snprintf(head, sizeof(head), "@%u\n", (unsigned)s.ms);
+  out += head;
+  for(const ScanRecord &rec : s.aps) {
+    char mac[18];
+    formatMac(macToKey(rec.bssid), mac);
+    snprintf(head, sizeof(head), "%s %d %u %u ", mac, rec.rssi, rec.channel, rec.auth);
+    out += head;
+    escapeSsid(rec, out);
+    out += '\n';
+  }
+  return writeAll(f, out);
+}
+
+bool ScanTrace::save(PalFs &fs, const char* path) const {
+  std::unique_ptr<PalFile> f = fs.open(path, "w");
+  if(!f) return false;
+  if(!writeAll(*f, "# scan trace: @ms, then bssid rssi channel auth ssid\n")) return false;
+  for(const ScanSweep &s : sweeps_) {
+    if(!writeSweep(*f, s)) return false;
+  }
+  f->flush();
+  return true;
+}
+
+size_t ScanTrace::records() const {
+  size_t n = 0;
+  for(const ScanSweep &s : sweeps_) n += s.aps.size();
+  return n;
+}
+
+ScanTrace ScanTrace::synthetic(uint64_t seed, size_t sweeps, size_t aps, uint32_t periodMs) {
+  static const char* NAMES[] = {
+    "HOME", "NETGEAR", "Linksys", "xfinitywifi", "TP-Link", "Cafe Wifi",
+    "Guest", "DIRECT-printer", "Pixel", "iPhone", "Library", "Bus Stop"
+  };
+  static const int NAME_COUNT = sizeof(NAMES) / sizeof(NAMES[0]);
+  static const int CHANNELS[] = { 1, 6, 6, 11, 11, 1, 3, 36, 44, 149 };
+  static const int STREET = 1000;    // positions along the walk
+  static const int HEARING = 40;     // how far an AP carries, in positions
+
+  Mix rng = { seed };
+  struct Ap { ScanRecord rec; int at; };
+  std::vector<Ap> hood(aps);
+  for(size_t i = 0; i < aps; i++) {
+    Ap &a = hood[i];
+    memset(&a.rec, 0, sizeof(a.rec));
+    // locally administered OUI keeps synthetic MACs off real vendors
+    uint64_t key = 0x020000000000ULL | ((uint64_t)rng.next() << 8) | (i & 0xFF);
+    keyToMac(key & 0xFEFFFFFFFFFFULL, a.rec.bssid);
+    a.rec.channel = (uint8_t)CHANNELS[rng.below(sizeof(CHANNELS) / sizeof(CHANNELS[0]))];
+    a.rec.auth = (uint8_t)(rng.below(10) < 2 ? SCAN_AUTH_OPEN : SCAN_AUTH_WPA_PSK + rng.below(4));
+    if(rng.below(20) == 0) {
+      a.rec.ssidLen = 0;   // hidden
+    } else {
+      int n = snprintf(a.rec.ssid, sizeof(a.rec.ssid), "%s-%02X",
+                       NAMES[rng.below(NAME_COUNT)], (unsigned)(rng.next() & 0xFF));
+      if(rng.below(25) == 0 && n < 30) {
+        // a few SSIDs with UTF-8 in them, as people name their routers
+        a.rec.ssid[n++] = (char)0xE2;
+        a.rec.ssid[n++] = (char)0x98;
+        a.rec.ssid[n++] = (char)0x95;
+        a.rec.ssid[n] = '\0';
+      }
+      a.rec.ssidLen = (uint8_t)n;
+    }
+    a.at = rng.below(STREET);
+  }
+
+  ScanTrace t;
+  int pos = rng.below(STREET);
+  int heading = 1;
+  uint32_t ms = periodMs;
+  for(size_t s = 0; s < sweeps; s++) {
+    ScanSweep sweep;
+    sweep.ms = ms;
+    for(const Ap &a : hood) {
+      int d = abs(a.at - pos);
+      bool heard = d <= HEARING || rng.below(200) == 0;   // or a freak long-range hit
+      if(!heard || rng.below(10) == 0) continue;         // sweeps miss some every time
+      ScanRecord rec = a.rec;
+      int rssi = -35 - (d > HEARING ? 55 : d) - rng.below(8);
+      rec.rssi = (int8_t)(rssi < -95 ? -95 : rssi);
+      sweep.aps.push_back(rec);
+    }
+    t.sweeps_.push_back(sweep);
+    // an errand: mostly onward, sometimes back the way we came
+    if(rng.below(8) == 0) heading = -heading;
+    pos += heading * (5 + rng.below(20));
+    if(pos < 0) { pos = 0; heading = 1; }
+    if(pos >= STREET) { pos = STREET - 1; heading = -1; }
+    ms += periodMs + rng.below(periodMs / 4 + 1);
+  }
+  return t;
+}
+
+int TraceRadio::sweep(bool async) {
+  current_ = next_ < trace_.sweeps().size() ? &trace_.sweeps()[next_++] : nullptr;
+  return async ? SWEEP_RUNNING : sweepDone();
+}
+
+int TraceRadio::sweepDone() {
+  return current_ ? (int)current_->aps.size() : 0;
+}
+
+void TraceRadio::result(int i, ScanRecord &rec) {
+  if(current_ && i >= 0 && (size_t)i < current_->aps.size()) rec = current_->aps[i];
+  else memset(&rec, 0, sizeof(rec));
+}
+
+bool TraceRadio::nextMs(uint32_t &ms) const {
+  if(next_ >= trace_.sweeps().size()) return false;
+  ms = trace_.sweeps()[next_].ms;
+  return true;
+}
+
+int RecordingRadio::sweep(bool async) {
+  int n = radio_.sweep(async);
+  pending_ = async && n == SWEEP_RUNNING;
+  if(!async && n >= 0) record(n);
+  return n;
+}
+
+int RecordingRadio::sweepDone() {
+  int n = radio_.sweepDone();
+  if(pending_ && n != SWEEP_RUNNING) {
+    pending_ = false;
+    if(n >= 0) record(n);
+  }
+  return n;
+}
+
+void RecordingRadio::record(int n) {
+  ScanSweep s;
+  s.ms = clock_.millis();
+  s.aps.resize(n);
+  for(int i = 0; i < n; i++) radio_.result(i, s.aps[i]);
+  std::unique_ptr<PalFile> f = fs_.open(path_, "a");
+  if(f && ScanTrace::writeSweep(*f, s)) recorded_++;
+}
@@ -0,0 +1,565 @@
+// seen_index.cpp
+#include "seen_index.h"
+#include "mac_addr.h"
+#include "crc32.h"
+#include "boot_image.h"
+#include <algorithm>
+#include <iterator>
+#include <math.h>
+#include <stdio.h>
+
+static const size_t REC = BssidJournal::RECORD_SIZE;
+static const size_t BLOOM_MIN_BITS = 8192;
+// readFooter() tells the footer versions apart by what the file size
+// leaves over after whole records
+static_assert(SeenIndex::FOOTER_SIZE % REC != 0 && SeenIndex::FOOTER_V1_SIZE % REC != 0 &&
+              SeenIndex::FOOTER_SIZE % REC != SeenIndex::FOOTER_V1_SIZE % REC,
+              "segment footer sizes must differ modulo the record size");
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+SeenIndex::SeenIndex(PalFs &fs, const char* segmentPath, const char* journalPath,
+                     size_t bloomMaxBits, size_t memtableCap)
+  : fs_(fs), segPath_(segmentPath), journal_(fs, journalPath),
+    bloom_(BLOOM_MIN_BITS, 7), bloomMaxBits_(bloomMaxBits), bloomKeys_(0),
+    memtable_(memtableCap + memtableCap / 3 + 1), memtableCap_(memtableCap)
+{
+  snprintf(tmpPath_, sizeof(tmpPath_), "%s.tmp", segmentPath);
+  merger_.active = false;
+  nextSeq_ = 1;
+  stats_ = Stats();
+}
+
+void SeenIndex::slotPath(size_t slot, char* out) const {
+  if(slot == 0) snprintf(out, 32, "%s", segPath_);
+  else snprintf(out, 32, "%s.%u", segPath_, (unsigned)slot);
+}
+
+void SeenIndex::reset() {
+  abandonMerge();
+  segs_.clear();
+  memtable_.clear();
+  std::vector<uint64_t>().swap(frozen_);
+
+  // Merge output is renamed into a free slot before its inputs are
+  // removed, so a temp segment is always unfinished; except from firmware
+  // with one segment, which removed it first and may have died before the
+  // rename.
+  if(fs_.exists(tmpPath_)){
+    bool any = false;
+    char path[32];
+    for(size_t i=0; i<SEGMENT_SLOTS && !any; i++){
+      slotPath(i, path);
+      any = fs_.exists(path);
+    }
+    if(any) fs_.remove(tmpPath_);
+    else fs_.rename(tmpPath_, segPath_);
+  }
+}
+
+// Opens every segment and reads its footer; no records yet
+void SeenIndex::loadSegments() {
+  char path[32];
+  for(size_t i=0; i<SEGMENT_SLOTS; i++){
+    slotPath(i, path);
+    if(!fs_.exists(path)) continue;
+    std::unique_ptr<PalFile> f = fs_.open(path, "r");
+    if(!f) continue;
+    Segment s;
+    s.slot = (uint8_t)i;
+    s.crc = 0;
+    s.records = readFooter(*f, s.crc, s.seq, s.footer);
+    s.last = 0;
+    s.reader = std::move(f);
+    segs_.push_back(std::move(s));
+  }
+  // Oldest first, as the merges left them in RAM. A merge short of room
+  // leaves its oldest inputs out, so its output can be bigger than an older
+  // segment: only segments from before sequence numbers go by size, which
+  // was age order while every merge took all of its inputs.
+  std::stable_sort(segs_.begin(), segs_.end(), [](const Segment &a, const Segment &b){
+    return a.seq != b.seq ? a.seq < b.seq : a.records > b.records;
+  });
+  nextSeq_ = segs_.empty() ? 1 : segs_.back().seq + 1;
+}
+
+// Adds the segment's keys to the Bloom filter; with index, also rebuilds
+// its fences and checks its CRC (false on a mismatch)
+bool SeenIndex::scanSegment(Segment &s, bool index) {
+  if(index) s.fence.clear();
+  uint32_t crc = 0;
+  size_t left = s.records, pos = 0;
+  while(left > 0){
+    size_t want = std::min((size_t)BLOCK_RECORDS, left);
+    size_t recs = s.reader->seek(pos * REC) ? s.reader->read(blockBuf_, want * REC) / REC : 0;
+    if(recs == 0) break;
+    if(index){
+      crc = crc32Update(crc, blockBuf_, recs * REC);
+      s.fence.push_back(macToKey(blockBuf_));
+      s.last = macToKey(blockBuf_ + (recs - 1) * REC);
+    }
+    for(size_t i=0; i<recs; i++) bloom_.add(macToKey(blockBuf_ + i * REC));
+    pos += recs;
+    left -= recs;
+    if(recs < want) break;
+  }
+  if(!index) return true;
+  s.records = pos;
+  bool ok = !s.footer || (left == 0 && crc == s.crc);
+  if(!ok) stats_.badSegments++;
+  s.crc = crc;
+  return ok;
+}
+
+bool SeenIndex::begin() {
+  reset();
+  loadSegments();
+  // room for the journal too, which may hold a full memtable
+  sizeBloom(2 * (segmentRecords() + memtableCap_));
+  bool segmentsOk = true;
+  for(Segment &s : segs_){
+    if(!scanSegment(s, true)) segmentsOk = false;
+  }
+  replayJournal();
+  return segmentsOk;
+}
+
+// Image sections: segment identities and Bloom sizing, then the Bloom bits
+// and every segment's fence keys exactly as they sit in RAM
+enum {
+  IMAGE_SEEN_META  = 0x4d4e4553,   // "SENM"
+  IMAGE_SEEN_BLOOM = 0x424e4553,   // "SENB"
+  IMAGE_SEEN_FENCE = 0x464e4553    // "SENF"
+};
+// META: version, segment count, Bloom bits, hashes, keys sized for, then
+// per segment: slot, records, crc, fence count, last key low/high
+static const uint32_t IMAGE_META_VERSION = 2;
+static const size_t IMAGE_META_HEAD = 5;
+static const size_t IMAGE_META_SEG = 6;
+
+bool SeenIndex::addToImage(BootImageWriter &w) {
+  if(merger_.active) return false;   // segments about to change
+  imageMeta_.clear();
+  imageFence_.clear();
+  imageMeta_.push_back(IMAGE_META_VERSION);
+  imageMeta_.push_back((uint32_t)segs_.size());
+  imageMeta_.push_back((uint32_t)bloom_.bits());
+  imageMeta_.push_back((uint32_t)bloom_.hashes());
+  imageMeta_.push_back((uint32_t)bloomKeys_);
+  for(const Segment &s : segs_){
+    imageMeta_.push_back(s.slot);
+    imageMeta_.push_back((uint32_t)s.records);
+    imageMeta_.push_back(s.crc);
+    imageMeta_.push_back((uint32_t)s.fence.size());
+    imageMeta_.push_back((uint32_t)s.last);
+    imageMeta_.push_back((uint32_t)(s.last >> 32));
+    imageFence_.insert(imageFence_.end(), s.fence.begin(), s.fence.end());
+  }
+  return w.add(IMAGE_SEEN_META, imageMeta_.data(), imageMeta_.size() * sizeof(uint32_t)) &&
+         w.add(IMAGE_SEEN_BLOOM, bloom_.data(), bloom_.memoryBytes()) &&
+         w.add(IMAGE_SEEN_FENCE, imageFence_.data(), imageFence_.size() * sizeof(uint64_t));
+}
+
+bool SeenIndex::beginFromImage(BootImageReader &r) {
+  reset();
+  loadSegments();
+  // the image must describe these exact segments (none counts too)
+  for(const Segment &s : segs_){
+    if(!s.footer) return false;
+  }
+  size_t metaLen = r.length(IMAGE_SEEN_META);
+  if(metaLen != (IMAGE_META_HEAD + IMAGE_META_SEG * segs_.size()) * sizeof(uint32_t)) return false;
+  std::vector<uint32_t> meta(metaLen / sizeof(uint32_t));
+  if(!r.read(IMAGE_SEEN_META, meta.data(), metaLen) ||
+     meta[0] != IMAGE_META_VERSION || meta[1] != segs_.size() ||
+     meta[2] > bloomMaxBits_ || meta[3] < 1 || meta[3] > 7) return false;
+
+  size_t fences = 0;
+  for(size_t i=0; i<segs_.size(); i++){
+    const uint32_t* m = &meta[IMAGE_META_HEAD + i * IMAGE_META_SEG];
+    const Segment &s = segs_[i];
+    if(m[0] != s.slot || m[1] != s.records || m[2] != s.crc) return false;
+    fences += m[3];
+  }
+  if(!bloom_.reset(meta[2], (int)meta[3]) || bloom_.bits() != meta[2] ||
+     !r.read(IMAGE_SEEN_BLOOM, bloom_.data(), bloom_.memoryBytes())) return false;
+  bloomKeys_ = meta[4];
+  std::vector<uint64_t> fence(fences);
+  if(!r.read(IMAGE_SEEN_FENCE, fence.data(), fences * sizeof(uint64_t))) return false;
+
+  size_t at = 0;
+  for(size_t i=0; i<segs_.size(); i++){
+    const uint32_t* m = &meta[IMAGE_META_HEAD + i * IMAGE_META_SEG];
+    Segment &s = segs_[i];
+    s.fence.assign(fence.begin() + at, fence.begin() + at + m[3]);
+    s.last = (uint64_t)m[4] | ((uint64_t)m[5] << 32);
+    at += m[3];
+  }
+  replayJournal();
+  return true;
+}
+
+void SeenIndex::replayJournal() {
+  // Recent inserts that never reached a segment
+  journal_.load([this](uint64_t mac){
+    if(memtable_.insert(mac)) bloom_.add(mac);
+  });
+  if(memtable_.size() >= memtableCap_){
+    startMerge();
+    while(merger_.active) service(BLOCK_RECORDS);
+  } else if(journal_.needsCompaction(memtable_.size())){
+    rewriteJournal();
+  }
+}
+
+// Power-of-two bits at BLOOM_BITS_PER_KEY for keys, within
+// [BLOOM_MIN_BITS, bloomMaxBits_], and the hash count that suits them
+void SeenIndex::sizeBloom(size_t keys) {
+  size_t cap = 64;
+  while(cap * 2 <= bloomMaxBits_) cap <<= 1;
+  size_t bits = std::min(BLOOM_MIN_BITS, cap);
+  while(bits < cap && bits < keys * BLOOM_BITS_PER_KEY) bits <<= 1;
+  int hashes = keys ? (int)((double)bits / keys * 0.6931 + 0.5) : 7;
+  hashes = std::max(1, std::min(7, hashes));
+  bloomKeys_ = keys;
+  bloom_.reset(bits, hashes);
+}
+
+// One pass over every key, at a size for twice as many as there are now
+void SeenIndex::rebuildBloom() {
+  sizeBloom(2 * size());
+  for(Segment &s : segs_) scanSegment(s, false);
+  for(uint64_t mac : frozen_) bloom_.add(mac);
+  memtable_.forEach([this](uint64_t mac){ bloom_.add(mac); });
+  stats_.bloomRebuilds++;
+}
+
+double SeenIndex::bloomFalsePositive() const {
+  if(!bloom_.bits()) return 1.0;
+  double k = bloom_.hashes();
+  return pow(1.0 - exp(-k * (double)size() / (double)bloom_.bits()), k);
+}
+
+// Record count of a segment. Version 0 segments (before the footer) are
+// bare records and version 1 footers have no sequence number (seq 0);
+// both get a current footer at their next merge.
+size_t SeenIndex::readFooter(PalFile &f, uint32_t &crc, uint32_t &seq, bool &hasFooter) {
+  size_t size = f.size();
+  hasFooter = false;
+  seq = 0;
+  if(size % REC == 0) return size / REC;
+  bool v1 = size % REC == FOOTER_V1_SIZE % REC;
+  size_t footLen = v1 ? FOOTER_V1_SIZE : FOOTER_SIZE;
+  uint8_t foot[FOOTER_SIZE];
+  if(size < footLen || !f.seek(size - footLen) ||
+     f.read(foot, footLen) != footLen ||
+     get32(foot) != SEGMENT_MAGIC ||
+     (foot[4] | (foot[5] << 8)) != (v1 ? 1 : SEGMENT_VERSION) ||
+     (foot[6] | (foot[7] << 8)) != REC){
+    stats_.badSegments++;
+    return (size / REC);   // best effort: every whole record
+  }
+  hasFooter = true;
+  size_t count = get32(foot + 8);
+  crc = get32(foot + 12);
+  if(!v1) seq = get32(foot + 16);
+  if(count * REC + footLen != size) return std::min(count, (size - footLen) / REC);
+  return count;
+}
+
+bool SeenIndex::contains(uint64_t mac) {
+  stats_.lookups++;
+  if(!bloom_.mightContain(mac)){
+    stats_.bloomRejects++;
+    return false;
+  }
+  if(memtable_.contains(mac)) return true;
+  if(std::binary_search(frozen_.begin(), frozen_.end(), mac)) return true;
+  for(size_t i=segs_.size(); i-- > 0; ){
+    if(segmentContains(segs_[i], mac)) return true;
+  }
+  return false;
+}
+
+bool SeenIndex::segmentContains(Segment &s, uint64_t mac) {
+  if(s.fence.empty() || !s.reader || mac < s.fence[0] || mac > s.last) return false;
+  std::vector<uint64_t>::const_iterator it = std::upper_bound(s.fence.begin(), s.fence.end(), mac);
+  size_t block = (it - s.fence.begin()) - 1;
+  size_t first = block * BLOCK_RECORDS;
+  size_t recs  = std::min((size_t)BLOCK_RECORDS, s.records - first);
+
+  stats_.flashReads++;
+  if(!s.reader->seek(first * REC)) return false;
+  if(s.reader->read(blockBuf_, recs * REC) != recs * REC) return false;
+
+  size_t lo = 0, hi = recs;
+  while(lo < hi){
+    size_t mid = (lo + hi) / 2;
+    uint64_t k = macToKey(blockBuf_ + mid * REC);
+    if(k == mac) return true;
+    if(k < mac) lo = mid + 1;
+    else hi = mid;
+  }
+  return false;
+}
+
+void SeenIndex::forEach(const std::function<void(uint64_t)> &fn) {
+  for(Segment &s : segs_){
+    for(size_t pos=0; pos<s.records; pos+=BLOCK_RECORDS){
+      size_t recs = std::min((size_t)BLOCK_RECORDS, s.records - pos);
+      if(!s.reader->seek(pos * REC) || s.reader->read(blockBuf_, recs * REC) != recs * REC) break;
+      for(size_t i=0; i<recs; i++) fn(macToKey(blockBuf_ + i * REC));
+    }
+  }
+  forEachRecent(fn);
+}
+
+void SeenIndex::forEachRecent(const std::function<void(uint64_t)> &fn) {
+  for(size_t i=0; i<frozen_.size(); i++) fn(frozen_[i]);
+  memtable_.forEach(fn);
+}
+
+bool SeenIndex::insert(uint64_t mac) {
+  if(!memtable_.insert(mac)) return false;
+  bloom_.add(mac);
+  bool ok = journal_.append(mac);
+  stats_.journalDrops = (uint32_t)journal_.dropped();
+  if(memtable_.size() >= memtableCap_){
+    // Still merging the previous memtable: finish it before freezing again
+    while(merger_.active) service(BLOCK_RECORDS);
+    journal_.flush();
+    startMerge();
+  }
+  return ok;
+}
+
+bool SeenIndex::sync() {
+  bool flushed = journal_.flush();
+  // A short flush can leave a torn tail; the rewrite from RAM clears it and
+  // picks up any dropped records
+  if(journal_.needsCompaction(memtable_.size() + frozen_.size())){
+    return rewriteJournal();
+  }
+  return flushed;
+}
+
+size_t SeenIndex::segmentRecords() const {
+  size_t n = 0;
+  for(const Segment &s : segs_) n += s.records;
+  return n;
+}
+
+size_t SeenIndex::memoryBytes() const {
+  size_t n = sizeof(*this) + bloom_.memoryBytes() + memtable_.memoryBytes()
+           + frozen_.capacity() * sizeof(uint64_t)
+           + segs_.capacity() * sizeof(Segment)
+           + merger_.fence.capacity() * sizeof(uint64_t)
+           + merger_.inputs.size() * sizeof(Input);
+  for(const Segment &s : segs_) n += s.fence.capacity() * sizeof(uint64_t);
+  return n;
+}
+
+bool SeenIndex::startMerge() {
+  std::vector<uint64_t> fresh;
+  fresh.reserve(memtable_.size());
+  memtable_.forEach([&fresh](uint64_t mac){ fresh.push_back(mac); });
+  std::sort(fresh.begin(), fresh.end());
+  memtable_.clear();
+  // Keys left frozen by a merge that failed or had no room are in neither
+  // a segment nor the memtable: fold them into this run rather than lose
+  // them
+  if(frozen_.empty()){
+    frozen_.swap(fresh);
+  } else {
+    std::vector<uint64_t> run;
+    run.reserve(frozen_.size() + fresh.size());
+    std::set_union(frozen_.begin(), frozen_.end(), fresh.begin(), fresh.end(), std::back_inserter(run));
+    frozen_.swap(run);
+  }
+  if(frozen_.empty()) return false;
+
+  // Take in the newest segments while each is no bigger than the run so
+  // far, and enough of them to stay within MAX_SEGMENTS
+  size_t n = segs_.size(), first = n, records = frozen_.size();
+  while(first > 0 && (first + 1 > MAX_SEGMENTS || segs_[first - 1].records <= records)){
+    first--;
+    records += segs_[first].records;
+  }
+  // The inputs stay until the output is renamed in, so the output needs
+  // its own room: leave the oldest inputs out until it fits
+  size_t room = fs_.freeBytes();
+  if(room != PalFs::UNKNOWN_FREE && records * REC + FOOTER_SIZE > room){
+    while(first < n && first + 2 <= MAX_SEGMENTS && records * REC + FOOTER_SIZE > room){
+      records -= segs_[first].records;
+      first++;
+    }
+    stats_.mergesNoRoom++;
+    // Not even room for this run: keep it frozen in RAM (still journaled)
+    if(records * REC + FOOTER_SIZE > room) return false;
+  }
+
+  unsigned used = 0;
+  for(const Segment &s : segs_) used |= 1u << s.slot;
+  size_t slot = 0;
+  while(slot < SEGMENT_SLOTS && (used & (1u << slot))) slot++;
+  if(slot == SEGMENT_SLOTS) return false;
+
+  Merger &m = merger_;
+  m.out = fs_.open(tmpPath_, "w");
+  if(!m.out) return false;   // keep serving from RAM; the frozen keys stay journaled
+  m.first = first;
+  m.slot = (uint8_t)slot;
+  m.inputs.clear();
+  for(size_t i=first; i<n; i++){
+    std::unique_ptr<Input> in(new Input());
+    in->seg = i;
+    in->next = in->pos = in->len = 0;
+    m.inputs.push_back(std::move(in));
+  }
+  m.frozenPos = 0;
+  m.written = 0;
+  m.last = 0;
+  m.outLen = 0;
+  m.crc = 0;
+  m.fence.clear();
+  m.active = true;
+  return true;
+}
+
+bool SeenIndex::emit(uint64_t mac) {
+  Merger &m = merger_;
+  if(m.written % BLOCK_RECORDS == 0) m.fence.push_back(mac);
+  keyToMac(mac, m.outBuf + m.outLen);
+  m.outLen += REC;
+  m.written++;
+  m.last = mac;
+  if(m.outLen == sizeof(m.outBuf)){
+    if(m.out->write(m.outBuf, m.outLen) != m.outLen) return false;
+    m.crc = crc32Update(m.crc, m.outBuf, m.outLen);
+    m.outLen = 0;
+  }
+  return true;
+}
+
+// Out of flash or a failed read: drop the output, the frozen keys remain
+// in RAM and the inputs where they were
+void SeenIndex::abandonMerge() {
+  Merger &m = merger_;
+  if(!m.active) return;
+  m.out.reset();
+  m.inputs.clear();
+  std::vector<uint64_t>().swap(m.fence);
+  fs_.remove(tmpPath_);
+  m.active = false;
+}
+
+void SeenIndex::service(size_t budget) {
+  Merger &m = merger_;
+  if(!m.active) return;
+  while(budget-- > 0){
+    uint64_t next = UINT64_MAX;
+    bool any = false;
+    for(std::unique_ptr<Input> &p : m.inputs){
+      Input &in = *p;
+      Segment &s = segs_[in.seg];
+      if(in.pos == in.len && in.next < s.records){
+        size_t want = std::min(s.records - in.next, (size_t)MERGE_BUF_RECORDS);
+        size_t got = s.reader->seek(in.next * REC) ? s.reader->read(in.buf, want * REC) / REC : 0;
+        if(got != want){
+          abandonMerge();
+          return;
+        }
+        in.next += got;
+        in.pos = 0;
+        in.len = got;
+      }
+      if(in.pos < in.len){
+        next = std::min(next, macToKey(in.buf + in.pos * REC));
+        any = true;
+      }
+    }
+    if(m.frozenPos < frozen_.size()){
+      next = std::min(next, frozen_[m.frozenPos]);
+      any = true;
+    }
+    if(!any){
+      finishMerge();
+      return;
+    }
+    // a key in more than one input (a reboot between rename and remove)
+    // is written once
+    for(std::unique_ptr<Input> &p : m.inputs){
+      if(p->pos < p->len && macToKey(p->buf + p->pos * REC) == next) p->pos++;
+    }
+    if(m.frozenPos < frozen_.size() && frozen_[m.frozenPos] == next) m.frozenPos++;
+    if(!emit(next)){
+      abandonMerge();
+      return;
+    }
+  }
+}
+
+bool SeenIndex::finishMerge() {
+  Merger &m = merger_;
+  bool ok = m.outLen == 0 || m.out->write(m.outBuf, m.outLen) == m.outLen;
+  m.crc = crc32Update(m.crc, m.outBuf, m.outLen);
+  uint8_t foot[FOOTER_SIZE];
+  put32(foot, SEGMENT_MAGIC);
+  foot[4] = (uint8_t)SEGMENT_VERSION;
+  foot[5] = (uint8_t)(SEGMENT_VERSION >> 8);
+  foot[6] = (uint8_t)REC;
+  foot[7] = 0;
+  put32(foot + 8, (uint32_t)m.written);
+  put32(foot + 12, m.crc);
+  put32(foot + 16, nextSeq_);
+  ok = ok && m.out->write(foot, FOOTER_SIZE) == FOOTER_SIZE;
+  m.out.reset();
+  char path[32];
+  slotPath(m.slot, path);
+  if(!ok || !fs_.rename(tmpPath_, path)){
+    abandonMerge();
+    return false;
+  }
+  m.inputs.clear();
+  m.active = false;
+
+  // The new segment is complete on flash; only now drop its inputs
+  for(size_t i=m.first; i<segs_.size(); i++){
+    char old[32];
+    segs_[i].reader.reset();
+    slotPath(segs_[i].slot, old);
+    fs_.remove(old);
+  }
+  segs_.resize(m.first);
+  Segment s;
+  s.slot = m.slot;
+  s.footer = true;
+  s.records = m.written;
+  s.crc = m.crc;
+  s.seq = nextSeq_++;
+  s.last = m.last;
+  s.fence.swap(m.fence);
+  s.reader = fs_.open(path, "r");
+  segs_.push_back(std::move(s));
+  std::vector<uint64_t>().swap(frozen_);
+  stats_.merges++;
+
+  // Grown past what the filter was sized for: bigger, or at the RAM cap
+  // fewer hashes, which is what keeps false positives lowest there
+  if(size() > bloomKeys_) rebuildBloom();
+  // The frozen keys are in a segment now; keep only the memtable journaled
+  return rewriteJournal();
+}
+
+bool SeenIndex::rewriteJournal() {
+  if(!journal_.beginCompaction()) return false;
+  memtable_.forEach([this](uint64_t mac){ journal_.addCompacted(mac); });
+  for(uint64_t mac : frozen_) journal_.addCompacted(mac);
+  return journal_.commitCompaction();
+}
@@ -0,0 +1,80 @@
+// session_table.cpp
+#include "session_table.h"
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v; p[1] = v >> 8;
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+size_t encodeSessions(const Session* const* sessions, size_t n, uint8_t* buf, size_t cap) {
+  size_t len = SESSION_SAVE_BYTES(n);
+  if(cap < len || n > 0xFFFF) return 0;
+  put16(buf, SESSION_SAVE_VERSION);
+  put16(buf + 2, (uint16_t)n);
+  uint8_t* p = buf + 4;
+  for(size_t i = 0; i < n; i++, p += SESSION_RECORD_BYTES) {
+    uint64_t t = sessions[i]->token;
+    for(int b = 0; b < 8; b++) p[b] = (uint8_t)(t >> (8 * b));
+    encodeSaveGame(sessions[i]->game, p + 8, SAVE_GAME_BYTES);
+  }
+  return len;
+}
+
+bool decodeSessions(const uint8_t* buf, size_t len,
+                    const std::function<void(uint64_t token, const SaveGame &g)> &fn) {
+  if(len < 4 || get16(buf) != SESSION_SAVE_VERSION) return false;
+  size_t n = get16(buf + 2);
+  if(len < SESSION_SAVE_BYTES(n)) return false;
+  const uint8_t* p = buf + 4;
+  for(size_t i = 0; i < n; i++, p += SESSION_RECORD_BYTES) {
+    uint64_t t = 0;
+    for(int b = 7; b >= 0; b--) t = (t << 8) | p[b];
+    SaveGame g;
+    if(t != 0 && decodeSaveGame(p + 8, SAVE_GAME_BYTES, g)) fn(t, g);
+  }
+  return true;
+}
+
+void formatToken(uint64_t token, char* out) {
+  static const char HEX[] = "0123456789abcdef";
+  for(int i = 15; i >= 0; i--) {
+    out[i] = HEX[token & 0xF];
+    token >>= 4;
+  }
+  out[16] = 0;
+}
+
+bool parseToken(const char* s, size_t len, uint64_t &token) {
+  if(len != 16) return false;
+  uint64_t t = 0;
+  for(size_t i = 0; i < len; i++) {
+    char c = s[i];
+    int d;
+    if(c >= '0' && c <= '9') d = c - '0';
+    else if(c >= 'a' && c <= 'f') d = c - 'a' + 10;
+    else if(c >= 'A' && c <= 'F') d = c - 'A' + 10;
+    else return false;
+    t = (t << 4) | (uint64_t)d;
+  }
+  if(t == 0) return false;
+  token = t;
+  return true;
+}
+
+bool cookieToken(const char* cookies, const char* name, uint64_t &token) {
+  size_t nameLen = strlen(name);
+  const char* p = cookies;
+  while(p && *p) {
+    while(*p == ' ' || *p == ';') p++;
+    const char* end = strchr(p, ';');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    if(len > nameLen && strncmp(p, name, nameLen) == 0 && p[nameLen] == '=') {
+      return parseToken(p + nameLen + 1, len - nameLen - 1, token);
+    }
+    p = end;
+  }
+  return false;
+}
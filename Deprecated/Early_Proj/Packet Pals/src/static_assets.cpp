@@ -0,0 +1,149 @@
+// static_assets.cpp
+#include "static_assets.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* AssetTable::MANIFEST = "/assets.txt";
+
+static const size_t MAX_MANIFEST = 4096;
+
+void StaticAsset::etag(bool gz, char* out) const {
+  snprintf(out, 16, gz ? "\"%08lx-gz\"" : "\"%08lx\"", (unsigned long)crc);
+}
+
+static bool endsWith(const char* s, const char* suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+const char* mimeForPath(const char* path) {
+  if(endsWith(path, ".html")) return "text/html";
+  if(endsWith(path, ".js"))   return "text/javascript";
+  if(endsWith(path, ".css"))  return "text/css";
+  if(endsWith(path, ".json")) return "application/json";
+  if(endsWith(path, ".mp3"))  return "audio/mpeg";
+  if(endsWith(path, ".png"))  return "image/png";
+  if(endsWith(path, ".svg"))  return "image/svg+xml";
+  if(endsWith(path, ".ico"))  return "image/x-icon";
+  return "application/octet-stream";
+}
+
+// Pages and scripts keep their names between firmware builds, so the
+// browser must revalidate them (cheap: 304). Audio never changes under
+// the same name; give it a new file name if it ever does.
+const char* cacheControlForPath(const char* path) {
+  if(strncmp(path, "/audio/", 7) == 0) return "public, max-age=31536000, immutable";
+  return "no-cache";
+}
+
+bool AssetTable::parseLine(const char* line) {
+  // "<path> <size> <crc32 hex> <gzSize>"
+  StaticAsset a;
+  const char* sp = strchr(line, ' ');
+  if(!sp || line[0] != '/' || (size_t)(sp - line) >= StaticAsset::MAX_PATH) return false;
+  memcpy(a.path, line, sp - line);
+  a.path[sp - line] = 0;
+  char* end;
+  a.size = strtoul(sp + 1, &end, 10);
+  if(*end != ' ') return false;
+  a.crc = strtoul(end + 1, &end, 16);
+  if(*end != ' ') return false;
+  a.gzSize = strtoul(end + 1, &end, 10);
+  a.mime = mimeForPath(a.path);
+  a.cacheControl = cacheControlForPath(a.path);
+  assets_.push_back(a);
+  return true;
+}
+
+bool AssetTable::load(PalFs &fs, const char* manifest) {
+  assets_.clear();
+  std::unique_ptr<PalFile> f = fs.open(manifest, "r");
+  if(!f) return false;
+  size_t len = f->size();
+  if(len == 0 || len > MAX_MANIFEST) return false;
+  std::vector<char> text(len + 1);
+  if(f->read((uint8_t*)text.data(), len) != len) return false;
+  text[len] = 0;
+
+  char* line = text.data();
+  while(line && *line) {
+    char* nl = strchr(line, '\n');
+    if(nl) {
+      *nl = 0;
+      if(nl > line && nl[-1] == '\r') nl[-1] = 0;
+    }
+    if(*line) parseLine(line);
+    line = nl ? nl + 1 : nullptr;
+  }
+  return !assets_.empty();
+}
+
+const StaticAsset* AssetTable::find(const char* path) const {
+  // a handful of files: a linear scan beats anything cleverer
+  for(size_t i = 0; i < assets_.size(); i++) {
+    if(strcmp(assets_[i].path, path) == 0) return &assets_[i];
+  }
+  return nullptr;
+}
+
+bool etagMatches(const char* ifNoneMatch, const char* etag) {
+  if(!ifNoneMatch || !*ifNoneMatch) return false;
+  size_t n = strlen(etag);
+  const char* p = ifNoneMatch;
+  while(*p) {
+    while(*p == ' ' || *p == ',') p++;
+    if(*p == '*') return true;
+    if(p[0] == 'W' && p[1] == '/') p += 2;   // weak comparison for 304
+    if(strncmp(p, etag, n) == 0 && (p[n] == 0 || p[n] == ',' || p[n] == ' ')) return true;
+    while(*p && *p != ',') p++;
+  }
+  return false;
+}
+
+bool acceptsGzip(const char* acceptEncoding) {
+  if(!acceptEncoding) return false;
+  const char* p = strstr(acceptEncoding, "gzip");
+  if(!p) return false;
+  // "gzip;q=0" turns it off
+  const char* q = p + 4;
+  while(*q == ' ') q++;
+  if(*q == ';') {
+    q++;
+    while(*q == ' ') q++;
+    if(q[0] == 'q' && q[1] == '=' && atof(q + 2) == 0.0) return false;
+  }
+  return true;
+}
+
+RangeResult parseByteRange(const char* header, uint32_t size,
+                           uint32_t &first, uint32_t &last) {
+  if(!header || strncmp(header, "bytes=", 6) != 0) return RANGE_NONE;
+  const char* p = header + 6;
+  if(strchr(p, ',')) return RANGE_NONE;
+  while(*p == ' ') p++;
+
+  char* end;
+  if(*p == '-') {
+    // suffix: last N bytes
+    if(!isdigit((unsigned char)p[1])) return RANGE_NONE;
+    unsigned long n = strtoul(p + 1, &end, 10);
+    if(n == 0 || size == 0) return RANGE_UNSATISFIABLE;
+    first = n >= size ? 0 : size - n;
+    last  = size - 1;
+    return RANGE_OK;
+  }
+  if(!isdigit((unsigned char)*p)) return RANGE_NONE;
+  unsigned long a = strtoul(p, &end, 10);
+  if(*end != '-') return RANGE_NONE;
+  if(a >= size) return RANGE_UNSATISFIABLE;
+  first = a;
+  last  = size - 1;
+  if(isdigit((unsigned char)end[1])) {
+    unsigned long b = strtoul(end + 1, &end, 10);
+    if(b < a) return RANGE_NONE;
+    if(b < last) last = b;
+  }
+  return RANGE_OK;
+}
@@ -0,0 +1,117 @@
+// sync_feed.cpp
+#include "sync_feed.h"
+#include "mac_addr.h"
+#include <stdio.h>
+
+static const int SCAN_STEP = 32;   // log entries looked at per step
+
+SyncFeed::SyncFeed(const ChangeLog &log, uint32_t epoch, uint32_t since, uint64_t scope,
+                   bool resync, const Hooks &hooks)
+  : log_(log), hooks_(hooks), epoch_(epoch), since_(since), upto_(log.seq()), cursor_(since),
+    scope_(scope), phase_(HEAD), full_(resync || !log.covers(since)), party_(false), player_(false) {
+  if(full_) return;
+  Change c;
+  for(uint32_t s = since + 1; s <= upto_ && log.at(s, c); s++) {
+    if(scope == 0 || c.ref() != scope) continue;
+    if(c.kind == CHANGE_PARTY) party_ = true;
+    if(c.kind == CHANGE_PLAYER) player_ = true;
+    if(c.kind == CHANGE_BUCKET) full_ = true;
+  }
+}
+
+// Next change of kind after cursor_ (at most SCAN_STEP looked at); false
+// with c.kind == 0 when the pass is over, with c.kind != kind when the
+// step budget ran out
+bool SyncFeed::next(uint8_t kind, Change &c) {
+  for(int i = 0; i < SCAN_STEP; i++) {
+    if(cursor_ >= upto_) {
+      c.kind = 0;
+      return false;
+    }
+    if(!log_.at(++cursor_, c)) {
+      // overwritten while the response was going out
+      full_ = true;
+      c.kind = 0;
+      return false;
+    }
+    if(c.kind == kind) return true;
+  }
+  c.kind = 0xFF;
+  return false;
+}
+
+void SyncFeed::beginList(JsonStream &js, const char* name, Phase phase) {
+  js.key(name);
+  js.beginArray();
+  cursor_ = since_;
+  phase_ = phase;
+}
+
+bool SyncFeed::step(JsonStream &js) {
+  Change c;
+  switch(phase_) {
+  case HEAD: {
+    char epoch[9];
+    snprintf(epoch, sizeof(epoch), "%08x", (unsigned)epoch_);
+    js.beginObject();
+    js.field("epoch", epoch);
+    js.field("since", (unsigned long)since_);
+    if(full_) phase_ = TAIL;
+    else beginList(js, "wild", WILD);
+    return true;
+  }
+  case WILD:
+    if(next(CHANGE_WILD_ADD, c)) {
+      WildEntry e;
+      if(hooks_.wild(c.refLo, e)) writeJson(js, e);
+    } else if(c.kind == 0) {
+      js.endArray();
+      beginList(js, "gone", GONE);
+    }
+    return true;
+  case GONE:
+    if(next(CHANGE_WILD_GONE, c)) {
+      js.value((unsigned long)c.refLo);
+    } else if(c.kind == 0) {
+      js.endArray();
+      beginList(js, "seen", SEEN);
+    }
+    return true;
+  case SEEN:
+    if(next(CHANGE_SEEN, c)) {
+      char mac[18];
+      formatMac(c.ref(), mac);
+      js.value(mac);
+    } else if(c.kind == 0) {
+      js.endArray();
+      phase_ = PARTY;
+    }
+    return true;
+  case PARTY:
+    if(!full_ && party_) {
+      Party p;
+      if(hooks_.party(p)) {
+        js.key("party");
+        writeJson(js, p);
+      }
+    }
+    if(!full_ && player_) {
+      SyncPlayer p;
+      if(hooks_.player(p)) {
+        js.key("player");
+        writeJson(js, p);
+      }
+    }
+    phase_ = TAIL;
+    return true;
+  case TAIL:
+    js.field("seq", (unsigned long)upto_);
+    js.field("full", full_);
+    js.endObject();
+    phase_ = DONE;
+    return true;
+  case DONE:
+    break;
+  }
+  return false;
+}
@@ -0,0 +1,103 @@
+// wigle_log.cpp
+#include "wigle_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// columns: MAC,SSID,AuthMode,FirstSeen,Channel,RSSI,CurrentLatitude,CurrentLongitude,Type
+const char* WigleLog::HEADER =
+  "MAC,SSID,AuthMode,FirstSeen,Channel,RSSI,CurrentLatitude,CurrentLongitude,Type\r\n";
+
+// Longest possible row: 17 MAC + 32 SSID + auth + fixed columns
+static const size_t MAX_ROW = 128;
+
+WigleLog::WigleLog(PalFs &fs, const char* path, size_t bufferBytes)
+  : fs_(fs), path_(path), buf_((char*)malloc(bufferBytes)),
+    cap_(buf_ ? bufferBytes : 0), used_(0), durability_(FLUSH_PER_SCAN),
+    maxAgeMs_(10000), oldestMs_(0), flashAppends_(0), droppedRows_(0)
+{
+}
+
+WigleLog::~WigleLog() {
+  free(buf_);
+}
+
+void WigleLog::setDurability(Durability d, uint32_t maxAgeMs) {
+  durability_ = d;
+  maxAgeMs_   = maxAgeMs;
+}
+
+size_t WigleLog::encodeRow(char* out, size_t room, const char* bssid, const char* ssid,
+                           const char* auth, int channel, int rssi)
+{
+  // SSIDs are at most 32 bytes; commas would break the columns
+  char safeSSID[33];
+  size_t i = 0;
+  for(; ssid[i] && i < sizeof(safeSSID) - 1; i++){
+    safeSSID[i] = ssid[i] == ',' ? '_' : ssid[i];
+  }
+  safeSSID[i] = '\0';
+  // placeholder date/time, lat/lon
+  int n = snprintf(out, room, "%s,%s,%s,2023-01-01 00:00:00,%d,%d,0.00000,0.00000,WIFI\n",
+                   bssid, safeSSID, auth, channel, rssi);
+  return (n < 0 || (size_t)n >= room) ? 0 : (size_t)n;
+}
+
+bool WigleLog::addRow(const char* bssid, const char* ssid, const char* auth,
+                      int channel, int rssi, uint32_t nowMs)
+{
+  if(cap_ - used_ < MAX_ROW){
+    flush();
+    if(cap_ >= MAX_ROW && cap_ - used_ < MAX_ROW){
+      droppedRows_++;
+      return false;
+    }
+  }
+  if(cap_ < MAX_ROW){
+    // No buffer (malloc failed): write the row on its own
+    char row[MAX_ROW];
+    size_t n = encodeRow(row, sizeof(row), bssid, ssid, auth, channel, rssi);
+    std::unique_ptr<PalFile> f = fs_.open(path_, "a");
+    if(!f) return false;
+    if(f->size() == 0) f->write((const uint8_t*)HEADER, strlen(HEADER));
+    flashAppends_++;
+    return f->write((const uint8_t*)row, n) == n;
+  }
+  if(used_ == 0) oldestMs_ = nowMs;
+  size_t n = encodeRow(buf_ + used_, cap_ - used_, bssid, ssid, auth, channel, rssi);
+  if(n == 0) return false;
+  used_ += n;
+  if(durability_ == FLUSH_EACH_ROW) return flush();
+  return true;
+}
+
+bool WigleLog::endScan() {
+  if(durability_ == FLUSH_PER_SCAN) return flush();
+  return true;
+}
+
+void WigleLog::service(uint32_t nowMs) {
+  if(used_ > 0 && durability_ == FLUSH_ON_TIMER && nowMs - oldestMs_ >= maxAgeMs_){
+    flush();
+  }
+}
+
+bool WigleLog::flush() {
+  if(used_ == 0) return true;
+  std::unique_ptr<PalFile> f = fs_.open(path_, "a");
+  if(!f) return false;
+  // If empty, write the original columns
+  if(f->size() == 0){
+    f->write((const uint8_t*)HEADER, strlen(HEADER));
+  }
+  flashAppends_++;
+  size_t wrote = f->write((const uint8_t*)buf_, used_);
+  if(wrote != used_){
+    // Keep only what didn't reach flash, so nothing is appended twice
+    memmove(buf_, buf_ + wrote, used_ - wrote);
+    used_ -= wrote;
+    return false;
+  }
+  used_ = 0;
+  return true;
+}
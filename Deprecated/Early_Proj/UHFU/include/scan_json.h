@@ -0,0 +1,31 @@
+// scan_json.h
+#ifndef SCAN_JSON_H
+#define SCAN_JSON_H
+
+#include <stddef.h>
+#include <string>
+
+// The /scan_wifi and /scan_bluetooth response bodies: pure C++, so the
+// host bench suite builds the same JSON the board sends.
+
+struct WiFiScanRow {
+    const char* ssid;
+    int rssi;
+    const char* encryption;
+    const char* bssid;
+};
+
+struct BluetoothScanRow {
+    const char* name;
+    const char* address;
+    int rssi;
+};
+
+// [{"SSID":..,"RSSI":..,"Encryption":..,"BSSID":..},...] into out
+// (replaced), sized once up front; quotes, backslashes and control
+// characters in the strings are escaped
+void wifiScanJson(const WiFiScanRow* rows, size_t count, std::string &out);
+// [{"Name":..,"Address":..,"RSSI":..},...] into out, the same way
+void bluetoothScanJson(const BluetoothScanRow* rows, size_t count, std::string &out);
+
+#endif
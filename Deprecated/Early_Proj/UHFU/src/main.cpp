@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include "wifi_scanner.h"
 #include "bluetooth_scanner.h"
+#include "scan_json.h"
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 
@@ -56,34 +57,26 @@ void setupWebServer() {
     // Route to scan Wi-Fi networks
     server.on("/scan_wifi", HTTP_GET, [&](AsyncWebServerRequest *request){
         std::vector<WiFiNetwork> networks = wifiScanner.scanNetworks();
-        String json = "[";
+        std::vector<WiFiScanRow> rows(networks.size());
         for (size_t i = 0; i < networks.size(); i++) {
-            json += "{";
-            json += "\"SSID\":\"" + networks[i].SSID + "\",";
-            json += "\"RSSI\":" + String(networks[i].RSSI) + ",";
-            json += "\"Encryption\":\"" + networks[i].encryptionType + "\",";
-            json += "\"BSSID\":\"" + networks[i].BSSID + "\"";
-            json += "}";
-            if (i < networks.size() - 1) json += ",";
+            rows[i] = { networks[i].SSID.c_str(), networks[i].RSSI,
+                        networks[i].encryptionType.c_str(), networks[i].BSSID.c_str() };
         }
-        json += "]";
-        request->send(200, "application/json", json);
+        std::string json;
+        wifiScanJson(rows.data(), rows.size(), json);
+        request->send(200, "application/json", json.c_str());
     });
 
     // Route to scan Bluetooth devices
     server.on("/scan_bluetooth", HTTP_GET, [&](AsyncWebServerRequest *request){
         std::vector<BluetoothDevice> devices = bluetoothScanner.scanDevices(5);
-        String json = "[";
+        std::vector<BluetoothScanRow> rows(devices.size());
         for (size_t i = 0; i < devices.size(); i++) {
-            json += "{";
-            json += "\"Name\":\"" + devices[i].name + "\",";
-            json += "\"Address\":\"" + devices[i].address + "\",";
-            json += "\"RSSI\":" + String(devices[i].rssi);
-            json += "}";
-            if (i < devices.size() - 1) json += ",";
+            rows[i] = { devices[i].name.c_str(), devices[i].address.c_str(), devices[i].rssi };
         }
-        json += "]";
-        request->send(200, "application/json", json);
+        std::string json;
+        bluetoothScanJson(rows.data(), rows.size(), json);
+        request->send(200, "application/json", json.c_str());
     });
 
     server.begin();
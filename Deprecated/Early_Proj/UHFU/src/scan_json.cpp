@@ -0,0 +1,96 @@
+// scan_json.cpp
+#include "scan_json.h"
+#include <stdio.h>
+#include <string.h>
+
+// Room for s as a JSON string, quotes included
+static size_t quotedLength(const char* s) {
+    size_t n = 2;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') n += 2;
+        else if (c < 0x20) n += 6;
+        else n++;
+    }
+    return n;
+}
+
+static void appendQuoted(std::string &out, const char* s) {
+    out += '"';
+    const char* run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+        out.append(run, s - run);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else {
+            char esc[7];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        }
+        run = s + 1;
+    }
+    out.append(run, s - run);
+    out += '"';
+}
+
+static void appendInt(std::string &out, int v) {
+    char buf[12];
+    char* p = buf + sizeof(buf);
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) *--p = '-';
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+void wifiScanJson(const WiFiScanRow* rows, size_t count, std::string &out) {
+    static const size_t FIXED = sizeof("{\"SSID\":,\"RSSI\":,\"Encryption\":,\"BSSID\":},") - 1 + 11;
+    size_t len = 2;
+    for (size_t i = 0; i < count; i++) {
+        len += FIXED + quotedLength(rows[i].ssid) + quotedLength(rows[i].encryption) +
+               quotedLength(rows[i].bssid);
+    }
+    out.clear();
+    out.reserve(len);
+    out += '[';
+    for (size_t i = 0; i < count; i++) {
+        if (i) out += ',';
+        out += "{\"SSID\":";
+        appendQuoted(out, rows[i].ssid);
+        out += ",\"RSSI\":";
+        appendInt(out, rows[i].rssi);
+        out += ",\"Encryption\":";
+        appendQuoted(out, rows[i].encryption);
+        out += ",\"BSSID\":";
+        appendQuoted(out, rows[i].bssid);
+        out += '}';
+    }
+    out += ']';
+}
+
+void bluetoothScanJson(const BluetoothScanRow* rows, size_t count, std::string &out) {
+    static const size_t FIXED = sizeof("{\"Name\":,\"Address\":,\"RSSI\":},") - 1 + 11;
+    size_t len = 2;
+    for (size_t i = 0; i < count; i++) {
+        len += FIXED + quotedLength(rows[i].name) + quotedLength(rows[i].address);
+    }
+    out.clear();
+    out.reserve(len);
+    out += '[';
+    for (size_t i = 0; i < count; i++) {
+        if (i) out += ',';
+        out += "{\"Name\":";
+        appendQuoted(out, rows[i].name);
+        out += ",\"Address\":";
+        appendQuoted(out, rows[i].address);
+        out += ",\"RSSI\":";
+        appendInt(out, rows[i].rssi);
+        out += '}';
+    }
+    out += ']';
+}
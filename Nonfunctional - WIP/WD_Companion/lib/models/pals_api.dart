@@ -0,0 +1,218 @@
+// lib/models/pals_api.dart
+// GENERATED from Packet Pals include/api_schema.h by
+// scripts/gen_api_models.py. Do not edit: change the schema and rerun.
+// Field order and names match the JSON the device sends.
+
+class PartyMonster {
+  final String name;
+  final int level;
+  final int hp;
+  final int defense;
+
+  const PartyMonster({
+    required this.name,
+    required this.level,
+    required this.hp,
+    required this.defense,
+  });
+
+  factory PartyMonster.fromJson(Map<String, dynamic> json) => PartyMonster(
+        name: json['name'] as String,
+        level: json['level'] as int,
+        hp: json['hp'] as int,
+        defense: json['defense'] as int,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'name': name,
+        'level': level,
+        'hp': hp,
+        'defense': defense,
+      };
+}
+
+class Party {
+  final int partySize;
+  final List<PartyMonster> party;
+
+  const Party({
+    required this.partySize,
+    required this.party,
+  });
+
+  factory Party.fromJson(Map<String, dynamic> json) => Party(
+        partySize: json['partySize'] as int,
+        party: (json['party'] as List)
+            .map((e) => PartyMonster.fromJson(e as Map<String, dynamic>))
+            .toList(),
+      );
+
+  Map<String, dynamic> toJson() => {
+        'partySize': partySize,
+        'party': party.map((e) => e.toJson()).toList(),
+      };
+}
+
+class PartyChange {
+  final String message;
+  final int partySize;
+  final List<PartyMonster> party;
+
+  const PartyChange({
+    required this.message,
+    required this.partySize,
+    required this.party,
+  });
+
+  factory PartyChange.fromJson(Map<String, dynamic> json) => PartyChange(
+        message: json['message'] as String,
+        partySize: json['partySize'] as int,
+        party: (json['party'] as List)
+            .map((e) => PartyMonster.fromJson(e as Map<String, dynamic>))
+            .toList(),
+      );
+
+  Map<String, dynamic> toJson() => {
+        'message': message,
+        'partySize': partySize,
+        'party': party.map((e) => e.toJson()).toList(),
+      };
+}
+
+class BattleStart {
+  final bool inProgress;
+  final String partyName;
+  final int partyLevel;
+  final int partyHP;
+  final String wildName;
+  final int wildLevel;
+  final int wildHP;
+
+  const BattleStart({
+    required this.inProgress,
+    required this.partyName,
+    required this.partyLevel,
+    required this.partyHP,
+    required this.wildName,
+    required this.wildLevel,
+    required this.wildHP,
+  });
+
+  factory BattleStart.fromJson(Map<String, dynamic> json) => BattleStart(
+        inProgress: json['inProgress'] as bool,
+        partyName: json['partyName'] as String,
+        partyLevel: json['partyLevel'] as int,
+        partyHP: json['partyHP'] as int,
+        wildName: json['wildName'] as String,
+        wildLevel: json['wildLevel'] as int,
+        wildHP: json['wildHP'] as int,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'inProgress': inProgress,
+        'partyName': partyName,
+        'partyLevel': partyLevel,
+        'partyHP': partyHP,
+        'wildName': wildName,
+        'wildLevel': wildLevel,
+        'wildHP': wildHP,
+      };
+}
+
+class BattleTurn {
+  final String message;
+  final int partyHP;
+  final int wildHP;
+  final bool battleEnd;
+
+  const BattleTurn({
+    required this.message,
+    required this.partyHP,
+    required this.wildHP,
+    required this.battleEnd,
+  });
+
+  factory BattleTurn.fromJson(Map<String, dynamic> json) => BattleTurn(
+        message: json['message'] as String,
+        partyHP: json['partyHP'] as int,
+        wildHP: json['wildHP'] as int,
+        battleEnd: json['battleEnd'] as bool,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'message': message,
+        'partyHP': partyHP,
+        'wildHP': wildHP,
+        'battleEnd': battleEnd,
+      };
+}
+
+class WildEntry {
+  final int id;
+  final String name;
+  final int level;
+
+  const WildEntry({
+    required this.id,
+    required this.name,
+    required this.level,
+  });
+
+  factory WildEntry.fromJson(Map<String, dynamic> json) => WildEntry(
+        id: json['id'] as int,
+        name: json['name'] as String,
+        level: json['level'] as int,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'id': id,
+        'name': name,
+        'level': level,
+      };
+}
+
+class MonsterPage {
+  final int total;
+  final List<WildEntry> monsters;
+  final int? nextCursor;
+
+  const MonsterPage({
+    required this.total,
+    required this.monsters,
+    this.nextCursor,
+  });
+
+  factory MonsterPage.fromJson(Map<String, dynamic> json) => MonsterPage(
+        total: json['total'] as int,
+        monsters: (json['monsters'] as List)
+            .map((e) => WildEntry.fromJson(e as Map<String, dynamic>))
+            .toList(),
+        nextCursor: json['nextCursor'] as int?,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'total': total,
+        'monsters': monsters.map((e) => e.toJson()).toList(),
+        'nextCursor': nextCursor,
+      };
+}
+
+class SyncPlayer {
+  final String name;
+  final int level;
+
+  const SyncPlayer({
+    required this.name,
+    required this.level,
+  });
+
+  factory SyncPlayer.fromJson(Map<String, dynamic> json) => SyncPlayer(
+        name: json['name'] as String,
+        level: json['level'] as int,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'name': name,
+        'level': level,
+      };
+}
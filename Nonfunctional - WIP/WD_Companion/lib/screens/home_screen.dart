@@ -31,6 +31,7 @@ class _HomeScreenState extends State<HomeScreen> {
 
       // Listen to BLE data stream and add Packet Pals
       bleService.dataStream?.listen((data) {
+        if (data['networks'] == null) return; // Packet Pals game records
         packetPalService.addPacketPals(data['networks']);
         setState(() {});
       });
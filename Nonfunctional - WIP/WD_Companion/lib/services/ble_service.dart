@@ -1,6 +1,7 @@
 import 'package:flutter_blue_plus/flutter_blue_plus.dart';
 import 'dart:convert';
 import 'dart:async';
+import 'pals_ble_codec.dart';
 
 class BLEService {
   final FlutterBluePlus flutterBlue = FlutterBluePlus.instance;
@@ -37,15 +38,13 @@ class BLEService {
                   if (c.uuid.toString() == CHARACTERISTIC_UUID) {
                     characteristic = c;
                     await c.setNotifyValue(true);
-                    c.value.listen((value) {
-                      String jsonString = utf8.decode(value);
-                      try {
-                        Map<String, dynamic> data = jsonDecode(jsonString);
-                        _dataController.add(data);
-                      } catch (e) {
-                        print('Error decoding JSON: $e');
-                      }
-                    });
+                    // binary frames (pals_ble_codec.dart); a lost frame
+                    // makes the device resend everything
+                    final decoder = PalsBleDecoder(
+                      onRecord: _dataController.add,
+                      onGap: () => c.write(utf8.encode('R'), withoutResponse: false),
+                    );
+                    c.value.listen(decoder.addFrame);
                   }
                 }
               }
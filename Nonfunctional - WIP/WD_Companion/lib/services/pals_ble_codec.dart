@@ -0,0 +1,102 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+/// Reassembles Packet Pals BLE notifications (firmware include/ble_frame.h)
+/// into records, each handed out as a map:
+///   {'type': 'wild', 'id', 'level', 'name'}
+///   {'type': 'roster', 'total', 'firstId'}
+///   {'type': 'party', 'playerLevel', 'party': [{'name', 'level', 'hp', 'defense'}]}
+/// [onGap] fires when a sequence number is skipped; the app should then
+/// write "R" so the device sends everything again.
+class PalsBleDecoder {
+  static const int frameStart = 0x01;
+  static const int frameEnd = 0x02;
+
+  final void Function(Map<String, dynamic> record) onRecord;
+  final void Function() onGap;
+
+  int? _expect;
+  bool _inMessage = false;
+  final BytesBuilder _message = BytesBuilder(copy: false);
+
+  PalsBleDecoder({required this.onRecord, required this.onGap});
+
+  void addFrame(List<int> frame) {
+    if (frame.length < 2) return;
+    final seq = frame[0];
+    final flags = frame[1];
+    if (_expect != null && seq != _expect) {
+      _inMessage = false;
+      onGap();
+    }
+    _expect = (seq + 1) & 0xFF;
+
+    if (flags & frameStart != 0) {
+      _inMessage = true;
+      _message.clear();
+    }
+    if (!_inMessage) return;
+    _message.add(frame.sublist(2));
+    if (flags & frameEnd != 0) {
+      _inMessage = false;
+      _deliver(_message.takeBytes());
+    }
+  }
+
+  void _deliver(Uint8List msg) {
+    var off = 0;
+    while (off + 2 <= msg.length) {
+      off += 2 + msg[off + 1];
+    }
+    if (off != msg.length) return; // malformed: deliver nothing
+    final data = ByteData.sublistView(msg);
+    for (off = 0; off < msg.length; off += 2 + msg[off + 1]) {
+      final record = _decode(msg[off], data, off + 2, msg[off + 1]);
+      if (record != null) onRecord(record);
+    }
+  }
+
+  Map<String, dynamic>? _decode(int type, ByteData d, int p, int len) {
+    String name(int at, int n) =>
+        utf8.decode(d.buffer.asUint8List(d.offsetInBytes + at, n), allowMalformed: true);
+    switch (type) {
+      case 1:
+        if (len < 5) return null;
+        return {
+          'type': 'wild',
+          'id': d.getUint32(p, Endian.little),
+          'level': d.getUint8(p + 4),
+          'name': name(p + 5, len - 5),
+        };
+      case 2:
+        if (len < 6) return null;
+        return {
+          'type': 'roster',
+          'total': d.getUint16(p, Endian.little),
+          'firstId': d.getUint32(p + 2, Endian.little),
+        };
+      case 3:
+        if (len < 3) return null;
+        final end = p + len;
+        final party = <Map<String, dynamic>>[];
+        var q = p + 3;
+        for (var i = 0; i < d.getUint8(p + 2); i++) {
+          if (q + 7 > end || q + 7 + d.getUint8(q + 6) > end) return null;
+          final n = d.getUint8(q + 6);
+          party.add({
+            'level': d.getUint16(q, Endian.little),
+            'hp': d.getInt16(q + 2, Endian.little),
+            'defense': d.getInt16(q + 4, Endian.little),
+            'name': name(q + 7, n),
+          });
+          q += 7 + n;
+        }
+        return {
+          'type': 'party',
+          'playerLevel': d.getUint16(p, Endian.little),
+          'party': party,
+        };
+    }
+    return null; // a newer firmware's record type
+  }
+}